@@ -0,0 +1,1983 @@
+#include "fs.h"
+#include "disk.h"
+#include "cache.h"
+#include "readahead.h"
+#include "disk_model.h"
+#include "disk_stats.h"
+#include "disk_sched.h"
+#include "disk_checksum.h"
+#include "disk_compress.h"
+#include "disk_dedup.h"
+#include "disk_thin.h"
+#include "disk_raid.h"
+#include "disk_discard.h"
+#include "bitmap.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define BENCH_IMAGE "test/images/user/bench.img"
+#define BENCH_BLOCKS 4096
+#define BENCH_ROUNDS 4
+#define BENCH_LARGE_BLOCKS (1 << 20) // 4 GB image
+#define BENCH_FILE_BLOCKS 615         // a 2.5 MB file, the size of write_test3a.pdf
+#define BENCH_LOOKUPS 20000
+#define BENCH_CACHE_BLOCKS 64
+#define BENCH_THREADS 8          // most threads in the stress run
+#define BENCH_THREAD_OPS 20000   // block operations per thread
+#define BENCH_CREATES 500         // files in the create/write workload
+#define BENCH_CREATE_BLOCKS 8     // data blocks per created file
+#define BENCH_METADATA_BLOCKS 64  // superblock, bitmaps, inode table and root directory
+#define BENCH_BEST_OF 3           // runs per row of the dedup comparison
+#define BENCH_CHECKSUM_IMAGE "test/images/user/bench_checksum.img"
+#define BENCH_CHECKSUM_PASSES 16  // passes over the blocks per row of the checksum comparison
+#define BENCH_COMPRESS_BLOCKS 1024 // a 4 MB image filled with one test file over and over
+#define BENCH_COMPRESS_RUN 64      // blocks per disk_writev/disk_readv of the compressed scans
+#define BENCH_DEDUP_COPIES 3       // copies of write_test3a.pdf in the duplicate-heavy dedup run
+#define BENCH_THIN_BLOCKS 26214400 // a 100 GB disk
+#define BENCH_THIN_EXTENTS 16      // extents of data spread over it
+#define BENCH_THIN_EXTENT 1024     // blocks per extent, 64 MB of data in all
+#define BENCH_RAID_BLOCKS 16384    // a 64 MB stream through the striped and mirrored disks
+#define BENCH_RAID_RUN 256         // blocks per disk_writev/disk_readv of the stream (1 MB)
+#define BENCH_RESYNC_DIRTY 4       // regions written while a member of the mirror is dropped
+#define BENCH_CHURN_BLOCKS 262144  // a 1 GB disk written over and over
+#define BENCH_CHURN_ROUND 4096     // blocks written per round of churn (16 MB)
+#define BENCH_CHURN_LIVE 4         // rounds of blocks kept at a time, the older ones freed
+#define BENCH_HUGE_BLOCKS (((int64_t)15 << 40) / BLOCK_SIZE) // a 15 TB sparse disk (ext4 files stop at 16 TB)
+#define BENCH_HUGE_PROBES 4096     // random blocks written and read back across it
+#define BENCH_GEOMETRY_BYTES (64 << 20) // file data written per test file in the block size run
+#define BENCH_GEOMETRY_COPIES 1024      // most copies of one file, so tiny files stay quick
+#define BENCH_BITMAP_BITS (1 << 24) // blocks of the disk whose bitmap is searched, 64 GB of 4 KB blocks
+#define BENCH_BITMAP_FREE 256       // blocks left free in it, scattered
+
+/**
+ * Returns a monotonic timestamp in nanoseconds.
+ */
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * Fills `order` with a pseudo-random permutation of 0..n-1 so every run touches the same blocks.
+ */
+static void shuffle_blocks(uint32_t *order, uint32_t n)
+{
+    srand(42);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+    for (uint32_t i = n - 1; i > 0; i--)
+    {
+        uint32_t j = rand() % (i + 1);
+        uint32_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+/**
+ * Returns 1 if the filesystem holding the bench image takes O_DIRECT transfers.
+ */
+static int direct_supported()
+{
+    struct vdisk *d = vdisk_init(BENCH_IMAGE, 1, DISK_DIRECT);
+    int direct = vdisk_direct(d);
+
+    if (d != NULL)
+    {
+        vdisk_close(d, 0);
+    }
+    return direct;
+}
+
+/**
+ * Baseline: the old stdio block path (fseek + fread/fwrite through a buffered FILE).
+ */
+static int bench_stdio(uint32_t *order, double *read_ns, double *write_ns)
+{
+    FILE *f = fopen(BENCH_IMAGE, "w+");
+    if (f == NULL)
+    {
+        printf("\tERROR: Could not open %s.\n", BENCH_IMAGE);
+        return -1;
+    }
+
+    union block block;
+    memset(block.data, 0xab, BLOCK_SIZE);
+
+    double start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t i = 0; i < BENCH_BLOCKS; i++)
+        {
+            fseek(f, (long)order[i] * BLOCK_SIZE, SEEK_SET);
+            fwrite(block.data, BLOCK_SIZE, 1, f);
+        }
+    }
+    fflush(f);
+    *write_ns = (now_ns() - start) / (BENCH_ROUNDS * BENCH_BLOCKS);
+
+    start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t i = 0; i < BENCH_BLOCKS; i++)
+        {
+            fseek(f, (long)order[i] * BLOCK_SIZE, SEEK_SET);
+            if (fread(block.data, BLOCK_SIZE, 1, f) != 1)
+            {
+                printf("\tERROR: stdio read of block %u failed.\n", order[i]);
+                fclose(f);
+                return -1;
+            }
+        }
+    }
+    *read_ns = (now_ns() - start) / (BENCH_ROUNDS * BENCH_BLOCKS);
+
+    fclose(f);
+    return 0;
+}
+
+/**
+ * The disk layer: disk_read/disk_write on the backend selected by `flags`. The disk statistics
+ * are left in `stats`.
+ */
+static int bench_disk(uint32_t *order, int flags, double *read_ns, double *write_ns, struct disk_stats *stats)
+{
+    if (disk_init_flags(BENCH_IMAGE, BENCH_BLOCKS, flags) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+
+    // Aligned, so O_DIRECT transfers need no extra copy.
+    union block *block = disk_alloc_blocks(1);
+    memset(block->data, 0xab, BLOCK_SIZE);
+
+    double start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t i = 0; i < BENCH_BLOCKS; i++)
+        {
+            if (disk_write(order[i], block->data) == -1)
+            {
+                disk_free_blocks(block);
+                disk_close(0);
+                return -1;
+            }
+        }
+    }
+    *write_ns = (now_ns() - start) / (BENCH_ROUNDS * BENCH_BLOCKS);
+
+    start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t i = 0; i < BENCH_BLOCKS; i++)
+        {
+            if (disk_read(order[i], block->data) == -1)
+            {
+                disk_free_blocks(block);
+                disk_close(0);
+                return -1;
+            }
+        }
+    }
+    *read_ns = (now_ns() - start) / (BENCH_ROUNDS * BENCH_BLOCKS);
+
+    disk_get_stats(stats);
+    disk_free_blocks(block);
+    return disk_close(0);
+}
+
+/**
+ * Zero-copy reads: disk_block() on a mapped disk, touching one word per block.
+ */
+static int bench_disk_block(uint32_t *order, double *read_ns)
+{
+    if (disk_init_flags(BENCH_IMAGE, BENCH_BLOCKS, DISK_MMAP) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+
+    volatile uint32_t sink = 0;
+
+    double start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t i = 0; i < BENCH_BLOCKS; i++)
+        {
+            const union block *block = disk_block(order[i]);
+            if (block == NULL)
+            {
+                disk_close(0);
+                return -1;
+            }
+            sink += block->bitmap[0];
+        }
+    }
+    *read_ns = (now_ns() - start) / (BENCH_ROUNDS * BENCH_BLOCKS);
+
+    (void)sink;
+    return disk_close(0);
+}
+
+/**
+ * Whole-file transfer: a contiguous file moved block by block versus as one disk_readv/disk_writev list.
+ */
+static int bench_vectored(double *loop_ms, double *vec_read_ms, double *vec_write_ms)
+{
+    if (disk_init(BENCH_IMAGE, BENCH_BLOCKS) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+
+    union block *file = malloc(BENCH_FILE_BLOCKS * sizeof(union block));
+    struct disk_iovec *iov = malloc(BENCH_FILE_BLOCKS * sizeof(struct disk_iovec));
+
+    for (int i = 0; i < BENCH_FILE_BLOCKS; i++)
+    {
+        iov[i].blocknum = 100 + i;
+        iov[i].buf = file[i].data;
+    }
+
+    double start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (int i = 0; i < BENCH_FILE_BLOCKS; i++)
+        {
+            disk_read(iov[i].blocknum, iov[i].buf);
+        }
+    }
+    *loop_ms = (now_ns() - start) / 1e6 / BENCH_ROUNDS;
+
+    start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        disk_readv(iov, BENCH_FILE_BLOCKS);
+    }
+    *vec_read_ms = (now_ns() - start) / 1e6 / BENCH_ROUNDS;
+
+    start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        disk_writev(iov, BENCH_FILE_BLOCKS);
+    }
+    *vec_write_ms = (now_ns() - start) / 1e6 / BENCH_ROUNDS;
+
+    free(iov);
+    free(file);
+    return disk_close(0);
+}
+
+/**
+ * Asynchronous writes at a given queue depth, through the engine selected by `flags`.
+ * Returns the engine actually used, or -1.
+ */
+static int bench_async(uint32_t *order, int queue_depth, int flags, double *write_ns)
+{
+    if (disk_init(BENCH_IMAGE, BENCH_BLOCKS) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+
+    if (disk_async_init(queue_depth, flags) == -1)
+    {
+        disk_close(0);
+        return -1;
+    }
+    int engine = disk_async_engine();
+
+    union block block;
+    memset(block.data, 0xab, BLOCK_SIZE);
+
+    double start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t i = 0; i < BENCH_BLOCKS; i++)
+        {
+            disk_async_write(order[i], block.data, NULL, NULL);
+        }
+    }
+    disk_async_wait(0);
+    *write_ns = (now_ns() - start) / (BENCH_ROUNDS * BENCH_BLOCKS);
+
+    disk_close(0);
+    return engine;
+}
+
+/**
+ * Metadata-heavy load: each path lookup reads the superblock, both bitmaps, an inode table block
+ * and a directory block, the way fs.c walks a path. Returns the physical block reads.
+ */
+static long bench_lookups(int cache_blocks, int flags, double *lookup_ns)
+{
+    if (disk_init_flags(BENCH_IMAGE, BENCH_BLOCKS, flags) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+
+    if (cache_blocks > 0 && cache_init(cache_blocks) == -1)
+    {
+        disk_close(0);
+        return -1;
+    }
+
+    union block block;
+    long block_reads = 0;
+    srand(7);
+
+    double start = now_ns();
+    for (int i = 0; i < BENCH_LOOKUPS; i++)
+    {
+        uint32_t path[5] = {0, 1, 2, 3 + rand() % 16, 19 + rand() % 32};
+
+        for (int j = 0; j < 5; j++)
+        {
+            disk_read(path[j], block.data);
+            block_reads++;
+        }
+    }
+    *lookup_ns = (now_ns() - start) / BENCH_LOOKUPS;
+
+    // Without a cache every block read is a physical read.
+    struct cache_stats stats;
+    cache_get_stats(&stats);
+    long physical = cache_blocks > 0 ? (long)stats.misses : block_reads;
+
+    disk_close(0);
+    return physical;
+}
+
+/**
+ * Streams a file of BENCH_FILE_BLOCKS blocks one block at a time, as copy_out does through
+ * fs_read, optionally with the cache and read-ahead. Returns MB/s, or -1.
+ */
+static double bench_stream(int readahead)
+{
+    // Small blocks cap the file at what the direct and indirect pointers reach.
+    uint32_t file_blocks = BENCH_FILE_BLOCKS;
+    if (file_blocks > INODE_DIRECT_POINTERS + INODE_INDIRECT_POINTERS_PER_BLOCK)
+    {
+        file_blocks = INODE_DIRECT_POINTERS + INODE_INDIRECT_POINTERS_PER_BLOCK;
+    }
+
+    if (disk_init(BENCH_IMAGE, BENCH_BLOCKS) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+
+    // Lay the file out like fs.c would: direct blocks, then an indirect block for the rest.
+    struct inode inode;
+    union block indirect, block;
+    memset(&inode, 0, sizeof(inode));
+    memset(&indirect, 0, sizeof(indirect));
+    memset(block.data, 0xcd, BLOCK_SIZE);
+
+    inode.i_size = (uint64_t)file_blocks * BLOCK_SIZE;
+    inode.i_single_indirect_pointer = 99;
+    for (uint32_t i = 0; i < file_blocks; i++)
+    {
+        uint64_t blocknum = 100 + i;
+        if (i < INODE_DIRECT_POINTERS)
+        {
+            inode.i_direct_pointers[i] = blocknum;
+        }
+        else
+        {
+            indirect.pointers[i - INODE_DIRECT_POINTERS] = blocknum;
+        }
+        disk_write(blocknum, block.data);
+    }
+    disk_write(99, indirect.data);
+
+    if (readahead && (cache_init(4 * BENCH_CACHE_BLOCKS) == -1 || readahead_init(BENCH_CACHE_BLOCKS) == -1))
+    {
+        disk_close(0);
+        return -1;
+    }
+
+    double start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t i = 0; i < file_blocks; i++)
+        {
+            if (readahead)
+            {
+                readahead_access(1, &inode, i);
+            }
+
+            // Resolve the block the way fs_read would, through the indirect block past the direct pointers.
+            uint64_t blocknum = inode.i_direct_pointers[i < INODE_DIRECT_POINTERS ? i : 0];
+            if (i >= INODE_DIRECT_POINTERS)
+            {
+                disk_read(inode.i_single_indirect_pointer, indirect.data);
+                blocknum = indirect.pointers[i - INODE_DIRECT_POINTERS];
+            }
+            disk_read(blocknum, block.data);
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    readahead_close();
+    disk_close(0);
+    return (double)BENCH_ROUNDS * file_blocks * BLOCK_SIZE / seconds / 1e6;
+}
+
+/**
+ * Startup cost: creating a large image, then reopening it without reformatting.
+ */
+static int bench_startup(double *create_ms, double *open_ms)
+{
+    double start = now_ns();
+    if (disk_init(BENCH_IMAGE, BENCH_LARGE_BLOCKS) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+    *create_ms = (now_ns() - start) / 1e6;
+    disk_close(0);
+
+    start = now_ns();
+    if (disk_open(BENCH_IMAGE, 0) == -1 || disk_size() != BENCH_LARGE_BLOCKS)
+    {
+        printf("\tERROR: Could not reopen disk.\n");
+        return -1;
+    }
+    *open_ms = (now_ns() - start) / 1e6;
+    disk_close(0);
+
+    // Leave a small image behind rather than a 4 GB one.
+    disk_init(BENCH_IMAGE, 0);
+    return disk_close(0);
+}
+
+/**
+ * Simulated time to read a BENCH_FILE_BLOCKS-block file on a modelled device, block by block
+ * and with one disk_readv. `layout` places file block i on disk block layout[i].
+ */
+static int bench_model(int profile, const uint32_t *layout, double *loop_ms, double *vec_ms)
+{
+    struct disk_model model;
+    struct disk_model_stats stats;
+
+    if (disk_init(BENCH_IMAGE, BENCH_BLOCKS) == -1 || disk_model_preset(profile, &model) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+
+    union block *file = malloc(BENCH_FILE_BLOCKS * sizeof(union block));
+    struct disk_iovec *iov = malloc(BENCH_FILE_BLOCKS * sizeof(struct disk_iovec));
+
+    for (int i = 0; i < BENCH_FILE_BLOCKS; i++)
+    {
+        iov[i].blocknum = layout[i];
+        iov[i].buf = file[i].data;
+    }
+
+    // Start every run with the arm parked on block 0.
+    disk_model_init(&model);
+    for (int i = 0; i < BENCH_FILE_BLOCKS; i++)
+    {
+        disk_read(iov[i].blocknum, iov[i].buf);
+    }
+    disk_model_get_stats(&stats);
+    *loop_ms = stats.elapsed_ns / 1e6;
+
+    disk_model_init(&model);
+    disk_readv(iov, BENCH_FILE_BLOCKS);
+    disk_model_get_stats(&stats);
+    *vec_ms = stats.elapsed_ns / 1e6;
+
+    free(iov);
+    free(file);
+    return disk_close(0);
+}
+
+/**
+ * A create/write workload on the modelled HDD: every file updates both bitmaps, its inode
+ * block and the directory, then writes its data blocks. With `depth` > 0 the writes go through
+ * a scheduler of that depth. Reports the simulated time and seeks, including the final flush.
+ */
+static int bench_sched(int depth, double *sim_ms, unsigned long long *seeks)
+{
+    struct disk_model model;
+    struct disk_model_stats stats;
+    union block block;
+
+    if (disk_init(BENCH_IMAGE, BENCH_BLOCKS) == -1 || disk_model_preset(DISK_MODEL_HDD, &model) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+
+    if (depth > 0 && disk_sched_init(depth, 0) == -1)
+    {
+        disk_close(0);
+        return -1;
+    }
+    disk_sched_metadata(BENCH_METADATA_BLOCKS);
+
+    memset(block.data, 0x5a, BLOCK_SIZE);
+    disk_model_init(&model);
+
+    for (int f = 0; f < BENCH_CREATES; f++)
+    {
+        uint32_t metadata[4] = {1, 2, 3 + f / INODES_PER_BLOCK % 40, 50};
+
+        for (int i = 0; i < 4; i++)
+        {
+            disk_write(metadata[i], block.data);
+        }
+
+        for (int i = 0; i < BENCH_CREATE_BLOCKS; i++)
+        {
+            disk_write(BENCH_METADATA_BLOCKS + f * BENCH_CREATE_BLOCKS + i, block.data);
+        }
+    }
+
+    disk_flush();
+    disk_model_get_stats(&stats);
+    *sim_ms = stats.elapsed_ns / 1e6;
+    *seeks = stats.seeks;
+
+    return disk_close(0);
+}
+
+/**
+ * Results of one compressed-image run.
+ *
+ * @param ratio The bytes of the blocks over the bytes stored for them.
+ * @param write_mbs Filling the image with disk_writev, in MB/s of blocks.
+ * @param scan_mbs Reading it back with disk_readv, in MB/s of blocks.
+ * @param stored_per_byte The bytes read from the image per byte of the scan.
+ * @param hdd_ms, ssd_ms The scan on the modelled devices.
+ */
+struct compress_result
+{
+    double ratio;
+    double write_mbs;
+    double scan_mbs;
+    double stored_per_byte;
+    double hdd_ms;
+    double ssd_ms;
+};
+
+/**
+ * Fills a BENCH_COMPRESS_BLOCKS-block image with the contents of `path` over and over, then
+ * scans it, in runs of BENCH_COMPRESS_RUN blocks. `flags` is 0 or DISK_COMPRESS.
+ */
+static int bench_compress(const char *path, int flags, int level, struct compress_result *r)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("\tERROR: Could not open %s.\n", path);
+        return -1;
+    }
+
+    uint8_t *data = malloc((size_t)BENCH_COMPRESS_BLOCKS * BLOCK_SIZE);
+    size_t size = fread(data, 1, (size_t)BENCH_COMPRESS_BLOCKS * BLOCK_SIZE, file);
+    fclose(file);
+
+    for (size_t i = size; size > 0 && i < (size_t)BENCH_COMPRESS_BLOCKS * BLOCK_SIZE; i++)
+    {
+        data[i] = data[i % size];
+    }
+
+    if (size == 0 || disk_init_flags(BENCH_IMAGE, BENCH_COMPRESS_BLOCKS, flags) == -1 ||
+        ((flags & DISK_COMPRESS) && disk_compress_level(level) == -1))
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        free(data);
+        return -1;
+    }
+
+    struct disk_iovec iov[BENCH_COMPRESS_RUN];
+    struct disk_model model;
+    struct disk_model_stats mstats;
+    struct disk_compress_stats zstats;
+    double scan_ns[3];
+
+    double start = now_ns();
+    for (int b = 0; b < BENCH_COMPRESS_BLOCKS; b += BENCH_COMPRESS_RUN)
+    {
+        for (int i = 0; i < BENCH_COMPRESS_RUN; i++)
+        {
+            iov[i].blocknum = b + i;
+            iov[i].buf = data + (size_t)(b + i) * BLOCK_SIZE;
+        }
+        disk_writev(iov, BENCH_COMPRESS_RUN);
+    }
+    r->write_mbs = (double)BENCH_COMPRESS_BLOCKS * BLOCK_SIZE / (now_ns() - start) * 1e3;
+
+    // Scan three times: unmodelled, then on the modelled HDD and SSD.
+    for (int m = 0; m < 3; m++)
+    {
+        if (m > 0)
+        {
+            disk_model_preset(m == 1 ? DISK_MODEL_HDD : DISK_MODEL_SSD, &model);
+            disk_model_init(&model);
+        }
+
+        start = now_ns();
+        for (int b = 0; b < BENCH_COMPRESS_BLOCKS; b += BENCH_COMPRESS_RUN)
+        {
+            for (int i = 0; i < BENCH_COMPRESS_RUN; i++)
+            {
+                iov[i].blocknum = b + i;
+                iov[i].buf = data + (size_t)(b + i) * BLOCK_SIZE;
+            }
+            disk_readv(iov, BENCH_COMPRESS_RUN);
+        }
+        scan_ns[m] = now_ns() - start;
+
+        disk_model_get_stats(&mstats);
+        *(m == 1 ? &r->hdd_ms : &r->ssd_ms) = mstats.elapsed_ns / 1e6;
+    }
+
+    r->scan_mbs = (double)BENCH_COMPRESS_BLOCKS * BLOCK_SIZE / scan_ns[0] * 1e3;
+    r->ratio = 1;
+    r->stored_per_byte = 1;
+
+    disk_compress_get_stats(&zstats);
+    if ((flags & DISK_COMPRESS) && zstats.stored_bytes > 0 && zstats.read_bytes > 0)
+    {
+        r->ratio = (double)zstats.blocks * BLOCK_SIZE / zstats.stored_bytes;
+        r->stored_per_byte = (double)zstats.read_stored / zstats.read_bytes;
+    }
+
+    free(data);
+    return disk_close(0);
+}
+
+/**
+ * Results of one deduplication run.
+ *
+ * @param write_mbs Writing the blocks with disk_writev, in MB/s of blocks, best of BENCH_BEST_OF.
+ * @param ratio The blocks written over the copies stored for them.
+ * @param hits The blocks whose data was already stored.
+ */
+struct dedup_result
+{
+    double write_mbs;
+    double ratio;
+    unsigned long long hits;
+};
+
+/**
+ * Writes `blocks` blocks of `data` to a new image in runs of BENCH_COMPRESS_RUN blocks, the
+ * best of BENCH_BEST_OF times. `flags` is 0 or DISK_DEDUP.
+ */
+static int bench_dedup(uint8_t *data, int blocks, int flags, struct dedup_result *r)
+{
+    struct disk_iovec iov[BENCH_COMPRESS_RUN];
+    struct disk_dedup_stats ustats;
+
+    r->write_mbs = 0;
+    for (int round = 0; round < BENCH_BEST_OF; round++)
+    {
+        if (disk_init_flags(BENCH_IMAGE, blocks, flags) == -1)
+        {
+            printf("\tERROR: Could not initialize disk.\n");
+            return -1;
+        }
+
+        double start = now_ns();
+        for (int b = 0; b < blocks; b += BENCH_COMPRESS_RUN)
+        {
+            int n = blocks - b < BENCH_COMPRESS_RUN ? blocks - b : BENCH_COMPRESS_RUN;
+
+            for (int i = 0; i < n; i++)
+            {
+                iov[i].blocknum = b + i;
+                iov[i].buf = data + (size_t)(b + i) * BLOCK_SIZE;
+            }
+            disk_writev(iov, n);
+        }
+
+        double mbs = (double)blocks * BLOCK_SIZE / (now_ns() - start) * 1e3;
+        if (mbs > r->write_mbs)
+        {
+            r->write_mbs = mbs;
+        }
+
+        disk_dedup_get_stats(&ustats);
+        r->ratio = ustats.stored > 0 ? (double)ustats.blocks / ustats.stored : 1;
+        r->hits = ustats.hits;
+
+        if (disk_close(0) != 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Results of one thin-provisioning run.
+ *
+ * @param write_mbs Writing the data with disk_writev, in MB/s.
+ * @param scan_mbs Reading it back with disk_readv, in MB/s.
+ * @param hole_mbs Reading as many blocks that were never written, in MB/s.
+ * @param open_ms Reopening the image.
+ * @param file_mb The size of the image file.
+ * @param used_mb The space the host filesystem gives it.
+ */
+struct thin_result
+{
+    double write_mbs;
+    double scan_mbs;
+    double hole_mbs;
+    double open_ms;
+    double file_mb;
+    double used_mb;
+};
+
+/**
+ * Moves the BENCH_THIN_EXTENTS extents of a BENCH_THIN_BLOCKS-block disk in runs of
+ * BENCH_COMPRESS_RUN blocks, or the blocks just after them, which were never written.
+ *
+ * @return Returns the MB/s of blocks moved.
+ */
+static double thin_pass(int write, int holes, uint8_t *data)
+{
+    struct disk_iovec iov[BENCH_COMPRESS_RUN];
+    double start = now_ns();
+
+    for (int e = 0; e < BENCH_THIN_EXTENTS; e++)
+    {
+        uint64_t first = (uint32_t)e * (BENCH_THIN_BLOCKS / BENCH_THIN_EXTENTS) + (holes ? BENCH_THIN_EXTENT : 0);
+
+        for (int b = 0; b < BENCH_THIN_EXTENT; b += BENCH_COMPRESS_RUN)
+        {
+            for (int i = 0; i < BENCH_COMPRESS_RUN; i++)
+            {
+                iov[i].blocknum = first + b + i;
+                iov[i].buf = data + (size_t)i * BLOCK_SIZE;
+                if (write)
+                {
+                    memcpy(iov[i].buf, &iov[i].blocknum, sizeof(iov[i].blocknum));
+                }
+            }
+            write ? disk_writev(iov, BENCH_COMPRESS_RUN) : disk_readv(iov, BENCH_COMPRESS_RUN);
+        }
+    }
+
+    return (double)BENCH_THIN_EXTENTS * BENCH_THIN_EXTENT * BLOCK_SIZE / (now_ns() - start) * 1e3;
+}
+
+/**
+ * Writes 64 MB spread over a 100 GB disk, then reads it back and reads as much that was never
+ * written. `flags` is 0 or DISK_THIN.
+ */
+static int bench_thin(int flags, struct thin_result *r)
+{
+    uint8_t *data = malloc((size_t)BENCH_COMPRESS_RUN * BLOCK_SIZE);
+    struct stat st;
+
+    for (int i = 0; data != NULL && i < BENCH_COMPRESS_RUN * BLOCK_SIZE; i++)
+    {
+        data[i] = rand();
+    }
+
+    if (data == NULL || disk_init_flags(BENCH_IMAGE, BENCH_THIN_BLOCKS, flags) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        free(data);
+        return -1;
+    }
+
+    r->write_mbs = thin_pass(1, 0, data);
+    disk_close(0);
+
+    double start = now_ns();
+    if (disk_open(BENCH_IMAGE, flags) == -1)
+    {
+        printf("\tERROR: Could not reopen disk.\n");
+        free(data);
+        return -1;
+    }
+    r->open_ms = (now_ns() - start) / 1e6;
+
+    r->scan_mbs = thin_pass(0, 0, data);
+    r->hole_mbs = thin_pass(0, 1, data);
+    disk_close(0);
+
+    stat(BENCH_IMAGE, &st);
+    r->file_mb = st.st_size / 1e6;
+    r->used_mb = st.st_blocks * 512 / 1e6;
+
+    // Leave a small image behind rather than a 100 GB one.
+    disk_init(BENCH_IMAGE, 0);
+    free(data);
+    return disk_close(0);
+}
+
+/**
+ * Takes a snapshot of a thin-provisioned 100 GB disk holding 64 MB, and rewrites the data
+ * before it, just after it (every block copied) and once more (every block in place again).
+ */
+static int bench_snapshot(double *snap_ms, double *before_mbs, double *cow_mbs, double *after_mbs)
+{
+    uint8_t *data = malloc((size_t)BENCH_COMPRESS_RUN * BLOCK_SIZE);
+
+    for (int i = 0; data != NULL && i < BENCH_COMPRESS_RUN * BLOCK_SIZE; i++)
+    {
+        data[i] = rand();
+    }
+
+    if (data == NULL || disk_init_flags(BENCH_IMAGE, BENCH_THIN_BLOCKS, DISK_THIN) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        free(data);
+        return -1;
+    }
+
+    thin_pass(1, 0, data);
+    *before_mbs = thin_pass(1, 0, data);
+
+    double start = now_ns();
+    if (disk_thin_snapshot("bench") == -1)
+    {
+        free(data);
+        disk_close(0);
+        return -1;
+    }
+    *snap_ms = (now_ns() - start) / 1e6;
+
+    *cow_mbs = thin_pass(1, 0, data);
+    *after_mbs = thin_pass(1, 0, data);
+    disk_close(0);
+
+    // Leave a small image behind.
+    disk_init(BENCH_IMAGE, 0);
+    free(data);
+    return disk_close(0);
+}
+
+/**
+ * The member images of the striped and mirrored runs, and the spare one of the resync run.
+ */
+static char *raid_members[] = {"test/images/user/bench_raid0.img", "test/images/user/bench_raid1.img",
+                               "test/images/user/bench_raid2.img", "test/images/user/bench_raid3.img",
+                               "test/images/user/bench_raid_spare.img"};
+
+/**
+ * Writes a BENCH_RAID_BLOCKS stream to a disk striped (level 0) or mirrored (level 1) across
+ * `members` images and flushes it, then reads it back, in runs of BENCH_RAID_RUN blocks.
+ */
+static int bench_raid(int level, int members, double *write_mbs, double *read_mbs)
+{
+    uint8_t *data = disk_alloc_blocks(BENCH_RAID_RUN);
+    struct disk_iovec iov[BENCH_RAID_RUN];
+
+    for (int i = 0; data != NULL && i < BENCH_RAID_RUN * BLOCK_SIZE; i++)
+    {
+        data[i] = rand();
+    }
+
+    int result = -1;
+    if (data != NULL && level == 0)
+    {
+        result = disk_init_raid(raid_members, members, BENCH_RAID_BLOCKS, 0, 0);
+    }
+    else if (data != NULL)
+    {
+        result = disk_init_mirror(raid_members, members, BENCH_RAID_BLOCKS, 0);
+    }
+
+    if (result == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        disk_free_blocks(data);
+        return -1;
+    }
+
+    for (int write = 1; write >= 0; write--)
+    {
+        double start = now_ns();
+
+        for (uint64_t b = 0; b < BENCH_RAID_BLOCKS; b += BENCH_RAID_RUN)
+        {
+            for (int i = 0; i < BENCH_RAID_RUN; i++)
+            {
+                iov[i].blocknum = b + i;
+                iov[i].buf = data + (size_t)i * BLOCK_SIZE;
+            }
+            write ? disk_writev(iov, BENCH_RAID_RUN) : disk_readv(iov, BENCH_RAID_RUN);
+        }
+
+        if (write)
+        {
+            disk_flush();
+        }
+
+        *(write ? write_mbs : read_mbs) = (double)BENCH_RAID_BLOCKS * BLOCK_SIZE / (now_ns() - start) * 1e3;
+    }
+
+    disk_close(0);
+    disk_free_blocks(data);
+
+    for (int i = 0; i < members; i++)
+    {
+        remove(raid_members[i]);
+    }
+
+    return 0;
+}
+
+/**
+ * Fills a BENCH_RAID_BLOCKS disk mirrored on two images, drops the second, writes a block in
+ * each of BENCH_RESYNC_DIRTY regions, then times bringing it back with disk_raid_replace(): first
+ * the member itself, which gets the regions written, then a new image, which gets them all.
+ */
+static int bench_resync(double *dirty_ms, uint64_t *dirty_blocks, double *full_ms, uint64_t *full_blocks)
+{
+    uint8_t *data = disk_alloc_blocks(BENCH_RAID_RUN);
+    struct disk_iovec iov[BENCH_RAID_RUN];
+    struct disk_raid_stats stats;
+
+    for (int i = 0; data != NULL && i < BENCH_RAID_RUN * BLOCK_SIZE; i++)
+    {
+        data[i] = rand();
+    }
+
+    if (data == NULL || disk_init_mirror(raid_members, 2, BENCH_RAID_BLOCKS, 0) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        disk_free_blocks(data);
+        return -1;
+    }
+
+    for (uint64_t b = 0; b < BENCH_RAID_BLOCKS; b += BENCH_RAID_RUN)
+    {
+        for (int i = 0; i < BENCH_RAID_RUN; i++)
+        {
+            iov[i].blocknum = b + i;
+            iov[i].buf = data + (size_t)i * BLOCK_SIZE;
+        }
+        disk_writev(iov, BENCH_RAID_RUN);
+    }
+    disk_flush();
+
+    // Drop the second member and write behind its back.
+    disk_raid_fail(1);
+    for (int r = 0; r < BENCH_RESYNC_DIRTY; r++)
+    {
+        disk_write(r * (BENCH_RAID_BLOCKS / BENCH_RESYNC_DIRTY), data);
+    }
+    disk_flush();
+
+    double start = now_ns();
+    int result = disk_raid_replace(1, raid_members[1]);
+    *dirty_ms = (now_ns() - start) / 1e6;
+    disk_raid_get_stats(&stats);
+    *dirty_blocks = stats.resynced;
+
+    disk_raid_fail(1);
+    start = now_ns();
+    result |= disk_raid_replace(1, raid_members[4]);
+    *full_ms = (now_ns() - start) / 1e6;
+    disk_raid_get_stats(&stats);
+    *full_blocks = stats.resynced - *dirty_blocks;
+
+    disk_close(0);
+    disk_free_blocks(data);
+
+    for (int i = 0; i < 5; i++)
+    {
+        remove(raid_members[i]);
+    }
+
+    return result;
+}
+
+/**
+ * Results of one churn run.
+ */
+struct churn_result
+{
+    double write_mbs;
+    double used_mb;
+    double freed_mbs;
+};
+
+/**
+ * Writes BENCH_CHURN_ROUND blocks at a time across a BENCH_CHURN_BLOCKS disk, like a file
+ * system replacing its files, and frees the round written BENCH_CHURN_LIVE rounds before, with
+ * disk_discard() if `discard` is set. Then reads back the blocks freed.
+ */
+static int bench_churn(int discard, struct churn_result *r)
+{
+    uint8_t *data = disk_alloc_blocks(BENCH_RAID_RUN);
+    struct disk_iovec iov[BENCH_RAID_RUN];
+    int rounds = BENCH_CHURN_BLOCKS / BENCH_CHURN_ROUND;
+    struct stat st;
+
+    for (int i = 0; data != NULL && i < BENCH_RAID_RUN * BLOCK_SIZE; i++)
+    {
+        data[i] = rand();
+    }
+
+    if (data == NULL || disk_init(BENCH_IMAGE, BENCH_CHURN_BLOCKS) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        disk_free_blocks(data);
+        return -1;
+    }
+
+    double start = now_ns();
+    for (int round = 0; round < rounds; round++)
+    {
+        for (uint64_t b = 0; b < BENCH_CHURN_ROUND; b += BENCH_RAID_RUN)
+        {
+            for (int i = 0; i < BENCH_RAID_RUN; i++)
+            {
+                iov[i].blocknum = round * BENCH_CHURN_ROUND + b + i;
+                iov[i].buf = data + (size_t)i * BLOCK_SIZE;
+            }
+            disk_writev(iov, BENCH_RAID_RUN);
+        }
+
+        if (discard && round >= BENCH_CHURN_LIVE)
+        {
+            disk_discard((round - BENCH_CHURN_LIVE) * BENCH_CHURN_ROUND, BENCH_CHURN_ROUND);
+        }
+    }
+    disk_flush();
+    r->write_mbs = (double)BENCH_CHURN_BLOCKS * BLOCK_SIZE / (now_ns() - start) * 1e3;
+
+    stat(BENCH_IMAGE, &st);
+    r->used_mb = st.st_blocks * 512 / 1e6;
+
+    // Read back every block freed.
+    uint32_t freed = (rounds - BENCH_CHURN_LIVE) * BENCH_CHURN_ROUND;
+    start = now_ns();
+    for (uint64_t b = 0; b < freed; b += BENCH_RAID_RUN)
+    {
+        for (int i = 0; i < BENCH_RAID_RUN; i++)
+        {
+            iov[i].blocknum = b + i;
+            iov[i].buf = data + (size_t)i * BLOCK_SIZE;
+        }
+        disk_readv(iov, BENCH_RAID_RUN);
+    }
+    r->freed_mbs = (double)freed * BLOCK_SIZE / (now_ns() - start) * 1e3;
+
+    disk_close(0);
+    disk_free_blocks(data);
+
+    // Leave a small image behind rather than a 1 GB one.
+    disk_init(BENCH_IMAGE, 0);
+    return disk_close(0);
+}
+
+/**
+ * Results of the large-image run.
+ */
+struct huge_result
+{
+    double create_ms;
+    double open_ms;
+    double write_us;
+    double read_us;
+    double used_mb;
+    long mismatches;
+};
+
+/**
+ * Stamps a block with its number, so a block read from the wrong offset is caught.
+ */
+static void stamp_block(uint8_t *buf, uint64_t blocknum)
+{
+    uint64_t *words = (uint64_t *)buf;
+
+    for (int w = 0; w < BLOCK_SIZE / 8; w++)
+    {
+        words[w] = blocknum * 0x9e3779b97f4a7c15ull ^ w;
+    }
+}
+
+/**
+ * Writes stamped blocks across a BENCH_HUGE_BLOCKS sparse image: the blocks on each side of the
+ * 4 GB offset, of block 2^31 (the middle block, with blocks too large to reach it) and of the end,
+ * a disk_writev run straddling that block, and BENCH_HUGE_PROBES random blocks. Then reopens the
+ * image and reads every block back.
+ */
+static int bench_huge(struct huge_result *r)
+{
+    uint64_t mid = BENCH_HUGE_BLOCKS > (1ll << 31) ? 1ull << 31 : BENCH_HUGE_BLOCKS / 2;
+    uint64_t four_gb = (1ull << 32) / BLOCK_SIZE;
+    uint64_t fixed[] = {0, four_gb - 1, four_gb, mid - 1, mid, BENCH_HUGE_BLOCKS - 1};
+    int nfixed = sizeof(fixed) / sizeof(fixed[0]);
+    uint64_t *probes = malloc((nfixed + BENCH_HUGE_PROBES) * sizeof(uint64_t));
+    uint8_t *data = disk_alloc_blocks(BENCH_RAID_RUN);
+    struct disk_iovec iov[BENCH_RAID_RUN];
+    union block block;
+    struct stat st;
+
+    memset(r, 0, sizeof(*r));
+    if (probes == NULL || data == NULL)
+    {
+        printf("\tERROR: Out of memory.\n");
+        free(probes);
+        disk_free_blocks(data);
+        return -1;
+    }
+
+    memcpy(probes, fixed, sizeof(fixed));
+    for (int i = 0; i < BENCH_HUGE_PROBES; i++)
+    {
+        probes[nfixed + i] = (((uint64_t)rand() << 31) ^ (uint64_t)rand()) % BENCH_HUGE_BLOCKS;
+    }
+
+    double start = now_ns();
+    if (disk_init(BENCH_IMAGE, BENCH_HUGE_BLOCKS) == -1)
+    {
+        printf("\tERROR: Could not initialize a %lld-block disk.\n", (long long)BENCH_HUGE_BLOCKS);
+        free(probes);
+        disk_free_blocks(data);
+        return -1;
+    }
+    r->create_ms = (now_ns() - start) / 1e6;
+
+    start = now_ns();
+    for (int i = 0; i < nfixed + BENCH_HUGE_PROBES; i++)
+    {
+        stamp_block(block.data, probes[i]);
+        disk_write(probes[i], block.data);
+    }
+    r->write_us = (now_ns() - start) / (nfixed + BENCH_HUGE_PROBES) / 1e3;
+
+    for (int i = 0; i < BENCH_RAID_RUN; i++)
+    {
+        iov[i].blocknum = mid - BENCH_RAID_RUN / 2 + i;
+        iov[i].buf = data + (size_t)i * BLOCK_SIZE;
+        stamp_block(iov[i].buf, iov[i].blocknum);
+    }
+    disk_writev(iov, BENCH_RAID_RUN);
+    disk_close(0);
+
+    start = now_ns();
+    if (disk_open(BENCH_IMAGE, 0) == -1 || disk_size() != BENCH_HUGE_BLOCKS)
+    {
+        printf("\tERROR: Could not reopen the %lld-block disk.\n", (long long)BENCH_HUGE_BLOCKS);
+        free(probes);
+        disk_free_blocks(data);
+        return -1;
+    }
+    r->open_ms = (now_ns() - start) / 1e6;
+
+    // Read back in reverse, so the later random probes overwriting a block win.
+    uint8_t expected[BLOCK_SIZE];
+    start = now_ns();
+    for (int i = nfixed + BENCH_HUGE_PROBES - 1; i >= 0; i--)
+    {
+        stamp_block(expected, probes[i]);
+        if (disk_read(probes[i], block.data) != BLOCK_SIZE || memcmp(block.data, expected, BLOCK_SIZE) != 0)
+        {
+            r->mismatches++;
+        }
+    }
+    r->read_us = (now_ns() - start) / (nfixed + BENCH_HUGE_PROBES) / 1e3;
+
+    memset(data, 0, (size_t)BENCH_RAID_RUN * BLOCK_SIZE);
+    disk_readv(iov, BENCH_RAID_RUN);
+    for (int i = 0; i < BENCH_RAID_RUN; i++)
+    {
+        stamp_block(expected, iov[i].blocknum);
+        r->mismatches += memcmp(iov[i].buf, expected, BLOCK_SIZE) != 0;
+    }
+
+    stat(BENCH_IMAGE, &st);
+    r->used_mb = st.st_blocks * 512 / 1e6;
+
+    disk_close(0);
+    free(probes);
+    disk_free_blocks(data);
+
+    // Leave a small image behind rather than a 15 TB one.
+    disk_init(BENCH_IMAGE, 0);
+    return disk_close(0);
+}
+
+/**
+ * Results of writing and reading back copies of one test file.
+ */
+struct geometry_result
+{
+    long file_size;
+    int blocks;
+    int copies;
+    double slack;
+    double write_mbs;
+    double read_mbs;
+    int mismatches;
+};
+
+/**
+ * Writes copies of the file at `path` to a fresh disk, each as one disk_writev of whole blocks
+ * starting on a block of its own, as the file system lays files out, then reads them back with
+ * one disk_readv each. Throughput counts the file bytes only, and slack is the share of the
+ * blocks used that the files leave empty.
+ */
+static int bench_geometry(const char *path, struct geometry_result *r)
+{
+    FILE *file = fopen(path, "rb");
+    memset(r, 0, sizeof(*r));
+
+    if (file == NULL || fseek(file, 0, SEEK_END) != 0 || (r->file_size = ftell(file)) <= 0)
+    {
+        printf("\tERROR: Could not read %s.\n", path);
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+        return -1;
+    }
+
+    r->blocks = (r->file_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    r->copies = BENCH_GEOMETRY_BYTES / r->file_size;
+    r->copies = r->copies < 1 ? 1 : r->copies > BENCH_GEOMETRY_COPIES ? BENCH_GEOMETRY_COPIES : r->copies;
+    r->slack = 1.0 - (double)r->file_size / ((double)r->blocks * BLOCK_SIZE);
+
+    // The file, zero-padded to whole blocks, and a buffer to read each copy back into.
+    uint8_t *data = disk_alloc_blocks(r->blocks);
+    uint8_t *back = disk_alloc_blocks(r->blocks);
+    struct disk_iovec *iov = malloc(r->blocks * sizeof(struct disk_iovec));
+
+    rewind(file);
+    if (data == NULL || back == NULL || iov == NULL || fread(data, 1, r->file_size, file) != (size_t)r->file_size ||
+        disk_init(BENCH_IMAGE, (int64_t)r->copies * r->blocks) == -1)
+    {
+        printf("\tERROR: Could not set up the run for %s.\n", path);
+        fclose(file);
+        disk_free_blocks(data);
+        disk_free_blocks(back);
+        free(iov);
+        return -1;
+    }
+    fclose(file);
+
+    double start = now_ns();
+    for (int c = 0; c < r->copies; c++)
+    {
+        for (int i = 0; i < r->blocks; i++)
+        {
+            iov[i].blocknum = (uint64_t)c * r->blocks + i;
+            iov[i].buf = data + (size_t)i * BLOCK_SIZE;
+        }
+        disk_writev(iov, r->blocks);
+    }
+    r->write_mbs = (double)r->copies * r->file_size / (now_ns() - start) * 1e3;
+
+    start = now_ns();
+    for (int c = 0; c < r->copies; c++)
+    {
+        for (int i = 0; i < r->blocks; i++)
+        {
+            iov[i].blocknum = (uint64_t)c * r->blocks + i;
+            iov[i].buf = back + (size_t)i * BLOCK_SIZE;
+        }
+        disk_readv(iov, r->blocks);
+        r->mismatches += memcmp(back, data, r->file_size) != 0;
+    }
+    r->read_mbs = (double)r->copies * r->file_size / (now_ns() - start) * 1e3;
+
+    disk_close(0);
+    disk_free_blocks(data);
+    disk_free_blocks(back);
+    free(iov);
+    return 0;
+}
+
+/**
+ * Runs bench_geometry() over the test data files and prints a row for each.
+ *
+ * @return Returns 0, or -1 if a file read back wrong.
+ */
+static int print_geometry()
+{
+    const char *files[5] = {"test/data/write_test1.txt", "test/data/write_test2.txt", "test/data/write_test2a.txt",
+                            "test/data/write_test2b.txt", "test/data/write_test3a.pdf"};
+    int result = 0;
+
+    printf("\tBlock size %d B (inode %d B, %d direct pointers), the test data files as whole files:\n", BLOCK_SIZE,
+           INODE_SIZE, INODE_DIRECT_POINTERS);
+    for (int f = 0; f < 5; f++)
+    {
+        struct geometry_result g;
+
+        if (bench_geometry(files[f], &g) == 0)
+        {
+            printf("\t  %-18s %8ld B x %4d   %5d blocks   slack %5.1f%%   write %7.1f MB/s   read %7.1f MB/s\n",
+                   files[f] + strlen("test/data/"), g.file_size, g.copies, g.blocks, g.slack * 100, g.write_mbs,
+                   g.read_mbs);
+            if (g.mismatches > 0)
+            {
+                printf("\tERROR: %d copies of %s read back wrong.\n", g.mismatches, files[f]);
+                result = -1;
+            }
+        }
+    }
+
+    // Leave a small image behind.
+    disk_init(BENCH_IMAGE, 0);
+    disk_close(0);
+    return result;
+}
+
+/**
+ * Allocates a block the way a single-block bitmap is searched, carried over several blocks:
+ * bitmap blocks are read from the goal's on, wrapping around, and scanned word by word.
+ *
+ * @return Returns the block allocated, or -1 if there is none.
+ */
+static int64_t scan_alloc(uint64_t first, uint64_t nbits, uint64_t goal)
+{
+    union block block;
+    uint64_t nblocks = BITMAP_BLOCKS(nbits);
+    uint64_t start = goal / BITMAP_BITS_PER_BLOCK;
+
+    for (uint64_t i = 0; i <= nblocks; i++)
+    {
+        uint64_t k = (start + i) % nblocks;
+        disk_read(first + k, block.data);
+
+        for (uint32_t w = 0; w < FLAGS_PER_BLOCK; w++)
+        {
+            if (block.bitmap[w] == UINT32_MAX)
+            {
+                continue;
+            }
+
+            uint64_t bit = k * BITMAP_BITS_PER_BLOCK + w * 32 + __builtin_ctz(~block.bitmap[w]);
+            if (bit < nbits && (i > 0 || bit >= goal))
+            {
+                block.bitmap[w] |= 1u << (bit % 32);
+                disk_write(first + k, block.data);
+                return bit;
+            }
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Fills the bitmap of a BENCH_BITMAP_BITS-block disk but for BENCH_BITMAP_FREE random blocks,
+ * then allocates them all, each from the block after the last one, by scanning the bitmap or
+ * with bitmap_alloc(). Returns the microseconds per allocation, the milliseconds that
+ * bitmap_open() took to build the summary in open_ms, and the blocks allocated in allocated.
+ */
+static double bench_bitmap(int summary, double *open_ms, int *allocated)
+{
+    uint64_t nblocks = BITMAP_BLOCKS(BENCH_BITMAP_BITS);
+    union block block;
+
+    if (disk_init(BENCH_IMAGE, BENCH_BITMAP_BITS) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+
+    // Everything in use but for the free blocks, which the same seed picks for both runs.
+    srand(BENCH_BITMAP_FREE);
+    memset(block.data, 0xff, BLOCK_SIZE);
+    for (uint64_t k = 0; k < nblocks; k++)
+    {
+        disk_write(1 + k, block.data);
+    }
+    for (int i = 0; i < BENCH_BITMAP_FREE; i++)
+    {
+        uint64_t bit = (((uint64_t)rand() << 31) ^ (uint64_t)rand()) % BENCH_BITMAP_BITS;
+        disk_read(1 + bit / BITMAP_BITS_PER_BLOCK, block.data);
+        block.bitmap[bit % BITMAP_BITS_PER_BLOCK / 32] &= ~(1u << (bit % 32));
+        disk_write(1 + bit / BITMAP_BITS_PER_BLOCK, block.data);
+    }
+
+    struct bitmap *b = NULL;
+    double start = now_ns();
+    if (summary && (b = bitmap_open(disk_default(), 1, BENCH_BITMAP_BITS)) == NULL)
+    {
+        disk_close(0);
+        return -1;
+    }
+    *open_ms = (now_ns() - start) / 1e6;
+
+    // Allocate until the disk is full; the random picks may have hit a block twice.
+    uint64_t goal = 0, bit;
+    *allocated = 0;
+    start = now_ns();
+    while (summary ? bitmap_alloc(b, goal, &bit) == 0 : (int64_t)(bit = scan_alloc(1, BENCH_BITMAP_BITS, goal)) >= 0)
+    {
+        goal = bit + 1;
+        (*allocated)++;
+    }
+    double us = *allocated > 0 ? (now_ns() - start) / *allocated / 1e3 : 0;
+
+    if (summary && bitmap_free(b) != 0)
+    {
+        printf("\tERROR: The summary counts %llu free blocks on a full disk.\n", (unsigned long long)bitmap_free(b));
+        us = -1;
+    }
+
+    bitmap_close(b);
+    disk_close(0);
+
+    // Leave a small image behind rather than a 64 GB one.
+    disk_init(BENCH_IMAGE, 0);
+    disk_close(0);
+    return us;
+}
+
+/**
+ * State of one stress thread.
+ */
+struct stress_thread
+{
+    pthread_t thread;
+    struct vdisk *disk;
+    unsigned seed;
+    long torn;
+};
+
+/**
+ * Random whole-block reads and writes, one write in four. Every write fills the block with a
+ * single byte value, so a read that sees more than one value caught a write half done.
+ */
+static void *stress_worker(void *arg)
+{
+    struct stress_thread *t = arg;
+    union block block;
+
+    for (int i = 0; i < BENCH_THREAD_OPS; i++)
+    {
+        uint64_t blocknum = rand_r(&t->seed) % BENCH_BLOCKS;
+
+        if (rand_r(&t->seed) % 4 == 0)
+        {
+            memset(block.data, rand_r(&t->seed), BLOCK_SIZE);
+            vdisk_write(t->disk, blocknum, block.data);
+        }
+        else if (vdisk_read(t->disk, blocknum, block.data) == BLOCK_SIZE && memcmp(block.data, block.data + 1, BLOCK_SIZE - 1) != 0)
+        {
+            t->torn++;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Runs the stress workers on one shared DISK_THREADSAFE disk.
+ */
+static int bench_threads(int nthreads, int flags, double *kops, long *torn)
+{
+    struct stress_thread threads[BENCH_THREADS];
+    struct vdisk *d = vdisk_init(BENCH_IMAGE, BENCH_BLOCKS, flags | DISK_THREADSAFE);
+
+    if (d == NULL)
+    {
+        printf("\tERROR: Could not initialize %s.\n", BENCH_IMAGE);
+        return -1;
+    }
+
+    double start = now_ns();
+    for (int i = 0; i < nthreads; i++)
+    {
+        threads[i].disk = d;
+        threads[i].seed = i + 1;
+        threads[i].torn = 0;
+        pthread_create(&threads[i].thread, NULL, stress_worker, &threads[i]);
+    }
+
+    *torn = 0;
+    for (int i = 0; i < nthreads; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+        *torn += threads[i].torn;
+    }
+    *kops = (double)nthreads * BENCH_THREAD_OPS / (now_ns() - start) * 1e6;
+
+    vdisk_close(d, 0);
+    return 0;
+}
+
+/**
+ * Moves the blocks of `order` once between d and block, each a disk_read or disk_write.
+ *
+ * @return double Returns the time per block in ns, or -1 on failure.
+ */
+static double checksum_pass(struct vdisk *d, uint32_t *order, int write, union block *block)
+{
+    double start = now_ns();
+    for (uint32_t i = 0; i < BENCH_BLOCKS; i++)
+    {
+        int result = write ? vdisk_write(d, order[i], block->data) : vdisk_read(d, order[i], block->data);
+        if (result == -1)
+        {
+            return -1;
+        }
+    }
+    return (now_ns() - start) / BENCH_BLOCKS;
+}
+
+/**
+ * Prints the per-block latency of the pread/pwrite and O_DIRECT backends with every block
+ * checksummed on write and verified on read, against the same blocks without checksums.
+ */
+static void print_checksums(uint32_t *order)
+{
+    union block *block = disk_alloc_blocks(1);
+
+    memset(block->data, 0x3c, BLOCK_SIZE);
+    double start = now_ns();
+    uint32_t crc = 0;
+    for (int i = 0; i < BENCH_BLOCKS * BENCH_ROUNDS; i++)
+    {
+        crc = disk_crc32c(crc, block->data, BLOCK_SIZE);
+    }
+    double crc_ns = (now_ns() - start) / (BENCH_BLOCKS * BENCH_ROUNDS);
+
+    printf("\tCRC32C checksums (%s kernel: %.0f ns per block, %.1f GB/s, crc %08x), best of %d passes:\n",
+           disk_crc32c_engine(), crc_ns, BLOCK_SIZE / crc_ns, crc, BENCH_CHECKSUM_PASSES);
+
+    int backends[2] = {0, DISK_DIRECT};
+    const char *backend_names[2] = {"pread + crc32c", "O_DIRECT + crc32c"};
+
+    for (int b = 0; b < 2; b++)
+    {
+        // Both disks stay open and take turns pass by pass, each going first every other pass, so
+        // a slow stretch of the machine falls on both. The difference is smaller than that.
+        struct vdisk *disks[2] = {vdisk_init(BENCH_IMAGE, BENCH_BLOCKS, backends[b]),
+                                  vdisk_init(BENCH_CHECKSUM_IMAGE, BENCH_BLOCKS, backends[b] | DISK_CHECKSUM)};
+        double best[2][2] = {{1e30, 1e30}, {1e30, 1e30}};
+        int failed = disks[0] == NULL || disks[1] == NULL;
+
+        // Writes first, so the reads find data rather than holes.
+        for (int write = 1; write >= 0 && !failed; write--)
+        {
+            for (int r = 0; r < BENCH_CHECKSUM_PASSES && !failed; r++)
+            {
+                for (int k = 0; k < 2 && !failed; k++)
+                {
+                    int c = k ^ (r & 1);
+                    double ns = checksum_pass(disks[c], order, write, block);
+                    failed = ns < 0;
+                    best[c][write] = ns < best[c][write] ? ns : best[c][write];
+                }
+            }
+        }
+
+        for (int c = 0; c < 2; c++)
+        {
+            if (disks[c] != NULL)
+            {
+                vdisk_close(disks[c], 0);
+            }
+        }
+        remove(BENCH_CHECKSUM_IMAGE);
+
+        if (failed)
+        {
+            printf("\tERROR: Could not run the %s blocks.\n", backend_names[b]);
+            continue;
+        }
+
+        printf("\t  %-17s read %8.0f ns (%+5.1f%%, %+4.0f ns)   write %8.0f ns (%+5.1f%%, %+4.0f ns)\n",
+               backend_names[b], best[1][0], 100 * (best[1][0] / best[0][0] - 1), best[1][0] - best[0][0], best[1][1],
+               100 * (best[1][1] / best[0][1] - 1), best[1][1] - best[0][1]);
+    }
+
+    disk_free_blocks(block);
+}
+
+int main(int argc, char *argv[])
+{
+    // `bench_disk.out geometry` runs the block size section alone, for `make bench-geometry`.
+    if (argc > 1 && strcmp(argv[1], "geometry") == 0)
+    {
+        return print_geometry();
+    }
+
+    uint32_t *order = malloc(BENCH_BLOCKS * sizeof(uint32_t));
+    shuffle_blocks(order, BENCH_BLOCKS);
+
+    // `bench_disk.out checksum` runs the checksum rows alone.
+    if (argc > 1 && strcmp(argv[1], "checksum") == 0)
+    {
+        print_checksums(order);
+        free(order);
+        return 0;
+    }
+
+    printf("\tPer-block latency, %d random blocks x %d rounds:\n", BENCH_BLOCKS, BENCH_ROUNDS);
+
+    double read_ns, write_ns, sync_write_ns = 0;
+    struct disk_stats stats[3];
+    const char *stats_names[3] = {"pread/pwrite", "mmap", "O_DIRECT"};
+    int stats_ok[3] = {0, 0, 0};
+
+    if (bench_stdio(order, &read_ns, &write_ns) == 0)
+    {
+        printf("\t  %-16s read %8.0f ns   write %8.0f ns\n", "stdio", read_ns, write_ns);
+    }
+
+    stats_ok[0] = bench_disk(order, 0, &read_ns, &write_ns, &stats[0]) == 0;
+    if (stats_ok[0])
+    {
+        printf("\t  %-16s read %8.0f ns   write %8.0f ns\n", "pread/pwrite", read_ns, write_ns);
+        sync_write_ns = write_ns;
+    }
+
+    stats_ok[1] = bench_disk(order, DISK_MMAP, &read_ns, &write_ns, &stats[1]) == 0;
+    if (stats_ok[1])
+    {
+        printf("\t  %-16s read %8.0f ns   write %8.0f ns\n", "mmap", read_ns, write_ns);
+    }
+
+    if (bench_disk_block(order, &read_ns) == 0)
+    {
+        printf("\t  %-16s read %8.0f ns\n", "mmap zero-copy", read_ns);
+    }
+
+    stats_ok[2] = bench_disk(order, DISK_DIRECT, &read_ns, &write_ns, &stats[2]) == 0;
+    if (stats_ok[2])
+    {
+        printf("\t  %-16s read %8.0f ns   write %8.0f ns\n", direct_supported() ? "O_DIRECT" : "O_DIRECT (off)", read_ns, write_ns);
+    }
+
+    printf("\tTail latency of the same runs, p50 / p99 / p99.9 (disk_get_stats):\n");
+    for (int i = 0; i < 3; i++)
+    {
+        if (stats_ok[i])
+        {
+            printf("\t  %-16s read %6.1f / %6.1f / %6.1f us   write %6.1f / %6.1f / %6.1f us\n", stats_names[i],
+                   stats[i].read.p50_ns / 1e3, stats[i].read.p99_ns / 1e3, stats[i].read.p999_ns / 1e3,
+                   stats[i].write.p50_ns / 1e3, stats[i].write.p99_ns / 1e3, stats[i].write.p999_ns / 1e3);
+        }
+    }
+
+    print_checksums(order);
+
+    int depths[] = {1, 8, 32, 128};
+
+    printf("\tAsynchronous writes (disk_write: %.0f ns per block):\n", sync_write_ns);
+    for (int i = 0; i < 4; i++)
+    {
+        double uring_ns, threads_ns;
+        int engine = bench_async(order, depths[i], 0, &uring_ns);
+        bench_async(order, depths[i], DISK_ASYNC_THREADS, &threads_ns);
+
+        printf("\t  QD %-13d %s %8.0f ns   threads %8.0f ns\n", depths[i],
+               engine == DISK_ASYNC_URING ? "io_uring" : "(none)  ", uring_ns, threads_ns);
+    }
+
+    double lookup_ns;
+    long uncached = bench_lookups(0, 0, &lookup_ns);
+
+    printf("\tPath lookups, %d x 5 metadata blocks:\n", BENCH_LOOKUPS);
+    printf("\t  %-16s %8ld physical reads %8.0f ns per lookup\n", "no cache", uncached, lookup_ns);
+
+    long cached = bench_lookups(BENCH_CACHE_BLOCKS, 0, &lookup_ns);
+    printf("\t  %-16s %8ld physical reads %8.0f ns per lookup\n", "64-block cache", cached, lookup_ns);
+
+    // Without the page cache behind it, every miss costs a device read.
+    uncached = bench_lookups(0, DISK_DIRECT, &lookup_ns);
+    printf("\t  %-16s %8ld physical reads %8.0f ns per lookup\n", "O_DIRECT", uncached, lookup_ns);
+
+    cached = bench_lookups(BENCH_CACHE_BLOCKS, DISK_DIRECT, &lookup_ns);
+    printf("\t  %-16s %8ld physical reads %8.0f ns per lookup\n", "O_DIRECT + cache", cached, lookup_ns);
+
+    double loop_ms, vec_read_ms, vec_write_ms;
+
+    if (bench_vectored(&loop_ms, &vec_read_ms, &vec_write_ms) == 0)
+    {
+        printf("\tWhole file, %d contiguous blocks:\n", BENCH_FILE_BLOCKS);
+        printf("\t  %-16s %8.3f ms\n", "disk_read loop", loop_ms);
+        printf("\t  %-16s %8.3f ms\n", "disk_readv", vec_read_ms);
+        printf("\t  %-16s %8.3f ms\n", "disk_writev", vec_write_ms);
+
+        printf("\tStreaming the same file block by block:\n");
+        printf("\t  %-16s %8.1f MB/s\n", "disk_readv", BENCH_FILE_BLOCKS * BLOCK_SIZE / vec_read_ms / 1e3);
+        printf("\t  %-16s %8.1f MB/s\n", "no read-ahead", bench_stream(0));
+        printf("\t  %-16s %8.1f MB/s\n", "read-ahead", bench_stream(1));
+    }
+
+    double base_pread = 0, base_mmap = 0;
+
+    printf("\tShared DISK_THREADSAFE disk, %d random blocks per thread (1 write in 4):\n", BENCH_THREAD_OPS);
+    for (int n = 1; n <= BENCH_THREADS; n *= 2)
+    {
+        double pread_kops, mmap_kops;
+        long pread_torn, mmap_torn;
+
+        if (bench_threads(n, 0, &pread_kops, &pread_torn) != 0 || bench_threads(n, DISK_MMAP, &mmap_kops, &mmap_torn) != 0)
+        {
+            break;
+        }
+
+        if (n == 1)
+        {
+            base_pread = pread_kops;
+            base_mmap = mmap_kops;
+        }
+
+        printf("\t  %d thread%-9s pread %7.0f kops/s (x%.2f)   mmap %7.0f kops/s (x%.2f)   torn reads %ld\n", n, n > 1 ? "s" : "",
+               pread_kops, pread_kops / base_pread, mmap_kops, mmap_kops / base_mmap, pread_torn + mmap_torn);
+    }
+
+    // The same file laid out contiguously, with gaps, and scattered over the disk.
+    uint32_t layouts[3][BENCH_FILE_BLOCKS];
+    const char *layout_names[3] = {"contiguous", "every 4th block", "scattered"};
+
+    for (int i = 0; i < BENCH_FILE_BLOCKS; i++)
+    {
+        layouts[0][i] = 100 + i;
+        layouts[1][i] = 100 + 4 * i;
+        layouts[2][i] = order[i];
+    }
+
+    printf("\tModelled device time to read the %d-block file, block by block and with disk_readv:\n", BENCH_FILE_BLOCKS);
+    for (int l = 0; l < 3; l++)
+    {
+        double hdd_loop, hdd_vec, ssd_loop, ssd_vec;
+
+        if (bench_model(DISK_MODEL_HDD, layouts[l], &hdd_loop, &hdd_vec) == 0 && bench_model(DISK_MODEL_SSD, layouts[l], &ssd_loop, &ssd_vec) == 0)
+        {
+            printf("\t  %-16s HDD %8.2f ms / %8.2f ms   SSD %8.2f ms / %8.2f ms\n", layout_names[l], hdd_loop, hdd_vec, ssd_loop, ssd_vec);
+        }
+    }
+
+    int sched_depths[] = {0, 32, 128, 512};
+
+    printf("\tCreating %d files of %d blocks on the modelled HDD:\n", BENCH_CREATES, BENCH_CREATE_BLOCKS);
+    for (int i = 0; i < 4; i++)
+    {
+        double sim_ms;
+        unsigned long long seeks;
+
+        if (bench_sched(sched_depths[i], &sim_ms, &seeks) == 0)
+        {
+            char name[32] = "no scheduler";
+            if (sched_depths[i] > 0)
+            {
+                snprintf(name, sizeof(name), "scheduler QD %d", sched_depths[i]);
+            }
+            printf("\t  %-16s %8.2f ms %6llu seeks %8.1f MB/s of data\n", name, sim_ms, seeks,
+                   BENCH_CREATES * BENCH_CREATE_BLOCKS * BLOCK_SIZE / sim_ms / 1e3);
+        }
+    }
+
+    const char *compress_files[3] = {"test/data/write_test2a.txt", "test/data/write_test2b.txt", "test/data/write_test3a.pdf"};
+    int levels[2] = {DISK_COMPRESS_LEVEL, 6};
+
+    printf("\tCompressed images, %d blocks filled with each test file, in runs of %d blocks:\n", BENCH_COMPRESS_BLOCKS,
+           BENCH_COMPRESS_RUN);
+    for (int f = 0; f < 3; f++)
+    {
+        struct compress_result raw, comp;
+
+        if (bench_compress(compress_files[f], 0, 0, &raw) != 0)
+        {
+            continue;
+        }
+
+        printf("\t  %s\n", compress_files[f] + strlen("test/data/"));
+        printf("\t    %-12s ratio %5.2fx   write %7.1f MB/s   scan %7.1f MB/s   read %4.2f B/B   HDD %7.2f ms   SSD %7.2f ms\n",
+               "raw", raw.ratio, raw.write_mbs, raw.scan_mbs, raw.stored_per_byte, raw.hdd_ms, raw.ssd_ms);
+
+        for (int l = 0; l < 2; l++)
+        {
+            if (bench_compress(compress_files[f], DISK_COMPRESS, levels[l], &comp) == 0)
+            {
+                char name[32];
+                snprintf(name, sizeof(name), "zlib -%d", levels[l]);
+                printf("\t    %-12s ratio %5.2fx   write %7.1f MB/s   scan %7.1f MB/s   read %4.2f B/B   HDD %7.2f ms   SSD %7.2f ms\n",
+                       name, comp.ratio, comp.write_mbs, comp.scan_mbs, comp.stored_per_byte, comp.hdd_ms, comp.ssd_ms);
+            }
+        }
+    }
+
+    // Deduplication: the same file stored several times, then blocks that never repeat.
+    FILE *file = fopen("test/data/write_test3a.pdf", "rb");
+    int dedup_blocks = BENCH_DEDUP_COPIES * BENCH_FILE_BLOCKS;
+    uint8_t *dedup_data = calloc((size_t)dedup_blocks, BLOCK_SIZE);
+
+    if (file != NULL && dedup_data != NULL &&
+        fread(dedup_data, 1, (size_t)BENCH_FILE_BLOCKS * BLOCK_SIZE, file) > 0)
+    {
+        printf("\tDeduplication, %d blocks written in runs of %d blocks:\n", dedup_blocks, BENCH_COMPRESS_RUN);
+        for (int w = 0; w < 2; w++)
+        {
+            // The copies of the file, or every block made unique by its number.
+            for (int b = 0; b < dedup_blocks; b++)
+            {
+                uint8_t *block = dedup_data + (size_t)b * BLOCK_SIZE;
+
+                if (b >= BENCH_FILE_BLOCKS)
+                {
+                    memcpy(block, dedup_data + (size_t)(b % BENCH_FILE_BLOCKS) * BLOCK_SIZE, BLOCK_SIZE);
+                }
+                if (w == 1)
+                {
+                    memcpy(block, &b, sizeof(b));
+                }
+            }
+
+            struct dedup_result raw, dedup;
+
+            if (bench_dedup(dedup_data, dedup_blocks, 0, &raw) == 0 &&
+                bench_dedup(dedup_data, dedup_blocks, DISK_DEDUP, &dedup) == 0)
+            {
+                printf("\t  %s\n", w == 0 ? "write_test3a.pdf stored 3 times" : "unique blocks");
+                printf("\t    %-12s write %7.1f MB/s\n", "raw", raw.write_mbs);
+                printf("\t    %-12s write %7.1f MB/s   ratio %5.2fx   %6llu hits\n", "dedup", dedup.write_mbs, dedup.ratio,
+                       dedup.hits);
+            }
+        }
+    }
+
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    free(dedup_data);
+
+    printf("\tThin provisioning, %d MB written in %d extents over a %d-block (100 GB) disk:\n",
+           BENCH_THIN_EXTENTS * BENCH_THIN_EXTENT * BLOCK_SIZE >> 20, BENCH_THIN_EXTENTS, BENCH_THIN_BLOCKS);
+    for (int t = 0; t < 2; t++)
+    {
+        struct thin_result thin;
+
+        if (bench_thin(t == 0 ? 0 : DISK_THIN, &thin) == 0)
+        {
+            printf("\t  %-6s write %7.1f MB/s   scan %7.1f MB/s   unwritten %8.1f MB/s   open %6.3f ms   file %9.1f MB   "
+                   "used %6.1f MB\n",
+                   t == 0 ? "flat" : "thin", thin.write_mbs, thin.scan_mbs, thin.hole_mbs, thin.open_ms, thin.file_mb,
+                   thin.used_mb);
+        }
+    }
+
+    double snap_ms, before_mbs, cow_mbs, after_mbs;
+
+    if (bench_snapshot(&snap_ms, &before_mbs, &cow_mbs, &after_mbs) == 0)
+    {
+        printf("\t  snapshot %6.3f ms   rewrite before %7.1f MB/s   just after %7.1f MB/s   then %7.1f MB/s\n", snap_ms,
+               before_mbs, cow_mbs, after_mbs);
+    }
+
+    printf("\tRAID-0, %d MB streamed in %d KB runs, %d KB stripe unit:\n", BENCH_RAID_BLOCKS * BLOCK_SIZE >> 20,
+           BENCH_RAID_RUN * BLOCK_SIZE >> 10, DISK_RAID_STRIPE_UNIT * BLOCK_SIZE >> 10);
+    for (int members = 1; members <= 4; members *= 2)
+    {
+        double write_mbs, read_mbs;
+
+        if (bench_raid(0, members, &write_mbs, &read_mbs) == 0)
+        {
+            printf("\t  %d member%s  write + flush %7.1f MB/s   read %7.1f MB/s\n", members, members > 1 ? "s" : " ",
+                   write_mbs, read_mbs);
+        }
+    }
+
+    printf("\tRAID-1, %d MB streamed in %d KB runs:\n", BENCH_RAID_BLOCKS * BLOCK_SIZE >> 20,
+           BENCH_RAID_RUN * BLOCK_SIZE >> 10);
+    for (int members = 1; members <= 2; members++)
+    {
+        double write_mbs, read_mbs;
+
+        if (bench_raid(1, members, &write_mbs, &read_mbs) == 0)
+        {
+            printf("\t  %d member%s  write + flush %7.1f MB/s   read %7.1f MB/s\n", members, members > 1 ? "s" : " ",
+                   write_mbs, read_mbs);
+        }
+    }
+
+    double dirty_ms, full_ms;
+    uint64_t dirty_blocks, full_blocks;
+
+    if (bench_resync(&dirty_ms, &dirty_blocks, &full_ms, &full_blocks) == 0)
+    {
+        printf("\t  resync after %d regions written %8.3f ms (%llu blocks)   new member %8.3f ms (%llu blocks)\n",
+               BENCH_RESYNC_DIRTY, dirty_ms, (unsigned long long)dirty_blocks, full_ms, (unsigned long long)full_blocks);
+    }
+
+    printf("\tChurn, %d MB written in %d MB rounds over a %d MB disk, %d MB kept live:\n",
+           (int)((int64_t)BENCH_CHURN_BLOCKS * BLOCK_SIZE >> 20), BENCH_CHURN_ROUND * BLOCK_SIZE >> 20,
+           (int)((int64_t)BENCH_CHURN_BLOCKS * BLOCK_SIZE >> 20), BENCH_CHURN_LIVE * BENCH_CHURN_ROUND * BLOCK_SIZE >> 20);
+    for (int discard = 0; discard < 2; discard++)
+    {
+        struct churn_result churn;
+
+        if (bench_churn(discard, &churn) == 0)
+        {
+            printf("\t  %-16s write %7.1f MB/s   image uses %7.1f MB   read freed %8.1f MB/s\n",
+                   discard ? "with discard" : "without discard", churn.write_mbs, churn.used_mb, churn.freed_mbs);
+        }
+    }
+
+    double create_ms, open_ms;
+
+    if (bench_startup(&create_ms, &open_ms) == 0)
+    {
+        printf("\tStartup, %d-block image:\n", BENCH_LARGE_BLOCKS);
+        printf("\t  %-16s %8.3f ms\n", "disk_init", create_ms);
+        printf("\t  %-16s %8.3f ms\n", "disk_open", open_ms);
+    }
+
+    struct huge_result huge;
+    int result = 0;
+    double scan_us, summary_us, summary_open_ms;
+    int scan_count = 0, summary_count = 0;
+
+    scan_us = bench_bitmap(0, &summary_open_ms, &scan_count);
+    summary_us = bench_bitmap(1, &summary_open_ms, &summary_count);
+    if (scan_us >= 0 && summary_us >= 0)
+    {
+        printf("\tFree-space search, %d free blocks left on a %d-block disk (%llu bitmap blocks):\n", summary_count,
+               BENCH_BITMAP_BITS, (unsigned long long)BITMAP_BLOCKS(BENCH_BITMAP_BITS));
+        printf("\t  %-16s %9.2f us per allocation\n", "scan", scan_us);
+        printf("\t  %-16s %9.2f us per allocation   bitmap_open %7.3f ms\n", "summary", summary_us, summary_open_ms);
+    }
+    if (scan_us < 0 || summary_us < 0 || scan_count != summary_count)
+    {
+        printf("\tERROR: The scan found %d free blocks, the summary %d.\n", scan_count, summary_count);
+        result = -1;
+    }
+
+    printf("\tLarge image, %lld blocks (%lld TB sparse), %d random blocks and the 4 GB, 2^31-block and end boundaries:\n",
+           (long long)BENCH_HUGE_BLOCKS, (long long)(BENCH_HUGE_BLOCKS * BLOCK_SIZE >> 40), BENCH_HUGE_PROBES);
+    if (bench_huge(&huge) == 0)
+    {
+        printf("\t  disk_init %8.3f ms   disk_open %8.3f ms   write %7.1f us/block   read %7.1f us/block   "
+               "used %6.1f MB\n",
+               huge.create_ms, huge.open_ms, huge.write_us, huge.read_us, huge.used_mb);
+        if (huge.mismatches > 0)
+        {
+            printf("\tERROR: %ld blocks of the large image read back wrong.\n", huge.mismatches);
+            result = -1;
+        }
+    }
+
+    if (print_geometry() != 0)
+    {
+        result = -1;
+    }
+
+    free(order);
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitmap.h"
+
+#define NOT_LOADED UINT64_MAX // no bitmap block, or no bit
+
+/**
+ * A bitmap and its summary.
+ *
+ * @param disk The disk holding the bitmap blocks.
+ * @param first The first bitmap block.
+ * @param nbits The number of bits.
+ * @param nblocks The number of bitmap blocks.
+ * @param free_counts The number of clear bits in each bitmap block.
+ * @param has_free A bit per bitmap block, set while its free count is not 0.
+ * @param nfree The number of clear bits in all.
+ * @param block A copy of one bitmap block, kept so that runs of allocations in the same block
+ * read it once. Writes go through to the disk at once.
+ * @param loaded The bitmap block in `block`, or NOT_LOADED.
+ */
+struct bitmap
+{
+    struct vdisk *disk;
+    uint64_t first;
+    uint64_t nbits;
+    uint64_t nblocks;
+    uint32_t *free_counts;
+    uint64_t *has_free;
+    uint64_t nfree;
+    uint8_t *block;
+    uint64_t loaded;
+};
+
+/**
+ * Returns the number of bits of bitmap block k that belong to the bitmap.
+ */
+static uint64_t valid_bits(struct bitmap *b, uint64_t k)
+{
+    return k + 1 < b->nblocks ? BITMAP_BITS_PER_BLOCK : b->nbits - k * BITMAP_BITS_PER_BLOCK;
+}
+
+/**
+ * Reads bitmap block k into b->block, unless it is there already.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int load(struct bitmap *b, uint64_t k)
+{
+    if (b->loaded == k)
+    {
+        return 0;
+    }
+
+    b->loaded = NOT_LOADED;
+    if (vdisk_read(b->disk, b->first + k, b->block) != BLOCK_SIZE)
+    {
+        printf("   ERROR: Could not read bitmap block %llu.\n", (unsigned long long)(b->first + k));
+        return -1;
+    }
+
+    b->loaded = k;
+    return 0;
+}
+
+/**
+ * Writes b->block back as bitmap block k.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int store(struct bitmap *b, uint64_t k)
+{
+    if (vdisk_write(b->disk, b->first + k, b->block) != BLOCK_SIZE)
+    {
+        printf("   ERROR: Could not write bitmap block %llu.\n", (unsigned long long)(b->first + k));
+        b->loaded = NOT_LOADED;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Adds delta to the free count of bitmap block k and keeps its summary bit in step.
+ */
+static void account(struct bitmap *b, uint64_t k, int delta)
+{
+    b->free_counts[k] += delta;
+    b->nfree += delta;
+
+    if (b->free_counts[k] > 0)
+    {
+        b->has_free[k / 64] |= 1ull << (k % 64);
+    }
+    else
+    {
+        b->has_free[k / 64] &= ~(1ull << (k % 64));
+    }
+}
+
+/**
+ * Returns the first bitmap block from `from` up to, not including, `to` with a clear bit, or
+ * NOT_LOADED if there is none.
+ */
+static uint64_t next_with_free(struct bitmap *b, uint64_t from, uint64_t to)
+{
+    for (uint64_t w = from / 64; w * 64 < to; w++)
+    {
+        uint64_t word = b->has_free[w];
+
+        // Ignore the blocks before `from` in its word.
+        if (w == from / 64)
+        {
+            word &= ~0ull << (from % 64);
+        }
+
+        if (word != 0)
+        {
+            uint64_t k = w * 64 + __builtin_ctzll(word);
+            return k < to ? k : NOT_LOADED;
+        }
+    }
+
+    return NOT_LOADED;
+}
+
+/**
+ * Returns the first clear bit of the loaded bitmap block k at or after bit `from` of the block,
+ * or NOT_LOADED if there is none. The on-disk 32-bit words are scanned two at a time, which on a
+ * little-endian host keeps bit n at bit n % 64 of 64-bit word n / 64.
+ */
+static uint64_t find_clear(struct bitmap *b, uint64_t k, uint64_t from)
+{
+    const uint64_t *words = (const uint64_t *)b->block;
+    uint64_t valid = valid_bits(b, k);
+
+    for (uint64_t w = from / 64; w * 64 < valid; w++)
+    {
+        uint64_t clear = ~words[w];
+
+        if (w == from / 64)
+        {
+            clear &= ~0ull << (from % 64);
+        }
+
+        if (clear != 0)
+        {
+            uint64_t bit = w * 64 + __builtin_ctzll(clear);
+            return bit < valid ? bit : NOT_LOADED;
+        }
+    }
+
+    return NOT_LOADED;
+}
+
+/**
+ * Returns the number of clear bits in the loaded bitmap block k.
+ */
+static uint32_t count_clear(struct bitmap *b, uint64_t k)
+{
+    const uint64_t *words = (const uint64_t *)b->block;
+    uint64_t valid = valid_bits(b, k);
+    uint32_t count = 0;
+
+    for (uint64_t w = 0; w * 64 < valid; w++)
+    {
+        uint64_t clear = ~words[w];
+
+        // Bits past the end of the bitmap do not count, whatever they hold.
+        if (valid - w * 64 < 64)
+        {
+            clear &= (1ull << (valid - w * 64)) - 1;
+        }
+        count += __builtin_popcountll(clear);
+    }
+
+    return count;
+}
+
+/**
+ * Allocates a bitmap of nbits bits over blocks first.. of disk d, with an empty summary.
+ */
+static struct bitmap *new_bitmap(struct vdisk *d, uint64_t first, uint64_t nbits)
+{
+    uint64_t nblocks = BITMAP_BLOCKS(nbits);
+
+    if (d == NULL || nbits == 0 || first + nblocks > (uint64_t)vdisk_size(d))
+    {
+        printf("   ERROR: A bitmap of %llu bits does not fit the disk at block %llu.\n", (unsigned long long)nbits,
+               (unsigned long long)first);
+        return NULL;
+    }
+
+    struct bitmap *b = calloc(1, sizeof(struct bitmap));
+    if (b == NULL)
+    {
+        printf("   ERROR: Out of memory.\n");
+        return NULL;
+    }
+
+    b->disk = d;
+    b->first = first;
+    b->nbits = nbits;
+    b->nblocks = nblocks;
+    b->loaded = NOT_LOADED;
+    b->free_counts = calloc(nblocks, sizeof(uint32_t));
+    b->has_free = calloc((nblocks + 63) / 64, sizeof(uint64_t));
+    b->block = disk_alloc_blocks(1);
+
+    if (b->free_counts == NULL || b->has_free == NULL || b->block == NULL)
+    {
+        printf("   ERROR: Out of memory.\n");
+        bitmap_close(b);
+        return NULL;
+    }
+
+    return b;
+}
+
+struct bitmap *bitmap_create(struct vdisk *d, uint64_t first, uint64_t nbits)
+{
+    struct bitmap *b = new_bitmap(d, first, nbits);
+
+    if (b == NULL)
+    {
+        return NULL;
+    }
+
+    for (uint64_t k = 0; k < b->nblocks; k++)
+    {
+        uint64_t valid = valid_bits(b, k);
+
+        // Set the bits past the end, so no reader of the image hands them out.
+        memset(b->block, 0, BLOCK_SIZE);
+        for (uint64_t bit = valid; bit < BITMAP_BITS_PER_BLOCK; bit++)
+        {
+            b->block[bit / 8] |= 1 << (bit % 8);
+        }
+
+        b->loaded = k;
+        if (store(b, k) != 0)
+        {
+            bitmap_close(b);
+            return NULL;
+        }
+        account(b, k, valid);
+    }
+
+    return b;
+}
+
+struct bitmap *bitmap_open(struct vdisk *d, uint64_t first, uint64_t nbits)
+{
+    struct bitmap *b = new_bitmap(d, first, nbits);
+
+    if (b == NULL)
+    {
+        return NULL;
+    }
+
+    for (uint64_t k = 0; k < b->nblocks; k++)
+    {
+        if (load(b, k) != 0)
+        {
+            bitmap_close(b);
+            return NULL;
+        }
+        account(b, k, count_clear(b, k));
+    }
+
+    return b;
+}
+
+void bitmap_close(struct bitmap *b)
+{
+    if (b == NULL)
+    {
+        return;
+    }
+
+    free(b->free_counts);
+    free(b->has_free);
+    disk_free_blocks(b->block);
+    free(b);
+}
+
+/**
+ * Sets or clears a bit, writing its block and updating the summary if it changed.
+ */
+static int change(struct bitmap *b, uint64_t bit, int set)
+{
+    if (bit >= b->nbits)
+    {
+        printf("   ERROR: Bit %llu is past the end of the bitmap.\n", (unsigned long long)bit);
+        return -1;
+    }
+
+    uint64_t k = bit / BITMAP_BITS_PER_BLOCK;
+    uint64_t offset = bit % BITMAP_BITS_PER_BLOCK;
+    uint8_t mask = 1 << (offset % 8);
+
+    if (load(b, k) != 0)
+    {
+        return -1;
+    }
+
+    if (!(b->block[offset / 8] & mask) == !set)
+    {
+        return 0;
+    }
+
+    b->block[offset / 8] ^= mask;
+    if (store(b, k) != 0)
+    {
+        return -1;
+    }
+
+    account(b, k, set ? -1 : 1);
+    return 0;
+}
+
+int bitmap_alloc(struct bitmap *b, uint64_t goal, uint64_t *bit)
+{
+    if (goal >= b->nbits)
+    {
+        goal = 0;
+    }
+
+    uint64_t start = goal / BITMAP_BITS_PER_BLOCK;
+    uint64_t found = NOT_LOADED;
+    uint64_t k = start;
+
+    // The rest of the goal's block first, then the blocks after it, then the ones before.
+    if (b->free_counts[start] > 0)
+    {
+        if (load(b, start) != 0)
+        {
+            return -1;
+        }
+        found = find_clear(b, start, goal % BITMAP_BITS_PER_BLOCK);
+    }
+
+    while (found == NOT_LOADED)
+    {
+        k = next_with_free(b, k + 1, b->nblocks);
+        if (k == NOT_LOADED)
+        {
+            k = next_with_free(b, 0, start + 1);
+        }
+        if (k == NOT_LOADED)
+        {
+            return -1;
+        }
+
+        if (load(b, k) != 0)
+        {
+            return -1;
+        }
+        found = find_clear(b, k, 0);
+
+        // The block was changed behind the bitmap's back; believe the block.
+        if (found == NOT_LOADED)
+        {
+            account(b, k, -(int)b->free_counts[k]);
+        }
+    }
+
+    *bit = k * BITMAP_BITS_PER_BLOCK + found;
+    return change(b, *bit, 1);
+}
+
+int bitmap_set(struct bitmap *b, uint64_t bit)
+{
+    return change(b, bit, 1);
+}
+
+int bitmap_clear(struct bitmap *b, uint64_t bit)
+{
+    return change(b, bit, 0);
+}
+
+int bitmap_test(struct bitmap *b, uint64_t bit)
+{
+    if (bit >= b->nbits || load(b, bit / BITMAP_BITS_PER_BLOCK) != 0)
+    {
+        return -1;
+    }
+
+    uint64_t offset = bit % BITMAP_BITS_PER_BLOCK;
+    return (b->block[offset / 8] >> (offset % 8)) & 1;
+}
+
+uint64_t bitmap_free(struct bitmap *b)
+{
+    return b->nfree;
+}
\ No newline at end of file
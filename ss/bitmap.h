@@ -0,0 +1,86 @@
+/**
+ * @file bitmap.h
+ * @brief This header file contains the declarations of the multi-block free-space bitmaps.
+ *
+ * The file system tracks which data blocks and which inodes are in use with one bitmap each.
+ * A bitmap of nbits bits takes BITMAP_BLOCKS(nbits) consecutive disk blocks, so neither the
+ * disk nor the inode table is capped at what one block of bits can describe. Bit n is bit
+ * n % 32 of 32-bit word n / 32, the layout of the bitmap in union block, carried on from one
+ * bitmap block to the next.
+ *
+ * The bitmap blocks are read and written through the disk, and so through its cache. In
+ * memory, a bitmap keeps a summary: the number of clear bits in each bitmap block, and a bit per
+ * bitmap block telling whether it has any. bitmap_alloc() finds a block with a clear bit in the
+ * summary and reads only that one, so on a nearly full disk it does not scan every word.
+ *
+ */
+
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdint.h>
+
+#include "disk.h"
+
+#define BITMAP_BITS_PER_BLOCK ((uint64_t)BLOCK_SIZE * 8)
+#define BITMAP_BLOCKS(nbits) (((nbits) + BITMAP_BITS_PER_BLOCK - 1) / BITMAP_BITS_PER_BLOCK) // blocks a bitmap takes
+
+struct bitmap;
+
+/**
+ * @brief Writes a bitmap of nbits clear bits to blocks first.. of disk d, and opens it.
+ *
+ * The bits past nbits in the last block are set, so they are never handed out.
+ *
+ * @return struct bitmap* The bitmap, or NULL on failure.
+ */
+struct bitmap *bitmap_create(struct vdisk *d, uint64_t first, uint64_t nbits);
+
+/**
+ * @brief Opens the bitmap of nbits bits in blocks first.. of disk d, reading every block once
+ * to build the summary.
+ *
+ * @return struct bitmap* The bitmap, or NULL on failure.
+ */
+struct bitmap *bitmap_open(struct vdisk *d, uint64_t first, uint64_t nbits);
+
+/**
+ * @brief Frees the bitmap. Its blocks were written as it changed, so nothing is lost.
+ */
+void bitmap_close(struct bitmap *b);
+
+/**
+ * @brief Finds a clear bit, sets it and stores its number in bit.
+ *
+ * The search starts at goal and moves up, wrapping around to bit 0, so that a file's blocks
+ * are allocated next to each other when goal is the block after its last one.
+ *
+ * @return int Returns 0 on success, -1 if every bit is set or the bitmap could not be written.
+ */
+int bitmap_alloc(struct bitmap *b, uint64_t goal, uint64_t *bit);
+
+/**
+ * @brief Sets a bit, marking the block or inode in use. Setting a set bit does nothing.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int bitmap_set(struct bitmap *b, uint64_t bit);
+
+/**
+ * @brief Clears a bit, marking the block or inode free. Clearing a clear bit does nothing.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int bitmap_clear(struct bitmap *b, uint64_t bit);
+
+/**
+ * @brief Returns 1 if the bit is set, 0 if it is clear, or -1 on failure.
+ */
+int bitmap_test(struct bitmap *b, uint64_t bit);
+
+/**
+ * @brief Returns the number of clear bits, from the summary.
+ */
+uint64_t bitmap_free(struct bitmap *b);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,575 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "disk_internal.h"
+
+/**
+ * One cache slot. Slots hashing to the same bucket are chained through `next`.
+ */
+struct cache_slot
+{
+    uint64_t blocknum;
+    uint8_t valid;
+    uint8_t dirty;
+    uint8_t referenced; // CLOCK bit, set on every access
+    uint8_t loading;    // an asynchronous prefetch is filling the slot
+    int next;
+};
+
+/**
+ * The cache of one disk.
+ */
+struct cache
+{
+    struct vdisk *disk;
+    struct cache_slot *slots;
+    uint8_t *data;      // capacity blocks, slot i at data + i * BLOCK_SIZE
+    int *buckets;       // first slot of each hash chain, or -1
+    uint32_t bucket_mask;
+    int capacity;
+    int hand;           // CLOCK hand
+    struct cache_stats stats;
+};
+
+static uint32_t hash(struct cache *c, uint64_t blocknum)
+{
+    // Fold the high half in, so blocks 2^32 apart do not share a chain.
+    return ((blocknum ^ (blocknum >> 32)) * 2654435761u) & c->bucket_mask;
+}
+
+static uint8_t *slot_data(struct cache *c, int i)
+{
+    return c->data + (size_t)i * BLOCK_SIZE;
+}
+
+/**
+ * Returns the slot holding the block, or -1.
+ */
+static int lookup(struct cache *c, uint64_t blocknum)
+{
+    for (int i = c->buckets[hash(c, blocknum)]; i >= 0; i = c->slots[i].next)
+    {
+        if (c->slots[i].blocknum == blocknum)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Waits until an asynchronous prefetch of slot i has landed.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int wait_loaded(struct cache *c, int i)
+{
+    while (c->slots[i].loading)
+    {
+        if (vdisk_async_wait(c->disk, 1) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Like lookup(), but waits for a prefetch in progress. The prefetch may fail, leaving no slot.
+ */
+static int lookup_loaded(struct cache *c, uint64_t blocknum)
+{
+    int i = lookup(c, blocknum);
+
+    if (i >= 0 && c->slots[i].loading)
+    {
+        if (wait_loaded(c, i) != 0)
+        {
+            return -1;
+        }
+        i = lookup(c, blocknum);
+    }
+
+    return i;
+}
+
+static void unlink_slot(struct cache *c, int i)
+{
+    int *link = &c->buckets[hash(c, c->slots[i].blocknum)];
+
+    while (*link != i)
+    {
+        link = &c->slots[*link].next;
+    }
+    *link = c->slots[i].next;
+}
+
+static void install(struct cache *c, int i, uint64_t blocknum)
+{
+    uint32_t h = hash(c, blocknum);
+
+    c->slots[i].blocknum = blocknum;
+    c->slots[i].valid = 1;
+    c->slots[i].dirty = 0;
+    c->slots[i].referenced = 1;
+    c->slots[i].next = c->buckets[h];
+    c->buckets[h] = i;
+}
+
+static int writeback(struct cache *c, int i)
+{
+    if (disk_internal_io(c->disk, 1, c->slots[i].blocknum, slot_data(c, i)) != 0)
+    {
+        return -1;
+    }
+
+    c->slots[i].dirty = 0;
+    c->stats.writebacks++;
+    return 0;
+}
+
+/**
+ * Frees a slot with the CLOCK algorithm: the hand skips, and clears, slots referenced since it
+ * last passed. A dirty victim is written back first. Slots being prefetched are never taken.
+ *
+ * @return Returns the free slot, or -1 if the victim could not be written back.
+ */
+static int evict(struct cache *c)
+{
+    int loading = 0;
+
+    while (c->slots[c->hand].loading || (c->slots[c->hand].valid && c->slots[c->hand].referenced))
+    {
+        // With every slot busy prefetching, let some of the prefetches finish.
+        if (c->slots[c->hand].loading)
+        {
+            if (++loading >= c->capacity && vdisk_async_wait(c->disk, 1) < 0)
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            c->slots[c->hand].referenced = 0;
+        }
+
+        c->hand = (c->hand + 1) % c->capacity;
+    }
+
+    int i = c->hand;
+    c->hand = (c->hand + 1) % c->capacity;
+
+    if (c->slots[i].valid)
+    {
+        if (c->slots[i].dirty && writeback(c, i) != 0)
+        {
+            return -1;
+        }
+
+        unlink_slot(c, i);
+        c->slots[i].valid = 0;
+        c->stats.evictions++;
+    }
+
+    return i;
+}
+
+int cache_init(int nblocks)
+{
+    return vdisk_cache_init(disk_default(), nblocks);
+}
+
+int vdisk_cache_init(struct vdisk *d, int nblocks)
+{
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    if (d->cache != NULL)
+    {
+        printf("   ERROR: Cache is already enabled.\n");
+        return -1;
+    }
+
+    if (nblocks <= 0)
+    {
+        printf("   ERROR: Cache size must be positive.\n");
+        return -1;
+    }
+
+    // Twice as many buckets as slots, rounded up to a power of two.
+    uint32_t nbuckets = 1;
+    while (nbuckets < 2 * (uint32_t)nblocks)
+    {
+        nbuckets <<= 1;
+    }
+
+    struct cache *c = calloc(1, sizeof(struct cache));
+    if (c != NULL)
+    {
+        c->slots = calloc(nblocks, sizeof(struct cache_slot));
+        c->buckets = malloc(nbuckets * sizeof(int));
+    }
+
+    if (c == NULL || c->slots == NULL || c->buckets == NULL || (c->data = disk_alloc_blocks(nblocks)) == NULL)
+    {
+        printf("   ERROR: Could not allocate cache.\n");
+        if (c != NULL)
+        {
+            free(c->slots);
+            free(c->buckets);
+            free(c);
+        }
+        return -1;
+    }
+
+    memset(c->buckets, -1, nbuckets * sizeof(int));
+    c->disk = d;
+    c->bucket_mask = nbuckets - 1;
+    c->capacity = nblocks;
+
+    disk_internal_lock(d);
+    d->cache = c;
+    disk_internal_unlock(d);
+
+    return 0;
+}
+
+int cache_enabled()
+{
+    return vdisk_cache_enabled(disk_default());
+}
+
+int vdisk_cache_enabled(struct vdisk *d)
+{
+    return d != NULL && d->cache != NULL;
+}
+
+int cache_read(struct vdisk *d, uint64_t blocknum, void *buf)
+{
+    struct cache *c = d->cache;
+    int i = lookup_loaded(c, blocknum);
+
+    if (i >= 0)
+    {
+        c->stats.hits++;
+    }
+    else
+    {
+        c->stats.misses++;
+
+        // Take a slot and fill it from the image.
+        if ((i = evict(c)) < 0 || disk_internal_io(d, 0, blocknum, slot_data(c, i)) != 0)
+        {
+            return -1;
+        }
+        install(c, i, blocknum);
+    }
+
+    c->slots[i].referenced = 1;
+    memcpy(buf, slot_data(c, i), BLOCK_SIZE);
+    return 0;
+}
+
+int cache_write(struct vdisk *d, uint64_t blocknum, void *buf)
+{
+    struct cache *c = d->cache;
+    int i = lookup_loaded(c, blocknum);
+
+    if (i >= 0)
+    {
+        c->stats.hits++;
+    }
+    else
+    {
+        c->stats.misses++;
+
+        // The whole block is overwritten, so there is nothing to read first.
+        if ((i = evict(c)) < 0)
+        {
+            return -1;
+        }
+        install(c, i, blocknum);
+    }
+
+    memcpy(slot_data(c, i), buf, BLOCK_SIZE);
+    c->slots[i].referenced = 1;
+    c->slots[i].dirty = 1;
+    return 0;
+}
+
+static int compare_blocknum(const void *a, const void *b)
+{
+    uint64_t x = ((const struct disk_iovec *)a)->blocknum;
+    uint64_t y = ((const struct disk_iovec *)b)->blocknum;
+    return (x > y) - (x < y);
+}
+
+int cache_sync()
+{
+    return vdisk_cache_sync(disk_default());
+}
+
+/**
+ * Body of vdisk_cache_sync(), with the disk lock held.
+ */
+static int sync_locked(struct vdisk *d)
+{
+    if (!vdisk_cache_enabled(d))
+    {
+        return 0;
+    }
+
+    struct cache *c = d->cache;
+    struct disk_iovec *iov = malloc(c->capacity * sizeof(struct disk_iovec));
+    if (iov == NULL)
+    {
+        printf("   ERROR: Could not allocate cache sync list.\n");
+        return -1;
+    }
+
+    // Collect the dirty blocks.
+    int n = 0;
+    for (int i = 0; i < c->capacity; i++)
+    {
+        if (c->slots[i].valid && c->slots[i].dirty)
+        {
+            iov[n].blocknum = c->slots[i].blocknum;
+            iov[n].buf = slot_data(c, i);
+            n++;
+        }
+    }
+
+    // Write them in block order, so neighbouring blocks go out in one call.
+    qsort(iov, n, sizeof(struct disk_iovec), compare_blocknum);
+    int result = disk_internal_iov(d, 1, iov, n);
+
+    if (result == 0)
+    {
+        for (int i = 0; i < c->capacity; i++)
+        {
+            c->slots[i].dirty = 0;
+        }
+        c->stats.writebacks += n;
+    }
+
+    free(iov);
+    return result;
+}
+
+int vdisk_cache_sync(struct vdisk *d)
+{
+    disk_internal_lock(d);
+    int result = sync_locked(d);
+    disk_internal_unlock(d);
+
+    return result;
+}
+
+void cache_get_stats(struct cache_stats *out)
+{
+    vdisk_cache_get_stats(disk_default(), out);
+}
+
+void vdisk_cache_get_stats(struct vdisk *d, struct cache_stats *out)
+{
+    disk_internal_lock(d);
+    if (vdisk_cache_enabled(d))
+    {
+        *out = d->cache->stats;
+    }
+    else
+    {
+        memset(out, 0, sizeof(*out));
+    }
+    disk_internal_unlock(d);
+}
+
+int cache_close()
+{
+    return vdisk_cache_close(disk_default());
+}
+
+int vdisk_cache_close(struct vdisk *d)
+{
+    if (!vdisk_cache_enabled(d))
+    {
+        return 0;
+    }
+
+    disk_internal_lock(d);
+    int result = sync_locked(d);
+    if (result != 0)
+    {
+        printf("   ERROR: Could not write back cache.\n");
+    }
+
+    struct cache *c = d->cache;
+    d->cache = NULL;
+    disk_internal_unlock(d);
+
+    free(c->slots);
+    free(c->buckets);
+    disk_free_blocks(c->data);
+    free(c);
+    return result;
+}
+
+void cache_internal_update(struct vdisk *d, uint64_t blocknum, const void *buf)
+{
+    struct cache *c = d->cache;
+    int i = c != NULL ? lookup_loaded(c, blocknum) : -1;
+
+    if (i >= 0)
+    {
+        memcpy(slot_data(c, i), buf, BLOCK_SIZE);
+        c->slots[i].dirty = 0;
+    }
+}
+
+void cache_internal_overlay(struct vdisk *d, uint64_t blocknum, void *buf)
+{
+    struct cache *c = d->cache;
+    int i = c != NULL ? lookup(c, blocknum) : -1;
+
+    if (i >= 0 && c->slots[i].dirty)
+    {
+        memcpy(buf, slot_data(c, i), BLOCK_SIZE);
+    }
+}
+
+int cache_internal_writeback(struct vdisk *d, uint64_t blocknum)
+{
+    struct cache *c = d->cache;
+    int i = c != NULL ? lookup(c, blocknum) : -1;
+
+    if (i >= 0 && c->slots[i].dirty)
+    {
+        return writeback(c, i);
+    }
+
+    return 0;
+}
+/**
+ * Completion of one prefetched block: its slot is ready, or dropped if the read failed.
+ */
+static void prefetch_done(uint64_t blocknum, void *buf, int result, void *arg)
+{
+    struct cache *c = arg;
+    int i = lookup(c, blocknum);
+    (void)buf;
+
+    if (i < 0)
+    {
+        return;
+    }
+
+    c->slots[i].loading = 0;
+
+    if (result != BLOCK_SIZE)
+    {
+        unlink_slot(c, i);
+        c->slots[i].valid = 0;
+    }
+}
+
+/**
+ * Takes slots for a run of uncached blocks and reads them with one asynchronous request.
+ */
+static int prefetch_run(struct cache *c, uint64_t first, int count)
+{
+    struct disk_iovec iov[DISK_ASYNC_MAX_RUN];
+
+    for (int n = 0; n < count; n++)
+    {
+        int i = evict(c);
+        if (i < 0)
+        {
+            count = n;
+            break;
+        }
+
+        install(c, i, first + n);
+        c->slots[i].loading = 1;
+        iov[n].blocknum = first + n;
+        iov[n].buf = slot_data(c, i);
+    }
+
+    if (count == 0)
+    {
+        return -1;
+    }
+
+    if (vdisk_async_readv(c->disk, iov, count, prefetch_done, c) != 0)
+    {
+        // Give the slots back.
+        for (int n = 0; n < count; n++)
+        {
+            int i = lookup(c, first + n);
+            c->slots[i].loading = 0;
+            unlink_slot(c, i);
+            c->slots[i].valid = 0;
+        }
+        return -1;
+    }
+
+    c->stats.prefetches += count;
+    return 0;
+}
+
+int cache_prefetch(struct vdisk *d, uint64_t first, int count)
+{
+    struct cache *c = d->cache;
+
+    if (c == NULL || vdisk_async_engine(d) == DISK_ASYNC_NONE)
+    {
+        return -1;
+    }
+
+    // Never let prefetching take more than half the cache.
+    if (count > c->capacity / 2)
+    {
+        count = c->capacity / 2;
+    }
+
+    int n = 0;
+    while (n < count)
+    {
+        // Skip blocks that are cached or already on their way.
+        if (lookup(c, first + n) >= 0)
+        {
+            n++;
+            continue;
+        }
+
+        // Read the run of missing blocks that starts here.
+        int run = 1;
+        while (n + run < count && run < DISK_ASYNC_MAX_RUN && lookup(c, first + n + run) < 0)
+        {
+            run++;
+        }
+
+        if (prefetch_run(c, first + n, run) != 0)
+        {
+            return -1;
+        }
+        n += run;
+    }
+
+    return 0;
+}
+
+int cache_contains(struct vdisk *d, uint64_t blocknum)
+{
+    struct cache *c = d->cache;
+    int i = c != NULL ? lookup(c, blocknum) : -1;
+
+    return i >= 0 && !c->slots[i].loading;
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+/**
+ * @file cache.h
+ * @brief This header file contains the declarations of the write-back block cache.
+ *
+ * Once enabled with cache_init(), every disk_read and disk_write goes through the cache: hits are
+ * served from memory, writes stay dirty in memory until they are evicted or synced, and only
+ * misses and write-backs reach the disk image. Eviction uses the CLOCK algorithm.
+ *
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+
+#include "disk.h"
+
+/**
+ * @brief Counters kept by the cache.
+ *
+ * @param hits Lookups served from the cache.
+ * @param misses Lookups that had to take a new slot.
+ * @param evictions Valid blocks pushed out to make room.
+ * @param writebacks Dirty blocks written to the disk image.
+ * @param prefetches Blocks read into the cache ahead of use by the read-ahead engine.
+ */
+struct cache_stats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t writebacks;
+    uint64_t prefetches;
+};
+
+/**
+ * @brief Enables the cache on the default disk.
+ *
+ * @param nblocks The number of blocks the cache can hold.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int cache_init(int nblocks);
+
+/**
+ * @brief Returns 1 if the cache is enabled, 0 otherwise.
+ */
+int cache_enabled();
+
+/**
+ * @brief Writes every dirty block back to the disk image, in block order.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int cache_sync();
+
+/**
+ * @brief Copies the cache counters into stats. They are all zero when the cache is disabled.
+ *
+ * @param stats Where to store the counters.
+ */
+void cache_get_stats(struct cache_stats *stats);
+
+/**
+ * @brief Syncs and disables the cache. Called by disk_close(). The cache is disabled even if
+ * the sync fails, and the dirty blocks that could not be written back are lost.
+ *
+ * @return int Returns 0 on success, -1 if dirty blocks could not be written back.
+ */
+int cache_close();
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+int vdisk_cache_init(struct vdisk *d, int nblocks);
+int vdisk_cache_enabled(struct vdisk *d);
+int vdisk_cache_sync(struct vdisk *d);
+void vdisk_cache_get_stats(struct vdisk *d, struct cache_stats *stats);
+int vdisk_cache_close(struct vdisk *d);
+
+#endif
\ No newline at end of file
@@ -1,164 +1,1601 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#include "disk.h"
-
-static FILE *disk;                      // disk file pointer
-static uint32_t number_of_blocks = 0;   // number of blocks in the disk
-static int reads = 0;                   // number of reads from the disk
-static int writes = 0;                  // number of writes to the disk
-
-int disk_init(char *filename, int nblocks)
-{
-    // Open the file in write mode.
-    disk = fopen(filename, "w+");
-
-    // If the file could not be created, return -1.
-    if (disk == NULL)
-    {
-        return -1;
-    }
-
-    // Create a block of zeros.
-    char *block = calloc(BLOCK_SIZE, sizeof(char));
-
-    // Write the blocks to the disk.
-    for (int i = 0; i < nblocks; i++)
-    {
-        fwrite(block, BLOCK_SIZE, 1, disk);
-    }
-
-    // Free the block.
-    free(block);
-
-    // Set the number of blocks.
-    number_of_blocks = nblocks;
-
-    // Return 0.
-    return 0;
-}
-
-int disk_size()
-{
-    // Return the number of blocks.
-    return number_of_blocks;
-}
-
-/**
- * Checks if the given block number and buffer are valid.
- * 
- * @param blocknum The block number to be checked.
- * @param buf The buffer to be checked.
- * 
- * @return Returns 0 if both the block number and buffer are valid, otherwise returns a non-zero value.
- */
-static int sanity_check(uint32_t blocknum, const void *buf)
-{
-    if (blocknum >= number_of_blocks)
-    {
-        printf("   > %d\n", blocknum);
-        printf("   ERROR: Block number must be less than %d.\n", number_of_blocks);
-        return -1;
-    }
-
-    if (buf == NULL)
-    {
-        printf("   ERROR: Buffer cannot be NULL.\n");
-        return -1;
-    }
-
-    return 0;
-}
-
-int disk_read(uint32_t blocknum, void *buf)
-{
-    // Perform sanity check.
-    if (sanity_check(blocknum, buf) != 0)
-    {
-        printf("   READ sanity check failed.\n");
-        return -1;
-    }
-
-    // Seek to the block.
-    fseek(disk, blocknum * BLOCK_SIZE, SEEK_SET);
-
-    // Read the block.
-    int blocks_read = fread(buf, BLOCK_SIZE, 1, disk);
-
-    // If the number of blocks read is not 1, return -1.
-    if (blocks_read != 1)
-    {
-        printf("   ERROR: Could not read block %d.\n", blocknum);
-        return -1;
-    }
-
-    // Increment the number of reads.
-    reads++;
-
-    // Return the number of bytes read.
-    return BLOCK_SIZE;
-}
-
-int disk_write(uint32_t blocknum, void *buf)
-{
-    // Perform sanity check.
-    if (sanity_check(blocknum, buf) != 0)
-    {
-        printf("   WRITE sanity check failed.\n");
-        return -1;
-    }
-
-    // Seek to the block.
-    fseek(disk, blocknum * BLOCK_SIZE, SEEK_SET);
-
-    // Write the block.
-    int blocks_written = fwrite(buf, BLOCK_SIZE, 1, disk);
-
-    // If the number of blocks written is not 1, return -1.
-    if (blocks_written != 1)
-    {
-        printf("   ERROR: Could not write block %d.\n", blocknum);
-        return -1;
-    }
-
-    // Increment the number of writes.
-    writes++;
-
-    // Return the number of bytes written.
-    return BLOCK_SIZE;
-}
-
-/**
- * @param log: 0 if log is not required, 1 if log is required
- */
-int disk_close(int log)
-{
-    // If the disk is not open, return -1.
-    if (disk == NULL)
-    {
-        printf("   ERROR: Disk is not open.\n");
-        return -1;
-    }
-
-    // If the disk could not be flushed, return -1.
-    else if (fclose(disk) != 0)
-    {
-        printf("   ERROR: Could not close disk.\n");
-        return -1;
-    }
-
-    // Print the number of reads and writes.
-    if (log) 
-    {
-        printf("   Reads (Blocks): %d\n", reads);
-        printf("   Writes (Blocks): %d\n", writes);
-        printf("   Disk closed.\n");
-    }
-
-    // Clear the disk pointer.
-    disk = NULL;
-
-    // Return 0.
-    return 0;
+#define _GNU_SOURCE // O_DIRECT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "disk.h"
+#include "disk_internal.h"
+#include "cache.h"
+#include "disk_model.h"
+#include "disk_stats.h"
+#include "disk_trace.h"
+#include "disk_sched.h"
+#include "disk_checksum.h"
+#include "disk_compress.h"
+#include "disk_dedup.h"
+#include "disk_thin.h"
+#include "disk_raid.h"
+#include "disk_discard.h"
+
+#define DISK_MAX_RUN 256                // most blocks merged into one preadv/pwritev
+#define DISK_CHECKED_RUN 16             // most blocks per preadv when each is verified, 64 KB
+
+static struct vdisk *default_disk = NULL; // disk used by the disk_* functions
+
+/**
+ * Reads exactly `count` bytes at `offset`, retrying on short reads and EINTR.
+ *
+ * @return Returns 0 on success, -1 on failure or end of file.
+ */
+static int pread_full(int fd, void *buf, size_t count, off_t offset)
+{
+    char *p = buf;
+
+    while (count > 0)
+    {
+        ssize_t n = pread(fd, p, count, offset);
+
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (n <= 0)
+        {
+            return -1;
+        }
+
+        p += n;
+        count -= n;
+        offset += n;
+    }
+
+    return 0;
+}
+
+/**
+ * Writes exactly `count` bytes at `offset`, retrying on short writes and EINTR.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int pwrite_full(int fd, const void *buf, size_t count, off_t offset)
+{
+    const char *p = buf;
+
+    while (count > 0)
+    {
+        ssize_t n = pwrite(fd, p, count, offset);
+
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (n <= 0)
+        {
+            return -1;
+        }
+
+        p += n;
+        count -= n;
+        offset += n;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns 1 if buf can be handed to an O_DIRECT transfer as is.
+ */
+static int is_aligned(const void *buf)
+{
+    return ((uintptr_t)buf & (BLOCK_SIZE - 1)) == 0;
+}
+
+/**
+ * Moves one block at its offset with pread/pwrite. On an O_DIRECT disk an unaligned buffer is
+ * copied through an aligned one.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int block_pio(struct vdisk *d, int write, uint64_t blocknum, void *buf)
+{
+    _Alignas(BLOCK_SIZE) uint8_t bounce[BLOCK_SIZE];
+    off_t offset = (off_t)blocknum * BLOCK_SIZE;
+    void *p = buf;
+
+    // A compressed image keeps the block wherever its map says.
+    if (d->comp != NULL)
+    {
+        struct disk_iovec iov = {blocknum, buf};
+        return disk_compress_run(d, write, &iov, 1);
+    }
+
+    // So does a deduplicated one.
+    if (d->dedup != NULL)
+    {
+        struct disk_iovec iov = {blocknum, buf};
+        return disk_dedup_run(d, write, &iov, 1);
+    }
+
+    // And a thin-provisioned one.
+    if (d->thin != NULL)
+    {
+        struct disk_iovec iov = {blocknum, buf};
+        return disk_thin_run(d, write, &iov, 1);
+    }
+
+    // A striped or mirrored disk keeps it on its members.
+    if (d->raid != NULL)
+    {
+        struct disk_iovec iov = {blocknum, buf};
+        return disk_raid_run(d, write, &iov, 1);
+    }
+
+    // A hole reads as zeros without I/O, and a block written is a hole no more.
+    if (write)
+    {
+        disk_discard_fill(d, blocknum, 1);
+    }
+    else if (disk_discard_holes(d, blocknum, 1))
+    {
+        memset(buf, 0, BLOCK_SIZE);
+        return 0;
+    }
+
+    if (d->direct && !is_aligned(buf))
+    {
+        p = bounce;
+        if (write)
+        {
+            memcpy(bounce, buf, BLOCK_SIZE);
+        }
+    }
+
+    if ((write ? pwrite_full(d->fd, p, BLOCK_SIZE, offset) : pread_full(d->fd, p, BLOCK_SIZE, offset)) != 0)
+    {
+        return -1;
+    }
+
+    if (p != buf && !write)
+    {
+        memcpy(buf, bounce, BLOCK_SIZE);
+    }
+
+    return 0;
+}
+
+/**
+ * Switches fd to O_DIRECT, and back again if the filesystem refuses direct transfers: some
+ * refuse the flag, others accept it and fail every transfer.
+ *
+ * @return Returns 1 if the descriptor is left in O_DIRECT mode, 0 otherwise.
+ */
+static int direct_enable(int fd, uint64_t nblocks)
+{
+    int fl = fcntl(fd, F_GETFL);
+
+    if (fl < 0 || fcntl(fd, F_SETFL, fl | O_DIRECT) != 0)
+    {
+        return 0;
+    }
+
+    // Try a transfer, so the failure shows up now rather than on the first disk_read.
+    if (nblocks > 0)
+    {
+        void *probe = disk_alloc_blocks(1);
+        int works = probe != NULL && pread(fd, probe, BLOCK_SIZE, 0) == BLOCK_SIZE;
+        disk_free_blocks(probe);
+
+        if (!works)
+        {
+            fcntl(fd, F_SETFL, fl);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Sets up the block locks and the cache/engine lock of a DISK_THREADSAFE disk.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int locks_init(struct vdisk *d)
+{
+    pthread_mutexattr_t attr;
+
+    d->stripes = malloc(DISK_LOCK_STRIPES * sizeof(pthread_rwlock_t));
+    if (d->stripes == NULL)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < DISK_LOCK_STRIPES; i++)
+    {
+        pthread_rwlock_init(&d->stripes[i], NULL);
+    }
+
+    // The cache waits on the engine, whose callbacks go back into the cache.
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&d->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    return 0;
+}
+
+static void locks_destroy(struct vdisk *d)
+{
+    if (d->stripes == NULL)
+    {
+        return;
+    }
+
+    for (int i = 0; i < DISK_LOCK_STRIPES; i++)
+    {
+        pthread_rwlock_destroy(&d->stripes[i]);
+    }
+    pthread_mutex_destroy(&d->lock);
+    free(d->stripes);
+    d->stripes = NULL;
+}
+
+/**
+ * Returns 1 if the run of `count` blocks from `first` has a block on stripe `stripe`.
+ */
+static int run_covers(uint64_t first, int count, int stripe)
+{
+    uint32_t distance = (stripe + DISK_LOCK_STRIPES - first % DISK_LOCK_STRIPES) % DISK_LOCK_STRIPES;
+    return distance < (uint32_t)count;
+}
+
+/**
+ * Takes the block locks of blocks first..first+count-1, shared to read and exclusive to write.
+ * The locks are always taken in stripe order, so two runs can never wait on each other.
+ */
+static void lock_blocks(struct vdisk *d, int write, uint64_t first, int count)
+{
+    for (int i = 0; d->stripes != NULL && i < DISK_LOCK_STRIPES; i++)
+    {
+        if (!run_covers(first, count, i))
+        {
+            continue;
+        }
+
+        if (write)
+        {
+            pthread_rwlock_wrlock(&d->stripes[i]);
+        }
+        else
+        {
+            pthread_rwlock_rdlock(&d->stripes[i]);
+        }
+    }
+}
+
+static void unlock_blocks(struct vdisk *d, uint64_t first, int count)
+{
+    for (int i = 0; d->stripes != NULL && i < DISK_LOCK_STRIPES; i++)
+    {
+        if (run_covers(first, count, i))
+        {
+            pthread_rwlock_unlock(&d->stripes[i]);
+        }
+    }
+}
+
+/**
+ * Finishes opening a disk once `fd` refers to an image of `nblocks` blocks.
+ * Maps the image when DISK_MMAP is set. Closes the descriptor on failure.
+ *
+ * @param create 1 if the image was just created, 0 if it was opened. A compressed,
+ * deduplicated or thin-provisioned image is given its header then, or has its number of
+ * blocks read from it.
+ * @return Returns the new disk, or NULL on failure.
+ */
+static struct vdisk *disk_attach(int fd, uint64_t nblocks, int flags, int create)
+{
+    struct vdisk *d = calloc(1, sizeof(struct vdisk));
+
+    if (d == NULL)
+    {
+        printf("   ERROR: Could not allocate disk.\n");
+        close(fd);
+        return NULL;
+    }
+
+    d->fd = fd;
+
+    if ((flags & DISK_DIRECT) && (flags & DISK_MMAP))
+    {
+        printf("   ERROR: DISK_DIRECT cannot be combined with DISK_MMAP.\n");
+        close(fd);
+        free(d);
+        return NULL;
+    }
+
+    if ((flags & DISK_COMPRESS) && (flags & (DISK_MMAP | DISK_DIRECT | DISK_CHECKSUM)))
+    {
+        printf("   ERROR: DISK_COMPRESS cannot be combined with DISK_MMAP, DISK_DIRECT or DISK_CHECKSUM.\n");
+        close(fd);
+        free(d);
+        return NULL;
+    }
+
+    if ((flags & DISK_DEDUP) && (flags & (DISK_MMAP | DISK_DIRECT | DISK_CHECKSUM | DISK_COMPRESS)))
+    {
+        printf("   ERROR: DISK_DEDUP cannot be combined with DISK_MMAP, DISK_DIRECT, DISK_CHECKSUM or DISK_COMPRESS.\n");
+        close(fd);
+        free(d);
+        return NULL;
+    }
+
+    if ((flags & DISK_THIN) && (flags & (DISK_MMAP | DISK_DIRECT | DISK_CHECKSUM | DISK_COMPRESS | DISK_DEDUP)))
+    {
+        printf("   ERROR: DISK_THIN cannot be combined with DISK_MMAP, DISK_DIRECT, DISK_CHECKSUM, DISK_COMPRESS or DISK_DEDUP.\n");
+        close(fd);
+        free(d);
+        return NULL;
+    }
+
+    // Bypass the page cache when asked to and the filesystem allows it.
+    if (flags & DISK_DIRECT)
+    {
+        d->direct = direct_enable(fd, nblocks);
+    }
+
+    if ((flags & DISK_THREADSAFE) && locks_init(d) != 0)
+    {
+        printf("   ERROR: Could not allocate disk locks.\n");
+        close(fd);
+        free(d);
+        return NULL;
+    }
+
+    // Map the whole image once, so blocks can be served straight from the page cache.
+    if ((flags & DISK_MMAP) && nblocks > 0)
+    {
+        void *map = mmap(NULL, (size_t)nblocks * BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (map == MAP_FAILED)
+        {
+            printf("   ERROR: Could not map disk.\n");
+            close(fd);
+            locks_destroy(d);
+            free(d);
+            return NULL;
+        }
+
+        d->map = map;
+    }
+
+    // Set the number of blocks.
+    d->nblocks = nblocks;
+
+    // Load the checksums of every block.
+    if ((flags & DISK_CHECKSUM) && disk_checksum_attach(d) != 0)
+    {
+        if (d->map != NULL)
+        {
+            munmap(d->map, (size_t)nblocks * BLOCK_SIZE);
+        }
+        close(fd);
+        locks_destroy(d);
+        free(d);
+        return NULL;
+    }
+
+    // Set up the translation map of a compressed image, which knows its own number of blocks.
+    if ((flags & DISK_COMPRESS) && disk_compress_attach(d, create) != 0)
+    {
+        close(fd);
+        locks_destroy(d);
+        free(d);
+        return NULL;
+    }
+
+    // Likewise the tables of a deduplicated image.
+    if ((flags & DISK_DEDUP) && disk_dedup_attach(d, create) != 0)
+    {
+        close(fd);
+        locks_destroy(d);
+        free(d);
+        return NULL;
+    }
+
+    // And the mapping tables of a thin-provisioned image.
+    if ((flags & DISK_THIN) && disk_thin_attach(d, create) != 0)
+    {
+        close(fd);
+        locks_destroy(d);
+        free(d);
+        return NULL;
+    }
+    nblocks = d->nblocks;
+
+    // Split the disk into the heatmap regions, rounding up so they cover every block.
+    d->stats.region_blocks = nblocks > DISK_STATS_REGIONS ? (nblocks + DISK_STATS_REGIONS - 1) / DISK_STATS_REGIONS : 1;
+
+    return d;
+}
+
+/**
+ * Transfers a run of buffers at `offset` with preadv/pwritev, retrying on short transfers and EINTR.
+ * The iovec array is consumed in the process.
+ *
+ * @return Returns 0 on success, -1 on failure or end of file.
+ */
+static int prwv_full(int fd, int write, struct iovec *v, int count, off_t offset)
+{
+    while (count > 0)
+    {
+        ssize_t n = write ? pwritev(fd, v, count, offset) : preadv(fd, v, count, offset);
+
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (n <= 0)
+        {
+            return -1;
+        }
+
+        offset += n;
+
+        // Skip the buffers that were completed, and trim the one that was partially done.
+        while (count > 0 && (size_t)n >= v->iov_len)
+        {
+            n -= v->iov_len;
+            v++;
+            count--;
+        }
+
+        if (count > 0)
+        {
+            v->iov_base = (char *)v->iov_base + n;
+            v->iov_len -= n;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Finishes opening an image like disk_attach(), and finds the holes of a flat one so that
+ * reads of them need no I/O.
+ *
+ * @return Returns the new disk, or NULL on failure.
+ */
+static struct vdisk *attach_image(int fd, uint64_t nblocks, int flags, int create)
+{
+    struct vdisk *d = disk_attach(fd, nblocks, flags, create);
+    int map = !(flags & (DISK_MMAP | DISK_COMPRESS | DISK_DEDUP | DISK_THIN));
+
+    if (d != NULL && disk_discard_attach(d, map) != 0)
+    {
+        vdisk_close(d, 0);
+        return NULL;
+    }
+
+    return d;
+}
+
+/**
+ * Makes `d` the default disk, closing the one it replaces.
+ *
+ * @return Returns 0 if d is a disk, -1 if opening it failed.
+ */
+static int set_default(struct vdisk *d)
+{
+    if (d == NULL)
+    {
+        return -1;
+    }
+
+    if (default_disk != NULL)
+    {
+        vdisk_close(default_disk, 0);
+    }
+
+    default_disk = d;
+    return 0;
+}
+
+int disk_init(char *filename, int64_t nblocks)
+{
+    return disk_init_flags(filename, nblocks, 0);
+}
+
+int disk_init_flags(char *filename, int64_t nblocks, int flags)
+{
+    return set_default(vdisk_init(filename, nblocks, flags));
+}
+
+int disk_open(char *filename, int flags)
+{
+    return set_default(vdisk_open(filename, flags));
+}
+
+int disk_init_raid(char **members, int count, int64_t nblocks, int stripe_unit, int flags)
+{
+    return set_default(vdisk_init_raid(members, count, nblocks, stripe_unit, flags));
+}
+
+int disk_open_raid(char **members, int count, int flags)
+{
+    return set_default(vdisk_open_raid(members, count, flags));
+}
+
+int disk_init_mirror(char **members, int count, int64_t nblocks, int flags)
+{
+    return set_default(vdisk_init_mirror(members, count, nblocks, flags));
+}
+
+struct vdisk *disk_default()
+{
+    return default_disk;
+}
+
+struct vdisk *vdisk_init(char *filename, int64_t nblocks, int flags)
+{
+    if (nblocks < 0)
+    {
+        printf("   ERROR: Number of blocks cannot be negative.\n");
+        return NULL;
+    }
+
+    if ((uint64_t)nblocks > DISK_MAX_BLOCKS)
+    {
+        printf("   ERROR: Number of blocks cannot be more than %llu.\n", (unsigned long long)DISK_MAX_BLOCKS);
+        return NULL;
+    }
+
+    // Open the file for reading and writing, truncating any previous contents.
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    // If the file could not be created, return NULL.
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    // Size the image in one call, checksum region included. The file is sparse, so every block
+    // reads back as zeros without having been written. A compressed, deduplicated or
+    // thin-provisioned image starts empty, and grows with the blocks written to it.
+    uint64_t region = (flags & DISK_CHECKSUM) ? disk_checksum_blocks(nblocks) : 0;
+    off_t size = (flags & (DISK_COMPRESS | DISK_DEDUP | DISK_THIN)) ? 0 : ((off_t)nblocks + region) * BLOCK_SIZE;
+    int result = ftruncate(fd, size);
+
+    // Reserve the space up front if asked to, so later writes cannot fail with ENOSPC.
+    if (result == 0 && (flags & DISK_PREALLOC) && size > 0)
+    {
+        result = posix_fallocate(fd, 0, size);
+    }
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not size disk to %lld blocks.\n", (long long)nblocks);
+        close(fd);
+        return NULL;
+    }
+
+    return attach_image(fd, nblocks, flags, 1);
+}
+
+struct vdisk *vdisk_open(char *filename, int flags)
+{
+    // Open the existing file for reading and writing, keeping its contents.
+    int fd = open(filename, O_RDWR);
+
+    // If the file could not be opened, return NULL.
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    // A compressed, deduplicated or thin-provisioned image has its size in its header.
+    if (flags & (DISK_COMPRESS | DISK_DEDUP | DISK_THIN))
+    {
+        return attach_image(fd, 0, flags, 0);
+    }
+
+    // The image must be a whole number of blocks.
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size % BLOCK_SIZE != 0 || (uint64_t)st.st_size / BLOCK_SIZE > DISK_MAX_BLOCKS)
+    {
+        printf("   ERROR: %s is not a valid disk image.\n", filename);
+        close(fd);
+        return NULL;
+    }
+
+    // Leave out the checksum region, which must be exactly the size the data blocks need.
+    uint64_t total = st.st_size / BLOCK_SIZE;
+    uint64_t nblocks = total;
+
+    if (flags & DISK_CHECKSUM)
+    {
+        nblocks = total - disk_checksum_blocks(total);
+        while (nblocks + disk_checksum_blocks(nblocks) < total)
+        {
+            nblocks++;
+        }
+
+        if (nblocks + disk_checksum_blocks(nblocks) != total)
+        {
+            printf("   ERROR: %s has no checksum region.\n", filename);
+            close(fd);
+            return NULL;
+        }
+    }
+
+    return attach_image(fd, nblocks, flags, 0);
+}
+
+int64_t disk_size()
+{
+    return vdisk_size(default_disk);
+}
+
+int64_t vdisk_size(struct vdisk *d)
+{
+    // Return the number of blocks.
+    return d != NULL ? d->nblocks : 0;
+}
+
+/**
+ * Checks if the given block number and buffer are valid.
+ * 
+ * @param d The disk the block belongs to.
+ * @param blocknum The block number to be checked.
+ * @param buf The buffer to be checked.
+ * 
+ * @return Returns 0 if both the block number and buffer are valid, otherwise returns a non-zero value.
+ */
+static int sanity_check(struct vdisk *d, uint64_t blocknum, const void *buf)
+{
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    if (blocknum >= d->nblocks)
+    {
+        printf("   > %llu\n", (unsigned long long)blocknum);
+        printf("   ERROR: Block number must be less than %llu.\n", (unsigned long long)d->nblocks);
+        return -1;
+    }
+
+    if (buf == NULL)
+    {
+        printf("   ERROR: Buffer cannot be NULL.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Records the checksum of a block just written, or checks one just read. The block lock must
+ * be held, so that the block and its checksum change together.
+ *
+ * @return Returns 0 on success, -1 if a block read does not match its checksum.
+ */
+static int checksum(struct vdisk *d, int write, uint64_t blocknum, const void *buf)
+{
+    if (d->csum == NULL)
+    {
+        return 0;
+    }
+
+    if (write)
+    {
+        disk_checksum_update(d, blocknum, buf);
+        return 0;
+    }
+
+    return disk_checksum_verify(d, blocknum, buf);
+}
+
+/**
+ * Moves one block between the backing image and buf, and counts it.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int block_io(struct vdisk *d, int write, uint64_t blocknum, void *buf)
+{
+    uint8_t *block = d->map + (size_t)blocknum * BLOCK_SIZE;
+    int result = 0;
+
+    // With the scheduler running, writes join its queue and reads of queued blocks come from it.
+    if (d->sched != NULL)
+    {
+        int queued = write ? disk_sched_write(d, blocknum, buf) : disk_sched_read(d, blocknum, buf);
+        if (queued != 0)
+        {
+            return queued > 0 ? 0 : -1;
+        }
+    }
+
+    lock_blocks(d, write, blocknum, 1);
+
+    // Copy the block in or out of the mapping.
+    if (d->map != NULL)
+    {
+        if (write)
+        {
+            memcpy(block, buf, BLOCK_SIZE);
+        }
+        else
+        {
+            memcpy(buf, block, BLOCK_SIZE);
+        }
+    }
+
+    // Or move it in a single positional read or write.
+    else
+    {
+        result = block_pio(d, write, blocknum, buf);
+    }
+
+    result = result == 0 ? checksum(d, write, blocknum, buf) : result;
+
+    unlock_blocks(d, blocknum, 1);
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not %s block %llu.\n", write ? "write" : "read", (unsigned long long)blocknum);
+        return -1;
+    }
+
+    // Increment the number of reads or writes.
+    disk_internal_account(d, write, blocknum, 1);
+
+    return 0;
+}
+
+/**
+ * Adds a completed request to the statistics, and to the trace if one is running.
+ */
+static void note_request(struct vdisk *d, int write, uint64_t start, const struct disk_iovec *iov, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        disk_stats_touch(d, write, iov[i].blocknum, 1);
+    }
+    disk_stats_record(d, write, start, (uint64_t)count * BLOCK_SIZE);
+
+    if (d->trace != NULL)
+    {
+        disk_trace_record(d, write, start, iov, count, 0);
+    }
+}
+
+int disk_read(uint64_t blocknum, void *buf)
+{
+    return vdisk_read(default_disk, blocknum, buf);
+}
+
+int vdisk_read(struct vdisk *d, uint64_t blocknum, void *buf)
+{
+    // Perform sanity check.
+    if (sanity_check(d, blocknum, buf) != 0)
+    {
+        printf("   READ sanity check failed.\n");
+        return -1;
+    }
+
+    uint64_t start = disk_stats_now();
+
+    // Serve the block from the cache when there is one, or read it from the image.
+    // The cache and the scheduler hold blocks the image does not have yet, so with either the
+    // lookup and the transfer behind it must not interleave with other threads.
+    int locked = d->cache != NULL || d->sched != NULL;
+    if (locked)
+    {
+        disk_internal_lock(d);
+    }
+
+    int result = d->cache != NULL ? cache_read(d, blocknum, buf) : block_io(d, 0, blocknum, buf);
+
+    if (locked)
+    {
+        disk_internal_unlock(d);
+    }
+
+    if (result != 0)
+    {
+        return -1;
+    }
+
+    struct disk_iovec iov = {blocknum, buf};
+    note_request(d, 0, start, &iov, 1);
+
+    // Return the number of bytes read.
+    return BLOCK_SIZE;
+}
+
+int disk_write(uint64_t blocknum, void *buf)
+{
+    return vdisk_write(default_disk, blocknum, buf);
+}
+
+int vdisk_write(struct vdisk *d, uint64_t blocknum, void *buf)
+{
+    // Perform sanity check.
+    if (sanity_check(d, blocknum, buf) != 0)
+    {
+        printf("   WRITE sanity check failed.\n");
+        return -1;
+    }
+
+    uint64_t start = disk_stats_now();
+
+    // Leave the block dirty in the cache when there is one, or write it to the image.
+    // The cache and the scheduler hold blocks the image does not have yet, so with either the
+    // lookup and the transfer behind it must not interleave with other threads.
+    int locked = d->cache != NULL || d->sched != NULL;
+    if (locked)
+    {
+        disk_internal_lock(d);
+    }
+
+    int result = d->cache != NULL ? cache_write(d, blocknum, buf) : block_io(d, 1, blocknum, buf);
+
+    if (locked)
+    {
+        disk_internal_unlock(d);
+    }
+
+    if (result != 0)
+    {
+        return -1;
+    }
+
+    struct disk_iovec iov = {blocknum, buf};
+    note_request(d, 1, start, &iov, 1);
+
+    // Return the number of bytes written.
+    return BLOCK_SIZE;
+}
+
+/**
+ * Moves one run of contiguous blocks with preadv/pwritev. On an O_DIRECT disk, entries with
+ * unaligned buffers go through `*bounce`, which is allocated on first use with room for a
+ * whole run; the caller frees it.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int run_pio(struct vdisk *d, int write, const struct disk_iovec *iov, struct iovec *run, int n, uint8_t **bounce)
+{
+    off_t offset = (off_t)iov[0].blocknum * BLOCK_SIZE;
+    int bounced = 0;
+
+    // A compressed image moves the run as stored, in as few transfers as its layout allows.
+    if (d->comp != NULL)
+    {
+        return disk_compress_run(d, write, iov, n);
+    }
+
+    // A deduplicated one moves each block to or from the copy its map entry points at.
+    if (d->dedup != NULL)
+    {
+        return disk_dedup_run(d, write, iov, n);
+    }
+
+    // A thin-provisioned one moves the run in as many pieces as it is stored in.
+    if (d->thin != NULL)
+    {
+        return disk_thin_run(d, write, iov, n);
+    }
+
+    // A striped or mirrored one moves each member's part of it at once.
+    if (d->raid != NULL)
+    {
+        return disk_raid_run(d, write, iov, n);
+    }
+
+    // A run of holes reads as zeros without I/O.
+    if (write)
+    {
+        disk_discard_fill(d, iov[0].blocknum, n);
+    }
+    else if (disk_discard_holes(d, iov[0].blocknum, n))
+    {
+        for (int j = 0; j < n; j++)
+        {
+            memset(iov[j].buf, 0, BLOCK_SIZE);
+        }
+        return 0;
+    }
+
+    for (int j = 0; d->direct && j < n; j++)
+    {
+        if (is_aligned(run[j].iov_base))
+        {
+            continue;
+        }
+
+        if (*bounce == NULL && (*bounce = disk_alloc_blocks(DISK_MAX_RUN)) == NULL)
+        {
+            return -1;
+        }
+
+        run[j].iov_base = *bounce + (size_t)j * BLOCK_SIZE;
+        if (write)
+        {
+            memcpy(run[j].iov_base, iov[j].buf, BLOCK_SIZE);
+        }
+        bounced = 1;
+    }
+
+    if (prwv_full(d->fd, write, run, n, offset) != 0)
+    {
+        return -1;
+    }
+
+    // prwv_full() consumed the iovecs, so find the bounced entries again by address.
+    for (int j = 0; bounced && !write && j < n; j++)
+    {
+        if (!is_aligned(iov[j].buf))
+        {
+            memcpy(iov[j].buf, *bounce + (size_t)j * BLOCK_SIZE, BLOCK_SIZE);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Moves a checked block list between the image and its buffers. Runs of physically contiguous
+ * blocks are moved with one preadv/pwritev each; on a mapped disk every block is a plain copy.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int transfer_runs(struct vdisk *d, int write, const struct disk_iovec *iov, int count)
+{
+    struct iovec run[DISK_MAX_RUN];
+    uint8_t *bounce = NULL;
+    int i = 0;
+
+    // Writes supersede the scheduler's queued copies of their blocks.
+    if (write && disk_sched_settle(d, 1, iov, count) != 0)
+    {
+        return -1;
+    }
+
+    // Checked reads are kept short enough that the blocks are still in cache when verified.
+    int max_run = d->csum != NULL && !write ? DISK_CHECKED_RUN : DISK_MAX_RUN;
+
+    while (i < count)
+    {
+        uint64_t first = iov[i].blocknum;
+        int n = 0;
+
+        // Collect the run of entries that continue block by block from `first`.
+        while (i + n < count && n < max_run && iov[i + n].blocknum == first + (uint64_t)n)
+        {
+            run[n].iov_base = iov[i + n].buf;
+            run[n].iov_len = BLOCK_SIZE;
+            n++;
+        }
+
+        int result = 0;
+
+        lock_blocks(d, write, first, n);
+
+        // On a mapped disk each block is checksummed straight after its copy.
+        if (d->map != NULL)
+        {
+            for (int j = 0; j < n && result == 0; j++)
+            {
+                uint8_t *block = d->map + (size_t)(first + j) * BLOCK_SIZE;
+
+                if (write)
+                {
+                    memcpy(block, run[j].iov_base, BLOCK_SIZE);
+                }
+                else
+                {
+                    memcpy(run[j].iov_base, block, BLOCK_SIZE);
+                }
+
+                result = checksum(d, write, first + j, iov[i + j].buf);
+            }
+        }
+        else
+        {
+            result = run_pio(d, write, iov + i, run, n, &bounce);
+
+            for (int j = 0; j < n && result == 0; j++)
+            {
+                result = checksum(d, write, first + j, iov[i + j].buf);
+            }
+        }
+
+        unlock_blocks(d, first, n);
+
+        if (result != 0)
+        {
+            printf("   ERROR: Could not %s blocks %llu-%llu.\n", write ? "write" : "read", (unsigned long long)first,
+                   (unsigned long long)(first + n - 1));
+            disk_free_blocks(bounce);
+            return -1;
+        }
+
+        // Count every block in the run.
+        disk_internal_account(d, write, first, n);
+
+        i += n;
+    }
+
+    // Reads see the writes still queued in the scheduler.
+    if (!write)
+    {
+        disk_sched_overlay(d, iov, count);
+    }
+
+    disk_free_blocks(bounce);
+    return 0;
+}
+
+/**
+ * Shared body of disk_readv() and disk_writev().
+ *
+ * @return Returns the number of bytes transferred, or -1 if an error occurred.
+ */
+static int disk_transfer(struct vdisk *d, int write, const struct disk_iovec *iov, int count)
+{
+    if (iov == NULL || count < 0)
+    {
+        printf("   ERROR: Invalid block list.\n");
+        return -1;
+    }
+
+    // Check the whole list first, so a bad entry does not leave a partial transfer behind.
+    for (int i = 0; i < count; i++)
+    {
+        if (sanity_check(d, iov[i].blocknum, iov[i].buf) != 0)
+        {
+            printf(write ? "   WRITE sanity check failed.\n" : "   READ sanity check failed.\n");
+            return -1;
+        }
+    }
+
+    uint64_t start = disk_stats_now();
+
+    // With a cache, the transfer and the cache update below must not interleave with other threads,
+    // and neither may the transfer and the scheduler's queue.
+    int cached = d->cache != NULL;
+    int locked = cached || d->sched != NULL;
+    if (locked)
+    {
+        disk_internal_lock(d);
+    }
+
+    int result = transfer_runs(d, write, iov, count);
+
+    // Vectored transfers go around the cache, so keep it coherent with what was moved:
+    // cached copies take the written data, and reads see blocks still dirty in the cache.
+    for (int i = 0; i < count && result == 0 && cached; i++)
+    {
+        if (write)
+        {
+            cache_internal_update(d, iov[i].blocknum, iov[i].buf);
+        }
+        else
+        {
+            cache_internal_overlay(d, iov[i].blocknum, iov[i].buf);
+        }
+    }
+
+    if (locked)
+    {
+        disk_internal_unlock(d);
+    }
+
+    if (result != 0)
+    {
+        return -1;
+    }
+
+    note_request(d, write, start, iov, count);
+
+    return count * BLOCK_SIZE;
+}
+
+int disk_readv(const struct disk_iovec *iov, int count)
+{
+    return vdisk_readv(default_disk, iov, count);
+}
+
+int disk_writev(const struct disk_iovec *iov, int count)
+{
+    return vdisk_writev(default_disk, iov, count);
+}
+
+int vdisk_readv(struct vdisk *d, const struct disk_iovec *iov, int count)
+{
+    return disk_transfer(d, 0, iov, count);
+}
+
+int vdisk_writev(struct vdisk *d, const struct disk_iovec *iov, int count)
+{
+    return disk_transfer(d, 1, iov, count);
+}
+
+const void *disk_block(uint64_t blocknum)
+{
+    return vdisk_block(default_disk, blocknum);
+}
+
+const void *vdisk_block(struct vdisk *d, uint64_t blocknum)
+{
+    if (d == NULL || d->map == NULL)
+    {
+        printf("   ERROR: Disk is not mapped.\n");
+        return NULL;
+    }
+
+    // Perform sanity check. The block itself stands in for the buffer.
+    if (sanity_check(d, blocknum, d->map) != 0)
+    {
+        printf("   READ sanity check failed.\n");
+        return NULL;
+    }
+
+    // The mapping must hold the latest contents of the block.
+    disk_internal_lock(d);
+    int result = cache_internal_writeback(d, blocknum);
+    disk_internal_unlock(d);
+
+    // And it must match its checksum before it is handed out.
+    const uint8_t *block = d->map + (size_t)blocknum * BLOCK_SIZE;
+    if (result == 0)
+    {
+        lock_blocks(d, 0, blocknum, 1);
+        result = checksum(d, 0, blocknum, block);
+        unlock_blocks(d, blocknum, 1);
+    }
+
+    if (result != 0)
+    {
+        return NULL;
+    }
+
+    // Handing out the block counts as reading it.
+    disk_internal_account(d, 0, blocknum, 1);
+
+    return block;
+}
+
+int disk_flush()
+{
+    return vdisk_flush(default_disk);
+}
+
+int vdisk_flush(struct vdisk *d)
+{
+    // If the disk is not open, return -1.
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    // Write back the blocks that are only dirty in the cache.
+    if (vdisk_cache_sync(d) != 0)
+    {
+        return -1;
+    }
+
+    // Then the writes waiting in the scheduler.
+    if (vdisk_sched_dispatch(d) != 0)
+    {
+        return -1;
+    }
+
+    // Then the checksums of everything written.
+    if (disk_checksum_flush(d) != 0)
+    {
+        return -1;
+    }
+
+    // And where a compressed image stored it.
+    if (disk_compress_flush(d) != 0)
+    {
+        return -1;
+    }
+
+    // Or which copies a deduplicated image points it at.
+    if (disk_dedup_flush(d) != 0)
+    {
+        return -1;
+    }
+
+    // Or where a thin-provisioned image put it.
+    if (disk_thin_flush(d) != 0)
+    {
+        return -1;
+    }
+
+    // Flush the members of a striped or mirrored disk.
+    if (disk_raid_flush(d) != 0)
+    {
+        return -1;
+    }
+
+    // Write back dirty pages of the mapping.
+    if (d->map != NULL && msync(d->map, (size_t)d->nblocks * BLOCK_SIZE, MS_SYNC) != 0)
+    {
+        printf("   ERROR: Could not flush disk.\n");
+        return -1;
+    }
+
+    // Flush the file itself.
+    if (fsync(d->fd) != 0)
+    {
+        printf("   ERROR: Could not flush disk.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int disk_direct()
+{
+    return vdisk_direct(default_disk);
+}
+
+int vdisk_direct(struct vdisk *d)
+{
+    return d != NULL && d->direct;
+}
+
+void *disk_alloc_blocks(int nblocks)
+{
+    void *blocks = NULL;
+
+    if (nblocks <= 0 || posix_memalign(&blocks, BLOCK_SIZE, (size_t)nblocks * BLOCK_SIZE) != 0)
+    {
+        return NULL;
+    }
+
+    memset(blocks, 0, (size_t)nblocks * BLOCK_SIZE);
+    return blocks;
+}
+
+void disk_free_blocks(void *blocks)
+{
+    free(blocks);
+}
+
+int disk_internal_check(struct vdisk *d, uint64_t blocknum, const void *buf)
+{
+    return sanity_check(d, blocknum, buf);
+}
+
+int disk_internal_io(struct vdisk *d, int write, uint64_t blocknum, void *buf)
+{
+    return block_io(d, write, blocknum, buf);
+}
+
+int disk_internal_iov(struct vdisk *d, int write, const struct disk_iovec *iov, int count)
+{
+    return transfer_runs(d, write, iov, count);
+}
+
+int disk_internal_pio(struct vdisk *d, int write, uint64_t blocknum, void *buf)
+{
+    lock_blocks(d, write, blocknum, 1);
+    int result = block_pio(d, write, blocknum, buf);
+    result = result == 0 ? checksum(d, write, blocknum, buf) : result;
+    unlock_blocks(d, blocknum, 1);
+
+    return result;
+}
+
+int disk_internal_region(struct vdisk *d, int write, uint64_t blocknum, void *buf, int count)
+{
+    return disk_internal_extent(d, write, (uint64_t)blocknum * BLOCK_SIZE, buf, (size_t)count * BLOCK_SIZE);
+}
+
+int disk_internal_extent(struct vdisk *d, int write, uint64_t offset, void *buf, size_t size)
+{
+    return write ? pwrite_full(d->fd, buf, size, offset) : pread_full(d->fd, buf, size, offset);
+}
+
+int disk_internal_fdv(int fd, int write, struct iovec *vec, int count, uint64_t offset)
+{
+    // Stay within what one preadv/pwritev takes.
+    for (int done = 0; done < count; done += DISK_MAX_RUN)
+    {
+        int n = count - done < DISK_MAX_RUN ? count - done : DISK_MAX_RUN;
+        uint64_t size = 0;
+
+        for (int i = 0; i < n; i++)
+        {
+            size += vec[done + i].iov_len;
+        }
+
+        if (prwv_full(fd, write, vec + done, n, offset) != 0)
+        {
+            return -1;
+        }
+        offset += size;
+    }
+
+    return 0;
+}
+
+struct vdisk *disk_internal_attach(int fd, uint64_t nblocks, int flags)
+{
+    return disk_attach(fd, nblocks, flags, 0);
+}
+
+int disk_internal_extentv(struct vdisk *d, int write, uint64_t offset, const struct disk_iovec *iov, int count)
+{
+    struct iovec run[DISK_MAX_RUN];
+
+    for (int done = 0; done < count; done += DISK_MAX_RUN)
+    {
+        int n = count - done < DISK_MAX_RUN ? count - done : DISK_MAX_RUN;
+
+        for (int i = 0; i < n; i++)
+        {
+            run[i].iov_base = iov[done + i].buf;
+            run[i].iov_len = BLOCK_SIZE;
+        }
+
+        if (prwv_full(d->fd, write, run, n, offset + (uint64_t)done * BLOCK_SIZE) != 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void disk_internal_lock_blocks(struct vdisk *d, int write, uint64_t first, int count)
+{
+    lock_blocks(d, write, first, count);
+}
+
+void disk_internal_unlock_blocks(struct vdisk *d, uint64_t first, int count)
+{
+    unlock_blocks(d, first, count);
+}
+
+void disk_internal_account(struct vdisk *d, int write, uint64_t blocknum, int blocks)
+{
+    // Atomic, since threads of a DISK_THREADSAFE disk count at the same time.
+    __atomic_add_fetch(write ? &d->writes : &d->reads, blocks, __ATOMIC_RELAXED);
+
+    // Compressed, deduplicated and thin-provisioned images charge the model for where they
+    // store blocks.
+    if (d->model != NULL && d->comp == NULL && d->dedup == NULL && d->thin == NULL)
+    {
+        disk_model_charge(d, write, blocknum, blocks);
+    }
+}
+
+void disk_internal_lock(struct vdisk *d)
+{
+    if (d != NULL && d->stripes != NULL)
+    {
+        pthread_mutex_lock(&d->lock);
+    }
+}
+
+void disk_internal_unlock(struct vdisk *d)
+{
+    if (d != NULL && d->stripes != NULL)
+    {
+        pthread_mutex_unlock(&d->lock);
+    }
+}
+
+/**
+ * @param log: 0 if log is not required, 1 if log is required
+ */
+int disk_close(int log)
+{
+    struct vdisk *d = default_disk;
+
+    default_disk = NULL;
+    return vdisk_close(d, log);
+}
+
+int vdisk_close(struct vdisk *d, int log)
+{
+    // If the disk is not open, return -1.
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    // Finish any asynchronous requests while the descriptor is still valid.
+    vdisk_async_close(d);
+
+    // Their completions are traced, so the trace ends after them.
+    vdisk_trace_stop(d);
+
+    // Write back the cache, keeping its counters for the log below.
+    struct cache_stats cstats;
+    int cached = vdisk_cache_enabled(d);
+    vdisk_cache_get_stats(d, &cstats);
+    int cache_result = vdisk_cache_close(d);
+
+    // Write out the scheduler queue, and keep its counters as well.
+    struct disk_sched_stats sstats;
+    int scheduled = d->sched != NULL;
+    int sched_result = vdisk_sched_dispatch(d);
+    vdisk_sched_get_stats(d, &sstats);
+    if (vdisk_sched_close(d) != 0)
+    {
+        sched_result = -1;
+    }
+
+    // Store the checksums of the last writes, and keep the counters for the log.
+    struct disk_checksum_stats kstats;
+    int checksummed = d->csum != NULL;
+    vdisk_checksum_get_stats(d, &kstats);
+    int csum_result = disk_checksum_flush(d);
+    disk_checksum_detach(d);
+
+    // Store the translation map of a compressed image, keeping its counters as well.
+    struct disk_compress_stats zstats;
+    int compressed = d->comp != NULL;
+    vdisk_compress_get_stats(d, &zstats);
+    int comp_result = disk_compress_flush(d);
+    disk_compress_detach(d);
+
+    // And the tables of a deduplicated image.
+    struct disk_dedup_stats ustats;
+    int deduplicated = d->dedup != NULL;
+    vdisk_dedup_get_stats(d, &ustats);
+    int dedup_result = disk_dedup_flush(d);
+    disk_dedup_detach(d);
+
+    // And those of a thin-provisioned image.
+    struct disk_thin_stats tstats;
+    int thin = d->thin != NULL;
+    vdisk_thin_get_stats(d, &tstats);
+    int thin_result = disk_thin_flush(d);
+    disk_thin_detach(d);
+
+    // Stop the members of a striped or mirrored disk.
+    struct disk_raid_stats rstats;
+    int striped = d->raid != NULL;
+    vdisk_raid_get_stats(d, &rstats);
+    int raid_result = disk_raid_flush(d);
+    disk_raid_detach(d);
+
+    // Keep the discard counters, and free the hole map.
+    struct disk_discard_stats dstats;
+    vdisk_discard_get_stats(d, &dstats);
+    disk_discard_detach(d);
+
+    // Keep the simulated time for the log too.
+    struct disk_model_stats mstats;
+    int modelled = d->model != NULL;
+    vdisk_model_get_stats(d, &mstats);
+    vdisk_model_close(d);
+
+    // Keep the request statistics for the log as well.
+    struct disk_stats stats;
+    vdisk_get_stats(d, &stats);
+
+    // Drop the mapping. Dirty pages stay in the page cache and reach the file as usual.
+    if (d->map != NULL)
+    {
+        munmap(d->map, (size_t)d->nblocks * BLOCK_SIZE);
+    }
+
+    // If the disk could not be closed, return -1.
+    int result = close(d->fd);
+    if (result != 0)
+    {
+        printf("   ERROR: Could not close disk.\n");
+    }
+
+    // Print the number of reads and writes.
+    if (log && result == 0)
+    {
+        printf("   Reads (Blocks): %llu\n", (unsigned long long)d->reads);
+        printf("   Writes (Blocks): %llu\n", (unsigned long long)d->writes);
+        printf("   Bytes Read: %llu\n", (unsigned long long)stats.read.bytes);
+        printf("   Bytes Written: %llu\n", (unsigned long long)stats.write.bytes);
+        if (stats.read.count > 0)
+        {
+            printf("   Read Latency p50/p99/p99.9 (us): %.1f / %.1f / %.1f\n", stats.read.p50_ns / 1e3,
+                   stats.read.p99_ns / 1e3, stats.read.p999_ns / 1e3);
+        }
+        if (stats.write.count > 0)
+        {
+            printf("   Write Latency p50/p99/p99.9 (us): %.1f / %.1f / %.1f\n", stats.write.p50_ns / 1e3,
+                   stats.write.p99_ns / 1e3, stats.write.p999_ns / 1e3);
+        }
+        if (cached)
+        {
+            printf("   Cache Hits: %llu\n", (unsigned long long)cstats.hits);
+            printf("   Cache Misses: %llu\n", (unsigned long long)cstats.misses);
+            printf("   Cache Evictions: %llu\n", (unsigned long long)cstats.evictions);
+        }
+        if (scheduled)
+        {
+            printf("   Scheduler Batches: %llu\n", (unsigned long long)sstats.dispatches);
+            printf("   Scheduler Runs: %llu\n", (unsigned long long)sstats.runs);
+            printf("   Scheduler Writes Absorbed: %llu\n", (unsigned long long)sstats.absorbed);
+        }
+        if (checksummed)
+        {
+            printf("   Checksums Verified: %llu\n", (unsigned long long)kstats.verified);
+            printf("   Checksum Failures: %llu\n", (unsigned long long)kstats.failures);
+        }
+        if (compressed)
+        {
+            printf("   Compression Ratio: %.2f\n", zstats.stored_bytes > 0 ? (double)zstats.blocks * BLOCK_SIZE / zstats.stored_bytes : 1.0);
+            printf("   Bytes Read from Image: %llu\n", (unsigned long long)zstats.read_stored);
+        }
+        if (deduplicated)
+        {
+            printf("   Dedup Ratio: %.2f\n", ustats.stored > 0 ? (double)ustats.blocks / ustats.stored : 1.0);
+            printf("   Dedup Hits: %llu\n", (unsigned long long)ustats.hits);
+        }
+        if (thin)
+        {
+            printf("   Blocks Allocated: %llu\n", (unsigned long long)tstats.allocated);
+            printf("   Image Size (Blocks): %llu\n", (unsigned long long)tstats.image_blocks);
+            if (tstats.snapshots > 0)
+            {
+                printf("   Snapshots: %llu\n", (unsigned long long)tstats.snapshots);
+                printf("   Blocks Copied on Write: %llu\n", (unsigned long long)tstats.copied);
+            }
+        }
+        if (striped)
+        {
+            printf("   RAID Level: %u\n", rstats.level);
+            printf("   RAID Members: %u\n", rstats.members);
+            if (rstats.level == 0)
+            {
+                printf("   Stripe Unit (Blocks): %u\n", rstats.stripe_unit);
+            }
+            else
+            {
+                printf("   Failed Members: %u\n", rstats.failed);
+                printf("   Blocks Resynced: %llu\n", (unsigned long long)rstats.resynced);
+            }
+            printf("   Runs Split Across Members: %llu\n", (unsigned long long)rstats.split);
+        }
+        if (dstats.discarded > 0 || dstats.hole_reads > 0)
+        {
+            printf("   Blocks Discarded: %llu\n", (unsigned long long)dstats.discarded);
+            printf("   Reads of Holes Skipped: %llu\n", (unsigned long long)dstats.hole_reads);
+        }
+        if (modelled)
+        {
+            printf("   Simulated Time (ms): %.3f\n", mstats.elapsed_ns / 1e6);
+            printf("   Simulated Seeks: %llu\n", (unsigned long long)mstats.seeks);
+        }
+        printf("   Disk closed.\n");
+    }
+
+    // Free the disk.
+    locks_destroy(d);
+    free(d);
+
+    return result == 0 && cache_result == 0 && sched_result == 0 && csum_result == 0 && comp_result == 0 &&
+                   dedup_result == 0 && thin_result == 0 && raid_result == 0 ? 0 : -1;
 }
\ No newline at end of file
@@ -1,61 +1,403 @@
-/**
- * @file disk.h
- * @brief This header file contains the declarations of functions and variables related to disk operations.
- *
- * The functions declared in this file are used to initialize the disk, read from the disk, write to the disk, and close the disk.
- * The variables declared in this file are used to keep track of the number of blocks, reads, and writes.
- *
- */
-
-#ifndef DISK_H
-#define DISK_H
-
-#include <stdio.h>
-#include <stdint.h>
-
-#define BLOCK_SIZE 4096 // 4 KB
-
-/**
- * @brief Initializes a virtual disk with the given filename and number of blocks.
- *
- * @param filename The name of the file to use as the virtual disk.
- * @param nblocks The number of blocks to allocate for the virtual disk.
- * @return int Returns 0 on success, -1 on failure.
- */
-int disk_init(char *filename, int nblocks);
-
-/**
- * @brief Returns the size of the disk in number of blocks.
- *
- * @return int The size of the disk in number of blocks.
- */
-int disk_size();
-
-/**
- * @brief Reads data from the disk starting at the specified block number.
- *
- * @param blocknum The block number to start reading from.
- * @param buf A pointer to the buffer to read the data into.
- *
- * @return int The number of bytes read, or -1 if an error occurred.
- */
-int disk_read(uint32_t blocknum, void *buf);
-
-/**
- * @brief Writes data to the disk starting from the specified block number.
- *
- * @param blocknum The block number to start writing from.
- * @param buf A pointer to the buffer containing the data to write.
- * @return int The number of bytes written, or -1 if an error occurred.
- */
-int disk_write(uint32_t blocknum, void *buf);
-
-/**
- * @brief Closes the disk file and frees any allocated memory.
- * 
- * @param log 1 if the disk operations should be logged, 0 otherwise.
- * @return int Returns 0 on success, -1 on failure.
- */
-int disk_close(int log);
-
+/**
+ * @file disk.h
+ * @brief This header file contains the declarations of functions and variables related to disk operations.
+ *
+ * The functions declared in this file are used to initialize the disk, read from the disk, write to the disk, and close the disk.
+ * The variables declared in this file are used to keep track of the number of blocks, reads, and writes.
+ *
+ */
+
+#ifndef DISK_H
+#define DISK_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// The block size is fixed at compile time, so block arithmetic on every path folds to shifts and
+// masks. Build with `make BLOCK_SIZE=<bytes>` for another size; the Makefile passes it on as
+// DISK_BLOCK_SIZE, since kernel headers define a BLOCK_SIZE of their own. Compressed, deduplicated,
+// thin and RAID images record it in their headers, and are not opened by a build of another
+// size. A flat image has none; the file system superblock keeps it.
+#ifndef DISK_BLOCK_SIZE
+#define DISK_BLOCK_SIZE 4096 // 4 KB
+#endif
+
+#if DISK_BLOCK_SIZE < 1024 || DISK_BLOCK_SIZE > 65536 || (DISK_BLOCK_SIZE & (DISK_BLOCK_SIZE - 1)) != 0
+#error "The block size must be a power of two from 1024 to 65536."
+#endif
+
+#define BLOCK_SIZE DISK_BLOCK_SIZE
+
+/* Flags for disk_init_flags(). */
+#define DISK_MMAP (1 << 0)     // map the image once and serve blocks from the mapping
+#define DISK_PREALLOC (1 << 1) // reserve every block on creation instead of leaving the image sparse
+#define DISK_THREADSAFE (1 << 2) // allow calls on the disk from several threads at once
+#define DISK_DIRECT (1 << 3)     // bypass the host page cache with O_DIRECT where the filesystem allows it
+#define DISK_CHECKSUM (1 << 4)   // keep a CRC32C of every block and check it on every read
+#define DISK_COMPRESS (1 << 5)   // store blocks compressed, behind a translation map
+#define DISK_DEDUP (1 << 6)      // store each distinct block once, behind a translation map
+#define DISK_THIN (1 << 7)       // store only the blocks written, behind L1/L2 mapping tables
+
+#define DISK_LOCK_STRIPES 64 // block locks of a DISK_THREADSAFE disk; block n uses lock n % DISK_LOCK_STRIPES
+
+#define DISK_MAX_BLOCKS (1ULL << 48) // most blocks in a disk (1 EB), so every byte offset fits an off_t
+
+/**
+ * @brief One entry of a vectored block transfer.
+ *
+ * Block numbers are 64-bit throughout the disk layer, and byte offsets in the image are
+ * computed in 64 bits, so a disk may be larger than 4 GB or 2^32 blocks.
+ *
+ * @param blocknum The block number to transfer.
+ * @param buf A pointer to BLOCK_SIZE bytes to read into or write from.
+ */
+struct disk_iovec
+{
+    uint64_t blocknum;
+    void *buf;
+};
+
+/**
+ * @brief Initializes a virtual disk with the given filename and number of blocks.
+ *
+ * Any existing file is truncated. The new image is created sparse in constant time, and all
+ * of its blocks read back as zeros.
+ *
+ * @param filename The name of the file to use as the virtual disk.
+ * @param nblocks The number of blocks to allocate for the virtual disk, at most DISK_MAX_BLOCKS.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_init(char *filename, int64_t nblocks);
+
+/**
+ * @brief Initializes a virtual disk like disk_init(), selecting the I/O backend with flags.
+ *
+ * With DISK_MMAP the image is mapped once and disk_read/disk_write become copies in and out of
+ * the mapping, and disk_block() can hand out blocks in place.
+ *
+ * With DISK_THREADSAFE every function of the disk may be called from several threads at once.
+ * Each block is guarded by one of DISK_LOCK_STRIPES reader/writer locks, so transfers of blocks
+ * on different stripes run in parallel, a whole-block read never sees half of a concurrent
+ * write, and the Reads/Writes counters are updated atomically. The block cache and the
+ * asynchronous engine are shared under one lock per disk, and the asynchronous engine always
+ * uses the thread pool, whose workers take the same block locks. Pointers from disk_block()
+ * are not protected.
+ *
+ * With DISK_DIRECT the image is accessed with O_DIRECT, so blocks are not kept a second time in
+ * the host page cache. Buffers from disk_alloc_blocks() are transferred in place; any other
+ * buffer is copied through an aligned one. If the filesystem holding the image rejects O_DIRECT,
+ * the disk silently uses buffered I/O instead (see disk_direct()). Cannot be combined with
+ * DISK_MMAP.
+ *
+ * With DISK_CHECKSUM a checksum region of disk_checksum_blocks(nblocks) blocks is added after
+ * the last block, and every block read from the image is checked against it (see
+ * disk_checksum.h). The disk must be opened with DISK_CHECKSUM from then on.
+ *
+ * With DISK_COMPRESS the image holds a translation map instead of the blocks at their own
+ * offsets, and each block is stored zlib-compressed in as few 512-byte sectors as it needs (see
+ * disk_compress.h). The disk must be opened with DISK_COMPRESS from then on. The asynchronous
+ * engine always uses the thread pool on it. Cannot be combined with DISK_MMAP, DISK_DIRECT or
+ * DISK_CHECKSUM.
+ *
+ * With DISK_DEDUP the image holds a map from every block to a shared copy of its data, and
+ * blocks written with the same data share one copy (see disk_dedup.h). The disk must be opened
+ * with DISK_DEDUP from then on. The asynchronous engine always uses the thread pool on it.
+ * Cannot be combined with DISK_MMAP, DISK_DIRECT, DISK_CHECKSUM or DISK_COMPRESS.
+ *
+ * With DISK_THIN the image holds only the blocks written, found through L1/L2 mapping tables,
+ * so it takes space for the data on the disk rather than for its size (see disk_thin.h). The
+ * disk must be opened with DISK_THIN from then on. The asynchronous engine always uses the
+ * thread pool on it. Cannot be combined with the flags above.
+ *
+ * @param filename The name of the file to use as the virtual disk.
+ * @param nblocks The number of blocks to allocate for the virtual disk.
+ * @param flags A combination of DISK_* flags, or 0 for the default pread/pwrite backend.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_init_flags(char *filename, int64_t nblocks, int flags);
+
+/**
+ * @brief Opens an existing disk image without reformatting it.
+ *
+ * The number of blocks is taken from the file size, which must be a multiple of BLOCK_SIZE.
+ * With DISK_CHECKSUM the checksum region at the end of the image is not counted. With
+ * DISK_COMPRESS, DISK_DEDUP or DISK_THIN it is read from the header of the image.
+ *
+ * @param filename The name of the existing disk image.
+ * @param flags A combination of DISK_* flags, or 0 for the default pread/pwrite backend.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_open(char *filename, int flags);
+
+/**
+ * @brief Returns the size of the disk in number of blocks.
+ *
+ * @return int64_t The size of the disk in number of blocks.
+ */
+int64_t disk_size();
+
+/**
+ * @brief Reads data from the disk starting at the specified block number.
+ *
+ * When the block cache is enabled (see cache.h) the block may be served from memory.
+ *
+ * @param blocknum The block number to start reading from.
+ * @param buf A pointer to the buffer to read the data into.
+ *
+ * @return int The number of bytes read, or -1 if an error occurred.
+ */
+int disk_read(uint64_t blocknum, void *buf);
+
+/**
+ * @brief Writes data to the disk starting from the specified block number.
+ *
+ * When the block cache is enabled (see cache.h) the block stays dirty in memory until it is
+ * evicted, synced, or the disk is closed.
+ *
+ * @param blocknum The block number to start writing from.
+ * @param buf A pointer to the buffer containing the data to write.
+ * @return int The number of bytes written, or -1 if an error occurred.
+ */
+int disk_write(uint64_t blocknum, void *buf);
+
+/**
+ * @brief Reads a list of blocks in one call.
+ *
+ * Entries whose block numbers follow each other (n, n+1, n+2, ...) are read with a single
+ * vectored system call, so a file laid out contiguously costs one call instead of one per block.
+ * Every block counts towards the number of reads.
+ *
+ * @param iov The blocks to read and their destination buffers.
+ * @param count The number of entries in iov.
+ * @return int The number of bytes read, or -1 if an error occurred.
+ */
+int disk_readv(const struct disk_iovec *iov, int count);
+
+/**
+ * @brief Writes a list of blocks in one call, merging contiguous runs like disk_readv().
+ *
+ * @param iov The blocks to write and their source buffers.
+ * @param count The number of entries in iov.
+ * @return int The number of bytes written, or -1 if an error occurred.
+ */
+int disk_writev(const struct disk_iovec *iov, int count);
+
+/**
+ * @brief Returns a read-only pointer to a block inside the mapped image, without copying it.
+ *
+ * Only available when the disk was initialized with DISK_MMAP. The pointer stays valid until
+ * disk_close(); writes to the block through disk_write() are visible through it.
+ *
+ * @param blocknum The block number to access.
+ * @return const void* A pointer to BLOCK_SIZE bytes, or NULL if an error occurred.
+ */
+const void *disk_block(uint64_t blocknum);
+
+/**
+ * @brief Flushes all written blocks to stable storage (msync for mapped disks, fsync otherwise).
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_flush();
+
+/**
+ * @brief Returns 1 if the disk transfers blocks with O_DIRECT, 0 otherwise.
+ *
+ * A disk opened with DISK_DIRECT returns 0 when the filesystem refused O_DIRECT.
+ */
+int disk_direct();
+
+/**
+ * @brief Allocates zeroed, BLOCK_SIZE-aligned memory for nblocks blocks.
+ *
+ * The memory suits O_DIRECT transfers, and can be used as an array of union block (see fs.h).
+ *
+ * @param nblocks The number of blocks to allocate.
+ * @return void* The memory, or NULL on failure. Free it with disk_free_blocks().
+ */
+void *disk_alloc_blocks(int nblocks);
+
+/**
+ * @brief Frees memory from disk_alloc_blocks(). Does nothing if blocks is NULL.
+ */
+void disk_free_blocks(void *blocks);
+
+/*------------------------------------ ASYNCHRONOUS ENGINE --------------------------------------*/
+
+/* Engines reported by disk_async_engine(). DISK_ASYNC_THREADS doubles as a flag for disk_async_init(). */
+#define DISK_ASYNC_NONE 0    // not running
+#define DISK_ASYNC_URING 1   // io_uring
+#define DISK_ASYNC_THREADS 2 // pool of threads doing pread/pwrite
+
+#define DISK_ASYNC_MAX_RUN 32 // most contiguous blocks in one disk_async_readv() request
+
+/**
+ * @brief Called when an asynchronous block request completes.
+ *
+ * @param blocknum The block number of the request.
+ * @param buf The buffer of the request.
+ * @param result BLOCK_SIZE on success, -1 on failure.
+ * @param arg The argument given when the request was queued.
+ */
+typedef void (*disk_async_cb)(uint64_t blocknum, void *buf, int result, void *arg);
+
+/**
+ * @brief Starts the asynchronous block engine on the open disk.
+ *
+ * Requests go through io_uring when the kernel allows it, and through a pool of worker threads
+ * otherwise. Completion callbacks always run in the thread that calls disk_async_poll(),
+ * disk_async_wait() or queues a request, never in a worker.
+ *
+ * @param queue_depth The most requests that can be outstanding at once.
+ * @param flags DISK_ASYNC_THREADS to skip io_uring and use the thread pool, or 0.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_async_init(int queue_depth, int flags);
+
+/**
+ * @brief Returns the engine in use: DISK_ASYNC_NONE, DISK_ASYNC_URING or DISK_ASYNC_THREADS.
+ */
+int disk_async_engine();
+
+/**
+ * @brief Queues a block read. It is not started until disk_async_submit() or disk_async_wait().
+ *
+ * If queue_depth requests are already outstanding, this submits the queue and waits for one to
+ * complete first. buf must stay valid until the callback runs.
+ *
+ * @param blocknum The block number to read.
+ * @param buf A pointer to the buffer to read the data into.
+ * @param cb Called on completion, or NULL.
+ * @param arg Passed to cb.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_async_read(uint64_t blocknum, void *buf, disk_async_cb cb, void *arg);
+
+/**
+ * @brief Queues a block write. Works like disk_async_read().
+ *
+ * @param blocknum The block number to write.
+ * @param buf A pointer to the buffer containing the data to write.
+ * @param cb Called on completion, or NULL.
+ * @param arg Passed to cb.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_async_write(uint64_t blocknum, void *buf, disk_async_cb cb, void *arg);
+
+/**
+ * @brief Queues a read of contiguous blocks as a single request.
+ *
+ * The entries must cover blocks n, n+1, ..., at most DISK_ASYNC_MAX_RUN of them. The request
+ * takes one queue slot and one vectored read; cb still runs once per block.
+ *
+ * @param iov The blocks to read and their destination buffers.
+ * @param count The number of entries in iov.
+ * @param cb Called on completion of each block, or NULL.
+ * @param arg Passed to cb.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_async_readv(const struct disk_iovec *iov, int count, disk_async_cb cb, void *arg);
+
+/**
+ * @brief Starts every queued request.
+ *
+ * @return int The number of requests submitted, or -1 if an error occurred.
+ */
+int disk_async_submit();
+
+/**
+ * @brief Runs the callbacks of requests that have completed, without blocking.
+ *
+ * @return int The number of requests completed.
+ */
+int disk_async_poll();
+
+/**
+ * @brief Submits queued requests and blocks until at least min of them complete.
+ *
+ * @param min The number of completions to wait for, or 0 to wait for all outstanding requests.
+ * @return int The number of requests completed, or -1 if an error occurred.
+ */
+int disk_async_wait(int min);
+
+/**
+ * @brief Returns the number of requests queued or in flight.
+ */
+int disk_async_inflight();
+
+/**
+ * @brief Waits for all outstanding requests and stops the engine. Called by disk_close().
+ */
+void disk_async_close();
+
+/**
+ * @brief Closes the disk file and frees any allocated memory.
+ *
+ * Outstanding asynchronous requests are completed and the block cache is written back first.
+ * The log reports block reads and writes, the cache counters when the cache was enabled, and
+ * the simulated device time when a device model was attached (see disk_model.h).
+ * 
+ * @param log 1 if the disk operations should be logged, 0 otherwise.
+ * @return int Returns 0 on success, -1 on failure, including when blocks dirty in the cache or
+ * queued in the scheduler could not be written. The disk is closed either way.
+ */
+int disk_close(int log);
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/**
+ * @brief An open disk.
+ *
+ * The disk_* functions above all work on one default disk, opened by disk_init(), disk_init_flags()
+ * or disk_open(). Each of them has a vdisk_* counterpart that takes the disk as its first
+ * argument, so several images can be open at once, each with its own counters, cache and
+ * asynchronous engine. Calls on different disks may run in different threads; calls on one disk
+ * must not run concurrently unless it was opened with DISK_THREADSAFE.
+ */
+struct vdisk;
+
+/**
+ * @brief Creates a disk like disk_init_flags(), without touching the default disk.
+ *
+ * @return struct vdisk* The new disk, or NULL on failure.
+ */
+struct vdisk *vdisk_init(char *filename, int64_t nblocks, int flags);
+
+/**
+ * @brief Opens an existing image like disk_open(), without touching the default disk.
+ *
+ * @return struct vdisk* The disk, or NULL on failure.
+ */
+struct vdisk *vdisk_open(char *filename, int flags);
+
+/**
+ * @brief Returns the default disk, or NULL if it is not open.
+ */
+struct vdisk *disk_default();
+
+int64_t vdisk_size(struct vdisk *d);
+int vdisk_read(struct vdisk *d, uint64_t blocknum, void *buf);
+int vdisk_write(struct vdisk *d, uint64_t blocknum, void *buf);
+int vdisk_readv(struct vdisk *d, const struct disk_iovec *iov, int count);
+int vdisk_writev(struct vdisk *d, const struct disk_iovec *iov, int count);
+const void *vdisk_block(struct vdisk *d, uint64_t blocknum);
+int vdisk_flush(struct vdisk *d);
+int vdisk_direct(struct vdisk *d);
+
+int vdisk_async_init(struct vdisk *d, int queue_depth, int flags);
+int vdisk_async_engine(struct vdisk *d);
+int vdisk_async_read(struct vdisk *d, uint64_t blocknum, void *buf, disk_async_cb cb, void *arg);
+int vdisk_async_write(struct vdisk *d, uint64_t blocknum, void *buf, disk_async_cb cb, void *arg);
+int vdisk_async_readv(struct vdisk *d, const struct disk_iovec *iov, int count, disk_async_cb cb, void *arg);
+int vdisk_async_submit(struct vdisk *d);
+int vdisk_async_poll(struct vdisk *d);
+int vdisk_async_wait(struct vdisk *d, int min);
+int vdisk_async_inflight(struct vdisk *d);
+void vdisk_async_close(struct vdisk *d);
+
+/**
+ * @brief Closes the disk like disk_close() and frees the handle.
+ */
+int vdisk_close(struct vdisk *d, int log);
+
 #endif
\ No newline at end of file
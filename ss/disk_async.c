@@ -0,0 +1,923 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// The kernel headers pulled in by io_uring.h define their own BLOCK_SIZE.
+#undef BLOCK_SIZE
+
+#include "disk.h"
+#include "disk_internal.h"
+
+#define ASYNC_MAX_THREADS 8 // workers of the thread-pool engine
+
+/**
+ * One request for a run of contiguous blocks. Slots are indexed by their position in `slots`, which is also the
+ * io_uring user_data, and are chained through `next` on the free, pending and done lists.
+ */
+struct async_req
+{
+    uint64_t blocknum;  // first block of the request
+    int nblocks;        // contiguous blocks, one buffer each in vec
+    struct iovec vec[DISK_ASYNC_MAX_RUN];
+    int write;
+    int result;
+    disk_async_cb cb;
+    void *arg;
+    uint64_t start_ns;  // when the request was queued, for the latency statistics
+    int next;
+};
+
+/**
+ * The io_uring rings, mapped from the kernel.
+ */
+struct uring
+{
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+};
+
+/**
+ * The thread-pool fallback: workers take slots off `pending` and put them on `done`.
+ */
+struct pool
+{
+    pthread_t threads[ASYNC_MAX_THREADS];
+    int nthreads;
+    pthread_mutex_t lock;
+    pthread_cond_t work;     // signalled when pending grows or on shutdown
+    pthread_cond_t finished; // signalled when done grows
+    int pending_head, pending_tail;
+    int done_head;
+    int stop;
+};
+
+/**
+ * The asynchronous engine of one disk.
+ */
+struct async_engine
+{
+    struct vdisk *disk;
+    int engine;
+    struct async_req *slots;
+    int free_head;   // free slots
+    int queued_head; // queued by read/write, not yet submitted
+    int queued_tail;
+    int queued;
+    int inflight;    // submitted, not yet reaped (callbacks not run)
+    struct uring ring;
+    struct pool pool;
+};
+
+/*------------------------------------------ io_uring -------------------------------------------*/
+
+static int uring_setup(struct async_engine *e, unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    e->ring.fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (e->ring.fd < 0)
+    {
+        return -1;
+    }
+
+    e->ring.sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    e->ring.cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    e->ring.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    // Newer kernels share one mapping between the two rings.
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (e->ring.cq_ring_size > e->ring.sq_ring_size)
+        {
+            e->ring.sq_ring_size = e->ring.cq_ring_size;
+        }
+        e->ring.cq_ring_size = e->ring.sq_ring_size;
+    }
+
+    e->ring.sq_ring = mmap(NULL, e->ring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->ring.fd, IORING_OFF_SQ_RING);
+    if (e->ring.sq_ring == MAP_FAILED)
+    {
+        close(e->ring.fd);
+        return -1;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        e->ring.cq_ring = e->ring.sq_ring;
+    }
+    else
+    {
+        e->ring.cq_ring = mmap(NULL, e->ring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->ring.fd, IORING_OFF_CQ_RING);
+        if (e->ring.cq_ring == MAP_FAILED)
+        {
+            munmap(e->ring.sq_ring, e->ring.sq_ring_size);
+            close(e->ring.fd);
+            return -1;
+        }
+    }
+
+    e->ring.sqes = mmap(NULL, e->ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->ring.fd, IORING_OFF_SQES);
+    if (e->ring.sqes == MAP_FAILED)
+    {
+        if (e->ring.cq_ring != e->ring.sq_ring)
+        {
+            munmap(e->ring.cq_ring, e->ring.cq_ring_size);
+        }
+        munmap(e->ring.sq_ring, e->ring.sq_ring_size);
+        close(e->ring.fd);
+        return -1;
+    }
+
+    char *sq = e->ring.sq_ring;
+    char *cq = e->ring.cq_ring;
+    e->ring.sq_head = (unsigned *)(sq + p.sq_off.head);
+    e->ring.sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    e->ring.sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    e->ring.sq_array = (unsigned *)(sq + p.sq_off.array);
+    e->ring.cq_head = (unsigned *)(cq + p.cq_off.head);
+    e->ring.cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    e->ring.cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    e->ring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    return 0;
+}
+
+static void uring_teardown(struct async_engine *e)
+{
+    munmap(e->ring.sqes, e->ring.sqes_size);
+    if (e->ring.cq_ring != e->ring.sq_ring)
+    {
+        munmap(e->ring.cq_ring, e->ring.cq_ring_size);
+    }
+    munmap(e->ring.sq_ring, e->ring.sq_ring_size);
+    close(e->ring.fd);
+}
+
+static int uring_enter(struct async_engine *e, unsigned to_submit, unsigned min_complete)
+{
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int result;
+
+    do
+    {
+        result = syscall(__NR_io_uring_enter, e->ring.fd, to_submit, min_complete, flags, NULL, 0);
+    } while (result < 0 && errno == EINTR);
+
+    return result;
+}
+
+/**
+ * Places a slot on the submission ring. The caller guarantees there is room, since at most
+ * queue_depth requests exist and the ring has at least queue_depth entries.
+ */
+static void uring_push(struct async_engine *e, int index)
+{
+    struct async_req *req = &e->slots[index];
+    unsigned tail = *e->ring.sq_tail;
+    unsigned i = tail & *e->ring.sq_mask;
+    struct io_uring_sqe *sqe = &e->ring.sqes[i];
+
+    // The blocks written are holes no more.
+    if (req->write)
+    {
+        disk_discard_fill(e->disk, req->blocknum, req->nblocks);
+    }
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = e->disk->fd;
+    sqe->off = (uint64_t)req->blocknum * BLOCK_SIZE;
+    sqe->user_data = index;
+
+    // A single block goes straight to its buffer; a run scatters over the request's iovecs.
+    if (req->nblocks == 1)
+    {
+        sqe->opcode = req->write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->addr = (uint64_t)(uintptr_t)req->vec[0].iov_base;
+        sqe->len = BLOCK_SIZE;
+    }
+    else
+    {
+        sqe->opcode = req->write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->addr = (uint64_t)(uintptr_t)req->vec;
+        sqe->len = req->nblocks;
+    }
+
+    e->ring.sq_array[i] = i;
+    __atomic_store_n(e->ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Takes the completions off the completion ring, in order. Returns the first reaped slot
+ * in a chain linked through `next`, or -1.
+ */
+static int uring_reap(struct async_engine *e, int *count)
+{
+    unsigned head = *e->ring.cq_head;
+    unsigned tail = __atomic_load_n(e->ring.cq_tail, __ATOMIC_ACQUIRE);
+    int first = -1, last = -1;
+
+    *count = 0;
+    while (head != tail)
+    {
+        struct io_uring_cqe *cqe = &e->ring.cqes[head & *e->ring.cq_mask];
+        int index = (int)cqe->user_data;
+
+        e->slots[index].result = cqe->res;
+        e->slots[index].next = -1;
+        if (last >= 0)
+        {
+            e->slots[last].next = index;
+        }
+        else
+        {
+            first = index;
+        }
+        last = index;
+
+        head++;
+        (*count)++;
+    }
+
+    __atomic_store_n(e->ring.cq_head, head, __ATOMIC_RELEASE);
+    return first;
+}
+
+/*---------------------------------------- thread pool ------------------------------------------*/
+
+static void *pool_worker(void *arg)
+{
+    struct async_engine *e = arg;
+
+    pthread_mutex_lock(&e->pool.lock);
+    while (1)
+    {
+        while (e->pool.pending_head < 0 && !e->pool.stop)
+        {
+            pthread_cond_wait(&e->pool.work, &e->pool.lock);
+        }
+
+        if (e->pool.pending_head < 0 && e->pool.stop)
+        {
+            break;
+        }
+
+        // Take the oldest pending request.
+        int index = e->pool.pending_head;
+        e->pool.pending_head = e->slots[index].next;
+        if (e->pool.pending_head < 0)
+        {
+            e->pool.pending_tail = -1;
+        }
+
+        // Do the I/O without holding the lock.
+        pthread_mutex_unlock(&e->pool.lock);
+        struct async_req *req = &e->slots[index];
+        req->result = 0;
+        for (int i = 0; i < req->nblocks && req->result >= 0; i++)
+        {
+            req->result = disk_internal_pio(e->disk, req->write, req->blocknum + i, req->vec[i].iov_base) == 0 ? req->result + BLOCK_SIZE : -EIO;
+        }
+        pthread_mutex_lock(&e->pool.lock);
+
+        // Hand it back to the caller's thread.
+        req->next = e->pool.done_head;
+        e->pool.done_head = index;
+        pthread_cond_signal(&e->pool.finished);
+    }
+    pthread_mutex_unlock(&e->pool.lock);
+
+    return NULL;
+}
+
+static int pool_setup(struct async_engine *e, int nthreads)
+{
+    memset(&e->pool, 0, sizeof(e->pool));
+    pthread_mutex_init(&e->pool.lock, NULL);
+    pthread_cond_init(&e->pool.work, NULL);
+    pthread_cond_init(&e->pool.finished, NULL);
+    e->pool.pending_head = e->pool.pending_tail = e->pool.done_head = -1;
+
+    for (int i = 0; i < nthreads; i++)
+    {
+        if (pthread_create(&e->pool.threads[i], NULL, pool_worker, e) != 0)
+        {
+            break;
+        }
+        e->pool.nthreads++;
+    }
+
+    return e->pool.nthreads > 0 ? 0 : -1;
+}
+
+static void pool_teardown(struct async_engine *e)
+{
+    pthread_mutex_lock(&e->pool.lock);
+    e->pool.stop = 1;
+    pthread_cond_broadcast(&e->pool.work);
+    pthread_mutex_unlock(&e->pool.lock);
+
+    for (int i = 0; i < e->pool.nthreads; i++)
+    {
+        pthread_join(e->pool.threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&e->pool.finished);
+    pthread_cond_destroy(&e->pool.work);
+    pthread_mutex_destroy(&e->pool.lock);
+}
+
+/**
+ * Takes the completed slots from the pool, waiting until there are at least `min`.
+ * Returns the chain of slots, or -1.
+ */
+static int pool_reap(struct async_engine *e, int min, int *count)
+{
+    pthread_mutex_lock(&e->pool.lock);
+
+    // Count what is already done, and wait for more if that is not enough.
+    while (1)
+    {
+        *count = 0;
+        for (int i = e->pool.done_head; i >= 0; i = e->slots[i].next)
+        {
+            (*count)++;
+        }
+
+        if (*count >= min)
+        {
+            break;
+        }
+
+        pthread_cond_wait(&e->pool.finished, &e->pool.lock);
+    }
+
+    int first = e->pool.done_head;
+    e->pool.done_head = -1;
+    pthread_mutex_unlock(&e->pool.lock);
+
+    return first;
+}
+
+/*------------------------------------------- engine --------------------------------------------*/
+
+/**
+ * Runs the callbacks of a chain of completed slots and returns them to the free list.
+ * The callback runs once per block of each request.
+ */
+static void complete(struct async_engine *e, int first)
+{
+    while (first >= 0)
+    {
+        struct async_req *req = &e->slots[first];
+        int next = req->next;
+        int bytes = req->nblocks * BLOCK_SIZE;
+
+        // Finish short or interrupted transfers synchronously, so callers always see whole blocks.
+        if (req->result != bytes)
+        {
+            req->result = bytes;
+            for (int i = 0; i < req->nblocks; i++)
+            {
+                if (disk_internal_pio(e->disk, req->write, req->blocknum + i, req->vec[i].iov_base) != 0)
+                {
+                    req->result = -1;
+                    break;
+                }
+            }
+        }
+
+        // io_uring transfers go around disk_internal_pio(), so their checksums are handled here.
+        // The thread pool handled them already, under the block locks.
+        for (int i = 0; e->engine == DISK_ASYNC_URING && e->disk->csum != NULL && req->result == bytes && i < req->nblocks; i++)
+        {
+            if (req->write)
+            {
+                disk_checksum_update(e->disk, req->blocknum + i, req->vec[i].iov_base);
+            }
+            else if (disk_checksum_verify(e->disk, req->blocknum + i, req->vec[i].iov_base) != 0)
+            {
+                req->result = -1;
+            }
+        }
+
+        if (req->result == bytes)
+        {
+            disk_internal_account(e->disk, req->write, req->blocknum, req->nblocks);
+            disk_stats_touch(e->disk, req->write, req->blocknum, req->nblocks);
+            disk_stats_record(e->disk, req->write, req->start_ns, bytes);
+
+            if (e->disk->trace != NULL)
+            {
+                struct disk_iovec iov[DISK_ASYNC_MAX_RUN];
+                for (int i = 0; i < req->nblocks; i++)
+                {
+                    iov[i].blocknum = req->blocknum + i;
+                    iov[i].buf = req->vec[i].iov_base;
+                }
+                disk_trace_record(e->disk, req->write, req->start_ns, iov, req->nblocks, 1);
+            }
+        }
+        else
+        {
+            printf("   ERROR: Could not %s blocks %llu-%llu.\n", req->write ? "write" : "read", (unsigned long long)req->blocknum,
+                   (unsigned long long)(req->blocknum + req->nblocks - 1));
+        }
+
+        e->inflight--;
+
+        // Copy the request out, then free the slot before running the callbacks, so they may queue
+        // new requests; one that does is handed this same slot.
+        uint64_t blocknum = req->blocknum;
+        int nblocks = req->nblocks;
+        int ok = req->result == bytes;
+        int write = req->write;
+        disk_async_cb cb = req->cb;
+        void *arg = req->arg;
+        void *bufs[DISK_ASYNC_MAX_RUN];
+        for (int i = 0; i < nblocks; i++)
+        {
+            bufs[i] = req->vec[i].iov_base;
+        }
+
+        req->next = e->free_head;
+        e->free_head = first;
+
+        for (int i = 0; i < nblocks; i++)
+        {
+            // A block still dirty in the cache is newer than what was read from the image.
+            if (ok && !write)
+            {
+                cache_internal_overlay(e->disk, blocknum + i, bufs[i]);
+            }
+
+            if (cb != NULL)
+            {
+                cb(blocknum + i, bufs[i], ok ? BLOCK_SIZE : -1, arg);
+            }
+        }
+
+        first = next;
+    }
+}
+
+/**
+ * Reaps completions, blocking until at least `min` have arrived. Returns the number reaped.
+ */
+static int reap(struct async_engine *e, int min)
+{
+    int count = 0;
+    int first;
+
+    if (e->engine == DISK_ASYNC_URING)
+    {
+        first = uring_reap(e, &count);
+        if (count < min)
+        {
+            uring_enter(e, 0, min - count);
+            int more;
+            int rest = uring_reap(e, &more);
+
+            // Append the second batch after the first.
+            if (first < 0)
+            {
+                first = rest;
+            }
+            else
+            {
+                int last = first;
+                while (e->slots[last].next >= 0)
+                {
+                    last = e->slots[last].next;
+                }
+                e->slots[last].next = rest;
+            }
+            count += more;
+        }
+    }
+    else
+    {
+        first = pool_reap(e, min, &count);
+    }
+
+    complete(e, first);
+    return count;
+}
+
+int disk_async_init(int queue_depth, int flags)
+{
+    return vdisk_async_init(disk_default(), queue_depth, flags);
+}
+
+int vdisk_async_init(struct vdisk *d, int queue_depth, int flags)
+{
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    if (d->async != NULL)
+    {
+        printf("   ERROR: Asynchronous engine is already running.\n");
+        return -1;
+    }
+
+    if (queue_depth <= 0)
+    {
+        printf("   ERROR: Queue depth must be positive.\n");
+        return -1;
+    }
+
+    struct async_engine *e = calloc(1, sizeof(struct async_engine));
+    if (e == NULL || (e->slots = calloc(queue_depth, sizeof(struct async_req))) == NULL)
+    {
+        free(e);
+        return -1;
+    }
+
+    // Chain every slot on the free list.
+    for (int i = 0; i < queue_depth; i++)
+    {
+        e->slots[i].next = i + 1 < queue_depth ? i + 1 : -1;
+    }
+    e->disk = d;
+    e->free_head = 0;
+    e->queued_head = e->queued_tail = -1;
+
+    // Prefer io_uring, and fall back to threads where it is missing or forbidden. A thread-safe
+    // disk always uses threads: their transfers take the block locks, io_uring's would not. So
+    // do compressed, deduplicated, thin-provisioned, striped and mirrored ones, whose blocks are
+    // not at their own offsets.
+    if (!(flags & DISK_ASYNC_THREADS) && d->stripes == NULL && d->comp == NULL && d->dedup == NULL && d->thin == NULL &&
+        d->raid == NULL && uring_setup(e, queue_depth) == 0)
+    {
+        e->engine = DISK_ASYNC_URING;
+    }
+    else if (pool_setup(e, queue_depth < ASYNC_MAX_THREADS ? queue_depth : ASYNC_MAX_THREADS) == 0)
+    {
+        e->engine = DISK_ASYNC_THREADS;
+    }
+    else
+    {
+        printf("   ERROR: Could not start asynchronous engine.\n");
+        free(e->slots);
+        free(e);
+        return -1;
+    }
+
+    disk_internal_lock(d);
+    d->async = e;
+    disk_internal_unlock(d);
+
+    return 0;
+}
+
+int disk_async_engine()
+{
+    return vdisk_async_engine(disk_default());
+}
+
+int vdisk_async_engine(struct vdisk *d)
+{
+    return d != NULL && d->async != NULL ? d->async->engine : DISK_ASYNC_NONE;
+}
+
+/**
+ * Starts every queued request. Returns the number submitted, or -1.
+ */
+static int submit(struct async_engine *e)
+{
+    int submitted = e->queued;
+    if (submitted == 0)
+    {
+        return 0;
+    }
+
+    if (e->engine == DISK_ASYNC_URING)
+    {
+        for (int i = e->queued_head; i >= 0; i = e->slots[i].next)
+        {
+            uring_push(e, i);
+        }
+
+        // The kernel consumes every entry we pushed; nothing is left on the ring afterwards.
+        int left = submitted;
+        while (left > 0)
+        {
+            int n = uring_enter(e, left, 0);
+            if (n < 0)
+            {
+                printf("   ERROR: Could not submit asynchronous requests.\n");
+                return -1;
+            }
+            left -= n;
+        }
+    }
+    else
+    {
+        // Append the queued chain to the pool's pending list.
+        pthread_mutex_lock(&e->pool.lock);
+        if (e->pool.pending_tail >= 0)
+        {
+            e->slots[e->pool.pending_tail].next = e->queued_head;
+        }
+        else
+        {
+            e->pool.pending_head = e->queued_head;
+        }
+        e->pool.pending_tail = e->queued_tail;
+        pthread_cond_broadcast(&e->pool.work);
+        pthread_mutex_unlock(&e->pool.lock);
+    }
+
+    e->inflight += submitted;
+    e->queued_head = e->queued_tail = -1;
+    e->queued = 0;
+
+    return submitted;
+}
+
+/**
+ * Submits queued requests and reaps until `min` complete, or all of them if min <= 0.
+ */
+static int wait_for(struct async_engine *e, int min)
+{
+    // Queued requests must go out before they can complete.
+    if (e->queued > 0 && submit(e) < 0)
+    {
+        return -1;
+    }
+
+    // A non-positive count, or more than is outstanding, means everything outstanding.
+    if (min <= 0 || min > e->inflight)
+    {
+        min = e->inflight;
+    }
+
+    int reaped = 0;
+    while (reaped < min)
+    {
+        reaped += reap(e, min - reaped);
+    }
+
+    return reaped;
+}
+
+/**
+ * Shared body of the queueing calls. The entries must be contiguous blocks, at most
+ * DISK_ASYNC_MAX_RUN of them.
+ */
+static int enqueue(struct vdisk *d, int write, const struct disk_iovec *iov, int count, disk_async_cb cb, void *arg)
+{
+    struct async_engine *e = d != NULL ? d->async : NULL;
+
+    if (e == NULL)
+    {
+        printf("   ERROR: Asynchronous engine is not running.\n");
+        return -1;
+    }
+
+    if (count <= 0 || count > DISK_ASYNC_MAX_RUN)
+    {
+        printf("   ERROR: A request must cover 1 to %d blocks.\n", DISK_ASYNC_MAX_RUN);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (disk_internal_check(d, iov[i].blocknum, iov[i].buf) != 0)
+        {
+            printf(write ? "   WRITE sanity check failed.\n" : "   READ sanity check failed.\n");
+            return -1;
+        }
+
+        if (iov[i].blocknum != iov[0].blocknum + (uint64_t)i)
+        {
+            printf("   ERROR: Blocks of a request must be contiguous.\n");
+            return -1;
+        }
+    }
+
+    // The request goes around the scheduler: a write supersedes its queued copies of the blocks,
+    // and a read must find them on the image.
+    if (disk_sched_settle(d, write, iov, count) != 0)
+    {
+        return -1;
+    }
+
+    // With every slot taken, push out what is queued and wait for a slot to come back.
+    while (e->free_head < 0)
+    {
+        if (e->queued > 0)
+        {
+            submit(e);
+        }
+        reap(e, 1);
+    }
+
+    int index = e->free_head;
+    struct async_req *req = &e->slots[index];
+    e->free_head = req->next;
+
+    req->blocknum = iov[0].blocknum;
+    req->nblocks = count;
+    req->write = write;
+    req->result = 0;
+    req->cb = cb;
+    req->arg = arg;
+    req->start_ns = disk_stats_now();
+    req->next = -1;
+
+    for (int i = 0; i < count; i++)
+    {
+        req->vec[i].iov_base = iov[i].buf;
+        req->vec[i].iov_len = BLOCK_SIZE;
+
+        // The write will land on the image behind the cache's back, so refresh any cached copy now.
+        if (write)
+        {
+            cache_internal_update(d, iov[i].blocknum, iov[i].buf);
+        }
+    }
+
+    // Keep submission order.
+    if (e->queued_tail >= 0)
+    {
+        e->slots[e->queued_tail].next = index;
+    }
+    else
+    {
+        e->queued_head = index;
+    }
+    e->queued_tail = index;
+    e->queued++;
+
+    return 0;
+}
+
+int disk_async_read(uint64_t blocknum, void *buf, disk_async_cb cb, void *arg)
+{
+    return vdisk_async_read(disk_default(), blocknum, buf, cb, arg);
+}
+
+int disk_async_write(uint64_t blocknum, void *buf, disk_async_cb cb, void *arg)
+{
+    return vdisk_async_write(disk_default(), blocknum, buf, cb, arg);
+}
+
+int disk_async_readv(const struct disk_iovec *iov, int count, disk_async_cb cb, void *arg)
+{
+    return vdisk_async_readv(disk_default(), iov, count, cb, arg);
+}
+
+int disk_async_submit()
+{
+    return vdisk_async_submit(disk_default());
+}
+
+int disk_async_poll()
+{
+    return vdisk_async_poll(disk_default());
+}
+
+int disk_async_wait(int min)
+{
+    return vdisk_async_wait(disk_default(), min);
+}
+
+int disk_async_inflight()
+{
+    return vdisk_async_inflight(disk_default());
+}
+
+void disk_async_close()
+{
+    vdisk_async_close(disk_default());
+}
+
+/**
+ * enqueue() with the disk lock held.
+ */
+static int enqueue_locked(struct vdisk *d, int write, const struct disk_iovec *iov, int count, disk_async_cb cb, void *arg)
+{
+    disk_internal_lock(d);
+    int result = enqueue(d, write, iov, count, cb, arg);
+    disk_internal_unlock(d);
+
+    return result;
+}
+
+int vdisk_async_read(struct vdisk *d, uint64_t blocknum, void *buf, disk_async_cb cb, void *arg)
+{
+    struct disk_iovec iov = {blocknum, buf};
+    return enqueue_locked(d, 0, &iov, 1, cb, arg);
+}
+
+int vdisk_async_write(struct vdisk *d, uint64_t blocknum, void *buf, disk_async_cb cb, void *arg)
+{
+    struct disk_iovec iov = {blocknum, buf};
+    return enqueue_locked(d, 1, &iov, 1, cb, arg);
+}
+
+int vdisk_async_readv(struct vdisk *d, const struct disk_iovec *iov, int count, disk_async_cb cb, void *arg)
+{
+    return enqueue_locked(d, 0, iov, count, cb, arg);
+}
+
+int vdisk_async_submit(struct vdisk *d)
+{
+    struct async_engine *e = d != NULL ? d->async : NULL;
+
+    if (e == NULL)
+    {
+        printf("   ERROR: Asynchronous engine is not running.\n");
+        return -1;
+    }
+
+    disk_internal_lock(d);
+    int submitted = submit(e);
+    disk_internal_unlock(d);
+
+    return submitted;
+}
+
+int vdisk_async_poll(struct vdisk *d)
+{
+    if (d == NULL || d->async == NULL)
+    {
+        return 0;
+    }
+
+    disk_internal_lock(d);
+    int reaped = reap(d->async, 0);
+    disk_internal_unlock(d);
+
+    return reaped;
+}
+
+int vdisk_async_wait(struct vdisk *d, int min)
+{
+    struct async_engine *e = d != NULL ? d->async : NULL;
+
+    if (e == NULL)
+    {
+        return 0;
+    }
+
+    disk_internal_lock(d);
+    int reaped = wait_for(e, min);
+    disk_internal_unlock(d);
+
+    return reaped;
+}
+
+int vdisk_async_inflight(struct vdisk *d)
+{
+    disk_internal_lock(d);
+    struct async_engine *e = d != NULL ? d->async : NULL;
+    int count = e != NULL ? e->inflight + e->queued : 0;
+    disk_internal_unlock(d);
+
+    return count;
+}
+
+void vdisk_async_close(struct vdisk *d)
+{
+    struct async_engine *e = d != NULL ? d->async : NULL;
+
+    if (e == NULL)
+    {
+        return;
+    }
+
+    // Drain everything that is still outstanding, so no callback is lost.
+    disk_internal_lock(d);
+    wait_for(e, 0);
+    d->async = NULL;
+    disk_internal_unlock(d);
+
+    if (e->engine == DISK_ASYNC_URING)
+    {
+        uring_teardown(e);
+    }
+    else
+    {
+        pool_teardown(e);
+    }
+
+    free(e->slots);
+    free(e);
+}
\ No newline at end of file
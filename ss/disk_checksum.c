@@ -0,0 +1,469 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "disk_checksum.h"
+#include "disk_internal.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define CRC32C_POLY 0x82f63b78  // Castagnoli polynomial, bit-reflected
+#define CRC_STREAM 1360         // bytes per stream of the three-way loop; 3 of them fill most of a block
+#define CRC_FOLD 256            // bytes folded per round of the carry-less multiply loop
+#define SUMS_PER_BLOCK (BLOCK_SIZE / 4)
+
+/**
+ * The checksums of one disk.
+ *
+ * @param table One entry per block, laid out as in the checksum region.
+ * @param dirty One flag per region block whose entries changed since the last flush.
+ * @param region_blocks The number of blocks of the checksum region.
+ * @param stats The counters.
+ */
+struct checksums
+{
+    uint32_t *table;
+    uint8_t *dirty;
+    uint64_t region_blocks;
+    struct disk_checksum_stats stats;
+};
+
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+static uint32_t crc_table[8][256]; // slicing-by-8 tables
+static uint32_t shift_table[4][256]; // appends CRC_STREAM zero bytes to a CRC register
+static uint64_t fold_keys[6];      // x^n mod P that fold 128-bit lanes forward by 512, 128 and 2048 bits
+static uint32_t zero_crc;          // CRC32C of a block of zeros
+static enum { ENGINE_TABLE, ENGINE_CRC32, ENGINE_CLMUL } engine;
+
+// The kernels are built optimized even in a debug build: unoptimized, every intrinsic goes
+// through memory and a block costs three times as long, which every checked read pays.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("O2")
+#endif
+
+/**
+ * Runs the CRC register over len bytes with the tables, eight at a time.
+ */
+static uint32_t crc_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    while (len >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        word ^= crc;
+
+        crc = crc_table[7][word & 0xff] ^ crc_table[6][(word >> 8) & 0xff] ^ crc_table[5][(word >> 16) & 0xff] ^
+              crc_table[4][(word >> 24) & 0xff] ^ crc_table[3][(word >> 32) & 0xff] ^ crc_table[2][(word >> 40) & 0xff] ^
+              crc_table[1][(word >> 48) & 0xff] ^ crc_table[0][word >> 56];
+        p += 8;
+        len -= 8;
+    }
+
+    while (len-- > 0)
+    {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+    }
+
+    return crc;
+}
+
+/**
+ * Returns the register after CRC_STREAM zero bytes, starting from crc.
+ */
+static uint32_t crc_shift(uint32_t crc)
+{
+    return shift_table[0][crc & 0xff] ^ shift_table[1][(crc >> 8) & 0xff] ^ shift_table[2][(crc >> 16) & 0xff] ^
+           shift_table[3][crc >> 24];
+}
+
+#if defined(__x86_64__)
+/**
+ * Runs the CRC register over len bytes with the crc32 instruction. The instruction takes three
+ * cycles but can start every cycle, so three independent streams are run side by side and
+ * joined with crc_shift(): the CRC of A followed by B is the CRC of A shifted past |B| zero
+ * bytes, XORed with the CRC of B from a zero register.
+ */
+__attribute__((target("sse4.2"))) static uint32_t crc_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t crc0 = crc;
+
+    while (len >= 3 * CRC_STREAM)
+    {
+        uint64_t crc1 = 0, crc2 = 0;
+
+        for (int i = 0; i < CRC_STREAM; i += 8)
+        {
+            uint64_t a, b, c;
+            memcpy(&a, p + i, 8);
+            memcpy(&b, p + CRC_STREAM + i, 8);
+            memcpy(&c, p + 2 * CRC_STREAM + i, 8);
+
+            crc0 = _mm_crc32_u64(crc0, a);
+            crc1 = _mm_crc32_u64(crc1, b);
+            crc2 = _mm_crc32_u64(crc2, c);
+        }
+
+        crc0 = crc_shift(crc_shift((uint32_t)crc0) ^ (uint32_t)crc1) ^ (uint32_t)crc2;
+        p += 3 * CRC_STREAM;
+        len -= 3 * CRC_STREAM;
+    }
+
+    while (len >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc0 = _mm_crc32_u64(crc0, word);
+        p += 8;
+        len -= 8;
+    }
+
+    while (len-- > 0)
+    {
+        crc0 = _mm_crc32_u8((uint32_t)crc0, *p++);
+    }
+
+    return (uint32_t)crc0;
+}
+
+/**
+ * Runs the CRC register over len bytes with 512-bit carry-less multiplies. The CRC of a message
+ * is the message times x^32 mod P, so a 128-bit lane can be moved forward n bits by multiplying
+ * its halves with x^n mod P (see fold_keys) and XORing the products, under 128 bits, into the
+ * lane found there. Four registers of four lanes take 256 bytes a round; at the end they are
+ * folded into a single lane, whose 16 bytes stand for everything before them.
+ */
+__attribute__((target("sse4.2,pclmul,avx512f,vpclmulqdq"))) static uint32_t crc_clmul(uint32_t crc, const uint8_t *p,
+                                                                                      size_t len)
+{
+    if (len < 2 * CRC_FOLD)
+    {
+        return crc_hw(crc, p, len);
+    }
+
+    __m512i k2048 = _mm512_broadcast_i32x4(_mm_set_epi64x(fold_keys[4], fold_keys[5]));
+    __m512i k512 = _mm512_broadcast_i32x4(_mm_set_epi64x(fold_keys[0], fold_keys[1]));
+    __m128i k128 = _mm_set_epi64x(fold_keys[2], fold_keys[3]);
+
+    // The register is the same as XORing it into the first four bytes with a zero register.
+    __m512i y0 = _mm512_xor_si512(_mm512_loadu_si512(p), _mm512_zextsi128_si512(_mm_cvtsi32_si128(crc)));
+    __m512i y1 = _mm512_loadu_si512(p + 64);
+    __m512i y2 = _mm512_loadu_si512(p + 128);
+    __m512i y3 = _mm512_loadu_si512(p + 192);
+    p += CRC_FOLD;
+    len -= CRC_FOLD;
+
+#define FOLD512(y, k, next)                                                                                    \
+    _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(y, k, 0x00), _mm512_clmulepi64_epi128(y, k, 0x11), next, 0x96)
+#define FOLD128(x, k, next) \
+    _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next)
+
+    while (len >= CRC_FOLD)
+    {
+        y0 = FOLD512(y0, k2048, _mm512_loadu_si512(p));
+        y1 = FOLD512(y1, k2048, _mm512_loadu_si512(p + 64));
+        y2 = FOLD512(y2, k2048, _mm512_loadu_si512(p + 128));
+        y3 = FOLD512(y3, k2048, _mm512_loadu_si512(p + 192));
+        p += CRC_FOLD;
+        len -= CRC_FOLD;
+    }
+
+    y1 = FOLD512(y0, k512, y1);
+    y2 = FOLD512(y1, k512, y2);
+    y3 = FOLD512(y2, k512, y3);
+
+    __m128i x = _mm512_extracti32x4_epi32(y3, 0);
+    x = FOLD128(x, k128, _mm512_extracti32x4_epi32(y3, 1));
+    x = FOLD128(x, k128, _mm512_extracti32x4_epi32(y3, 2));
+    x = FOLD128(x, k128, _mm512_extracti32x4_epi32(y3, 3));
+
+#undef FOLD512
+#undef FOLD128
+
+    // The last lane and the tail go through the crc32 instruction from a zero register.
+    uint8_t lane[16];
+    _mm_storeu_si128((__m128i *)lane, x);
+    return crc_hw(crc_hw(0, lane, sizeof(lane)), p, len);
+}
+#endif
+
+/**
+ * Runs the CRC register over len bytes the fastest way the CPU allows.
+ */
+static uint32_t crc_run(uint32_t crc, const uint8_t *p, size_t len)
+{
+#if defined(__x86_64__)
+    if (engine == ENGINE_CLMUL)
+    {
+        return crc_clmul(crc, p, len);
+    }
+
+    if (engine == ENGINE_CRC32)
+    {
+        return crc_hw(crc, p, len);
+    }
+#endif
+
+    return crc_sw(crc, p, len);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+/**
+ * Returns x^n mod P, bit-reflected like the CRC register.
+ */
+static uint32_t xpow_mod(int n)
+{
+    uint32_t v = 0x80000000u;
+
+    while (n-- > 0)
+    {
+        v = (v >> 1) ^ (v & 1 ? CRC32C_POLY : 0);
+    }
+
+    return v;
+}
+
+/**
+ * Builds the tables, once per process.
+ */
+static void tables_init()
+{
+    for (int i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+        }
+        crc_table[0][i] = crc;
+    }
+
+    for (int i = 0; i < 256; i++)
+    {
+        for (int k = 1; k < 8; k++)
+        {
+            crc_table[k][i] = (crc_table[k - 1][i] >> 8) ^ crc_table[0][crc_table[k - 1][i] & 0xff];
+        }
+    }
+
+    // Shifting is linear, so shift each of the 32 register bits and combine them per byte.
+    uint32_t bits[32];
+    for (int b = 0; b < 32; b++)
+    {
+        uint32_t crc = 1u << b;
+        for (int i = 0; i < CRC_STREAM; i++)
+        {
+            crc = (crc >> 8) ^ crc_table[0][crc & 0xff];
+        }
+        bits[b] = crc;
+    }
+
+    for (int k = 0; k < 4; k++)
+    {
+        for (int v = 0; v < 256; v++)
+        {
+            uint32_t crc = 0;
+            for (int b = 0; b < 8; b++)
+            {
+                crc ^= (v >> b) & 1 ? bits[8 * k + b] : 0;
+            }
+            shift_table[k][v] = crc;
+        }
+    }
+
+    // A reflected 64-bit half times a 32-bit key comes out one bit up and 32 bits into the
+    // lane, so moving a lane n bits takes x^(n+31) for its low half and x^(n-33) for its high.
+    int distances[3] = {512, 128, 8 * CRC_FOLD};
+    for (int i = 0; i < 3; i++)
+    {
+        fold_keys[2 * i] = xpow_mod(distances[i] - 33);
+        fold_keys[2 * i + 1] = xpow_mod(distances[i] + 31);
+    }
+
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("vpclmulqdq"))
+    {
+        engine = ENGINE_CLMUL;
+    }
+    else if (__builtin_cpu_supports("sse4.2"))
+    {
+        engine = ENGINE_CRC32;
+    }
+#endif
+
+    static const uint8_t zeros[BLOCK_SIZE];
+    zero_crc = ~crc_run(~0u, zeros, BLOCK_SIZE);
+}
+
+uint32_t disk_crc32c(uint32_t crc, const void *buf, size_t len)
+{
+    pthread_once(&tables_once, tables_init);
+    return ~crc_run(~crc, buf, len);
+}
+
+const char *disk_crc32c_engine()
+{
+    pthread_once(&tables_once, tables_init);
+    return engine == ENGINE_CLMUL ? "vpclmulqdq" : engine == ENGINE_CRC32 ? "sse4.2" : "table";
+}
+
+uint64_t disk_checksum_blocks(uint64_t nblocks)
+{
+    return (nblocks + SUMS_PER_BLOCK - 1) / SUMS_PER_BLOCK;
+}
+
+void disk_checksum_get_stats(struct disk_checksum_stats *stats)
+{
+    vdisk_checksum_get_stats(disk_default(), stats);
+}
+
+void vdisk_checksum_get_stats(struct vdisk *d, struct disk_checksum_stats *stats)
+{
+    if (d == NULL || d->csum == NULL)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    struct disk_checksum_stats *s = &d->csum->stats;
+    stats->verified = __atomic_load_n(&s->verified, __ATOMIC_RELAXED);
+    stats->updated = __atomic_load_n(&s->updated, __ATOMIC_RELAXED);
+    stats->failures = __atomic_load_n(&s->failures, __ATOMIC_RELAXED);
+}
+
+/*------------------------------------------- HOOKS ---------------------------------------------*/
+
+/**
+ * Returns the region entry of a block. The tables were built when the checksums were attached.
+ */
+static uint32_t block_sum(const void *buf)
+{
+    return ~crc_run(~0u, buf, BLOCK_SIZE) ^ zero_crc;
+}
+
+int disk_checksum_attach(struct vdisk *d)
+{
+    struct checksums *c = calloc(1, sizeof(struct checksums));
+    if (c == NULL)
+    {
+        printf("   ERROR: Could not allocate checksums.\n");
+        return -1;
+    }
+
+    c->region_blocks = disk_checksum_blocks(d->nblocks);
+
+    // The table is kept in memory whole, as one allocation.
+    if (c->region_blocks > INT_MAX)
+    {
+        printf("   ERROR: Disk is too large to keep checksums for.\n");
+        free(c);
+        return -1;
+    }
+
+    // Block-aligned, so the region can be moved in place on an O_DIRECT disk.
+    if (c->region_blocks > 0)
+    {
+        c->table = disk_alloc_blocks((int)c->region_blocks);
+        c->dirty = calloc(c->region_blocks, 1);
+
+        if (c->table == NULL || c->dirty == NULL)
+        {
+            printf("   ERROR: Could not allocate checksums.\n");
+            disk_free_blocks(c->table);
+            free(c->dirty);
+            free(c);
+            return -1;
+        }
+
+        if (disk_internal_region(d, 0, d->nblocks, c->table, (int)c->region_blocks) != 0)
+        {
+            printf("   ERROR: Could not read the checksum region.\n");
+            disk_free_blocks(c->table);
+            free(c->dirty);
+            free(c);
+            return -1;
+        }
+    }
+
+    // Build the tables now rather than on the first transfer.
+    pthread_once(&tables_once, tables_init);
+
+    d->csum = c;
+    return 0;
+}
+
+int disk_checksum_flush(struct vdisk *d)
+{
+    struct checksums *c = d->csum;
+
+    for (uint64_t i = 0; c != NULL && i < c->region_blocks; i++)
+    {
+        // Clear the flag first: an entry changed during the write sets it again.
+        if (__atomic_exchange_n(&c->dirty[i], 0, __ATOMIC_ACQ_REL) == 0)
+        {
+            continue;
+        }
+
+        if (disk_internal_region(d, 1, d->nblocks + i, c->table + (size_t)i * SUMS_PER_BLOCK, 1) != 0)
+        {
+            __atomic_store_n(&c->dirty[i], 1, __ATOMIC_RELAXED);
+            printf("   ERROR: Could not write the checksum region.\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void disk_checksum_detach(struct vdisk *d)
+{
+    struct checksums *c = d->csum;
+
+    if (c != NULL)
+    {
+        d->csum = NULL;
+        disk_free_blocks(c->table);
+        free(c->dirty);
+        free(c);
+    }
+}
+
+void disk_checksum_update(struct vdisk *d, uint64_t blocknum, const void *buf)
+{
+    struct checksums *c = d->csum;
+
+    if (c != NULL)
+    {
+        __atomic_store_n(&c->table[blocknum], block_sum(buf), __ATOMIC_RELAXED);
+        __atomic_store_n(&c->dirty[blocknum / SUMS_PER_BLOCK], 1, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&c->stats.updated, 1, __ATOMIC_RELAXED);
+    }
+}
+
+int disk_checksum_verify(struct vdisk *d, uint64_t blocknum, const void *buf)
+{
+    struct checksums *c = d->csum;
+
+    if (c == NULL)
+    {
+        return 0;
+    }
+
+    __atomic_add_fetch(&c->stats.verified, 1, __ATOMIC_RELAXED);
+
+    if (block_sum(buf) != __atomic_load_n(&c->table[blocknum], __ATOMIC_RELAXED))
+    {
+        __atomic_add_fetch(&c->stats.failures, 1, __ATOMIC_RELAXED);
+        printf("   ERROR: Checksum mismatch in block %llu.\n", (unsigned long long)blocknum);
+        return -1;
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+/**
+ * @file disk_checksum.h
+ * @brief This header file contains the declarations of the block checksums.
+ *
+ * A disk created with DISK_CHECKSUM keeps a CRC32C of every block in a checksum region after
+ * its last block, four bytes per block. The region is sized when the disk is created, and
+ * disk_size() does not count it. Checksums are kept in memory while the disk is open and
+ * written back to the region by disk_flush() and disk_close().
+ *
+ * Every block read from the image is checked against its checksum, and every block written
+ * updates it. A mismatch fails the read. A region entry holds the CRC32C of the block XORed
+ * with that of a block of zeros, so the all-zero region of a new sparse image matches its
+ * all-zero blocks without being written.
+ *
+ * The CRC32C is computed by folding with 512-bit carry-less multiplies (VPCLMULQDQ) where the
+ * CPU has them, else with the SSE4.2 crc32 instruction running three streams at once, else
+ * with tables.
+ *
+ */
+
+#ifndef DISK_CHECKSUM_H
+#define DISK_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "disk.h"
+
+/**
+ * @brief Counters kept by the checksums.
+ *
+ * @param verified The blocks read and checked.
+ * @param updated The blocks written and checksummed.
+ * @param failures The blocks that did not match their checksum.
+ */
+struct disk_checksum_stats
+{
+    uint64_t verified;
+    uint64_t updated;
+    uint64_t failures;
+};
+
+/**
+ * @brief Computes the CRC32C (Castagnoli) of buf, continuing from crc.
+ *
+ * Start with crc = 0. The CRC of "123456789" is 0xe3069283.
+ */
+uint32_t disk_crc32c(uint32_t crc, const void *buf, size_t len);
+
+/**
+ * @brief Returns how disk_crc32c() runs on this CPU: "vpclmulqdq", "sse4.2" or "table".
+ */
+const char *disk_crc32c_engine();
+
+/**
+ * @brief Returns the number of blocks of the checksum region of a disk with nblocks blocks.
+ */
+uint64_t disk_checksum_blocks(uint64_t nblocks);
+
+/**
+ * @brief Copies the checksum counters of the default disk into stats. They are all zero when
+ * it was not opened with DISK_CHECKSUM.
+ *
+ * @param stats Where to store the counters.
+ */
+void disk_checksum_get_stats(struct disk_checksum_stats *stats);
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+void vdisk_checksum_get_stats(struct vdisk *d, struct disk_checksum_stats *stats);
+
+#endif
\ No newline at end of file
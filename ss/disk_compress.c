@@ -0,0 +1,653 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include "disk_compress.h"
+#include "disk_internal.h"
+
+#define ENTRIES_PER_BLOCK (BLOCK_SIZE / 8)
+#define SECTORS_PER_BLOCK (BLOCK_SIZE / DISK_COMPRESS_SECTOR)
+#define LENGTH_BITS 24 // an entry is the first sector of a block (40 bits) above its stored length
+#define WINDOW_BITS 12 // raw deflate with a 4 KB window, since a block never refers outside itself
+#define MEM_LEVEL 5    // a hash table sized for one block, which deflateReset() clears every time
+
+/**
+ * The header in the first block of a compressed image.
+ *
+ * @param magic DISK_COMPRESS_MAGIC.
+ * @param version DISK_COMPRESS_VERSION.
+ * @param block_size BLOCK_SIZE.
+ * @param nblocks The number of blocks of the disk.
+ * @param map_blocks The number of blocks of the map that follows the header.
+ * @param next_sector The end of the data area, where the next block is appended.
+ * @param dead_sectors The sectors left behind by rewritten blocks.
+ */
+struct compress_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t nblocks;
+    uint32_t map_blocks;
+    uint64_t next_sector;
+    uint64_t dead_sectors;
+};
+
+/**
+ * The translation map of one disk.
+ *
+ * @param map One entry per block, laid out as in the image. An entry of 0 is a block of zeros.
+ * @param dirty One flag per map block whose entries changed since the last flush.
+ * @param map_blocks The number of blocks of the map.
+ * @param first The first sector of the data area.
+ * @param next The end of the data area.
+ * @param dead The sectors left behind by rewritten blocks.
+ * @param header_dirty 1 if next or dead changed since the last flush.
+ * @param level The zlib level of new blocks.
+ * @param stats The transfer counters; the space counters are worked out from the map.
+ */
+struct compression
+{
+    uint64_t *map;
+    uint8_t *dirty;
+    uint32_t map_blocks;
+    uint64_t first;
+    uint64_t next;
+    uint64_t dead;
+    int header_dirty;
+    int level;
+    struct disk_compress_stats stats;
+};
+
+/**
+ * The zlib streams of one thread, set up on its first block and reset for every other.
+ *
+ * @param level The level `deflate` was set up with, or -1 before the first block.
+ */
+struct codec
+{
+    z_stream deflate;
+    z_stream inflate;
+    int level;
+};
+
+static pthread_once_t codec_once = PTHREAD_ONCE_INIT;
+static pthread_key_t codec_key;
+
+static uint64_t entry_sector(uint64_t entry)
+{
+    return entry >> LENGTH_BITS;
+}
+
+static uint32_t entry_length(uint64_t entry)
+{
+    return entry & ((1u << LENGTH_BITS) - 1);
+}
+
+/**
+ * Returns the sectors a block of `length` stored bytes takes.
+ */
+static uint64_t sectors(uint32_t length)
+{
+    return (length + DISK_COMPRESS_SECTOR - 1) / DISK_COMPRESS_SECTOR;
+}
+
+static void codec_free(void *arg)
+{
+    struct codec *k = arg;
+
+    if (k->level >= 0)
+    {
+        deflateEnd(&k->deflate);
+    }
+    inflateEnd(&k->inflate);
+    free(k);
+}
+
+static void codec_key_init()
+{
+    pthread_key_create(&codec_key, codec_free);
+}
+
+/**
+ * Returns the streams of the calling thread, setting them up on first use.
+ */
+static struct codec *codec_get()
+{
+    pthread_once(&codec_once, codec_key_init);
+
+    struct codec *k = pthread_getspecific(codec_key);
+    if (k != NULL)
+    {
+        return k;
+    }
+
+    k = calloc(1, sizeof(struct codec));
+    if (k == NULL || inflateInit2(&k->inflate, -WINDOW_BITS) != Z_OK)
+    {
+        printf("   ERROR: Could not set up zlib.\n");
+        free(k);
+        return NULL;
+    }
+
+    k->level = -1;
+    pthread_setspecific(codec_key, k);
+    return k;
+}
+
+/**
+ * Returns 1 if the block holds only zeros.
+ */
+static int is_zero(const void *buf)
+{
+    const uint64_t *words = buf;
+
+    for (int i = 0; i < BLOCK_SIZE / 8; i++)
+    {
+        if (words[i] != 0)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Compresses one block into `out`, which has room for BLOCK_SIZE bytes.
+ *
+ * @return Returns the stored length: 0 for a block of zeros, BLOCK_SIZE for a block stored as
+ * it is, or -1 on failure.
+ */
+static int pack(struct codec *k, int level, const void *buf, uint8_t *out)
+{
+    if (is_zero(buf))
+    {
+        return 0;
+    }
+
+    if (level > 0)
+    {
+        if (k->level != level)
+        {
+            if (k->level >= 0)
+            {
+                deflateEnd(&k->deflate);
+            }
+
+            k->level = -1;
+            if (deflateInit2(&k->deflate, level, Z_DEFLATED, -WINDOW_BITS, MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                printf("   ERROR: Could not set up zlib.\n");
+                return -1;
+            }
+            k->level = level;
+        }
+        else
+        {
+            deflateReset(&k->deflate);
+        }
+
+        // Leave out the last sector, so only a block that saves at least one is kept compressed.
+        k->deflate.next_in = (Bytef *)buf;
+        k->deflate.avail_in = BLOCK_SIZE;
+        k->deflate.next_out = out;
+        k->deflate.avail_out = BLOCK_SIZE - DISK_COMPRESS_SECTOR;
+
+        if (deflate(&k->deflate, Z_FINISH) == Z_STREAM_END)
+        {
+            return BLOCK_SIZE - DISK_COMPRESS_SECTOR - k->deflate.avail_out;
+        }
+    }
+
+    memcpy(out, buf, BLOCK_SIZE);
+    return BLOCK_SIZE;
+}
+
+/**
+ * Restores one block from its `length` stored bytes.
+ *
+ * @return Returns 0 on success, -1 if the bytes do not decompress to a whole block.
+ */
+static int unpack(struct codec *k, const uint8_t *in, uint32_t length, void *buf)
+{
+    if (length == BLOCK_SIZE)
+    {
+        memcpy(buf, in, BLOCK_SIZE);
+        return 0;
+    }
+
+    inflateReset(&k->inflate);
+    k->inflate.next_in = (Bytef *)in;
+    k->inflate.avail_in = length;
+    k->inflate.next_out = buf;
+    k->inflate.avail_out = BLOCK_SIZE;
+
+    return inflate(&k->inflate, Z_FINISH) == Z_STREAM_END && k->inflate.avail_out == 0 ? 0 : -1;
+}
+
+/**
+ * Points the entry of a block at its new place, and marks the map and header for the next flush.
+ */
+static void set_entry(struct compression *c, uint64_t blocknum, uint64_t sector, uint32_t length)
+{
+    __atomic_store_n(&c->map[blocknum], length > 0 ? sector << LENGTH_BITS | length : 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->dirty[blocknum / ENTRIES_PER_BLOCK], 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&c->header_dirty, 1, __ATOMIC_RELEASE);
+}
+
+int disk_compress_level(int level)
+{
+    return vdisk_compress_level(disk_default(), level);
+}
+
+int vdisk_compress_level(struct vdisk *d, int level)
+{
+    if (d == NULL || d->comp == NULL)
+    {
+        printf("   ERROR: Disk is not compressed.\n");
+        return -1;
+    }
+
+    if (level < 0 || level > 9)
+    {
+        printf("   ERROR: Invalid compression level %d.\n", level);
+        return -1;
+    }
+
+    __atomic_store_n(&d->comp->level, level, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void disk_compress_get_stats(struct disk_compress_stats *stats)
+{
+    vdisk_compress_get_stats(disk_default(), stats);
+}
+
+void vdisk_compress_get_stats(struct vdisk *d, struct disk_compress_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (d == NULL || d->comp == NULL)
+    {
+        return;
+    }
+
+    struct compression *c = d->comp;
+
+    for (uint32_t i = 0; i < d->nblocks; i++)
+    {
+        uint32_t length = entry_length(__atomic_load_n(&c->map[i], __ATOMIC_RELAXED));
+
+        stats->blocks += length > 0;
+        stats->stored_bytes += length;
+    }
+
+    stats->data_bytes = (__atomic_load_n(&c->next, __ATOMIC_RELAXED) - c->first) * DISK_COMPRESS_SECTOR;
+    stats->dead_bytes = __atomic_load_n(&c->dead, __ATOMIC_RELAXED) * DISK_COMPRESS_SECTOR;
+    stats->read_bytes = __atomic_load_n(&c->stats.read_bytes, __ATOMIC_RELAXED);
+    stats->read_stored = __atomic_load_n(&c->stats.read_stored, __ATOMIC_RELAXED);
+    stats->write_bytes = __atomic_load_n(&c->stats.write_bytes, __ATOMIC_RELAXED);
+    stats->write_stored = __atomic_load_n(&c->stats.write_stored, __ATOMIC_RELAXED);
+}
+
+/*------------------------------------------- HOOKS ---------------------------------------------*/
+
+int disk_compress_attach(struct vdisk *d, int create)
+{
+    struct compress_header *h = disk_alloc_blocks(1);
+    struct compression *c = calloc(1, sizeof(struct compression));
+
+    if (h == NULL || c == NULL)
+    {
+        printf("   ERROR: Could not allocate translation map.\n");
+        disk_free_blocks(h);
+        free(c);
+        return -1;
+    }
+
+    if (create && d->nblocks > DISK_COMPRESS_MAX_BLOCKS)
+    {
+        printf("   ERROR: A compressed image holds at most %u blocks.\n", DISK_COMPRESS_MAX_BLOCKS);
+        disk_free_blocks(h);
+        free(c);
+        return -1;
+    }
+
+    // A new image gets a header; an existing one must have a header of this format.
+    if (create)
+    {
+        memcpy(h->magic, DISK_COMPRESS_MAGIC, sizeof(h->magic));
+        h->version = DISK_COMPRESS_VERSION;
+        h->block_size = BLOCK_SIZE;
+        h->nblocks = d->nblocks;
+        h->map_blocks = (d->nblocks + ENTRIES_PER_BLOCK - 1) / ENTRIES_PER_BLOCK;
+        h->next_sector = (uint64_t)(1 + h->map_blocks) * SECTORS_PER_BLOCK;
+    }
+    else if (disk_internal_region(d, 0, 0, h, 1) != 0 || memcmp(h->magic, DISK_COMPRESS_MAGIC, sizeof(h->magic)) != 0 ||
+             h->version != DISK_COMPRESS_VERSION || h->block_size != BLOCK_SIZE ||
+             h->map_blocks != (h->nblocks + ENTRIES_PER_BLOCK - 1) / ENTRIES_PER_BLOCK ||
+             h->next_sector < (uint64_t)(1 + h->map_blocks) * SECTORS_PER_BLOCK)
+    {
+        printf("   ERROR: The disk is not a compressed image.\n");
+        disk_free_blocks(h);
+        free(c);
+        return -1;
+    }
+
+    c->map_blocks = h->map_blocks;
+    c->first = (uint64_t)(1 + h->map_blocks) * SECTORS_PER_BLOCK;
+    c->next = h->next_sector;
+    c->dead = h->dead_sectors;
+    c->level = DISK_COMPRESS_LEVEL;
+
+    // Block-aligned, so map blocks go to the image straight from the map.
+    if (c->map_blocks > 0)
+    {
+        c->map = disk_alloc_blocks(c->map_blocks);
+        c->dirty = calloc(c->map_blocks, 1);
+
+        if (c->map == NULL || c->dirty == NULL)
+        {
+            printf("   ERROR: Could not allocate translation map.\n");
+            disk_free_blocks(c->map);
+            free(c->dirty);
+            disk_free_blocks(h);
+            free(c);
+            return -1;
+        }
+    }
+
+    // A new image is sized by its header and last map block; the map blocks between stay sparse.
+    int result;
+    if (create)
+    {
+        result = disk_internal_region(d, 1, 0, h, 1);
+        if (result == 0 && c->map_blocks > 0)
+        {
+            result = disk_internal_region(d, 1, c->map_blocks, c->map + (size_t)(c->map_blocks - 1) * ENTRIES_PER_BLOCK, 1);
+        }
+    }
+    else
+    {
+        result = c->map_blocks > 0 ? disk_internal_region(d, 0, 1, c->map, c->map_blocks) : 0;
+    }
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not %s the translation map.\n", create ? "write" : "read");
+        disk_free_blocks(c->map);
+        free(c->dirty);
+        disk_free_blocks(h);
+        free(c);
+        return -1;
+    }
+
+    d->nblocks = h->nblocks;
+    d->comp = c;
+    disk_free_blocks(h);
+    return 0;
+}
+
+int disk_compress_flush(struct vdisk *d)
+{
+    struct compression *c = d->comp;
+
+    if (c == NULL)
+    {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < c->map_blocks; i++)
+    {
+        // Clear the flag first: an entry changed during the write sets it again.
+        if (__atomic_exchange_n(&c->dirty[i], 0, __ATOMIC_ACQ_REL) == 0)
+        {
+            continue;
+        }
+
+        if (disk_internal_region(d, 1, 1 + i, c->map + (size_t)i * ENTRIES_PER_BLOCK, 1) != 0)
+        {
+            __atomic_store_n(&c->dirty[i], 1, __ATOMIC_RELAXED);
+            printf("   ERROR: Could not write the translation map.\n");
+            return -1;
+        }
+    }
+
+    if (__atomic_exchange_n(&c->header_dirty, 0, __ATOMIC_ACQ_REL) == 0)
+    {
+        return 0;
+    }
+
+    struct compress_header *h = disk_alloc_blocks(1);
+    int result = -1;
+
+    if (h != NULL)
+    {
+        memcpy(h->magic, DISK_COMPRESS_MAGIC, sizeof(h->magic));
+        h->version = DISK_COMPRESS_VERSION;
+        h->block_size = BLOCK_SIZE;
+        h->nblocks = d->nblocks;
+        h->map_blocks = c->map_blocks;
+        h->next_sector = __atomic_load_n(&c->next, __ATOMIC_RELAXED);
+        h->dead_sectors = __atomic_load_n(&c->dead, __ATOMIC_RELAXED);
+        result = disk_internal_region(d, 1, 0, h, 1);
+        disk_free_blocks(h);
+    }
+
+    if (result != 0)
+    {
+        __atomic_store_n(&c->header_dirty, 1, __ATOMIC_RELAXED);
+        printf("   ERROR: Could not write the compressed image header.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void disk_compress_detach(struct vdisk *d)
+{
+    struct compression *c = d->comp;
+
+    if (c != NULL)
+    {
+        d->comp = NULL;
+        disk_free_blocks(c->map);
+        free(c->dirty);
+        free(c);
+    }
+}
+
+/**
+ * Compresses a run of blocks into `area`, one after the other at sector boundaries, and writes
+ * them with one pwrite. A single block that still fits where it is stays there; anything else
+ * goes to the end of the data area.
+ *
+ * @param area Room for count blocks.
+ * @param lengths Room for count lengths.
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int write_run(struct vdisk *d, struct codec *k, const struct disk_iovec *iov, int count, uint8_t *area, uint32_t *lengths)
+{
+    struct compression *c = d->comp;
+    int level = __atomic_load_n(&c->level, __ATOMIC_RELAXED);
+    uint64_t used = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t *out = area + used * DISK_COMPRESS_SECTOR;
+        int length = pack(k, level, iov[i].buf, out);
+
+        if (length < 0)
+        {
+            return -1;
+        }
+
+        // Zero the end of the last sector, so the image does not keep stale bytes there.
+        memset(out + length, 0, sectors(length) * DISK_COMPRESS_SECTOR - length);
+        lengths[i] = length;
+        used += sectors(length);
+    }
+
+    uint64_t old = __atomic_load_n(&c->map[iov[0].blocknum], __ATOMIC_RELAXED);
+    uint64_t sector;
+    int in_place = count == 1 && entry_length(old) > 0 && used <= sectors(entry_length(old));
+
+    if (in_place)
+    {
+        sector = entry_sector(old);
+    }
+    else
+    {
+        sector = __atomic_fetch_add(&c->next, used, __ATOMIC_RELAXED);
+    }
+
+    if (used > 0)
+    {
+        uint64_t offset = sector * DISK_COMPRESS_SECTOR;
+        uint64_t bytes = used * DISK_COMPRESS_SECTOR;
+
+        if (disk_internal_extent(d, 1, offset, area, bytes) != 0)
+        {
+            printf("   ERROR: Could not write %d compressed blocks.\n", count);
+            return -1;
+        }
+
+        if (d->model != NULL)
+        {
+            disk_model_charge_bytes(d, 1, offset, bytes);
+        }
+    }
+
+    // Point the entries at their new places, and count what the old ones leave behind.
+    uint64_t dead = in_place ? sectors(entry_length(old)) - used : 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!in_place)
+        {
+            dead += sectors(entry_length(__atomic_load_n(&c->map[iov[i].blocknum], __ATOMIC_RELAXED)));
+        }
+
+        set_entry(c, iov[i].blocknum, sector, lengths[i]);
+        sector += sectors(lengths[i]);
+    }
+
+    __atomic_add_fetch(&c->dead, dead, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&c->stats.write_bytes, (uint64_t)count * BLOCK_SIZE, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&c->stats.write_stored, used * DISK_COMPRESS_SECTOR, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * Reads a run of blocks. Blocks stored one after the other are read with one pread into
+ * `area` and decompressed from there; blocks of zeros are not read at all.
+ *
+ * @param area Room for count blocks.
+ * @param entries Room for count entries.
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int read_run(struct vdisk *d, struct codec *k, const struct disk_iovec *iov, int count, uint8_t *area, uint64_t *entries)
+{
+    struct compression *c = d->comp;
+    uint64_t stored = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        entries[i] = __atomic_load_n(&c->map[iov[i].blocknum], __ATOMIC_RELAXED);
+    }
+
+    int i = 0;
+    while (i < count)
+    {
+        if (entry_length(entries[i]) == 0)
+        {
+            memset(iov[i].buf, 0, BLOCK_SIZE);
+            i++;
+            continue;
+        }
+
+        // Extend the extent over the blocks that follow on in the data area.
+        uint64_t first = entry_sector(entries[i]);
+        uint64_t end = first + sectors(entry_length(entries[i]));
+        int n = 1;
+
+        while (i + n < count && entry_length(entries[i + n]) > 0 && entry_sector(entries[i + n]) == end)
+        {
+            end += sectors(entry_length(entries[i + n]));
+            n++;
+        }
+
+        uint64_t offset = first * DISK_COMPRESS_SECTOR;
+        uint64_t bytes = (end - first) * DISK_COMPRESS_SECTOR;
+
+        if (disk_internal_extent(d, 0, offset, area, bytes) != 0)
+        {
+            printf("   ERROR: Could not read %d compressed blocks.\n", n);
+            return -1;
+        }
+
+        if (d->model != NULL)
+        {
+            disk_model_charge_bytes(d, 0, offset, bytes);
+        }
+
+        for (int j = i; j < i + n; j++)
+        {
+            const uint8_t *in = area + (entry_sector(entries[j]) - first) * DISK_COMPRESS_SECTOR;
+
+            if (unpack(k, in, entry_length(entries[j]), iov[j].buf) != 0)
+            {
+                printf("   ERROR: Block %llu does not decompress.\n", (unsigned long long)iov[j].blocknum);
+                return -1;
+            }
+        }
+
+        stored += bytes;
+        i += n;
+    }
+
+    __atomic_add_fetch(&c->stats.read_bytes, (uint64_t)count * BLOCK_SIZE, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&c->stats.read_stored, stored, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int disk_compress_run(struct vdisk *d, int write, const struct disk_iovec *iov, int count)
+{
+    struct codec *k = codec_get();
+
+    if (k == NULL)
+    {
+        return -1;
+    }
+
+    // A single block needs no allocation.
+    if (count == 1)
+    {
+        uint8_t area[BLOCK_SIZE];
+        uint64_t entry;
+        uint32_t length;
+
+        return write ? write_run(d, k, iov, 1, area, &length) : read_run(d, k, iov, 1, area, &entry);
+    }
+
+    uint8_t *area = malloc((size_t)count * BLOCK_SIZE);
+    uint64_t *entries = malloc(count * sizeof(uint64_t));
+    int result = -1;
+
+    if (area == NULL || entries == NULL)
+    {
+        printf("   ERROR: Could not allocate %d compressed blocks.\n", count);
+    }
+    else
+    {
+        // The entries array doubles as the lengths of a write.
+        result = write ? write_run(d, k, iov, count, area, (uint32_t *)entries) : read_run(d, k, iov, count, area, entries);
+    }
+
+    free(area);
+    free(entries);
+    return result;
+}
\ No newline at end of file
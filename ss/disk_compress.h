@@ -0,0 +1,82 @@
+/**
+ * @file disk_compress.h
+ * @brief This header file contains the declarations of the compressed image format.
+ *
+ * A disk created with DISK_COMPRESS does not keep block n at offset n * BLOCK_SIZE. The image
+ * starts with a header block and a translation map of one 8-byte entry per block, followed by
+ * a data area where each block is stored zlib-compressed in as few DISK_COMPRESS_SECTOR-byte
+ * sectors as it needs. A block that does not shrink by at least a sector is stored as it is,
+ * and a block of zeros takes no space at all: its entry is empty, and reading it moves nothing.
+ *
+ * The blocks of one disk_writev() run are stored one after the other and written with a
+ * single pwrite, and a disk_readv() run whose blocks are stored that way is read with a single
+ * pread. Scans of a file written in one go thus read only its compressed size from the image.
+ * A rewritten block stays in place when it still fits, and moves to the end of the data area
+ * otherwise; the space it leaves is counted as dead and not reused.
+ *
+ * The map is kept in memory while the disk is open, and written back by disk_flush() and
+ * disk_close(). An attached device model is charged the bytes actually moved, at the place
+ * they are stored.
+ *
+ */
+
+#ifndef DISK_COMPRESS_H
+#define DISK_COMPRESS_H
+
+#include <stdint.h>
+
+#include "disk.h"
+
+#define DISK_COMPRESS_MAGIC "RZCOMP01"
+#define DISK_COMPRESS_VERSION 1
+#define DISK_COMPRESS_MAX_BLOCKS UINT32_MAX // most blocks, as the header holds a 32-bit count
+#define DISK_COMPRESS_SECTOR 512 // unit of space in the data area
+#define DISK_COMPRESS_LEVEL 1    // default zlib level, the fastest
+
+/**
+ * @brief Counters kept by a compressed disk.
+ *
+ * @param blocks The blocks that take space (not all zeros).
+ * @param stored_bytes The compressed size of those blocks.
+ * @param data_bytes The size of the data area, dead space included.
+ * @param dead_bytes The space left behind by rewritten blocks.
+ * @param read_bytes The bytes of blocks read.
+ * @param read_stored The bytes read from the image for them.
+ * @param write_bytes The bytes of blocks written.
+ * @param write_stored The bytes written to the image for them.
+ */
+struct disk_compress_stats
+{
+    uint64_t blocks;
+    uint64_t stored_bytes;
+    uint64_t data_bytes;
+    uint64_t dead_bytes;
+    uint64_t read_bytes;
+    uint64_t read_stored;
+    uint64_t write_bytes;
+    uint64_t write_stored;
+};
+
+/**
+ * @brief Sets the zlib level of the blocks written from now on to the default disk.
+ *
+ * @param level 1 (fastest) to 9 (smallest), or 0 to store blocks uncompressed.
+ * @return int Returns 0 on success, -1 if the disk is not compressed or the level is invalid.
+ */
+int disk_compress_level(int level);
+
+/**
+ * @brief Copies the counters of the default disk into stats. They are all zero when it was
+ * not opened with DISK_COMPRESS. Walks the whole map.
+ *
+ * @param stats Where to store the counters.
+ */
+void disk_compress_get_stats(struct disk_compress_stats *stats);
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+int vdisk_compress_level(struct vdisk *d, int level);
+void vdisk_compress_get_stats(struct vdisk *d, struct disk_compress_stats *stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,602 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "disk_dedup.h"
+#include "disk_checksum.h"
+#include "disk_internal.h"
+
+#define MAP_PER_BLOCK (BLOCK_SIZE / 4)
+#define HASHES_PER_BLOCK (BLOCK_SIZE / 8)
+#define RELEASE_RUN 64 // blocks released per disk_writev
+
+/**
+ * The header in the first block of a deduplicated image.
+ *
+ * @param magic DISK_DEDUP_MAGIC.
+ * @param version DISK_DEDUP_VERSION.
+ * @param block_size BLOCK_SIZE.
+ * @param nblocks The number of blocks of the disk, and of physical blocks after the tables.
+ * @param map_blocks The number of blocks of the map that follows the header.
+ * @param hash_blocks The number of blocks of the hash index that follows the map.
+ */
+struct dedup_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t nblocks;
+    uint32_t map_blocks;
+    uint32_t hash_blocks;
+};
+
+/**
+ * The tables of one disk.
+ *
+ * @param map One entry per block, laid out as in the image: its physical block + 1, or 0 for
+ * a block of zeros.
+ * @param hashes The hash of every physical block, laid out as in the image.
+ * @param refs The number of blocks pointing at every physical block. 0 means free.
+ * @param free The free physical blocks, lowest on top.
+ * @param nfree The number of entries in free.
+ * @param buckets The hash table over the physical blocks in use: the first physical block + 1
+ * of every chain, or 0.
+ * @param chain The physical block + 1 after each one in its chain, or 0.
+ * @param mask The number of buckets - 1.
+ * @param map_dirty One flag per map block whose entries changed since the last flush.
+ * @param hash_dirty One flag per index block whose entries changed since the last flush.
+ * @param map_blocks The number of blocks of the map.
+ * @param hash_blocks The number of blocks of the index.
+ * @param data The first block of the physical blocks.
+ * @param lock Serializes writes, which share the tables.
+ * @param stats The counters; blocks and stored are worked out from the tables.
+ */
+struct dedup
+{
+    uint32_t *map;
+    uint64_t *hashes;
+    uint32_t *refs;
+    uint32_t *free;
+    uint32_t nfree;
+    uint32_t *buckets;
+    uint32_t *chain;
+    uint32_t mask;
+    uint8_t *map_dirty;
+    uint8_t *hash_dirty;
+    uint32_t map_blocks;
+    uint32_t hash_blocks;
+    uint32_t data;
+    pthread_mutex_t lock;
+    struct disk_dedup_stats stats;
+};
+
+/**
+ * Returns 1 if the block holds only zeros.
+ */
+static int is_zero(const void *buf)
+{
+    const uint64_t *words = buf;
+
+    for (int i = 0; i < BLOCK_SIZE / 8; i++)
+    {
+        if (words[i] != 0)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Returns the hash of a block: the CRC32C of each half, side by side.
+ */
+static uint64_t block_hash(const void *buf)
+{
+    const uint8_t *p = buf;
+
+    return (uint64_t)disk_crc32c(0, p, BLOCK_SIZE / 2) << 32 | disk_crc32c(0, p + BLOCK_SIZE / 2, BLOCK_SIZE / 2);
+}
+
+/**
+ * Adds a physical block to the chain of its hash.
+ */
+static void index_add(struct dedup *u, uint32_t p)
+{
+    uint32_t *bucket = &u->buckets[u->hashes[p] & u->mask];
+
+    u->chain[p] = *bucket;
+    *bucket = p + 1;
+}
+
+/**
+ * Takes a physical block off the chain of its hash.
+ */
+static void index_remove(struct dedup *u, uint32_t p)
+{
+    uint32_t *link = &u->buckets[u->hashes[p] & u->mask];
+
+    while (*link != 0 && *link != p + 1)
+    {
+        link = &u->chain[*link - 1];
+    }
+
+    if (*link != 0)
+    {
+        *link = u->chain[p];
+        u->chain[p] = 0;
+    }
+}
+
+/**
+ * Moves one physical block, and charges it to the device model.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int physical_io(struct vdisk *d, int write, uint32_t p, void *buf)
+{
+    uint64_t offset = ((uint64_t)d->dedup->data + p) * BLOCK_SIZE;
+
+    if (disk_internal_extent(d, write, offset, buf, BLOCK_SIZE) != 0)
+    {
+        return -1;
+    }
+
+    if (d->model != NULL)
+    {
+        disk_model_charge_bytes(d, write, offset, BLOCK_SIZE);
+    }
+
+    return 0;
+}
+
+/**
+ * Looks for a physical block holding exactly buf, whose hash is h. Every block with the same hash
+ * is read and compared.
+ *
+ * @param p Where to store the physical block found.
+ * @return Returns 1 if one was found, 0 if not, -1 on failure.
+ */
+static int find(struct vdisk *d, uint64_t h, const void *buf, uint32_t *p)
+{
+    struct dedup *u = d->dedup;
+    uint8_t stored[BLOCK_SIZE];
+
+    for (uint32_t q = u->buckets[h & u->mask]; q != 0; q = u->chain[q - 1])
+    {
+        if (u->hashes[q - 1] != h)
+        {
+            continue;
+        }
+
+        u->stats.verify_reads++;
+        if (physical_io(d, 0, q - 1, stored) != 0)
+        {
+            printf("   ERROR: Could not read physical block %u.\n", q - 1);
+            return -1;
+        }
+
+        if (memcmp(stored, buf, BLOCK_SIZE) == 0)
+        {
+            *p = q - 1;
+            return 1;
+        }
+
+        u->stats.collisions++;
+    }
+
+    return 0;
+}
+
+/**
+ * Records the hash of a physical block, and marks its index block for the next flush.
+ */
+static void set_hash(struct dedup *u, uint32_t p, uint64_t h)
+{
+    u->hashes[p] = h;
+    __atomic_store_n(&u->hash_dirty[p / HASHES_PER_BLOCK], 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Writes one block: points it at a stored copy of its data, or stores the data in a physical
+ * block of its own. Called with the tables locked.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int write_block(struct vdisk *d, uint64_t blocknum, const void *buf)
+{
+    struct dedup *u = d->dedup;
+    uint32_t old = u->map[blocknum];
+    uint32_t entry = 0;
+
+    if (!is_zero(buf))
+    {
+        uint64_t h = block_hash(buf);
+        uint32_t p;
+        int found = find(d, h, buf, &p);
+
+        if (found < 0)
+        {
+            return -1;
+        }
+
+        if (found)
+        {
+            // Share the stored copy; a block rewritten with its own data changes nothing.
+            u->stats.hits++;
+            if (p + 1 == old)
+            {
+                return 0;
+            }
+            u->refs[p]++;
+        }
+        else if (old != 0 && u->refs[old - 1] == 1)
+        {
+            // The block alone uses its copy, so overwrite it in place. Until that succeeds, no
+            // other block may be matched against it.
+            p = old - 1;
+            index_remove(u, p);
+            if (physical_io(d, 1, p, (void *)buf) != 0)
+            {
+                printf("   ERROR: Could not write physical block %u.\n", p);
+                return -1;
+            }
+            set_hash(u, p, h);
+            index_add(u, p);
+            return 0;
+        }
+        else
+        {
+            // There is always a free block here: a block that does not hold the only reference
+            // to a copy leaves at most nblocks - 1 copies in use.
+            p = u->free[u->nfree - 1];
+            if (physical_io(d, 1, p, (void *)buf) != 0)
+            {
+                printf("   ERROR: Could not write physical block %u.\n", p);
+                return -1;
+            }
+            u->nfree--;
+            u->refs[p] = 1;
+            set_hash(u, p, h);
+            index_add(u, p);
+        }
+
+        entry = p + 1;
+    }
+
+    // Drop the reference to the old copy, freeing it if it was the last.
+    if (old != 0 && old != entry && --u->refs[old - 1] == 0)
+    {
+        index_remove(u, old - 1);
+        u->free[u->nfree++] = old - 1;
+    }
+
+    __atomic_store_n(&u->map[blocknum], entry, __ATOMIC_RELAXED);
+    __atomic_store_n(&u->map_dirty[blocknum / MAP_PER_BLOCK], 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int disk_dedup_release(uint64_t first, int count)
+{
+    return vdisk_dedup_release(disk_default(), first, count);
+}
+
+int vdisk_dedup_release(struct vdisk *d, uint64_t first, int count)
+{
+    static const uint8_t zeros[BLOCK_SIZE];
+    struct disk_iovec iov[RELEASE_RUN];
+
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    if (count < 0 || first > d->nblocks || (uint64_t)count > d->nblocks - first)
+    {
+        printf("   ERROR: Invalid block range.\n");
+        return -1;
+    }
+
+    // Write zeros through the usual path, so the cache and the scheduler drop their copies too.
+    for (int done = 0; done < count; done += RELEASE_RUN)
+    {
+        int n = count - done < RELEASE_RUN ? count - done : RELEASE_RUN;
+
+        for (int i = 0; i < n; i++)
+        {
+            iov[i].blocknum = first + done + i;
+            iov[i].buf = (void *)zeros;
+        }
+
+        if (vdisk_writev(d, iov, n) != n * BLOCK_SIZE)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void disk_dedup_get_stats(struct disk_dedup_stats *stats)
+{
+    vdisk_dedup_get_stats(disk_default(), stats);
+}
+
+void vdisk_dedup_get_stats(struct vdisk *d, struct disk_dedup_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (d == NULL || d->dedup == NULL)
+    {
+        return;
+    }
+
+    struct dedup *u = d->dedup;
+
+    pthread_mutex_lock(&u->lock);
+    *stats = u->stats;
+    for (uint32_t i = 0; i < d->nblocks; i++)
+    {
+        stats->blocks += u->map[i] != 0;
+    }
+    stats->stored = d->nblocks - u->nfree;
+    pthread_mutex_unlock(&u->lock);
+}
+
+/*------------------------------------------- HOOKS ---------------------------------------------*/
+
+/**
+ * Frees the tables of u.
+ */
+static void dedup_free(struct dedup *u)
+{
+    disk_free_blocks(u->map);
+    disk_free_blocks(u->hashes);
+    free(u->refs);
+    free(u->free);
+    free(u->buckets);
+    free(u->chain);
+    free(u->map_dirty);
+    free(u->hash_dirty);
+    free(u);
+}
+
+int disk_dedup_attach(struct vdisk *d, int create)
+{
+    struct dedup_header *h = disk_alloc_blocks(1);
+    struct dedup *u = calloc(1, sizeof(struct dedup));
+
+    if (h == NULL || u == NULL)
+    {
+        printf("   ERROR: Could not allocate deduplication tables.\n");
+        disk_free_blocks(h);
+        free(u);
+        return -1;
+    }
+
+    if (create && d->nblocks > DISK_DEDUP_MAX_BLOCKS)
+    {
+        printf("   ERROR: A deduplicated image holds at most %u blocks.\n", DISK_DEDUP_MAX_BLOCKS);
+        disk_free_blocks(h);
+        free(u);
+        return -1;
+    }
+
+    // A new image gets a header; an existing one must have a header of this format.
+    if (create)
+    {
+        memcpy(h->magic, DISK_DEDUP_MAGIC, sizeof(h->magic));
+        h->version = DISK_DEDUP_VERSION;
+        h->block_size = BLOCK_SIZE;
+        h->nblocks = d->nblocks;
+        h->map_blocks = (d->nblocks + MAP_PER_BLOCK - 1) / MAP_PER_BLOCK;
+        h->hash_blocks = (d->nblocks + HASHES_PER_BLOCK - 1) / HASHES_PER_BLOCK;
+    }
+    else if (disk_internal_region(d, 0, 0, h, 1) != 0 || memcmp(h->magic, DISK_DEDUP_MAGIC, sizeof(h->magic)) != 0 ||
+             h->version != DISK_DEDUP_VERSION || h->block_size != BLOCK_SIZE ||
+             h->map_blocks != (h->nblocks + MAP_PER_BLOCK - 1) / MAP_PER_BLOCK ||
+             h->hash_blocks != (h->nblocks + HASHES_PER_BLOCK - 1) / HASHES_PER_BLOCK)
+    {
+        printf("   ERROR: The disk is not a deduplicated image.\n");
+        disk_free_blocks(h);
+        free(u);
+        return -1;
+    }
+
+    uint32_t n = h->nblocks;
+    u->map_blocks = h->map_blocks;
+    u->hash_blocks = h->hash_blocks;
+    u->data = 1 + h->map_blocks + h->hash_blocks;
+    u->mask = 1;
+    while (u->mask < n)
+    {
+        u->mask <<= 1;
+    }
+    u->mask--;
+
+    // Block-aligned, so table blocks go to the image straight from the tables.
+    u->map = n > 0 ? disk_alloc_blocks(u->map_blocks) : NULL;
+    u->hashes = n > 0 ? disk_alloc_blocks(u->hash_blocks) : NULL;
+    u->refs = calloc(n + 1, sizeof(uint32_t));
+    u->free = calloc(n + 1, sizeof(uint32_t));
+    u->buckets = calloc(u->mask + 1, sizeof(uint32_t));
+    u->chain = calloc(n + 1, sizeof(uint32_t));
+    u->map_dirty = calloc(u->map_blocks + 1, 1);
+    u->hash_dirty = calloc(u->hash_blocks + 1, 1);
+
+    if ((n > 0 && (u->map == NULL || u->hashes == NULL)) || u->refs == NULL || u->free == NULL || u->buckets == NULL ||
+        u->chain == NULL || u->map_dirty == NULL || u->hash_dirty == NULL)
+    {
+        printf("   ERROR: Could not allocate deduplication tables.\n");
+        dedup_free(u);
+        disk_free_blocks(h);
+        return -1;
+    }
+
+    // A new image is sized by its header and last index block; the tables between stay sparse.
+    int result;
+    if (create)
+    {
+        result = disk_internal_region(d, 1, 0, h, 1);
+        if (result == 0 && n > 0)
+        {
+            result = disk_internal_region(d, 1, u->data - 1, u->hashes + (size_t)(u->hash_blocks - 1) * HASHES_PER_BLOCK, 1);
+        }
+    }
+    else
+    {
+        result = n > 0 ? disk_internal_region(d, 0, 1, u->map, u->map_blocks) : 0;
+        if (result == 0 && n > 0)
+        {
+            result = disk_internal_region(d, 0, 1 + u->map_blocks, u->hashes, u->hash_blocks);
+        }
+    }
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not %s the deduplication tables.\n", create ? "write" : "read");
+        dedup_free(u);
+        disk_free_blocks(h);
+        return -1;
+    }
+
+    // Count the references from the map, which must all point inside the disk.
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (u->map[i] > n)
+        {
+            printf("   ERROR: Block %u points outside the disk.\n", i);
+            dedup_free(u);
+            disk_free_blocks(h);
+            return -1;
+        }
+
+        if (u->map[i] != 0)
+        {
+            u->refs[u->map[i] - 1]++;
+        }
+    }
+
+    // Index the blocks in use, and stack the free ones so the lowest is handed out first.
+    for (uint32_t p = n; p-- > 0;)
+    {
+        if (u->refs[p] > 0)
+        {
+            index_add(u, p);
+        }
+        else
+        {
+            u->free[u->nfree++] = p;
+        }
+    }
+
+    pthread_mutex_init(&u->lock, NULL);
+    d->nblocks = n;
+    d->dedup = u;
+    disk_free_blocks(h);
+    return 0;
+}
+
+/**
+ * Writes the blocks of a table whose flags are set.
+ *
+ * @param first The first block of the table in the image.
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int flush_table(struct vdisk *d, uint8_t *table, uint8_t *dirty, uint32_t blocks, uint64_t first)
+{
+    for (uint32_t i = 0; i < blocks; i++)
+    {
+        // Clear the flag first: an entry changed during the write sets it again.
+        if (__atomic_exchange_n(&dirty[i], 0, __ATOMIC_ACQ_REL) == 0)
+        {
+            continue;
+        }
+
+        if (disk_internal_region(d, 1, first + i, table + (size_t)i * BLOCK_SIZE, 1) != 0)
+        {
+            __atomic_store_n(&dirty[i], 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int disk_dedup_flush(struct vdisk *d)
+{
+    struct dedup *u = d->dedup;
+
+    if (u == NULL)
+    {
+        return 0;
+    }
+
+    // The index first, so a map entry never reaches the image before the hash of its block.
+    pthread_mutex_lock(&u->lock);
+    int result = flush_table(d, (uint8_t *)u->hashes, u->hash_dirty, u->hash_blocks, 1 + u->map_blocks);
+    if (result == 0)
+    {
+        result = flush_table(d, (uint8_t *)u->map, u->map_dirty, u->map_blocks, 1);
+    }
+    pthread_mutex_unlock(&u->lock);
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not write the deduplication tables.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void disk_dedup_detach(struct vdisk *d)
+{
+    struct dedup *u = d->dedup;
+
+    if (u != NULL)
+    {
+        d->dedup = NULL;
+        pthread_mutex_destroy(&u->lock);
+        dedup_free(u);
+    }
+}
+
+int disk_dedup_run(struct vdisk *d, int write, const struct disk_iovec *iov, int count)
+{
+    struct dedup *u = d->dedup;
+
+    if (write)
+    {
+        int result = 0;
+
+        pthread_mutex_lock(&u->lock);
+        for (int i = 0; i < count && result == 0; i++)
+        {
+            result = write_block(d, iov[i].blocknum, iov[i].buf);
+        }
+        pthread_mutex_unlock(&u->lock);
+
+        return result;
+    }
+
+    // The copy a block points at stays put while its block lock is held, so reads need no lock.
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t entry = __atomic_load_n(&u->map[iov[i].blocknum], __ATOMIC_RELAXED);
+
+        if (entry == 0)
+        {
+            memset(iov[i].buf, 0, BLOCK_SIZE);
+        }
+        else if (physical_io(d, 0, entry - 1, iov[i].buf) != 0)
+        {
+            printf("   ERROR: Could not read physical block %u.\n", entry - 1);
+            return -1;
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+/**
+ * @file disk_dedup.h
+ * @brief This header file contains the declarations of block deduplication.
+ *
+ * A disk created with DISK_DEDUP stores each distinct block once. The image starts with a
+ * header block, a map from every block to the physical block holding its data, and an index
+ * of the content hash of every physical block, followed by the physical blocks. A block
+ * written with data already stored is pointed at the stored copy, and the copy's reference
+ * count goes up; when the last block pointing at a copy is rewritten or released, the copy
+ * is freed for reuse. A block of zeros is not stored at all, and reading it moves nothing.
+ *
+ * Blocks are matched by a 64-bit CRC32C hash, and a match is confirmed by reading the stored
+ * copy and comparing it, so two blocks are never shared unless they are equal. The map and
+ * the index are kept in memory while the disk is open, and written back by disk_flush() and
+ * disk_close(); the reference counts are rebuilt from the map when the disk is opened.
+ *
+ */
+
+#ifndef DISK_DEDUP_H
+#define DISK_DEDUP_H
+
+#include <stdint.h>
+
+#include "disk.h"
+
+#define DISK_DEDUP_MAGIC "RZDEDUP1"
+#define DISK_DEDUP_VERSION 1
+#define DISK_DEDUP_MAX_BLOCKS (UINT32_MAX - 1) // most blocks, as the map holds 32-bit physical block numbers + 1
+
+/**
+ * @brief Counters kept by a deduplicated disk.
+ *
+ * @param blocks The blocks that hold data (not all zeros).
+ * @param stored The physical blocks holding their data.
+ * @param hits The block writes whose data was already stored.
+ * @param verify_reads The stored copies read to confirm a hash match.
+ * @param collisions The hash matches whose data turned out to differ.
+ */
+struct disk_dedup_stats
+{
+    uint64_t blocks;
+    uint64_t stored;
+    uint64_t hits;
+    uint64_t verify_reads;
+    uint64_t collisions;
+};
+
+/**
+ * @brief Releases blocks first..first+count-1 of the default disk, which then read back as
+ * zeros, so that copies no longer in use can be reused.
+ *
+ * Works on any disk, where it writes zeros over the blocks. disk_discard(), which the file
+ * system calls on the blocks it frees, does the same on a deduplicated disk and punches holes
+ * in a flat one.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_dedup_release(uint64_t first, int count);
+
+/**
+ * @brief Copies the counters of the default disk into stats. They are all zero when it was not
+ * opened with DISK_DEDUP.
+ *
+ * @param stats Where to store the counters.
+ */
+void disk_dedup_get_stats(struct disk_dedup_stats *stats);
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+int vdisk_dedup_release(struct vdisk *d, uint64_t first, int count);
+void vdisk_dedup_get_stats(struct vdisk *d, struct disk_dedup_stats *stats);
+
+#endif
\ No newline at end of file
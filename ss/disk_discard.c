@@ -0,0 +1,506 @@
+#define _GNU_SOURCE // FALLOC_FL_PUNCH_HOLE, SEEK_DATA, SEEK_HOLE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "disk_discard.h"
+#include "disk_internal.h"
+
+#define WORDS (DISK_DISCARD_CHUNK / 64) // 64-bit words of bits per chunk
+#define ZERO_RUN 64                     // blocks of zeros written at a time where holes cannot be punched
+
+/**
+ * Stands in for a chunk whose blocks are all holes. Never read or written.
+ */
+static uint64_t all_holes;
+#define ALL_HOLES (&all_holes)
+
+/**
+ * The discard state of one disk.
+ *
+ * @param chunks One entry per DISK_DISCARD_CHUNK blocks: NULL if none of them is a hole,
+ * ALL_HOLES if they all are, or WORDS words with a bit set for each hole. NULL if the disk
+ * keeps no map. Words of bits stay in place until the map is freed, since the threads of the
+ * asynchronous engine may be looking at them.
+ * @param nchunks The number of entries.
+ * @param stats The counters; holes is worked out by vdisk_discard_get_stats().
+ */
+struct discard
+{
+    uint64_t **chunks;
+    uint64_t nchunks;
+    struct disk_discard_stats stats;
+};
+
+/**
+ * Returns the number of blocks of the disk in chunk c.
+ */
+static uint32_t chunk_blocks(struct vdisk *d, uint64_t c)
+{
+    uint64_t rest = d->nblocks - c * DISK_DISCARD_CHUNK;
+    return rest < DISK_DISCARD_CHUNK ? rest : DISK_DISCARD_CHUNK;
+}
+
+/**
+ * Returns the first block after `b` that starts a chunk, or end if it comes first.
+ */
+static uint64_t chunk_stop(uint64_t b, uint64_t end)
+{
+    uint64_t next = (b / DISK_DISCARD_CHUNK + 1) * DISK_DISCARD_CHUNK;
+    return next < end ? next : end;
+}
+
+/**
+ * Replaces the NULL or ALL_HOLES entry `old` of chunk c with words of bits, all clear or all
+ * set to match. Another thread may do the same for another block of the chunk; the first one
+ * wins.
+ *
+ * @return Returns the words now in the entry, or NULL if they could not be allocated.
+ */
+static uint64_t *split_chunk(struct discard *h, uint64_t c, uint64_t *old)
+{
+    uint64_t *bits = malloc(WORDS * sizeof(uint64_t));
+
+    if (bits == NULL)
+    {
+        return NULL;
+    }
+
+    memset(bits, old == ALL_HOLES ? 0xff : 0, WORDS * sizeof(uint64_t));
+    if (!__atomic_compare_exchange_n(&h->chunks[c], &old, bits, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        free(bits);
+        return old;
+    }
+
+    return bits;
+}
+
+/**
+ * Takes blocks first..first+count-1 out of the map. Called with their block locks held.
+ */
+static void fill(struct vdisk *d, struct discard *h, uint64_t first, uint64_t count)
+{
+    uint64_t end = first + count;
+
+    while (first < end)
+    {
+        uint64_t c = first / DISK_DISCARD_CHUNK;
+        uint64_t stop = chunk_stop(first, end);
+        int whole = first == c * DISK_DISCARD_CHUNK && stop - first == chunk_blocks(d, c);
+        uint64_t *bits = __atomic_load_n(&h->chunks[c], __ATOMIC_ACQUIRE);
+
+        if (bits == ALL_HOLES && whole)
+        {
+            __atomic_store_n(&h->chunks[c], NULL, __ATOMIC_RELEASE);
+        }
+        else if (bits != NULL)
+        {
+            // Without memory for the bits, forget the other holes of the chunk: reading them
+            // from the image gives the same zeros.
+            if (bits == ALL_HOLES && (bits = split_chunk(h, c, bits)) == NULL)
+            {
+                __atomic_store_n(&h->chunks[c], NULL, __ATOMIC_RELEASE);
+            }
+
+            for (uint64_t b = first; bits != NULL && b < stop; b++)
+            {
+                uint32_t bit = b % DISK_DISCARD_CHUNK;
+                __atomic_and_fetch(&bits[bit / 64], ~(1ULL << (bit % 64)), __ATOMIC_RELAXED);
+            }
+        }
+
+        first = stop;
+    }
+}
+
+/**
+ * Adds blocks first..first+count-1 to the map. Called with their block locks held.
+ */
+static void mark(struct vdisk *d, struct discard *h, uint64_t first, uint64_t count)
+{
+    uint64_t end = first + count;
+
+    while (first < end)
+    {
+        uint64_t c = first / DISK_DISCARD_CHUNK;
+        uint64_t stop = chunk_stop(first, end);
+        int whole = first == c * DISK_DISCARD_CHUNK && stop - first == chunk_blocks(d, c);
+        uint64_t *bits = __atomic_load_n(&h->chunks[c], __ATOMIC_ACQUIRE);
+
+        if (bits == NULL && whole)
+        {
+            __atomic_store_n(&h->chunks[c], ALL_HOLES, __ATOMIC_RELEASE);
+        }
+        else if (bits != ALL_HOLES)
+        {
+            // Without memory for the bits, the blocks are read from the image as before.
+            if (bits == NULL)
+            {
+                bits = split_chunk(h, c, bits);
+            }
+
+            for (uint64_t b = first; bits != NULL && bits != ALL_HOLES && b < stop; b++)
+            {
+                uint32_t bit = b % DISK_DISCARD_CHUNK;
+                __atomic_or_fetch(&bits[bit / 64], 1ULL << (bit % 64), __ATOMIC_RELAXED);
+            }
+        }
+
+        first = stop;
+    }
+}
+
+/**
+ * Finds the holes of the image by asking the filesystem where its data is. A filesystem that
+ * cannot tell has one extent of data over the whole image.
+ */
+static void scan(struct vdisk *d, struct discard *h)
+{
+    off_t end = (off_t)d->nblocks * BLOCK_SIZE;
+    off_t start = 0;
+
+    for (uint64_t c = 0; c < h->nchunks; c++)
+    {
+        h->chunks[c] = ALL_HOLES;
+    }
+
+    while (start < end)
+    {
+        off_t data = lseek(d->fd, start, SEEK_DATA);
+        if (data < 0)
+        {
+            data = errno == ENXIO ? end : start;
+        }
+        if (data >= end)
+        {
+            break;
+        }
+
+        off_t hole = lseek(d->fd, data, SEEK_HOLE);
+        if (hole < 0 || hole > end)
+        {
+            hole = end;
+        }
+
+        // Round out to whole blocks: a block with any data in it is not a hole.
+        uint64_t first = data / BLOCK_SIZE;
+        uint64_t last = (hole + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        fill(d, h, first, last - first);
+        start = (off_t)last * BLOCK_SIZE;
+    }
+}
+
+/**
+ * Writes zeros over blocks first..first+count-1 through the usual path, for disks whose
+ * blocks are not at their own offsets.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int write_zeros(struct vdisk *d, uint64_t first, uint32_t count)
+{
+    static const uint8_t zeros[BLOCK_SIZE];
+    struct disk_iovec iov[ZERO_RUN];
+
+    for (uint32_t done = 0; done < count; done += ZERO_RUN)
+    {
+        int n = count - done < ZERO_RUN ? count - done : ZERO_RUN;
+
+        for (int i = 0; i < n; i++)
+        {
+            iov[i].blocknum = first + done + i;
+            iov[i].buf = (void *)zeros;
+        }
+
+        if (vdisk_writev(d, iov, n) != n * BLOCK_SIZE)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Punches blocks first..first+count-1 out of a flat image, or writes zeros over them if the
+ * filesystem cannot. Called with their block locks held.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int punch(struct vdisk *d, struct discard *h, uint64_t first, uint32_t count)
+{
+    off_t offset = (off_t)first * BLOCK_SIZE;
+
+    if (fallocate(d->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, (off_t)count * BLOCK_SIZE) == 0)
+    {
+        if (h != NULL)
+        {
+            __atomic_add_fetch(&h->stats.punched, 1, __ATOMIC_RELAXED);
+        }
+        return 0;
+    }
+
+    if (errno != EOPNOTSUPP && errno != ENOSYS)
+    {
+        return -1;
+    }
+
+    // Aligned, for a disk in O_DIRECT mode.
+    uint8_t *zeros = disk_alloc_blocks(ZERO_RUN);
+    int result = zeros != NULL ? 0 : -1;
+
+    for (uint32_t done = 0; done < count && result == 0; done += ZERO_RUN)
+    {
+        uint32_t n = count - done < ZERO_RUN ? count - done : ZERO_RUN;
+        result = disk_internal_region(d, 1, first + done, zeros, n);
+    }
+
+    disk_free_blocks(zeros);
+    return result;
+}
+
+int disk_discard(uint64_t first, int count)
+{
+    return vdisk_discard(disk_default(), first, count);
+}
+
+int vdisk_discard(struct vdisk *d, uint64_t first, int count)
+{
+    static const uint8_t zeros[BLOCK_SIZE];
+
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    if (count < 0 || first > d->nblocks || (uint64_t)count > d->nblocks - first)
+    {
+        printf("   ERROR: Invalid block range.\n");
+        return -1;
+    }
+
+    struct discard *h = d->discard;
+    int result = 0;
+
+    // Only a flat image has its blocks at their own offsets.
+    if (d->comp != NULL || d->dedup != NULL || d->thin != NULL || d->raid != NULL)
+    {
+        result = write_zeros(d, first, count);
+    }
+    else
+    {
+        // The cache and the scheduler must not hand out the old data meanwhile.
+        int locked = d->cache != NULL || d->sched != NULL;
+        if (locked)
+        {
+            disk_internal_lock(d);
+        }
+
+        // One chunk of the map at a time, so that the block locks are not held for long.
+        for (uint64_t b = first; b < first + count && result == 0;)
+        {
+            uint32_t n = chunk_stop(b, first + count) - b;
+
+            // Drop the queued writes of the blocks.
+            for (uint32_t i = 0; i < n && result == 0; i++)
+            {
+                struct disk_iovec iov = {b + i, (void *)zeros};
+                result = disk_sched_settle(d, 1, &iov, 1);
+            }
+
+            disk_internal_lock_blocks(d, 1, b, n);
+
+            result = result == 0 ? punch(d, h, b, n) : result;
+
+            for (uint32_t i = 0; i < n && result == 0 && d->csum != NULL; i++)
+            {
+                disk_checksum_update(d, b + i, zeros);
+            }
+
+            if (result == 0 && h != NULL && h->chunks != NULL)
+            {
+                mark(d, h, b, n);
+            }
+
+            disk_internal_unlock_blocks(d, b, n);
+
+            // Cached copies now hold zeros, clean.
+            for (uint32_t i = 0; i < n && result == 0 && d->cache != NULL; i++)
+            {
+                cache_internal_update(d, b + i, zeros);
+            }
+
+            b += n;
+        }
+
+        if (locked)
+        {
+            disk_internal_unlock(d);
+        }
+    }
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not discard blocks %llu-%llu.\n", (unsigned long long)first,
+               (unsigned long long)(first + count - 1));
+        return -1;
+    }
+
+    if (h != NULL)
+    {
+        __atomic_add_fetch(&h->stats.discarded, count, __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
+
+void disk_discard_get_stats(struct disk_discard_stats *stats)
+{
+    vdisk_discard_get_stats(disk_default(), stats);
+}
+
+void vdisk_discard_get_stats(struct vdisk *d, struct disk_discard_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (d == NULL || d->discard == NULL)
+    {
+        return;
+    }
+
+    struct discard *h = d->discard;
+
+    stats->discarded = __atomic_load_n(&h->stats.discarded, __ATOMIC_RELAXED);
+    stats->punched = __atomic_load_n(&h->stats.punched, __ATOMIC_RELAXED);
+    stats->hole_reads = __atomic_load_n(&h->stats.hole_reads, __ATOMIC_RELAXED);
+
+    // Count the holes, leaving out the bits past the last block.
+    for (uint64_t c = 0; h->chunks != NULL && c < h->nchunks; c++)
+    {
+        uint64_t *bits = __atomic_load_n(&h->chunks[c], __ATOMIC_ACQUIRE);
+        uint32_t blocks = chunk_blocks(d, c);
+
+        if (bits == ALL_HOLES)
+        {
+            stats->holes += blocks;
+            continue;
+        }
+
+        for (uint32_t w = 0; bits != NULL && w * 64 < blocks; w++)
+        {
+            uint64_t word = __atomic_load_n(&bits[w], __ATOMIC_RELAXED);
+            if (blocks - w * 64 < 64)
+            {
+                word &= (1ULL << (blocks - w * 64)) - 1;
+            }
+            stats->holes += __builtin_popcountll(word);
+        }
+    }
+}
+
+/*------------------------------------------- HOOKS ---------------------------------------------*/
+
+int disk_discard_attach(struct vdisk *d, int map)
+{
+    struct discard *h = calloc(1, sizeof(struct discard));
+
+    if (h == NULL)
+    {
+        printf("   ERROR: Could not allocate hole map.\n");
+        return -1;
+    }
+
+    if (map && d->nblocks > 0)
+    {
+        h->nchunks = (d->nblocks + DISK_DISCARD_CHUNK - 1) / DISK_DISCARD_CHUNK;
+        h->chunks = calloc(h->nchunks, sizeof(uint64_t *));
+
+        if (h->chunks == NULL)
+        {
+            printf("   ERROR: Could not allocate hole map.\n");
+            free(h);
+            return -1;
+        }
+
+        scan(d, h);
+    }
+
+    d->discard = h;
+    return 0;
+}
+
+void disk_discard_detach(struct vdisk *d)
+{
+    struct discard *h = d->discard;
+
+    if (h == NULL)
+    {
+        return;
+    }
+
+    for (uint64_t c = 0; h->chunks != NULL && c < h->nchunks; c++)
+    {
+        if (h->chunks[c] != ALL_HOLES)
+        {
+            free(h->chunks[c]);
+        }
+    }
+
+    free(h->chunks);
+    free(h);
+    d->discard = NULL;
+}
+
+int disk_discard_holes(struct vdisk *d, uint64_t first, int count)
+{
+    struct discard *h = d->discard;
+    uint64_t end = first + count;
+
+    if (h == NULL || h->chunks == NULL)
+    {
+        return 0;
+    }
+
+    for (uint64_t b = first; b < end;)
+    {
+        uint64_t c = b / DISK_DISCARD_CHUNK;
+        uint64_t *bits = __atomic_load_n(&h->chunks[c], __ATOMIC_ACQUIRE);
+
+        if (bits == NULL)
+        {
+            return 0;
+        }
+
+        if (bits == ALL_HOLES)
+        {
+            b = chunk_stop(b, end);
+            continue;
+        }
+
+        uint32_t bit = b % DISK_DISCARD_CHUNK;
+        if (!(__atomic_load_n(&bits[bit / 64], __ATOMIC_RELAXED) >> (bit % 64) & 1))
+        {
+            return 0;
+        }
+        b++;
+    }
+
+    __atomic_add_fetch(&h->stats.hole_reads, count, __ATOMIC_RELAXED);
+    return 1;
+}
+
+void disk_discard_fill(struct vdisk *d, uint64_t first, int count)
+{
+    struct discard *h = d->discard;
+
+    if (h != NULL && h->chunks != NULL)
+    {
+        fill(d, h, first, count);
+    }
+}
\ No newline at end of file
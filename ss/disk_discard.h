@@ -0,0 +1,71 @@
+/**
+ * @file disk_discard.h
+ * @brief This header file contains the declarations of block discard (TRIM).
+ *
+ * disk_discard() tells the disk that a range of blocks is no longer in use. On a flat image the
+ * range is punched out of the file with fallocate(FALLOC_FL_PUNCH_HOLE), so the host filesystem
+ * gets the space back and an image with churn stops growing. The blocks read back as zeros.
+ *
+ * A flat image keeps a map of its holes in memory: the blocks discarded, and those never
+ * written, found with SEEK_DATA/SEEK_HOLE when it is opened. A read of blocks that are all holes
+ * fills the buffer with zeros without any I/O, and a write takes its blocks out of the map. The
+ * map has one bit per block, in chunks of DISK_DISCARD_CHUNK blocks that take no memory while
+ * they are all holes or all data.
+ *
+ * Compressed, deduplicated, thin-provisioned, striped and mirrored disks have zeros written over
+ * the range instead, which their maps store without any data. Mapped images are punched, but
+ * read from the mapping as before.
+ *
+ */
+
+#ifndef DISK_DISCARD_H
+#define DISK_DISCARD_H
+
+#include <stdint.h>
+
+#include "disk.h"
+
+#define DISK_DISCARD_CHUNK 32768 // blocks per chunk of the hole map, one block of bits
+
+/**
+ * @brief Counters kept by a disk about its discards and holes.
+ *
+ * @param discarded The blocks discarded.
+ * @param punched The fallocate() calls that punched them out of the image.
+ * @param hole_reads The blocks read as zeros without I/O, since they were holes.
+ * @param holes The blocks that are holes now, or 0 if the disk keeps no map.
+ */
+struct disk_discard_stats
+{
+    uint64_t discarded;
+    uint64_t punched;
+    uint64_t hole_reads;
+    uint64_t holes;
+};
+
+/**
+ * @brief Discards blocks first..first+count-1 of the default disk, which then read back as
+ * zeros. The file system calls this on runs of the data blocks it frees, before clearing them
+ * in its bitmap.
+ *
+ * Copies of the blocks in the cache and the scheduler queue are dropped. A filesystem holding
+ * the image that cannot punch holes has zeros written over them instead.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_discard(uint64_t first, int count);
+
+/**
+ * @brief Copies the counters of the default disk into stats.
+ *
+ * @param stats Where to store the counters.
+ */
+void disk_discard_get_stats(struct disk_discard_stats *stats);
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+int vdisk_discard(struct vdisk *d, uint64_t first, int count);
+void vdisk_discard_get_stats(struct vdisk *d, struct disk_discard_stats *stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,505 @@
+/**
+ * @file disk_internal.h
+ * @brief Internal interface between disk.c and the other modules of the disk layer.
+ *
+ * Nothing here is part of the public disk API. These functions let the asynchronous engine and
+ * the block cache reach the backing file and the block counters of a disk, and let disk.c keep
+ * the cache coherent with transfers that go around it.
+ */
+
+#ifndef DISK_INTERNAL_H
+#define DISK_INTERNAL_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "disk.h"
+#include "disk_stats.h"
+
+struct cache;
+struct async_engine;
+struct model;
+struct trace;
+struct sched;
+struct checksums;
+struct compression;
+struct dedup;
+struct thin;
+struct raid;
+struct discard;
+
+/**
+ * @brief The state of one open disk.
+ *
+ * @param fd The file descriptor of the image.
+ * @param map The mapping of the whole image (DISK_MMAP only), or NULL.
+ * @param nblocks The number of blocks in the disk.
+ * @param direct 1 if fd is in O_DIRECT mode.
+ * @param reads The number of blocks read from the disk.
+ * @param writes The number of blocks written to the disk.
+ * @param cache The block cache, or NULL if it is disabled.
+ * @param async The asynchronous engine, or NULL if it is not running.
+ * @param model The device model, or NULL if none is attached.
+ * @param stats The request statistics.
+ * @param trace The running trace, or NULL.
+ * @param sched The I/O scheduler, or NULL if it is not running.
+ * @param csum The block checksums (DISK_CHECKSUM only), or NULL.
+ * @param comp The translation map of a compressed image (DISK_COMPRESS only), or NULL.
+ * @param dedup The tables of a deduplicated image (DISK_DEDUP only), or NULL.
+ * @param thin The mapping tables of a thin-provisioned image (DISK_THIN only), or NULL.
+ * @param raid The members of a striped or mirrored disk, or NULL. fd is then a duplicate of the
+ * first member present.
+ * @param discard The discard counters, and the hole map of a flat image. NULL for the members of
+ * striped and mirrored disks.
+ * @param stripes The block locks (DISK_THREADSAFE only), or NULL.
+ * @param lock A recursive lock over the cache, the scheduler and the asynchronous engine
+ * (DISK_THREADSAFE only).
+ */
+struct vdisk
+{
+    int fd;
+    uint8_t *map;
+    uint64_t nblocks;
+    int direct;
+    uint64_t reads;
+    uint64_t writes;
+    struct cache *cache;
+    struct async_engine *async;
+    struct model *model;
+    struct disk_stats stats;
+    struct trace *trace;
+    struct sched *sched;
+    struct checksums *csum;
+    struct compression *comp;
+    struct dedup *dedup;
+    struct thin *thin;
+    struct raid *raid;
+    struct discard *discard;
+    pthread_rwlock_t *stripes;
+    pthread_mutex_t lock;
+};
+
+/**
+ * @brief Takes the lock over the cache and the asynchronous engine. Does nothing if d is NULL
+ * or not DISK_THREADSAFE. The lock is recursive.
+ */
+void disk_internal_lock(struct vdisk *d);
+
+/**
+ * @brief Releases disk_internal_lock().
+ */
+void disk_internal_unlock(struct vdisk *d);
+
+/**
+ * @brief Checks a block number and buffer the same way disk_read/disk_write do, printing on failure.
+ *
+ * @return int Returns 0 if both are valid, -1 otherwise.
+ */
+int disk_internal_check(struct vdisk *d, uint64_t blocknum, const void *buf);
+
+/**
+ * @brief Moves one checked block between the image and buf, and counts it. Bypasses the cache.
+ *
+ * @param write 1 to write the block, 0 to read it.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_internal_io(struct vdisk *d, int write, uint64_t blocknum, void *buf);
+
+/**
+ * @brief Moves a checked block list like disk_readv/disk_writev, and counts it. Bypasses the cache.
+ *
+ * @param write 1 to write the blocks, 0 to read them.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_internal_iov(struct vdisk *d, int write, const struct disk_iovec *iov, int count);
+
+/**
+ * @brief Moves one whole block between the image and buf with pread/pwrite, without counting it.
+ *
+ * Safe to call from any thread. Takes the block lock on a DISK_THREADSAFE disk.
+ *
+ * @param write 1 to write the block, 0 to read it.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_internal_pio(struct vdisk *d, int write, uint64_t blocknum, void *buf);
+
+/**
+ * @brief Moves count blocks at blocknum with pread/pwrite, without range checks, locks,
+ * counters or checksums. For the regions the disk layer keeps after the last block.
+ *
+ * @param buf At least count blocks, aligned as from disk_alloc_blocks().
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_internal_region(struct vdisk *d, int write, uint64_t blocknum, void *buf, int count);
+
+/**
+ * @brief Moves size bytes at a byte offset of the image with pread/pwrite, like
+ * disk_internal_region(). For the variable-size extents of a compressed image, and the
+ * physical blocks of a deduplicated one.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_internal_extent(struct vdisk *d, int write, uint64_t offset, void *buf, size_t size);
+
+/**
+ * @brief Moves the whole blocks of iov between their buffers and the count blocks at a byte
+ * offset of the image, with as few preadv/pwritev as it takes. The block numbers in iov are
+ * not used. For runs of blocks stored together away from their own offsets.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_internal_extentv(struct vdisk *d, int write, uint64_t offset, const struct disk_iovec *iov, int count);
+
+/**
+ * @brief Moves a run of buffers at a byte offset of any descriptor with as few preadv/pwritev
+ * as it takes, retrying on short transfers. The iovec array is consumed in the process. For
+ * the member images of a striped disk.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_internal_fdv(int fd, int write, struct iovec *vec, int count, uint64_t offset);
+
+/**
+ * @brief Wraps the open image fd of nblocks blocks in a new disk, as vdisk_open() does once it
+ * has sized the image. Closes the descriptor on failure.
+ *
+ * @return struct vdisk* Returns the disk, or NULL on failure.
+ */
+struct vdisk *disk_internal_attach(int fd, uint64_t nblocks, int flags);
+
+/**
+ * @brief Takes the block locks of blocks first..first+count-1, shared to read and exclusive to
+ * write, as transfers do. Does nothing unless the disk is DISK_THREADSAFE.
+ */
+void disk_internal_lock_blocks(struct vdisk *d, int write, uint64_t first, int count);
+
+/**
+ * @brief Releases disk_internal_lock_blocks().
+ */
+void disk_internal_unlock_blocks(struct vdisk *d, uint64_t first, int count);
+
+/**
+ * @brief Adds one completed request to the Reads/Writes counters, and charges it to the device model.
+ *
+ * @param write 1 to count writes, 0 to count reads.
+ * @param blocknum The first block of the request.
+ * @param blocks The number of contiguous blocks transferred.
+ */
+void disk_internal_account(struct vdisk *d, int write, uint64_t blocknum, int blocks);
+
+/*----------------------------------------- CACHE HOOKS -----------------------------------------*/
+
+/**
+ * @brief Reads a checked block through the cache.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int cache_read(struct vdisk *d, uint64_t blocknum, void *buf);
+
+/**
+ * @brief Writes a checked block into the cache, leaving it dirty.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int cache_write(struct vdisk *d, uint64_t blocknum, void *buf);
+
+/**
+ * @brief Called after buf was written to the image around the cache: refreshes a cached copy.
+ */
+void cache_internal_update(struct vdisk *d, uint64_t blocknum, const void *buf);
+
+/**
+ * @brief Called after the image was read into buf around the cache: applies a dirty cached copy.
+ */
+void cache_internal_overlay(struct vdisk *d, uint64_t blocknum, void *buf);
+
+/**
+ * @brief Writes the block back now if it is dirty in the cache.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int cache_internal_writeback(struct vdisk *d, uint64_t blocknum);
+
+/**
+ * @brief Starts asynchronous reads of blocks first..first+count-1 into cache slots.
+ *
+ * Blocks already cached are skipped, and each run of missing blocks is read with one request.
+ * Needs the asynchronous engine. A later cache_read of a block waits for its read to land.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int cache_prefetch(struct vdisk *d, uint64_t first, int count);
+
+/**
+ * @brief Returns 1 if the block is in the cache and not still being prefetched, 0 otherwise.
+ */
+int cache_contains(struct vdisk *d, uint64_t blocknum);
+
+/*----------------------------------------- MODEL HOOKS -----------------------------------------*/
+
+/**
+ * @brief Charges one physical request to the device model of d, if it has one.
+ *
+ * Adds the cost to the simulated clock, and sleeps for it when the model asks to.
+ */
+void disk_model_charge(struct vdisk *d, int write, uint64_t blocknum, int blocks);
+
+/**
+ * @brief Charges one physical request of `bytes` at byte `offset` of the image, for requests
+ * that are not whole blocks at their own place.
+ */
+void disk_model_charge_bytes(struct vdisk *d, int write, uint64_t offset, uint64_t bytes);
+
+/*----------------------------------------- STATS HOOKS -----------------------------------------*/
+
+/**
+ * @brief Returns the monotonic clock in nanoseconds, the start time disk_stats_record() expects.
+ */
+uint64_t disk_stats_now();
+
+/**
+ * @brief Adds one successful request to the latency histogram of d. Safe to call from any thread.
+ *
+ * @param write 1 for a write, 0 for a read.
+ * @param start_ns The disk_stats_now() of when the request was made.
+ * @param bytes The bytes it moved.
+ */
+void disk_stats_record(struct vdisk *d, int write, uint64_t start_ns, uint64_t bytes);
+
+/**
+ * @brief Adds a run of requested blocks to the heatmap of d. Safe to call from any thread.
+ *
+ * @param write 1 for a write, 0 for a read.
+ */
+void disk_stats_touch(struct vdisk *d, int write, uint64_t blocknum, int blocks);
+
+/*----------------------------------------- TRACE HOOKS -----------------------------------------*/
+
+/**
+ * @brief Appends a completed request to the running trace of d. Does nothing if there is none.
+ *
+ * @param write 1 for a write, 0 for a read.
+ * @param start_ns The disk_stats_now() of when the request was made.
+ * @param iov The blocks of the request, in the order they were given.
+ * @param count The number of entries in iov.
+ * @param async 1 if the request was made through the asynchronous engine.
+ */
+void disk_trace_record(struct vdisk *d, int write, uint64_t start_ns, const struct disk_iovec *iov, int count, int async);
+
+/*--------------------------------------- SCHEDULER HOOKS ---------------------------------------*/
+
+/* All of these need the disk lock held, and do nothing when the scheduler is not running. */
+
+/**
+ * @brief Queues a checked block write.
+ *
+ * @return int Returns 1 if the write was queued, 0 if there is no scheduler, -1 on failure.
+ */
+int disk_sched_write(struct vdisk *d, uint64_t blocknum, const void *buf);
+
+/**
+ * @brief Answers a checked block read from the queue.
+ *
+ * @return int Returns 1 if the block was queued and copied to buf, 0 if it must be read from
+ * the image, -1 on failure.
+ */
+int disk_sched_read(struct vdisk *d, uint64_t blocknum, void *buf);
+
+/**
+ * @brief Called before blocks are moved around the scheduler: a write drops the queued copies
+ * it supersedes, and a read of a queued block writes out the queue first.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_sched_settle(struct vdisk *d, int write, const struct disk_iovec *iov, int count);
+
+/**
+ * @brief Called after blocks were read around the scheduler: applies the queued writes to them.
+ */
+void disk_sched_overlay(struct vdisk *d, const struct disk_iovec *iov, int count);
+
+/*--------------------------------------- CHECKSUM HOOKS ----------------------------------------*/
+
+/**
+ * @brief Loads the checksum region of a DISK_CHECKSUM disk whose nblocks is set.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_checksum_attach(struct vdisk *d);
+
+/**
+ * @brief Writes the changed checksums back to the region.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_checksum_flush(struct vdisk *d);
+
+/**
+ * @brief Frees the checksums without writing them back.
+ */
+void disk_checksum_detach(struct vdisk *d);
+
+/**
+ * @brief Records the checksum of a block just written. Called with the block lock held.
+ */
+void disk_checksum_update(struct vdisk *d, uint64_t blocknum, const void *buf);
+
+/**
+ * @brief Checks a block just read against its checksum, printing on a mismatch. Called with
+ * the block lock held.
+ *
+ * @return int Returns 0 if the block matches or d has no checksums, -1 otherwise.
+ */
+int disk_checksum_verify(struct vdisk *d, uint64_t blocknum, const void *buf);
+
+/*-------------------------------------- COMPRESSION HOOKS --------------------------------------*/
+
+/**
+ * @brief Sets up the translation map of a DISK_COMPRESS disk. A new image gets an empty map
+ * for d->nblocks blocks; an existing one is read back, and sets d->nblocks from its header.
+ *
+ * @param create 1 for a new image, 0 to open an existing one.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_compress_attach(struct vdisk *d, int create);
+
+/**
+ * @brief Writes the changed parts of the map and the header back to the image.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_compress_flush(struct vdisk *d);
+
+/**
+ * @brief Frees the map without writing it back.
+ */
+void disk_compress_detach(struct vdisk *d);
+
+/**
+ * @brief Moves the blocks of a run of contiguous entries, compressing them on the way out and
+ * decompressing them on the way in. Called with their block locks held.
+ *
+ * @param write 1 to write the blocks, 0 to read them.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_compress_run(struct vdisk *d, int write, const struct disk_iovec *iov, int count);
+
+/*----------------------------------------- DEDUP HOOKS -----------------------------------------*/
+
+/**
+ * @brief Sets up the tables of a DISK_DEDUP disk. A new image gets empty tables for d->nblocks
+ * blocks; an existing one is read back, and sets d->nblocks from its header.
+ *
+ * @param create 1 for a new image, 0 to open an existing one.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_dedup_attach(struct vdisk *d, int create);
+
+/**
+ * @brief Writes the changed parts of the hash index and the map back to the image.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_dedup_flush(struct vdisk *d);
+
+/**
+ * @brief Frees the tables without writing them back.
+ */
+void disk_dedup_detach(struct vdisk *d);
+
+/**
+ * @brief Moves the blocks of a run of entries through the map, sharing the copies of blocks
+ * written with data already stored. Called with their block locks held.
+ *
+ * @param write 1 to write the blocks, 0 to read them.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_dedup_run(struct vdisk *d, int write, const struct disk_iovec *iov, int count);
+
+/*----------------------------------------- THIN HOOKS ------------------------------------------*/
+
+/**
+ * @brief Sets up the mapping tables of a DISK_THIN disk. A new image gets an empty L1 table for
+ * d->nblocks blocks; an existing one has its tables read back, and sets d->nblocks from its header.
+ *
+ * @param create 1 for a new image, 0 to open an existing one.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_thin_attach(struct vdisk *d, int create);
+
+/**
+ * @brief Writes the changed L2 tables, L1 blocks and header back to the image.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_thin_flush(struct vdisk *d);
+
+/**
+ * @brief Frees the tables without writing them back.
+ */
+void disk_thin_detach(struct vdisk *d);
+
+/**
+ * @brief Moves the blocks of a run of entries to or from where the tables store them, storing
+ * blocks written for the first time at the end of the image. Called with their block locks held.
+ *
+ * @param write 1 to write the blocks, 0 to read them.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_thin_run(struct vdisk *d, int write, const struct disk_iovec *iov, int count);
+
+/*----------------------------------------- RAID HOOKS ------------------------------------------*/
+
+/**
+ * @brief Flushes every member of a striped or mirrored disk, and clears the write-intent
+ * bitmap of a mirror whose members are all up to date.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_raid_flush(struct vdisk *d);
+
+/**
+ * @brief Marks a mirror closed, stops the member threads and closes the members.
+ */
+void disk_raid_detach(struct vdisk *d);
+
+/**
+ * @brief Moves the blocks of a run of contiguous entries to or from the members holding them,
+ * each member's part in parallel: the members of a striped disk holding them, every member of
+ * a mirror for a write, or the least busy ones for a read. Called with their block locks held.
+ *
+ * @param write 1 to write the blocks, 0 to read them.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_raid_run(struct vdisk *d, int write, const struct disk_iovec *iov, int count);
+
+/*--------------------------------------- DISCARD HOOKS -----------------------------------------*/
+
+/**
+ * @brief Sets up the discard counters of a disk, and with `map` the hole map of a flat image,
+ * from where the filesystem holding it has data.
+ *
+ * @param map 1 to keep a hole map, 0 otherwise.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_discard_attach(struct vdisk *d, int map);
+
+/**
+ * @brief Frees the counters and the hole map.
+ */
+void disk_discard_detach(struct vdisk *d);
+
+/**
+ * @brief Returns 1 if blocks first..first+count-1 are all holes, which read back as zeros, and
+ * counts them; 0 otherwise, or if d keeps no hole map. Called with their block locks held.
+ */
+int disk_discard_holes(struct vdisk *d, uint64_t first, int count);
+
+/**
+ * @brief Takes blocks about to be written out of the hole map. Called with their block locks
+ * held, or before io_uring writes them.
+ */
+void disk_discard_fill(struct vdisk *d, uint64_t first, int count);
+
+#endif
\ No newline at end of file
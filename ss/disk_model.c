@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+
+#include "disk_model.h"
+#include "disk_internal.h"
+
+/**
+ * The model attached to one disk.
+ *
+ * @param params The device parameters.
+ * @param stats The counters and the simulated clock.
+ * @param head The byte the previous request ended at, where a sequential request starts.
+ */
+struct model
+{
+    struct disk_model params;
+    struct disk_model_stats stats;
+    uint64_t head;
+};
+
+int disk_model_preset(int profile, struct disk_model *model)
+{
+    memset(model, 0, sizeof(*model));
+
+    if (profile == DISK_MODEL_HDD)
+    {
+        model->request_ns = 20000;      // 20 us of command overhead
+        model->seek_min_ns = 800000;    // 0.8 ms track to track
+        model->seek_max_ns = 16000000;  // 16 ms full stroke, about 8.5 ms on average
+        model->rpm = 7200;              // 4.2 ms average rotational delay
+        model->bandwidth = 150000000;   // 150 MB/s
+        return 0;
+    }
+
+    if (profile == DISK_MODEL_SSD)
+    {
+        model->request_ns = 5000;       // 5 us of command overhead
+        model->read_ns = 80000;         // 80 us to read a page
+        model->write_ns = 25000;        // 25 us into the drive's write buffer
+        model->bandwidth = 500000000;   // 500 MB/s, the SATA limit
+        return 0;
+    }
+
+    printf("   ERROR: Unknown device profile %d.\n", profile);
+    return -1;
+}
+
+int disk_model_init(const struct disk_model *model)
+{
+    return vdisk_model_init(disk_default(), model);
+}
+
+int vdisk_model_init(struct vdisk *d, const struct disk_model *model)
+{
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    struct model *m = calloc(1, sizeof(struct model));
+    if (m == NULL)
+    {
+        printf("   ERROR: Could not allocate device model.\n");
+        return -1;
+    }
+
+    m->params = *model;
+
+    disk_internal_lock(d);
+    struct model *old = d->model;
+    d->model = m;
+    disk_internal_unlock(d);
+
+    free(old);
+    return 0;
+}
+
+void disk_model_get_stats(struct disk_model_stats *stats)
+{
+    vdisk_model_get_stats(disk_default(), stats);
+}
+
+void vdisk_model_get_stats(struct vdisk *d, struct disk_model_stats *stats)
+{
+    disk_internal_lock(d);
+    if (d != NULL && d->model != NULL)
+    {
+        *stats = d->model->stats;
+    }
+    else
+    {
+        memset(stats, 0, sizeof(*stats));
+    }
+    disk_internal_unlock(d);
+}
+
+void disk_model_close()
+{
+    vdisk_model_close(disk_default());
+}
+
+void vdisk_model_close(struct vdisk *d)
+{
+    if (d == NULL)
+    {
+        return;
+    }
+
+    disk_internal_lock(d);
+    struct model *m = d->model;
+    d->model = NULL;
+    disk_internal_unlock(d);
+
+    free(m);
+}
+
+/**
+ * Returns what one request of `bytes` at byte `offset` costs on the modelled device, and moves
+ * the head past it. `size` is the size of the device in bytes.
+ */
+static uint64_t request_cost(struct model *m, uint64_t size, int write, uint64_t offset, uint64_t bytes)
+{
+    const struct disk_model *p = &m->params;
+    uint64_t cost = p->request_ns + (write ? p->write_ns : p->read_ns);
+
+    // Anything but the byte after the previous request moves the arm and waits for the platter,
+    // unless the request is a short way ahead and it is quicker to let the gap pass under the head.
+    if (offset != m->head)
+    {
+        uint64_t distance = offset > m->head ? offset - m->head : m->head - offset;
+        uint64_t seek = 0;
+
+        if (p->seek_max_ns > 0 && size > 0)
+        {
+            double fraction = sqrt((double)distance / size);
+            seek += p->seek_min_ns + (uint64_t)((p->seek_max_ns - p->seek_min_ns) * (fraction < 1 ? fraction : 1));
+        }
+
+        if (p->rpm > 0)
+        {
+            seek += 60000000000ull / p->rpm / 2;
+        }
+
+        uint64_t skip = UINT64_MAX;
+        if (offset > m->head && p->bandwidth > 0)
+        {
+            skip = distance * 1000000000ull / p->bandwidth;
+        }
+
+        if (skip < seek)
+        {
+            cost += skip;
+        }
+        else if (seek > 0)
+        {
+            cost += seek;
+            m->stats.seeks++;
+        }
+    }
+
+    if (p->bandwidth > 0)
+    {
+        cost += bytes * 1000000000ull / p->bandwidth;
+    }
+
+    m->head = offset + bytes;
+    return cost;
+}
+
+/*------------------------------------------- HOOKS ---------------------------------------------*/
+
+void disk_model_charge(struct vdisk *d, int write, uint64_t blocknum, int blocks)
+{
+    disk_model_charge_bytes(d, write, (uint64_t)blocknum * BLOCK_SIZE, (uint64_t)blocks * BLOCK_SIZE);
+}
+
+void disk_model_charge_bytes(struct vdisk *d, int write, uint64_t offset, uint64_t bytes)
+{
+    disk_internal_lock(d);
+    struct model *m = d->model;
+    uint64_t cost = 0;
+    int sleep = 0;
+
+    if (m != NULL)
+    {
+        cost = request_cost(m, (uint64_t)d->nblocks * BLOCK_SIZE, write, offset, bytes);
+        sleep = m->params.sleep;
+        m->stats.elapsed_ns += cost;
+        m->stats.requests++;
+    }
+    disk_internal_unlock(d);
+
+    // Sleep outside the lock, so that other threads can queue their own requests meanwhile.
+    if (sleep && cost > 0)
+    {
+        struct timespec ts = {cost / 1000000000, cost % 1000000000};
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        {
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+/**
+ * @file disk_model.h
+ * @brief This header file contains the declarations of the device performance model.
+ *
+ * The image file answers every request in about the same time, wherever the block is. With a
+ * model attached, each physical request (a block read or written, a vectored run, an
+ * asynchronous request) is charged what it would cost on a real device: a fixed per-request
+ * overhead, a flat access latency, a seek and rotational delay on a disk arm, and the transfer
+ * time at the media bandwidth. The cost is added to a simulated clock, and can also be slept
+ * so that wall-clock benchmarks see it. Cache hits cost nothing, since they never reach the
+ * device.
+ *
+ */
+
+#ifndef DISK_MODEL_H
+#define DISK_MODEL_H
+
+#include <stdint.h>
+
+#include "disk.h"
+
+/* Profiles for disk_model_preset(). */
+#define DISK_MODEL_HDD 1 // 7200 rpm hard disk
+#define DISK_MODEL_SSD 2 // SATA solid state disk
+
+/**
+ * @brief The parameters of a modelled device. Zero disables a term.
+ *
+ * @param request_ns The fixed cost of every request (command and controller overhead).
+ * @param read_ns The flat access latency of a read, as on an SSD.
+ * @param write_ns The flat access latency of a write.
+ * @param seek_min_ns The seek to a neighbouring track, paid by any request that moves the arm.
+ * @param seek_max_ns The seek across the whole disk. Seeks in between grow with the square root
+ * of the distance.
+ * @param rpm The spindle speed. A request that moves the arm waits half a rotation on average.
+ * A request a short way past the previous one is charged the time for the gap to pass under
+ * the head instead, when that is less than a seek.
+ * @param bandwidth The media transfer rate in bytes per second.
+ * @param sleep 1 to sleep for the cost of each request, 0 to only add it to the simulated clock.
+ */
+struct disk_model
+{
+    uint64_t request_ns;
+    uint64_t read_ns;
+    uint64_t write_ns;
+    uint64_t seek_min_ns;
+    uint64_t seek_max_ns;
+    uint32_t rpm;
+    uint64_t bandwidth;
+    int sleep;
+};
+
+/**
+ * @brief Counters kept by the model.
+ *
+ * @param elapsed_ns The simulated time spent by the device.
+ * @param requests The physical requests charged.
+ * @param seeks The requests that moved the arm.
+ */
+struct disk_model_stats
+{
+    uint64_t elapsed_ns;
+    uint64_t requests;
+    uint64_t seeks;
+};
+
+/**
+ * @brief Fills model with the parameters of a typical device. The model only accumulates time.
+ *
+ * @param profile DISK_MODEL_HDD or DISK_MODEL_SSD.
+ * @param model Where to store the parameters.
+ * @return int Returns 0 on success, -1 if the profile is unknown.
+ */
+int disk_model_preset(int profile, struct disk_model *model);
+
+/**
+ * @brief Attaches a device model to the default disk, replacing any previous one.
+ *
+ * The simulated clock starts at zero. disk_close() reports the simulated time in its log.
+ *
+ * @param model The parameters, which are copied.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_model_init(const struct disk_model *model);
+
+/**
+ * @brief Copies the model counters into stats. They are all zero when no model is attached.
+ *
+ * @param stats Where to store the counters.
+ */
+void disk_model_get_stats(struct disk_model_stats *stats);
+
+/**
+ * @brief Detaches the model. Called by disk_close().
+ */
+void disk_model_close();
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+int vdisk_model_init(struct vdisk *d, const struct disk_model *model);
+void vdisk_model_get_stats(struct vdisk *d, struct disk_model_stats *stats);
+void vdisk_model_close(struct vdisk *d);
+
+#endif
\ No newline at end of file
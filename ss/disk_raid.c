@@ -0,0 +1,1508 @@
+#define _GNU_SOURCE // writer-preferring rwlocks
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "disk_raid.h"
+#include "disk_internal.h"
+
+#define RUN 256        // blocks split across the members at a time
+#define VECS (2 * RUN) // iovecs a mirrored write shares out between its members
+#define SPLIT 32       // fewest blocks of a mirrored read split between members
+#define IN_SYNC 0      // a member holding every block
+#define FAILED 1       // a member dropped or missing, which gets no I/O
+#define RECOVERING 2   // a member being resynced, which gets writes but no reads
+
+/**
+ * The header in the first block of every member image.
+ *
+ * @param magic DISK_RAID_MAGIC.
+ * @param version DISK_RAID_VERSION.
+ * @param block_size BLOCK_SIZE.
+ * @param level The RAID level of the set, 0 or 1.
+ * @param members The number of members of the set.
+ * @param index The place of this member in the set.
+ * @param stripe_unit The blocks per stripe unit, or 0 for a mirror.
+ * @param nblocks The low 32 bits of the number of blocks of the disk.
+ * @param bitmap_blocks The blocks of the write-intent bitmap that follows the header of a
+ * mirror, or 0.
+ * @param set_id A number drawn when the set was created, the same in every member.
+ * @param events Bumped on every member up to date each time a member is dropped or resynced,
+ * so a member that fell behind has fewer. 0 while a new member is being filled.
+ * @param degraded_at The events when the first of the members now missing was dropped. The
+ * bitmap has not been cleared since, so it covers what a member with at least as many missed.
+ * @param clean 1 if the disk was closed, 0 while it is open.
+ * @param nblocks_hi The high 32 bits of the number of blocks (version 2), 0 in version 1.
+ */
+struct raid_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t level;
+    uint32_t members;
+    uint32_t index;
+    uint32_t stripe_unit;
+    uint32_t nblocks;
+    uint32_t bitmap_blocks;
+    uint64_t set_id;
+    uint64_t events;
+    uint64_t degraded_at;
+    uint32_t clean;
+    uint32_t nblocks_hi;
+};
+
+/**
+ * Returns the number of blocks of the disk a header describes.
+ */
+static uint64_t header_blocks(const struct raid_header *header)
+{
+    return (uint64_t)header->nblocks_hi << 32 | header->nblocks;
+}
+
+struct raid_batch;
+
+/**
+ * One member's part of a run: a single preadv/pwritev at a byte offset of the member.
+ */
+struct raid_job
+{
+    struct iovec *vec;
+    int count;
+    uint64_t offset;
+    int write;
+    int member;
+    int result;
+    struct raid_batch *batch; // the run it belongs to
+    struct raid_job *next;    // next job queued on the member
+};
+
+/**
+ * The jobs of one run handed to member threads, which the calling thread waits for.
+ */
+struct raid_batch
+{
+    pthread_mutex_t lock;
+    pthread_cond_t done; // signalled when pending drops to 0
+    int pending;
+};
+
+/**
+ * One member image and the thread moving its parts of runs.
+ *
+ * @param fd The image, or -1 if it is missing.
+ * @param state IN_SYNC, FAILED or RECOVERING.
+ * @param inflight The jobs it has in hand, which mirrored reads keep low.
+ * @param next_block The block after the last one read from it.
+ */
+struct raid_member
+{
+    int fd;
+    int state;
+    uint32_t inflight;
+    uint64_t next_block;
+    pthread_t thread;
+    int started;
+    pthread_mutex_t lock;
+    pthread_cond_t work; // signalled when a job is queued or on shutdown
+    struct raid_job *head, *tail;
+    int stop;
+};
+
+/**
+ * The members of one striped or mirrored disk.
+ *
+ * @param count The number of members.
+ * @param level 0 or 1.
+ * @param unit The blocks per stripe unit, or 0 for a mirror.
+ * @param nblocks The number of blocks of the disk.
+ * @param data_start The blocks before the first data block of every member.
+ * @param set_id, events, degraded_at, clean As in the header.
+ * @param bitmap The write-intent bitmap of a mirror, laid out as in the image, or NULL.
+ * @param bitmap_blocks The blocks of the bitmap.
+ * @param regions The number of bits of the bitmap in use.
+ * @param members The members, in their order in the set.
+ * @param lock Serializes the member states, the headers and the setting of bits.
+ * @param io_lock Held shared by runs, and exclusively by resyncs and the clearing of bits.
+ * @param stats The counters; level, members and stripe_unit are set once.
+ */
+struct raid
+{
+    int count;
+    int level;
+    uint32_t unit;
+    uint64_t nblocks;
+    uint32_t data_start;
+    uint64_t set_id;
+    uint64_t events;
+    uint64_t degraded_at;
+    uint32_t clean;
+    uint8_t *bitmap;
+    uint32_t bitmap_blocks;
+    uint64_t regions;
+    struct raid_member members[DISK_RAID_MAX_MEMBERS];
+    pthread_mutex_t lock;
+    pthread_rwlock_t io_lock;
+    struct disk_raid_stats stats;
+};
+
+/**
+ * Finds the member holding a block of a striped disk, and the block's place among that
+ * member's blocks. The units of a member follow each other, so a run of blocks is one extent
+ * on each member.
+ */
+static void locate(struct raid *r, uint64_t blocknum, int *member, uint64_t *local)
+{
+    uint64_t unit = blocknum / r->unit;
+
+    *member = unit % r->count;
+    *local = unit / r->count * r->unit + blocknum % r->unit;
+}
+
+static void *member_worker(void *arg)
+{
+    struct raid_member *m = arg;
+
+    pthread_mutex_lock(&m->lock);
+    while (1)
+    {
+        while (m->head == NULL && !m->stop)
+        {
+            pthread_cond_wait(&m->work, &m->lock);
+        }
+
+        if (m->head == NULL)
+        {
+            break;
+        }
+
+        // Take the oldest job.
+        struct raid_job *job = m->head;
+        m->head = job->next;
+        if (m->head == NULL)
+        {
+            m->tail = NULL;
+        }
+
+        // Do the I/O without holding the lock.
+        pthread_mutex_unlock(&m->lock);
+        job->result = disk_internal_fdv(m->fd, job->write, job->vec, job->count, job->offset);
+
+        // Hand it back to the calling thread, which may free the batch as soon as it is done.
+        struct raid_batch *batch = job->batch;
+        pthread_mutex_lock(&batch->lock);
+        if (--batch->pending == 0)
+        {
+            pthread_cond_signal(&batch->done);
+        }
+        pthread_mutex_unlock(&batch->lock);
+
+        pthread_mutex_lock(&m->lock);
+    }
+    pthread_mutex_unlock(&m->lock);
+
+    return NULL;
+}
+
+static void queue_job(struct raid_member *m, struct raid_job *job)
+{
+    job->next = NULL;
+
+    pthread_mutex_lock(&m->lock);
+    if (m->tail != NULL)
+    {
+        m->tail->next = job;
+    }
+    else
+    {
+        m->head = job;
+    }
+    m->tail = job;
+    pthread_cond_signal(&m->work);
+    pthread_mutex_unlock(&m->lock);
+}
+
+/**
+ * Runs the jobs of a run, each on its member: the first one on the calling thread, the others
+ * on their members' threads. Leaves the outcome of each in its result.
+ */
+static void run_jobs(struct raid *r, struct raid_job *jobs, int njobs)
+{
+    for (int j = 0; j < njobs; j++)
+    {
+        __atomic_add_fetch(&r->members[jobs[j].member].inflight, 1, __ATOMIC_RELAXED);
+    }
+
+    if (njobs > 1)
+    {
+        struct raid_batch batch;
+        pthread_mutex_init(&batch.lock, NULL);
+        pthread_cond_init(&batch.done, NULL);
+        batch.pending = njobs - 1;
+
+        for (int j = 1; j < njobs; j++)
+        {
+            jobs[j].batch = &batch;
+            queue_job(&r->members[jobs[j].member], &jobs[j]);
+        }
+
+        // Move the first part meanwhile.
+        jobs[0].result = disk_internal_fdv(r->members[jobs[0].member].fd, jobs[0].write, jobs[0].vec, jobs[0].count,
+                                           jobs[0].offset);
+
+        pthread_mutex_lock(&batch.lock);
+        while (batch.pending > 0)
+        {
+            pthread_cond_wait(&batch.done, &batch.lock);
+        }
+        pthread_mutex_unlock(&batch.lock);
+
+        pthread_cond_destroy(&batch.done);
+        pthread_mutex_destroy(&batch.lock);
+
+        __atomic_add_fetch(&r->stats.split, 1, __ATOMIC_RELAXED);
+    }
+    else if (njobs == 1)
+    {
+        jobs[0].result = disk_internal_fdv(r->members[jobs[0].member].fd, jobs[0].write, jobs[0].vec, jobs[0].count,
+                                           jobs[0].offset);
+    }
+
+    for (int j = 0; j < njobs; j++)
+    {
+        __atomic_sub_fetch(&r->members[jobs[j].member].inflight, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&r->stats.member_blocks[jobs[j].member], jobs[j].count, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Writes the header of member `index` to fd, with the given events.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int write_header(struct raid *r, int fd, int index, uint64_t events)
+{
+    uint8_t block[BLOCK_SIZE];
+    struct raid_header *header = (struct raid_header *)block;
+    struct iovec vec = {block, BLOCK_SIZE};
+
+    memset(block, 0, sizeof(block));
+    memcpy(header->magic, DISK_RAID_MAGIC, sizeof(header->magic));
+    header->version = DISK_RAID_VERSION;
+    header->block_size = BLOCK_SIZE;
+    header->level = r->level;
+    header->members = r->count;
+    header->index = index;
+    header->stripe_unit = r->unit;
+    header->nblocks = (uint32_t)r->nblocks;
+    header->nblocks_hi = (uint32_t)(r->nblocks >> 32);
+    header->bitmap_blocks = r->bitmap_blocks;
+    header->set_id = r->set_id;
+    header->events = events;
+    header->degraded_at = r->degraded_at;
+    header->clean = r->clean;
+
+    return disk_internal_fdv(fd, 1, &vec, 1, 0) == 0 && fdatasync(fd) == 0 ? 0 : -1;
+}
+
+/**
+ * Returns the number of members in the given state.
+ */
+static int count_state(struct raid *r, int state)
+{
+    int count = 0;
+
+    for (int i = 0; i < r->count; i++)
+    {
+        count += r->members[i].state == state;
+    }
+
+    return count;
+}
+
+/**
+ * Drops a member, and records it in the headers of the others. Called with the lock held.
+ */
+static void fail_locked(struct raid *r, int member)
+{
+    if (r->members[member].state == FAILED)
+    {
+        return;
+    }
+
+    // The first member to go starts the period the bitmap keeps track of.
+    if (count_state(r, IN_SYNC) == r->count)
+    {
+        r->degraded_at = r->events;
+    }
+
+    __atomic_store_n(&r->members[member].state, FAILED, __ATOMIC_RELAXED);
+    r->events++;
+
+    for (int i = 0; i < r->count; i++)
+    {
+        if (r->members[i].state != FAILED && write_header(r, r->members[i].fd, i, r->events) != 0)
+        {
+            printf("   ERROR: Could not write to member %d, the disk carries on without it.\n", i);
+            fail_locked(r, i);
+            return;
+        }
+    }
+}
+
+/**
+ * Drops a member whose I/O failed.
+ */
+static void member_failed(struct raid *r, int member)
+{
+    pthread_mutex_lock(&r->lock);
+    if (r->members[member].state != FAILED)
+    {
+        printf("   ERROR: I/O on member %d failed, the disk carries on without it.\n", member);
+        fail_locked(r, member);
+    }
+    pthread_mutex_unlock(&r->lock);
+}
+
+/**
+ * Writes block k of the bitmap to every member in use, and waits for it to be stored. Members
+ * it cannot be written to are dropped. Called with the lock held.
+ *
+ * @return Returns 0 on success, -1 if no member up to date is left.
+ */
+static int store_bitmap(struct raid *r, uint32_t k)
+{
+    for (int i = 0; i < r->count; i++)
+    {
+        struct iovec vec = {r->bitmap + (size_t)k * BLOCK_SIZE, BLOCK_SIZE};
+        int fd = r->members[i].fd;
+
+        if (r->members[i].state != FAILED &&
+            (disk_internal_fdv(fd, 1, &vec, 1, (uint64_t)(1 + k) * BLOCK_SIZE) != 0 || fdatasync(fd) != 0))
+        {
+            printf("   ERROR: Could not write to member %d, the disk carries on without it.\n", i);
+            fail_locked(r, i);
+        }
+    }
+
+    return count_state(r, IN_SYNC) > 0 ? 0 : -1;
+}
+
+static int is_marked(struct raid *r, uint64_t region)
+{
+    return __atomic_load_n(&r->bitmap[region / 8], __ATOMIC_RELAXED) >> (region % 8) & 1;
+}
+
+/**
+ * Marks the regions of blocks first..first+count-1 in the bitmap of every member before they
+ * are written. Regions already marked cost nothing.
+ *
+ * @return Returns 0 on success, -1 if no member up to date is left.
+ */
+static int mark_regions(struct raid *r, uint64_t first, int count)
+{
+    uint64_t last = (first + count - 1) / DISK_RAID_REGION;
+    int result = 0;
+
+    for (uint64_t region = first / DISK_RAID_REGION; region <= last && result == 0; region++)
+    {
+        if (is_marked(r, region))
+        {
+            continue;
+        }
+
+        pthread_mutex_lock(&r->lock);
+        if (!is_marked(r, region))
+        {
+            __atomic_or_fetch(&r->bitmap[region / 8], 1 << (region % 8), __ATOMIC_RELAXED);
+            result = store_bitmap(r, region / (BLOCK_SIZE * 8));
+        }
+        pthread_mutex_unlock(&r->lock);
+    }
+
+    return result;
+}
+
+/**
+ * Clears the bitmap on every member, if every member is up to date. Called with the I/O lock
+ * held exclusively, once every write has reached every member, and with the lock held.
+ *
+ * @return Returns 0 on success, -1 if no member up to date is left.
+ */
+static int clear_bitmap(struct raid *r)
+{
+    int marked = 0;
+
+    for (size_t i = 0; i < (size_t)r->bitmap_blocks * BLOCK_SIZE; i++)
+    {
+        marked |= r->bitmap[i];
+    }
+
+    if (!marked || count_state(r, IN_SYNC) < r->count)
+    {
+        return 0;
+    }
+
+    memset(r->bitmap, 0, (size_t)r->bitmap_blocks * BLOCK_SIZE);
+    for (uint32_t k = 0; k < r->bitmap_blocks; k++)
+    {
+        if (store_bitmap(r, k) != 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Copies regions of a mirror from the first other member up to date to `target`: all of them,
+ * or only those marked. Takes the I/O lock for one region at a time, so the disk stays in use.
+ *
+ * @return Returns 0 on success, -1 on failure, with the target dropped if it failed.
+ */
+static int resync(struct raid *r, int target, int all)
+{
+    uint8_t *buf = disk_alloc_blocks(DISK_RAID_REGION);
+
+    if (buf == NULL)
+    {
+        printf("   ERROR: Could not allocate resync buffer.\n");
+        return -1;
+    }
+
+    int result = 0;
+    for (uint64_t region = 0; region < r->regions && result == 0; region++)
+    {
+        if (!all && !is_marked(r, region))
+        {
+            continue;
+        }
+
+        uint64_t first = region * DISK_RAID_REGION;
+        uint32_t blocks = r->nblocks - first < DISK_RAID_REGION ? r->nblocks - first : DISK_RAID_REGION;
+        uint64_t offset = ((uint64_t)r->data_start + first) * BLOCK_SIZE;
+        struct iovec vec;
+
+        pthread_rwlock_wrlock(&r->io_lock);
+
+        // Read the region from a member up to date, dropping those that fail.
+        int source = -1;
+        while (source < 0 && result == 0)
+        {
+            for (int i = 0; i < r->count && source < 0; i++)
+            {
+                source = i != target && r->members[i].state == IN_SYNC ? i : -1;
+            }
+
+            vec.iov_base = buf;
+            vec.iov_len = (size_t)blocks * BLOCK_SIZE;
+            if (source < 0)
+            {
+                printf("   ERROR: No member is left to resync member %d from.\n", target);
+                result = -1;
+            }
+            else if (disk_internal_fdv(r->members[source].fd, 0, &vec, 1, offset) != 0)
+            {
+                member_failed(r, source);
+                source = -1;
+            }
+        }
+
+        vec.iov_base = buf;
+        vec.iov_len = (size_t)blocks * BLOCK_SIZE;
+        if (result == 0 && disk_internal_fdv(r->members[target].fd, 1, &vec, 1, offset) != 0)
+        {
+            member_failed(r, target);
+            result = -1;
+        }
+
+        pthread_rwlock_unlock(&r->io_lock);
+
+        if (result == 0)
+        {
+            __atomic_add_fetch(&r->stats.resynced, blocks, __ATOMIC_RELAXED);
+        }
+    }
+
+    disk_free_blocks(buf);
+    return result;
+}
+
+/**
+ * Stops the member threads, closes the members and frees the set.
+ */
+static void raid_free(struct raid *r)
+{
+    for (int i = 0; i < r->count; i++)
+    {
+        struct raid_member *m = &r->members[i];
+
+        if (m->started)
+        {
+            pthread_mutex_lock(&m->lock);
+            m->stop = 1;
+            pthread_cond_signal(&m->work);
+            pthread_mutex_unlock(&m->lock);
+            pthread_join(m->thread, NULL);
+        }
+
+        pthread_cond_destroy(&m->work);
+        pthread_mutex_destroy(&m->lock);
+
+        if (m->fd >= 0)
+        {
+            close(m->fd);
+        }
+    }
+
+    pthread_rwlock_destroy(&r->io_lock);
+    pthread_mutex_destroy(&r->lock);
+    disk_free_blocks(r->bitmap);
+    free(r);
+}
+
+/**
+ * Sets up a set from its header, over the members fds in their order in the set, -1 for those
+ * missing. Starts a thread per member when there is more than one.
+ *
+ * @return Returns the set, or NULL on failure, with the descriptors closed.
+ */
+static struct raid *raid_new(const struct raid_header *header, int *fds)
+{
+    struct raid *r = calloc(1, sizeof(struct raid));
+    uint32_t bitmap_blocks = header->bitmap_blocks;
+
+    if (r == NULL || (bitmap_blocks > 0 && (r->bitmap = disk_alloc_blocks(bitmap_blocks)) == NULL))
+    {
+        printf("   ERROR: Could not allocate disk.\n");
+        for (uint32_t i = 0; i < header->members; i++)
+        {
+            if (fds[i] >= 0)
+            {
+                close(fds[i]);
+            }
+        }
+        free(r);
+        return NULL;
+    }
+
+    r->count = header->members;
+    r->level = header->level;
+    r->unit = header->stripe_unit;
+    r->nblocks = header_blocks(header);
+    r->data_start = 1 + bitmap_blocks;
+    r->set_id = header->set_id;
+    r->events = header->events;
+    r->degraded_at = header->degraded_at;
+    r->bitmap_blocks = bitmap_blocks;
+    r->regions = (r->nblocks + DISK_RAID_REGION - 1) / DISK_RAID_REGION;
+    r->stats.level = r->level;
+    r->stats.members = r->count;
+    r->stats.stripe_unit = r->unit;
+
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&r->io_lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    pthread_mutex_init(&r->lock, NULL);
+
+    int result = 0;
+    for (int i = 0; i < r->count; i++)
+    {
+        struct raid_member *m = &r->members[i];
+
+        m->fd = fds[i];
+        m->state = fds[i] >= 0 ? IN_SYNC : FAILED;
+        pthread_mutex_init(&m->lock, NULL);
+        pthread_cond_init(&m->work, NULL);
+
+        if (r->count > 1 && result == 0)
+        {
+            result = pthread_create(&m->thread, NULL, member_worker, m);
+            m->started = result == 0;
+        }
+    }
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not start the member threads.\n");
+        raid_free(r);
+        return NULL;
+    }
+
+    return r;
+}
+
+/**
+ * Makes a disk of a set. The disk's own descriptor is a duplicate of the first member present,
+ * so that it stays valid whichever members come and go.
+ *
+ * @return Returns the new disk, or NULL on failure, with the set freed.
+ */
+static struct vdisk *raid_attach(struct raid *r, int flags)
+{
+    int fd = -1;
+
+    for (int i = 0; i < r->count && fd < 0; i++)
+    {
+        fd = r->members[i].fd >= 0 ? dup(r->members[i].fd) : -1;
+    }
+
+    struct vdisk *d = fd >= 0 ? disk_internal_attach(fd, r->nblocks, flags) : NULL;
+    if (d == NULL)
+    {
+        raid_free(r);
+        return NULL;
+    }
+
+    d->raid = r;
+    return d;
+}
+
+/**
+ * Checks the flags and members of a striped or mirrored disk.
+ *
+ * @return Returns 0 if they can be used, -1 otherwise.
+ */
+static int check_set(char **members, int count, int flags)
+{
+    if (members == NULL || count < 1 || count > DISK_RAID_MAX_MEMBERS)
+    {
+        printf("   ERROR: A striped or mirrored disk needs 1 to %d members.\n", DISK_RAID_MAX_MEMBERS);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (members[i] == NULL)
+        {
+            printf("   ERROR: Member %d has no file name.\n", i);
+            return -1;
+        }
+    }
+
+    if (flags & (DISK_MMAP | DISK_DIRECT | DISK_CHECKSUM | DISK_COMPRESS | DISK_DEDUP | DISK_THIN))
+    {
+        printf("   ERROR: A striped or mirrored disk cannot use DISK_MMAP, DISK_DIRECT, DISK_CHECKSUM, DISK_COMPRESS, "
+               "DISK_DEDUP or DISK_THIN.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the size of every member of a set, in blocks.
+ */
+static uint64_t member_size(const struct raid_header *header)
+{
+    if (header->level == 1)
+    {
+        return 1 + (uint64_t)header->bitmap_blocks + header_blocks(header);
+    }
+
+    uint64_t units = (header_blocks(header) + header->stripe_unit - 1) / header->stripe_unit;
+    return 1 + (units + header->members - 1) / header->members * header->stripe_unit;
+}
+
+/**
+ * Creates the members of a new set described by `header`, sparse like flat images, and makes
+ * a disk of them.
+ *
+ * @return Returns the new disk, or NULL on failure.
+ */
+static struct vdisk *create_set(char **members, struct raid_header *header, int flags)
+{
+    int fds[DISK_RAID_MAX_MEMBERS];
+    off_t size = (off_t)member_size(header) * BLOCK_SIZE;
+    struct timespec now;
+
+    // Draw the number that ties the members together.
+    clock_gettime(CLOCK_REALTIME, &now);
+    header->set_id = ((uint64_t)now.tv_sec * 1000000000 + now.tv_nsec) ^ ((uint64_t)getpid() << 32);
+    header->events = 1;
+
+    for (uint32_t i = 0; i < header->members; i++)
+    {
+        fds[i] = open(members[i], O_RDWR | O_CREAT | O_TRUNC, 0644);
+        int result = fds[i] >= 0 ? ftruncate(fds[i], size) : -1;
+
+        if (result == 0 && (flags & DISK_PREALLOC))
+        {
+            result = posix_fallocate(fds[i], 0, size);
+        }
+
+        if (result != 0)
+        {
+            printf("   ERROR: Could not create member %s.\n", members[i]);
+            for (uint32_t j = 0; j <= i; j++)
+            {
+                if (fds[j] >= 0)
+                {
+                    close(fds[j]);
+                }
+            }
+            return NULL;
+        }
+    }
+
+    struct raid *r = raid_new(header, fds);
+    if (r == NULL)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < r->count; i++)
+    {
+        if (write_header(r, r->members[i].fd, i, r->events) != 0)
+        {
+            printf("   ERROR: Could not create member %s.\n", members[i]);
+            raid_free(r);
+            return NULL;
+        }
+    }
+
+    return raid_attach(r, flags);
+}
+
+struct vdisk *vdisk_init_raid(char **members, int count, int64_t nblocks, int stripe_unit, int flags)
+{
+    struct raid_header header;
+
+    if (check_set(members, count, flags) != 0)
+    {
+        return NULL;
+    }
+
+    if (nblocks < 0 || stripe_unit < 0)
+    {
+        printf("   ERROR: Number of blocks and stripe unit cannot be negative.\n");
+        return NULL;
+    }
+
+    if ((uint64_t)nblocks > DISK_MAX_BLOCKS)
+    {
+        printf("   ERROR: Number of blocks cannot be more than %llu.\n", (unsigned long long)DISK_MAX_BLOCKS);
+        return NULL;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.level = 0;
+    header.members = count;
+    header.stripe_unit = stripe_unit > 0 ? stripe_unit : DISK_RAID_STRIPE_UNIT;
+    header.nblocks = (uint32_t)nblocks;
+    header.nblocks_hi = (uint32_t)(nblocks >> 32);
+
+    return create_set(members, &header, flags);
+}
+
+struct vdisk *vdisk_init_mirror(char **members, int count, int64_t nblocks, int flags)
+{
+    struct raid_header header;
+
+    if (check_set(members, count, flags) != 0)
+    {
+        return NULL;
+    }
+
+    if (nblocks < 0)
+    {
+        printf("   ERROR: Number of blocks cannot be negative.\n");
+        return NULL;
+    }
+
+    if ((uint64_t)nblocks > DISK_MAX_BLOCKS)
+    {
+        printf("   ERROR: Number of blocks cannot be more than %llu.\n", (unsigned long long)DISK_MAX_BLOCKS);
+        return NULL;
+    }
+
+    // One bit per region, in as many blocks as it takes.
+    uint64_t regions = ((uint64_t)nblocks + DISK_RAID_REGION - 1) / DISK_RAID_REGION;
+
+    memset(&header, 0, sizeof(header));
+    header.level = 1;
+    header.members = count;
+    header.nblocks = (uint32_t)nblocks;
+    header.nblocks_hi = (uint32_t)(nblocks >> 32);
+    header.bitmap_blocks = (regions + BLOCK_SIZE * 8 - 1) / (BLOCK_SIZE * 8);
+
+    return create_set(members, &header, flags);
+}
+
+/**
+ * Reads the header of the image fd into header, and checks that it belongs to a set.
+ *
+ * @return Returns 0 if it does, -1 otherwise.
+ */
+static int read_header(int fd, struct raid_header *header)
+{
+    uint8_t block[BLOCK_SIZE];
+    struct iovec vec = {block, BLOCK_SIZE};
+    struct stat st;
+
+    if (fd < 0 || disk_internal_fdv(fd, 0, &vec, 1, 0) != 0 || fstat(fd, &st) != 0)
+    {
+        return -1;
+    }
+
+    memcpy(header, block, sizeof(*header));
+
+    int valid = memcmp(header->magic, DISK_RAID_MAGIC, sizeof(header->magic)) == 0 &&
+                (header->version == 1 || header->version == DISK_RAID_VERSION) && header->block_size == BLOCK_SIZE && header->members > 0 &&
+                header->members <= DISK_RAID_MAX_MEMBERS && header->index < header->members && header_blocks(header) <= DISK_MAX_BLOCKS &&
+                ((header->level == 0 && header->stripe_unit > 0) || (header->level == 1 && header->stripe_unit == 0));
+
+    return valid && (uint64_t)st.st_size >= member_size(header) * BLOCK_SIZE ? 0 : -1;
+}
+
+struct vdisk *vdisk_open_raid(char **members, int count, int flags)
+{
+    int fds[DISK_RAID_MAX_MEMBERS];
+    uint64_t events[DISK_RAID_MAX_MEMBERS];
+    struct raid_header header, first;
+
+    if (check_set(members, count, flags) != 0)
+    {
+        return NULL;
+    }
+
+    memset(&first, 0, sizeof(first));
+    for (int i = 0; i < DISK_RAID_MAX_MEMBERS; i++)
+    {
+        fds[i] = -1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int fd = open(members[i], O_RDWR);
+        int valid = read_header(fd, &header) == 0;
+
+        if (valid && i == 0)
+        {
+            first = header;
+        }
+
+        // Every member must belong to the set of the first one, and take a place of its own.
+        valid = valid && header.set_id == first.set_id && header.level == first.level &&
+                header.members == first.members && header.stripe_unit == first.stripe_unit &&
+                header_blocks(&header) == header_blocks(&first) && header.bitmap_blocks == first.bitmap_blocks &&
+                fds[header.index] < 0 && (int)header.members >= count;
+
+        // A striped disk needs all of them.
+        valid = valid && (header.level == 1 || (int)header.members == count);
+
+        if (!valid)
+        {
+            printf("   ERROR: %s is not a member of this disk.\n", members[i]);
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            for (int j = 0; j < DISK_RAID_MAX_MEMBERS; j++)
+            {
+                if (fds[j] >= 0)
+                {
+                    close(fds[j]);
+                }
+            }
+            return NULL;
+        }
+
+        fds[header.index] = fd;
+        events[header.index] = header.events;
+
+        // The members up to date have the most events, and the latest header.
+        if (header.events > first.events)
+        {
+            first = header;
+        }
+    }
+
+    // Leave out the members that fell behind.
+    for (uint32_t i = 0; i < first.members; i++)
+    {
+        if (fds[i] >= 0 && events[i] < first.events)
+        {
+            printf("   ERROR: Member %u is behind the others; give it to disk_raid_replace() to resync it.\n", i);
+            close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+
+    struct raid *r = raid_new(&first, fds);
+    if (r == NULL)
+    {
+        return NULL;
+    }
+
+    // Load the bitmap of a mirror, and mark it open.
+    int source = 0;
+    while (r->members[source].fd < 0)
+    {
+        source++;
+    }
+
+    struct iovec vec = {r->bitmap, (size_t)r->bitmap_blocks * BLOCK_SIZE};
+    int result = r->bitmap_blocks > 0 ? disk_internal_fdv(r->members[source].fd, 0, &vec, 1, BLOCK_SIZE) : 0;
+
+    for (int i = 0; i < r->count && result == 0 && r->level == 1; i++)
+    {
+        result = r->members[i].fd >= 0 ? write_header(r, r->members[i].fd, i, r->events) : 0;
+    }
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not read the write-intent bitmap.\n");
+        raid_free(r);
+        return NULL;
+    }
+
+    // A crash may have left the members different in the regions still marked. Make them
+    // match the first one, and clear the marks if no member is missing.
+    if (r->level == 1 && !first.clean)
+    {
+        for (int i = source + 1; i < r->count && result == 0; i++)
+        {
+            result = r->members[i].state == IN_SYNC ? resync(r, i, 0) : 0;
+        }
+
+        pthread_mutex_lock(&r->lock);
+        result = result == 0 ? clear_bitmap(r) : result;
+        pthread_mutex_unlock(&r->lock);
+    }
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not resync the members.\n");
+        raid_free(r);
+        return NULL;
+    }
+
+    return raid_attach(r, flags);
+}
+
+/**
+ * Checks that d is a mirrored disk and member one of its places.
+ *
+ * @return Returns 0 if they are, -1 otherwise.
+ */
+static int check_member(struct vdisk *d, int member)
+{
+    if (d == NULL || d->raid == NULL || d->raid->level != 1)
+    {
+        printf("   ERROR: Disk is not mirrored.\n");
+        return -1;
+    }
+
+    if (member < 0 || member >= d->raid->count)
+    {
+        printf("   ERROR: Member must be less than %d.\n", d->raid->count);
+        return -1;
+    }
+
+    return 0;
+}
+
+int disk_raid_fail(int member)
+{
+    return vdisk_raid_fail(disk_default(), member);
+}
+
+int vdisk_raid_fail(struct vdisk *d, int member)
+{
+    if (check_member(d, member) != 0)
+    {
+        return -1;
+    }
+
+    struct raid *r = d->raid;
+    int result = 0;
+
+    pthread_mutex_lock(&r->lock);
+    if (r->members[member].state == IN_SYNC && count_state(r, IN_SYNC) == 1)
+    {
+        printf("   ERROR: Member %d is the last one up to date.\n", member);
+        result = -1;
+    }
+    else
+    {
+        fail_locked(r, member);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return result;
+}
+
+int disk_raid_replace(int member, char *filename)
+{
+    return vdisk_raid_replace(disk_default(), member, filename);
+}
+
+int vdisk_raid_replace(struct vdisk *d, int member, char *filename)
+{
+    struct raid_header header;
+    struct stat st, other;
+
+    if (check_member(d, member) != 0 || filename == NULL)
+    {
+        return -1;
+    }
+
+    struct raid *r = d->raid;
+    struct raid_member *m = &r->members[member];
+
+    pthread_mutex_lock(&r->lock);
+    int state = m->state;
+    pthread_mutex_unlock(&r->lock);
+
+    if (state != FAILED)
+    {
+        printf("   ERROR: Member %d is in use.\n", member);
+        return -1;
+    }
+
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        printf("   ERROR: Could not open %s.\n", filename);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    // Refuse a file that is another member, which would be truncated below.
+    for (int i = 0; i < r->count; i++)
+    {
+        if (i != member && r->members[i].fd >= 0 && fstat(r->members[i].fd, &other) == 0 && other.st_dev == st.st_dev &&
+            other.st_ino == st.st_ino)
+        {
+            printf("   ERROR: %s is already member %d.\n", filename, i);
+            close(fd);
+            return -1;
+        }
+    }
+
+    // The member that was dropped lacks only what the bitmap marks. Anything else starts over,
+    // with no events until it is full, so that it is never taken for a member that fell behind.
+    int behind = read_header(fd, &header) == 0 && header.set_id == r->set_id && header.index == (uint32_t)member &&
+                 header.level == 1 && header.events > 0 && header.events >= r->degraded_at;
+
+    if (!behind && (ftruncate(fd, 0) != 0 || ftruncate(fd, ((off_t)r->data_start + r->nblocks) * BLOCK_SIZE) != 0 ||
+                    write_header(r, fd, member, 0) != 0))
+    {
+        printf("   ERROR: Could not prepare %s.\n", filename);
+        close(fd);
+        return -1;
+    }
+
+    // Swap it in between runs. From now on it gets every write.
+    pthread_rwlock_wrlock(&r->io_lock);
+    pthread_mutex_lock(&r->lock);
+    int old = m->fd;
+    m->fd = fd;
+    __atomic_store_n(&m->state, RECOVERING, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&r->lock);
+    pthread_rwlock_unlock(&r->io_lock);
+
+    if (old >= 0)
+    {
+        close(old);
+    }
+
+    if (resync(r, member, !behind) != 0)
+    {
+        return -1;
+    }
+
+    // It is up to date: record it on every member.
+    pthread_mutex_lock(&r->lock);
+    if (m->state == RECOVERING)
+    {
+        __atomic_store_n(&m->state, IN_SYNC, __ATOMIC_RELAXED);
+        r->events++;
+        for (int i = 0; i < r->count; i++)
+        {
+            if (r->members[i].state != FAILED && write_header(r, r->members[i].fd, i, r->events) != 0)
+            {
+                printf("   ERROR: Could not write to member %d, the disk carries on without it.\n", i);
+                fail_locked(r, i);
+            }
+        }
+    }
+    int result = m->state == IN_SYNC ? 0 : -1;
+    pthread_mutex_unlock(&r->lock);
+
+    // Clear the bitmap if no member is missing any more.
+    return result == 0 ? disk_raid_flush(d) : -1;
+}
+
+void disk_raid_get_stats(struct disk_raid_stats *stats)
+{
+    vdisk_raid_get_stats(disk_default(), stats);
+}
+
+void vdisk_raid_get_stats(struct vdisk *d, struct disk_raid_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (d == NULL || d->raid == NULL)
+    {
+        return;
+    }
+
+    struct raid *r = d->raid;
+
+    stats->level = r->stats.level;
+    stats->members = r->stats.members;
+    stats->stripe_unit = r->stats.stripe_unit;
+    stats->split = __atomic_load_n(&r->stats.split, __ATOMIC_RELAXED);
+    stats->resynced = __atomic_load_n(&r->stats.resynced, __ATOMIC_RELAXED);
+    for (int i = 0; i < r->count; i++)
+    {
+        stats->member_blocks[i] = __atomic_load_n(&r->stats.member_blocks[i], __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_lock(&r->lock);
+    stats->failed = r->count - count_state(r, IN_SYNC);
+    for (uint64_t region = 0; region < r->regions && r->bitmap != NULL; region++)
+    {
+        stats->dirty_regions += is_marked(r, region);
+    }
+    pthread_mutex_unlock(&r->lock);
+}
+
+/*------------------------------------------- HOOKS ---------------------------------------------*/
+
+int disk_raid_flush(struct vdisk *d)
+{
+    struct raid *r = d->raid;
+    int result = 0;
+
+    if (r == NULL)
+    {
+        return 0;
+    }
+
+    pthread_rwlock_wrlock(&r->io_lock);
+    pthread_mutex_lock(&r->lock);
+
+    for (int i = 0; i < r->count; i++)
+    {
+        if (r->members[i].state == FAILED || fsync(r->members[i].fd) == 0)
+        {
+            continue;
+        }
+
+        // A mirror does without the member, a striped disk cannot.
+        if (r->level == 1 && (r->members[i].state != IN_SYNC || count_state(r, IN_SYNC) > 1))
+        {
+            printf("   ERROR: Could not flush member %d, the disk carries on without it.\n", i);
+            fail_locked(r, i);
+        }
+        else
+        {
+            result = -1;
+        }
+    }
+
+    // Every write so far has reached every member: the regions need no resync any more.
+    result = result == 0 && r->level == 1 ? clear_bitmap(r) : result;
+
+    pthread_mutex_unlock(&r->lock);
+    pthread_rwlock_unlock(&r->io_lock);
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not flush disk.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void disk_raid_detach(struct vdisk *d)
+{
+    struct raid *r = d->raid;
+
+    if (r == NULL)
+    {
+        return;
+    }
+
+    // Mark a mirror closed, so that it is not resynced when it is opened again.
+    r->clean = 1;
+    for (int i = 0; i < r->count && r->level == 1; i++)
+    {
+        if (r->members[i].state != FAILED)
+        {
+            write_header(r, r->members[i].fd, i, r->events);
+        }
+    }
+
+    d->raid = NULL;
+    raid_free(r);
+}
+
+/**
+ * Moves a run of at most RUN contiguous entries of a striped disk: each member's part with
+ * one preadv/pwritev, all at once.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int stripe_run(struct raid *r, int write, const struct disk_iovec *iov, int count)
+{
+    struct iovec vec[RUN];
+    struct raid_job jobs[DISK_RAID_MAX_MEMBERS];
+    int slot[DISK_RAID_MAX_MEMBERS];
+    int member, njobs = 0, used = 0;
+    uint64_t local;
+
+    for (int m = 0; m < r->count; m++)
+    {
+        slot[m] = -1;
+    }
+
+    // Count each member's blocks, and note where its part starts on it.
+    for (int i = 0; i < count; i++)
+    {
+        locate(r, iov[i].blocknum, &member, &local);
+
+        if (slot[member] < 0)
+        {
+            slot[member] = njobs++;
+            memset(&jobs[slot[member]], 0, sizeof(jobs[0]));
+            jobs[slot[member]].member = member;
+            jobs[slot[member]].write = write;
+            jobs[slot[member]].offset = (r->data_start + local) * BLOCK_SIZE;
+        }
+        jobs[slot[member]].count++;
+    }
+
+    // Give each part its share of vec, then lay the buffers out in it.
+    for (int j = 0; j < njobs; j++)
+    {
+        jobs[j].vec = vec + used;
+        used += jobs[j].count;
+        jobs[j].count = 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        locate(r, iov[i].blocknum, &member, &local);
+
+        struct raid_job *job = &jobs[slot[member]];
+        job->vec[job->count].iov_base = iov[i].buf;
+        job->vec[job->count].iov_len = BLOCK_SIZE;
+        job->count++;
+    }
+
+    run_jobs(r, jobs, njobs);
+
+    for (int j = 0; j < njobs; j++)
+    {
+        if (jobs[j].result != 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Writes a run of at most RUN contiguous entries of a mirror to every member in use, all at
+ * once, once its regions are marked. Members that fail are dropped.
+ *
+ * @return Returns 0 if a member up to date took the run, -1 otherwise.
+ */
+static int mirror_write(struct raid *r, const struct disk_iovec *iov, int count)
+{
+    struct iovec vec[VECS];
+    struct raid_job jobs[DISK_RAID_MAX_MEMBERS];
+    int targets[DISK_RAID_MAX_MEMBERS];
+    int ntargets = 0;
+
+    if (mark_regions(r, iov[0].blocknum, count) != 0)
+    {
+        return -1;
+    }
+
+    for (int m = 0; m < r->count; m++)
+    {
+        if (__atomic_load_n(&r->members[m].state, __ATOMIC_RELAXED) != FAILED)
+        {
+            targets[ntargets++] = m;
+        }
+    }
+
+    // Each member needs iovecs of its own, since the transfers consume them.
+    int chunk = VECS / (ntargets > 0 ? ntargets : 1);
+    for (int done = 0; done < count; done += chunk)
+    {
+        int n = count - done < chunk ? count - done : chunk;
+        int stored = 0;
+
+        for (int j = 0; j < ntargets; j++)
+        {
+            memset(&jobs[j], 0, sizeof(jobs[j]));
+            jobs[j].vec = vec + j * chunk;
+            jobs[j].count = n;
+            jobs[j].offset = ((uint64_t)r->data_start + iov[done].blocknum) * BLOCK_SIZE;
+            jobs[j].write = 1;
+            jobs[j].member = targets[j];
+
+            for (int i = 0; i < n; i++)
+            {
+                jobs[j].vec[i].iov_base = iov[done + i].buf;
+                jobs[j].vec[i].iov_len = BLOCK_SIZE;
+            }
+        }
+
+        run_jobs(r, jobs, ntargets);
+
+        for (int j = 0; j < ntargets; j++)
+        {
+            if (jobs[j].result != 0)
+            {
+                member_failed(r, jobs[j].member);
+            }
+            else
+            {
+                stored |= __atomic_load_n(&r->members[jobs[j].member].state, __ATOMIC_RELAXED) == IN_SYNC;
+            }
+        }
+
+        if (!stored)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Reads a run of at most RUN contiguous entries of a mirror. A long run is split between the
+ * members up to date; a short one goes to the member with the fewest jobs in hand, preferring
+ * the one whose last read ended where it starts. Members that fail are dropped, and the run
+ * is read again from the others.
+ *
+ * @return Returns 0 on success, -1 if no member up to date is left.
+ */
+static int mirror_read(struct raid *r, const struct disk_iovec *iov, int count)
+{
+    struct iovec vec[RUN];
+    struct raid_job jobs[DISK_RAID_MAX_MEMBERS];
+    int sources[DISK_RAID_MAX_MEMBERS];
+
+    while (1)
+    {
+        int nsources = 0;
+        int best = -1;
+        uint32_t best_depth = 0;
+
+        for (int m = 0; m < r->count; m++)
+        {
+            if (__atomic_load_n(&r->members[m].state, __ATOMIC_RELAXED) != IN_SYNC)
+            {
+                continue;
+            }
+            sources[nsources++] = m;
+
+            uint32_t depth = __atomic_load_n(&r->members[m].inflight, __ATOMIC_RELAXED);
+            int follows = __atomic_load_n(&r->members[m].next_block, __ATOMIC_RELAXED) == iov[0].blocknum;
+            if (best < 0 || depth < best_depth || (depth == best_depth && follows))
+            {
+                best = m;
+                best_depth = depth;
+            }
+        }
+
+        if (nsources == 0)
+        {
+            return -1;
+        }
+
+        int parts = count >= SPLIT ? nsources : 1;
+        int per = (count + parts - 1) / parts;
+        int njobs = 0;
+
+        for (int done = 0; done < count; done += per)
+        {
+            struct raid_job *job = &jobs[njobs];
+
+            memset(job, 0, sizeof(*job));
+            job->vec = vec + done;
+            job->count = count - done < per ? count - done : per;
+            job->offset = ((uint64_t)r->data_start + iov[done].blocknum) * BLOCK_SIZE;
+            job->member = parts > 1 ? sources[njobs] : best;
+
+            for (int i = 0; i < job->count; i++)
+            {
+                job->vec[i].iov_base = iov[done + i].buf;
+                job->vec[i].iov_len = BLOCK_SIZE;
+            }
+            njobs++;
+        }
+
+        run_jobs(r, jobs, njobs);
+
+        int failed = 0;
+        for (int j = 0; j < njobs; j++)
+        {
+            if (jobs[j].result != 0)
+            {
+                member_failed(r, jobs[j].member);
+                failed = 1;
+            }
+            else
+            {
+                uint64_t next = iov[0].blocknum + (uint64_t)(jobs[j].vec - vec) + jobs[j].count;
+                __atomic_store_n(&r->members[jobs[j].member].next_block, next, __ATOMIC_RELAXED);
+            }
+        }
+
+        if (!failed)
+        {
+            return 0;
+        }
+    }
+}
+
+int disk_raid_run(struct vdisk *d, int write, const struct disk_iovec *iov, int count)
+{
+    struct raid *r = d->raid;
+    int result = 0;
+
+    pthread_rwlock_rdlock(&r->io_lock);
+
+    for (int done = 0; done < count && result == 0; done += RUN)
+    {
+        int n = count - done < RUN ? count - done : RUN;
+
+        if (r->level == 0)
+        {
+            result = stripe_run(r, write, iov + done, n);
+        }
+        else
+        {
+            result = write ? mirror_write(r, iov + done, n) : mirror_read(r, iov + done, n);
+        }
+    }
+
+    pthread_rwlock_unlock(&r->io_lock);
+
+    return result;
+}
\ No newline at end of file
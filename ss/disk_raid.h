@@ -0,0 +1,142 @@
+/**
+ * @file disk_raid.h
+ * @brief This header file contains the declarations of disks striped or mirrored across several
+ * images.
+ *
+ * A striped disk (RAID-0) spreads its blocks over up to DISK_RAID_MAX_MEMBERS member images,
+ * typically one per device, in stripe units of a number of blocks: the first unit goes to the
+ * first member, the next to the second, and so on round the members. Every member starts with
+ * a header block naming its place in the set, so the members can be given in any order when
+ * the disk is opened, and a member of another set is refused.
+ *
+ * A run of blocks spanning several members is split into one preadv/pwritev per member, since
+ * the units of a member follow each other in its image. Each member has a thread of its own
+ * moving its part while the calling thread moves the first one, so a long transfer keeps every
+ * device busy at once. A run within one unit is moved by the calling thread alone.
+ *
+ * A mirrored disk (RAID-1) keeps a full copy of its blocks on each of its members. Writes go
+ * to every member at once. A short read goes to the member with the fewest requests in flight,
+ * so concurrent readers spread over the members; a long one is split between them. A member
+ * whose I/O fails is dropped, and the disk carries on with the others.
+ *
+ * Every member of a mirror also holds a write-intent bitmap, with one bit per DISK_RAID_REGION
+ * blocks. A region's bit is set on every member before it is first written, and the bits are
+ * cleared by disk_flush() once the writes have reached every member. While a member is missing
+ * they are not cleared, so they cover everything it missed: when it comes back, through
+ * disk_raid_replace(), only the regions marked are copied to it. A new member gets every
+ * region. Regions left marked by a crash are copied from the first member when the disk is
+ * opened again.
+ *
+ * Striped and mirrored disks can be used with the cache, the scheduler and the asynchronous
+ * engine like any other, but not with DISK_MMAP, DISK_DIRECT, DISK_CHECKSUM, DISK_COMPRESS,
+ * DISK_DEDUP or DISK_THIN.
+ *
+ */
+
+#ifndef DISK_RAID_H
+#define DISK_RAID_H
+
+#include <stdint.h>
+
+#include "disk.h"
+
+#define DISK_RAID_MAGIC "RZRAID01"
+#define DISK_RAID_VERSION 2 // version 1 sets, of fewer than 2^32 blocks, are opened too
+#define DISK_RAID_MAX_MEMBERS 16
+#define DISK_RAID_STRIPE_UNIT 16 // blocks per stripe unit when 0 is given (64 KB)
+#define DISK_RAID_REGION 1024    // blocks per bit of the write-intent bitmap of a mirror (4 MB)
+
+/**
+ * @brief Counters kept by a striped or mirrored disk.
+ *
+ * @param level 0 for a striped disk, 1 for a mirrored one.
+ * @param members The number of member images.
+ * @param stripe_unit The blocks per stripe unit, or 0 for a mirror.
+ * @param failed The members of a mirror that are missing or being resynced.
+ * @param split The runs of blocks moved by several members at once.
+ * @param dirty_regions The regions marked in the write-intent bitmap of a mirror.
+ * @param resynced The blocks copied to members by resyncs.
+ * @param member_blocks The blocks moved to or from each member.
+ */
+struct disk_raid_stats
+{
+    uint32_t level;
+    uint32_t members;
+    uint32_t stripe_unit;
+    uint32_t failed;
+    uint64_t split;
+    uint64_t dirty_regions;
+    uint64_t resynced;
+    uint64_t member_blocks[DISK_RAID_MAX_MEMBERS];
+};
+
+/**
+ * @brief Creates a disk of nblocks blocks striped across the images `members` and makes it
+ * the default disk. Any existing files are truncated.
+ *
+ * @param count The number of members, from 1 to DISK_RAID_MAX_MEMBERS.
+ * @param stripe_unit The blocks per stripe unit, or 0 for DISK_RAID_STRIPE_UNIT.
+ * @param flags Flags as for disk_init_flags().
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_init_raid(char **members, int count, int64_t nblocks, int stripe_unit, int flags);
+
+/**
+ * @brief Creates a disk of nblocks blocks mirrored on each of the images `members` and makes
+ * it the default disk. Any existing files are truncated.
+ *
+ * @param count The number of members, from 1 to DISK_RAID_MAX_MEMBERS.
+ * @param flags Flags as for disk_init_flags().
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_init_mirror(char **members, int count, int64_t nblocks, int flags);
+
+/**
+ * @brief Opens the disk striped or mirrored across the images `members`, given in any order,
+ * and makes it the default disk. Every member of a striped disk must be given. A mirror opens
+ * with any of its members that are up to date; the others are left out until they are given
+ * to disk_raid_replace().
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_open_raid(char **members, int count, int flags);
+
+/**
+ * @brief Drops a member of the default disk, which must be mirrored, as if its I/O had failed.
+ * The other members go on without it, and the regions written meanwhile are kept marked.
+ *
+ * @param member The place of the member in the set, from 0.
+ * @return int Returns 0 on success, -1 if it is the last member up to date.
+ */
+int disk_raid_fail(int member);
+
+/**
+ * @brief Puts the image `filename` in place of a member of the default mirrored disk that was
+ * dropped or missing, and copies the blocks it lacks to it before returning. The disk stays in
+ * use meanwhile. Given the member that was dropped, only the regions written since are copied;
+ * any other file is truncated and gets every region.
+ *
+ * @param member The place of the member in the set, from 0.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_raid_replace(int member, char *filename);
+
+/**
+ * @brief Copies the counters of the default disk into stats. They are all zero when it is
+ * neither striped nor mirrored.
+ *
+ * @param stats Where to store the counters.
+ */
+void disk_raid_get_stats(struct disk_raid_stats *stats);
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+struct vdisk *vdisk_init_raid(char **members, int count, int64_t nblocks, int stripe_unit, int flags);
+struct vdisk *vdisk_init_mirror(char **members, int count, int64_t nblocks, int flags);
+struct vdisk *vdisk_open_raid(char **members, int count, int flags);
+int vdisk_raid_fail(struct vdisk *d, int member);
+int vdisk_raid_replace(struct vdisk *d, int member, char *filename);
+void vdisk_raid_get_stats(struct vdisk *d, struct disk_raid_stats *stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,445 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disk_sched.h"
+#include "disk_internal.h"
+
+/**
+ * One queued block write.
+ *
+ * @param blocknum The block to write.
+ * @param slot Where its data is kept, as an index into `data`.
+ */
+struct sched_entry
+{
+    uint64_t blocknum;
+    int slot;
+};
+
+/**
+ * The scheduler of one disk.
+ *
+ * @param queue The queued writes, in block order.
+ * @param count The number of queued writes.
+ * @param depth The most writes held.
+ * @param data One block of data per slot.
+ * @param free_slots The slots not in use, `nfree` of them.
+ * @param batch The block list of a dispatch, in the order it is written.
+ * @param deadline_ns How long a write may wait, or 0.
+ * @param oldest_ns When the oldest queued write was queued.
+ * @param metadata_end The first block that is not metadata.
+ * @param head The block after the last one written, where C-LOOK resumes.
+ */
+struct sched
+{
+    struct sched_entry *queue;
+    int count;
+    int depth;
+    uint8_t *data;
+    int *free_slots;
+    int nfree;
+    struct disk_iovec *batch;
+    uint64_t deadline_ns;
+    uint64_t oldest_ns;
+    uint64_t metadata_end;
+    uint64_t head;
+    struct disk_sched_stats stats;
+};
+
+static void sched_free(struct sched *s)
+{
+    if (s != NULL)
+    {
+        free(s->queue);
+        free(s->free_slots);
+        free(s->batch);
+        disk_free_blocks(s->data);
+        free(s);
+    }
+}
+
+int disk_sched_init(int depth, uint64_t deadline_ns)
+{
+    return vdisk_sched_init(disk_default(), depth, deadline_ns);
+}
+
+int vdisk_sched_init(struct vdisk *d, int depth, uint64_t deadline_ns)
+{
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    if (d->map != NULL)
+    {
+        printf("   ERROR: The scheduler cannot run on a mapped disk.\n");
+        return -1;
+    }
+
+    if (depth < 0)
+    {
+        printf("   ERROR: Invalid scheduler depth %d.\n", depth);
+        return -1;
+    }
+
+    struct sched *s = calloc(1, sizeof(struct sched));
+    if (s != NULL)
+    {
+        s->depth = depth > 0 ? depth : DISK_SCHED_DEPTH;
+        s->queue = malloc(s->depth * sizeof(struct sched_entry));
+        s->free_slots = malloc(s->depth * sizeof(int));
+        s->batch = malloc(s->depth * sizeof(struct disk_iovec));
+        s->data = disk_alloc_blocks(s->depth);
+    }
+
+    if (s == NULL || s->queue == NULL || s->free_slots == NULL || s->batch == NULL || s->data == NULL)
+    {
+        printf("   ERROR: Could not allocate scheduler.\n");
+        sched_free(s);
+        return -1;
+    }
+
+    for (int i = 0; i < s->depth; i++)
+    {
+        s->free_slots[i] = i;
+    }
+    s->nfree = s->depth;
+    s->deadline_ns = deadline_ns;
+
+    // The writes queued by a previous scheduler go out first.
+    if (vdisk_sched_close(d) != 0)
+    {
+        sched_free(s);
+        return -1;
+    }
+
+    disk_internal_lock(d);
+    d->sched = s;
+    disk_internal_unlock(d);
+
+    return 0;
+}
+
+void disk_sched_metadata(uint64_t first_data_block)
+{
+    vdisk_sched_metadata(disk_default(), first_data_block);
+}
+
+void vdisk_sched_metadata(struct vdisk *d, uint64_t first_data_block)
+{
+    disk_internal_lock(d);
+    if (d != NULL && d->sched != NULL)
+    {
+        d->sched->metadata_end = first_data_block;
+    }
+    disk_internal_unlock(d);
+}
+
+/**
+ * Finds a block in the queue.
+ *
+ * @param pos Set to where the block is, or would be inserted.
+ * @return Returns 1 if the block is queued, 0 otherwise.
+ */
+static int find(struct sched *s, uint64_t blocknum, int *pos)
+{
+    int lo = 0, hi = s->count;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (s->queue[mid].blocknum < blocknum)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    *pos = lo;
+    return lo < s->count && s->queue[lo].blocknum == blocknum;
+}
+
+/**
+ * Appends entries first..end-1 of the queue to the batch in C-LOOK order from the head: those
+ * at or above it, then the ones below.
+ *
+ * @return Returns the new length of the batch.
+ */
+static int clook(struct sched *s, int first, int end, int n)
+{
+    int start = first;
+    while (start < end && s->queue[start].blocknum < s->head)
+    {
+        start++;
+    }
+
+    for (int k = 0; k < end - first; k++)
+    {
+        int i = start + k < end ? start + k : first + (start + k - end);
+
+        s->batch[n].blocknum = s->queue[i].blocknum;
+        s->batch[n].buf = s->data + (size_t)s->queue[i].slot * BLOCK_SIZE;
+        n++;
+    }
+
+    if (end > first)
+    {
+        s->head = s->batch[n - 1].blocknum + 1;
+    }
+
+    return n;
+}
+
+/**
+ * Writes out the whole queue. The disk lock must be held.
+ */
+static int dispatch(struct vdisk *d, struct sched *s)
+{
+    if (s->count == 0)
+    {
+        return 0;
+    }
+
+    // Metadata sorts before data, so the queue splits into the two classes at `split`.
+    int split;
+    find(s, s->metadata_end, &split);
+
+    int n = clook(s, 0, split, 0);
+    n = clook(s, split, s->count, n);
+
+    int runs = 1;
+    for (int i = 1; i < n; i++)
+    {
+        runs += s->batch[i].blocknum != s->batch[i - 1].blocknum + 1;
+    }
+
+    // Hide the queue while writing, so the transfer finds nothing queued to drop. The data
+    // stays in its slots until the write is done, and the lock keeps readers out until then.
+    int count = s->count;
+    s->count = 0;
+
+    // A failed write leaves the queue as it was: disk_write() reported the blocks written, so
+    // reads are still answered from it and the next dispatch tries them again.
+    if (disk_internal_iov(d, 1, s->batch, n) != 0)
+    {
+        s->count = count;
+        printf("   ERROR: Could not write %d scheduled blocks.\n", n);
+        return -1;
+    }
+
+    for (int i = 0; i < s->depth; i++)
+    {
+        s->free_slots[i] = i;
+    }
+    s->nfree = s->depth;
+
+    s->stats.dispatches++;
+    s->stats.runs += runs;
+    s->stats.blocks += n;
+    return 0;
+}
+
+/**
+ * Writes out the queue if its oldest write has waited out the deadline.
+ */
+static int check_deadline(struct vdisk *d, struct sched *s)
+{
+    if (s->deadline_ns == 0 || s->count == 0 || disk_stats_now() - s->oldest_ns < s->deadline_ns)
+    {
+        return 0;
+    }
+
+    return dispatch(d, s);
+}
+
+/**
+ * Removes entry i from the queue and frees its slot.
+ */
+static void remove_entry(struct sched *s, int i)
+{
+    s->free_slots[s->nfree++] = s->queue[i].slot;
+    memmove(&s->queue[i], &s->queue[i + 1], (s->count - i - 1) * sizeof(struct sched_entry));
+    s->count--;
+}
+
+int disk_sched_dispatch()
+{
+    return vdisk_sched_dispatch(disk_default());
+}
+
+int vdisk_sched_dispatch(struct vdisk *d)
+{
+    int result = 0;
+
+    disk_internal_lock(d);
+    if (d != NULL && d->sched != NULL)
+    {
+        result = dispatch(d, d->sched);
+    }
+    disk_internal_unlock(d);
+
+    return result;
+}
+
+void disk_sched_get_stats(struct disk_sched_stats *stats)
+{
+    vdisk_sched_get_stats(disk_default(), stats);
+}
+
+void vdisk_sched_get_stats(struct vdisk *d, struct disk_sched_stats *stats)
+{
+    disk_internal_lock(d);
+    if (d != NULL && d->sched != NULL)
+    {
+        *stats = d->sched->stats;
+    }
+    else
+    {
+        memset(stats, 0, sizeof(*stats));
+    }
+    disk_internal_unlock(d);
+}
+
+int disk_sched_close()
+{
+    return vdisk_sched_close(disk_default());
+}
+
+int vdisk_sched_close(struct vdisk *d)
+{
+    if (d == NULL)
+    {
+        return 0;
+    }
+
+    disk_internal_lock(d);
+    struct sched *s = d->sched;
+    int result = s != NULL ? dispatch(d, s) : 0;
+    d->sched = NULL;
+    disk_internal_unlock(d);
+
+    sched_free(s);
+    return result;
+}
+
+/*------------------------------------------- HOOKS ---------------------------------------------*/
+
+int disk_sched_write(struct vdisk *d, uint64_t blocknum, const void *buf)
+{
+    struct sched *s = d->sched;
+    int pos;
+
+    if (s == NULL)
+    {
+        return 0;
+    }
+
+    if (check_deadline(d, s) != 0)
+    {
+        return -1;
+    }
+
+    // A newer write of a queued block replaces its data, keeping its place in line.
+    if (find(s, blocknum, &pos))
+    {
+        memcpy(s->data + (size_t)s->queue[pos].slot * BLOCK_SIZE, buf, BLOCK_SIZE);
+        s->stats.absorbed++;
+        return 1;
+    }
+
+    // A full queue goes out first, making room.
+    if (s->count == s->depth)
+    {
+        if (dispatch(d, s) != 0)
+        {
+            return -1;
+        }
+        pos = 0;
+    }
+
+    if (s->count == 0)
+    {
+        s->oldest_ns = disk_stats_now();
+    }
+
+    memmove(&s->queue[pos + 1], &s->queue[pos], (s->count - pos) * sizeof(struct sched_entry));
+    s->queue[pos].blocknum = blocknum;
+    s->queue[pos].slot = s->free_slots[--s->nfree];
+    s->count++;
+
+    memcpy(s->data + (size_t)s->queue[pos].slot * BLOCK_SIZE, buf, BLOCK_SIZE);
+    s->stats.queued++;
+    return 1;
+}
+
+int disk_sched_read(struct vdisk *d, uint64_t blocknum, void *buf)
+{
+    struct sched *s = d->sched;
+    int pos;
+
+    if (s == NULL)
+    {
+        return 0;
+    }
+
+    if (find(s, blocknum, &pos))
+    {
+        memcpy(buf, s->data + (size_t)s->queue[pos].slot * BLOCK_SIZE, BLOCK_SIZE);
+        s->stats.read_hits++;
+        return 1;
+    }
+
+    // The read moves the head; a batch that is due goes out before it.
+    if (check_deadline(d, s) != 0)
+    {
+        return -1;
+    }
+
+    s->head = blocknum + 1;
+    return 0;
+}
+
+int disk_sched_settle(struct vdisk *d, int write, const struct disk_iovec *iov, int count)
+{
+    struct sched *s = d->sched;
+    int pos;
+
+    for (int i = 0; s != NULL && i < count; i++)
+    {
+        if (!find(s, iov[i].blocknum, &pos))
+        {
+            continue;
+        }
+
+        // The write supersedes the queued data. A read must see it on the image.
+        if (write)
+        {
+            remove_entry(s, pos);
+        }
+        else
+        {
+            return dispatch(d, s);
+        }
+    }
+
+    return 0;
+}
+
+void disk_sched_overlay(struct vdisk *d, const struct disk_iovec *iov, int count)
+{
+    struct sched *s = d->sched;
+    int pos;
+
+    for (int i = 0; s != NULL && i < count; i++)
+    {
+        if (find(s, iov[i].blocknum, &pos))
+        {
+            memcpy(iov[i].buf, s->data + (size_t)s->queue[pos].slot * BLOCK_SIZE, BLOCK_SIZE);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+/**
+ * @file disk_sched.h
+ * @brief This header file contains the declarations of the elevator I/O scheduler.
+ *
+ * With the scheduler running, block writes are not sent to the image one by one. They wait in
+ * a queue kept in block order, and go out together when the queue fills, when the oldest has
+ * waited out the deadline, or on disk_flush() and disk_close(). A batch is written in C-LOOK
+ * order: upwards from where the head was left, then from the lowest block again. Metadata
+ * blocks go before data blocks, and each run of contiguous blocks is one pwritev. A write to a
+ * block already queued replaces the queued data, and a read of a queued block is answered from
+ * the queue.
+ *
+ * The scheduler sits below the cache, so it also orders the cache's write-backs. Reads are
+ * still made at once, since their callers wait for them.
+ *
+ */
+
+#ifndef DISK_SCHED_H
+#define DISK_SCHED_H
+
+#include <stdint.h>
+
+#include "disk.h"
+
+#define DISK_SCHED_DEPTH 128           // default queue depth, in blocks
+#define DISK_SCHED_DEADLINE_NS 50000000 // default deadline, 50 ms
+
+/**
+ * @brief Counters kept by the scheduler.
+ *
+ * @param queued The block writes queued.
+ * @param absorbed The queued writes replaced by a newer write of the same block.
+ * @param read_hits The reads answered from the queue.
+ * @param dispatches The batches written out.
+ * @param runs The pwritev calls the batches took.
+ * @param blocks The blocks the batches wrote.
+ */
+struct disk_sched_stats
+{
+    uint64_t queued;
+    uint64_t absorbed;
+    uint64_t read_hits;
+    uint64_t dispatches;
+    uint64_t runs;
+    uint64_t blocks;
+};
+
+/**
+ * @brief Starts the scheduler on the default disk, replacing any running one.
+ *
+ * Not available on a DISK_MMAP disk, where writes never reach a device queue.
+ *
+ * @param depth The most block writes held, or 0 for DISK_SCHED_DEPTH.
+ * @param deadline_ns How long a write may wait, or 0 to wait until the queue fills.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_sched_init(int depth, uint64_t deadline_ns);
+
+/**
+ * @brief Marks blocks 0..first_data_block-1 (superblock, bitmaps, inode table) as metadata,
+ * written before the data blocks of a batch. Pass the superblock's s_data_blocks_start.
+ */
+void disk_sched_metadata(uint64_t first_data_block);
+
+/**
+ * @brief Writes out everything queued now. If the write fails, the blocks stay queued: reads
+ * are still answered from the queue, and the next dispatch writes them again.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_sched_dispatch();
+
+/**
+ * @brief Copies the scheduler counters into stats. They are all zero when it is not running.
+ *
+ * @param stats Where to store the counters.
+ */
+void disk_sched_get_stats(struct disk_sched_stats *stats);
+
+/**
+ * @brief Writes out the queue and stops the scheduler. Called by disk_close().
+ *
+ * @return int Returns 0 on success, -1 if the queue could not be written.
+ */
+int disk_sched_close();
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+int vdisk_sched_init(struct vdisk *d, int depth, uint64_t deadline_ns);
+void vdisk_sched_metadata(struct vdisk *d, uint64_t first_data_block);
+int vdisk_sched_dispatch(struct vdisk *d);
+void vdisk_sched_get_stats(struct vdisk *d, struct disk_sched_stats *stats);
+int vdisk_sched_close(struct vdisk *d);
+
+#endif
\ No newline at end of file
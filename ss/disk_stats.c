@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "disk_stats.h"
+#include "disk_internal.h"
+
+/**
+ * Returns the histogram bucket of a latency. Latencies below 4 ns get a bucket each; above,
+ * every power of two is split into four buckets by the two bits after the leading one.
+ */
+static int bucket_of(uint64_t ns)
+{
+    if (ns < 4)
+    {
+        return (int)ns;
+    }
+
+    int exponent = 63 - __builtin_clzll(ns);
+    int bucket = (exponent - 1) * 4 + (int)((ns >> (exponent - 2)) & 3);
+
+    return bucket < DISK_STATS_BUCKETS ? bucket : DISK_STATS_BUCKETS - 1;
+}
+
+uint64_t disk_stats_bucket_floor(int bucket)
+{
+    if (bucket < 4)
+    {
+        return (uint64_t)bucket;
+    }
+
+    int exponent = bucket / 4 + 1;
+    return (uint64_t)(4 + bucket % 4) << (exponent - 2);
+}
+
+/**
+ * Returns the latency below which a fraction `per_mille` / 1000 of the requests fall.
+ */
+static uint64_t percentile(const struct disk_latency *l, int per_mille)
+{
+    if (l->count == 0)
+    {
+        return 0;
+    }
+
+    // The rank of the request sought, rounded up, counting from 1.
+    uint64_t rank = (l->count * per_mille + 999) / 1000;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < DISK_STATS_BUCKETS; i++)
+    {
+        seen += l->buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t top = disk_stats_bucket_floor(i + 1) - 1;
+            return top < l->max_ns ? top : l->max_ns;
+        }
+    }
+
+    return l->max_ns;
+}
+
+/**
+ * Copies counters that other threads may be adding to.
+ */
+static void load_all(uint64_t *dst, uint64_t *src, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
+
+static void load_latency(struct disk_latency *dst, struct disk_latency *src)
+{
+    dst->count = __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+    dst->bytes = __atomic_load_n(&src->bytes, __ATOMIC_RELAXED);
+    dst->total_ns = __atomic_load_n(&src->total_ns, __ATOMIC_RELAXED);
+    dst->max_ns = __atomic_load_n(&src->max_ns, __ATOMIC_RELAXED);
+    load_all(dst->buckets, src->buckets, DISK_STATS_BUCKETS);
+
+    dst->p50_ns = percentile(dst, 500);
+    dst->p99_ns = percentile(dst, 990);
+    dst->p999_ns = percentile(dst, 999);
+}
+
+int disk_get_stats(struct disk_stats *stats)
+{
+    return vdisk_get_stats(disk_default(), stats);
+}
+
+int vdisk_get_stats(struct vdisk *d, struct disk_stats *stats)
+{
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    load_latency(&stats->read, &d->stats.read);
+    load_latency(&stats->write, &d->stats.write);
+    stats->region_blocks = d->stats.region_blocks;
+    load_all(stats->region_reads, d->stats.region_reads, DISK_STATS_REGIONS);
+    load_all(stats->region_writes, d->stats.region_writes, DISK_STATS_REGIONS);
+
+    return 0;
+}
+
+static void json_list(FILE *out, const uint64_t *values, int count)
+{
+    fprintf(out, "[");
+    for (int i = 0; i < count; i++)
+    {
+        fprintf(out, "%s%llu", i > 0 ? ", " : "", (unsigned long long)values[i]);
+    }
+    fprintf(out, "]");
+}
+
+static void json_latency(FILE *out, const char *name, const struct disk_latency *l)
+{
+    fprintf(out, "  \"%s\": {\"count\": %llu, \"bytes\": %llu, \"total_ns\": %llu, \"max_ns\": %llu, ", name,
+            (unsigned long long)l->count, (unsigned long long)l->bytes, (unsigned long long)l->total_ns,
+            (unsigned long long)l->max_ns);
+    fprintf(out, "\"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu,\n", (unsigned long long)l->p50_ns,
+            (unsigned long long)l->p99_ns, (unsigned long long)l->p999_ns);
+
+    // Only the non-empty buckets, as [floor_ns, count] pairs.
+    fprintf(out, "    \"histogram\": [");
+    int first = 1;
+    for (int i = 0; i < DISK_STATS_BUCKETS; i++)
+    {
+        if (l->buckets[i] > 0)
+        {
+            fprintf(out, "%s[%llu, %llu]", first ? "" : ", ", (unsigned long long)disk_stats_bucket_floor(i),
+                    (unsigned long long)l->buckets[i]);
+            first = 0;
+        }
+    }
+    fprintf(out, "]},\n");
+}
+
+int disk_stats_json(FILE *out)
+{
+    return vdisk_stats_json(disk_default(), out);
+}
+
+int vdisk_stats_json(struct vdisk *d, FILE *out)
+{
+    struct disk_stats stats;
+
+    if (vdisk_get_stats(d, &stats) != 0)
+    {
+        return -1;
+    }
+
+    fprintf(out, "{\n");
+    json_latency(out, "read", &stats.read);
+    json_latency(out, "write", &stats.write);
+    fprintf(out, "  \"heatmap\": {\"region_blocks\": %llu,\n    \"reads\": ", (unsigned long long)stats.region_blocks);
+    json_list(out, stats.region_reads, DISK_STATS_REGIONS);
+    fprintf(out, ",\n    \"writes\": ");
+    json_list(out, stats.region_writes, DISK_STATS_REGIONS);
+    fprintf(out, "}\n}\n");
+
+    if (ferror(out))
+    {
+        printf("   ERROR: Could not write disk statistics.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void disk_stats_reset()
+{
+    vdisk_stats_reset(disk_default());
+}
+
+void vdisk_stats_reset(struct vdisk *d)
+{
+    if (d == NULL)
+    {
+        return;
+    }
+
+    // Keep the region size, which only depends on the disk size.
+    uint64_t region_blocks = d->stats.region_blocks;
+    disk_internal_lock(d);
+    memset(&d->stats, 0, sizeof(d->stats));
+    d->stats.region_blocks = region_blocks;
+    disk_internal_unlock(d);
+}
+
+/*------------------------------------------- HOOKS ---------------------------------------------*/
+
+uint64_t disk_stats_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void disk_stats_record(struct vdisk *d, int write, uint64_t start_ns, uint64_t bytes)
+{
+    struct disk_latency *l = write ? &d->stats.write : &d->stats.read;
+    uint64_t now = disk_stats_now();
+    uint64_t ns = now > start_ns ? now - start_ns : 0;
+
+    // Atomic, since threads of a DISK_THREADSAFE disk record at the same time.
+    __atomic_add_fetch(&l->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&l->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&l->total_ns, ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&l->buckets[bucket_of(ns)], 1, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&l->max_ns, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&l->max_ns, &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+void disk_stats_touch(struct vdisk *d, int write, uint64_t blocknum, int blocks)
+{
+    uint64_t *regions = write ? d->stats.region_writes : d->stats.region_reads;
+    uint64_t size = d->stats.region_blocks;
+
+    // Split the run at region boundaries, so each region is credited with its own blocks.
+    while (blocks > 0)
+    {
+        uint64_t region = blocknum / size;
+        uint64_t in_region = size - blocknum % size;
+        int n = (uint64_t)blocks < in_region ? blocks : (int)in_region;
+
+        __atomic_add_fetch(&regions[region < DISK_STATS_REGIONS ? region : DISK_STATS_REGIONS - 1], n, __ATOMIC_RELAXED);
+        blocknum += n;
+        blocks -= n;
+    }
+}
\ No newline at end of file
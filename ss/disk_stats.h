@@ -0,0 +1,111 @@
+/**
+ * @file disk_stats.h
+ * @brief This header file contains the declarations of the disk statistics.
+ *
+ * Every disk keeps statistics about the requests made to it: a latency histogram for reads
+ * and one for writes, the bytes moved, and a heatmap of the blocks touched per region of the
+ * disk. A request is one call to disk_read, disk_write, disk_readv or disk_writev, timed from
+ * call to return, or one asynchronous request, timed from queueing to completion. Cache hits
+ * are requests too, so the heatmap shows what the file system asks for, not what reaches the
+ * device; the Reads/Writes counters of disk_close() cover the latter.
+ *
+ */
+
+#ifndef DISK_STATS_H
+#define DISK_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "disk.h"
+
+#define DISK_STATS_BUCKETS 160 // latency buckets, four per power of two up to about 18 minutes
+#define DISK_STATS_REGIONS 64  // heatmap regions, each covering an equal share of the disk
+
+/**
+ * @brief The latencies of one kind of request.
+ *
+ * Bucket i counts the requests that took between disk_stats_bucket_floor(i) and
+ * disk_stats_bucket_floor(i + 1) - 1 nanoseconds, so values are known to within 25%.
+ *
+ * @param count The requests completed.
+ * @param bytes The bytes they moved.
+ * @param total_ns The sum of their latencies.
+ * @param max_ns The longest latency.
+ * @param p50_ns The median latency, filled in by disk_get_stats().
+ * @param p99_ns The 99th percentile, filled in by disk_get_stats().
+ * @param p999_ns The 99.9th percentile, filled in by disk_get_stats().
+ * @param buckets The histogram.
+ */
+struct disk_latency
+{
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t buckets[DISK_STATS_BUCKETS];
+};
+
+/**
+ * @brief The statistics of one disk.
+ *
+ * @param read The latencies of reads.
+ * @param write The latencies of writes.
+ * @param region_blocks The blocks per heatmap region. Block b falls in region b / region_blocks.
+ * @param region_reads The blocks read in each region.
+ * @param region_writes The blocks written in each region.
+ */
+struct disk_stats
+{
+    struct disk_latency read;
+    struct disk_latency write;
+    uint64_t region_blocks;
+    uint64_t region_reads[DISK_STATS_REGIONS];
+    uint64_t region_writes[DISK_STATS_REGIONS];
+};
+
+/**
+ * @brief Returns the smallest latency, in nanoseconds, counted by a histogram bucket.
+ *
+ * @param bucket A bucket index, from 0 to DISK_STATS_BUCKETS.
+ */
+uint64_t disk_stats_bucket_floor(int bucket);
+
+/**
+ * @brief Copies the statistics of the default disk into stats, with the percentiles filled in.
+ *
+ * A percentile is reported as the top of the bucket it falls in, capped at max_ns.
+ *
+ * @param stats Where to store the statistics.
+ * @return int Returns 0 on success, -1 if the disk is not open.
+ */
+int disk_get_stats(struct disk_stats *stats);
+
+/**
+ * @brief Writes the statistics of the default disk to out as one JSON object.
+ *
+ * The object has "read" and "write" members holding the fields of struct disk_latency, with
+ * the histogram as a list of [floor_ns, count] pairs for the non-empty buckets, and a
+ * "heatmap" member holding "region_blocks" and the "reads" and "writes" lists.
+ *
+ * @param out The stream to write to.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_stats_json(FILE *out);
+
+/**
+ * @brief Clears the statistics of the default disk.
+ */
+void disk_stats_reset();
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+int vdisk_get_stats(struct vdisk *d, struct disk_stats *stats);
+int vdisk_stats_json(struct vdisk *d, FILE *out);
+void vdisk_stats_reset(struct vdisk *d);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,956 @@
+#define _GNU_SOURCE // SEEK_DATA, SEEK_HOLE, writer-preferring rwlocks
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "disk_thin.h"
+#include "disk_internal.h"
+
+#define L1_PER_BLOCK (BLOCK_SIZE / 4)
+#define CHUNK 64 // blocks resolved at a time by a run, and copied at a time by the converters
+#define KEEP 0   // a write to a block stored since the last snapshot, which stays where it is
+#define STORE 1  // a write that needs a new image block
+#define DROP 2   // zeros written to a frozen block, which is unmapped instead
+
+/**
+ * The header in the first block of a thin-provisioned image.
+ *
+ * @param magic DISK_THIN_MAGIC.
+ * @param version DISK_THIN_VERSION.
+ * @param block_size BLOCK_SIZE.
+ * @param nblocks The number of blocks of the disk.
+ * @param l1_blocks The number of blocks of the L1 table that follows the header.
+ * @param next_block The end of the image, where the next table or block is appended.
+ * @param frozen The end of the image when the last snapshot was taken. Blocks before it are
+ * never written again.
+ * @param snapshot_dir The block listing the snapshots, or 0 before the first one.
+ * @param snapshots The number of snapshots.
+ */
+struct thin_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t nblocks;
+    uint32_t l1_blocks;
+    uint32_t next_block;
+    uint32_t frozen;
+    uint32_t snapshot_dir;
+    uint32_t snapshots;
+};
+
+/**
+ * The tables of one disk.
+ *
+ * @param l1 One entry per L2 table, laid out as in the image: the block holding it, or 0.
+ * @param l2 One pointer per L1 entry: the L2 table in memory, or NULL. An L2 entry is the block
+ * holding its block, or 0 if it was never written.
+ * @param l1_dirty One flag per L1 block whose entries changed since the last flush.
+ * @param l2_dirty One flag per L2 table whose entries changed since the last flush.
+ * @param l1_entries The number of L1 entries.
+ * @param l1_blocks The number of blocks of the L1 table.
+ * @param next The end of the image.
+ * @param header_dirty 1 if next changed since the last flush.
+ * @param frozen The end of the image when the last snapshot was taken.
+ * @param dir The block listing the snapshots, or 0.
+ * @param snaps The snapshots, laid out as in that block.
+ * @param nsnaps The number of snapshots.
+ * @param readonly 1 for a snapshot opened with vdisk_thin_snapshot_open().
+ * @param lock Serializes the growth of the image and the flushes.
+ * @param snap_lock Held shared by writes while they map blocks, and exclusively by snapshots.
+ * @param stats The counters; image_blocks and snapshots are worked out from the tables.
+ */
+struct thin
+{
+    uint32_t *l1;
+    uint32_t **l2;
+    uint8_t *l1_dirty;
+    uint8_t *l2_dirty;
+    uint32_t l1_entries;
+    uint32_t l1_blocks;
+    uint32_t next;
+    int header_dirty;
+    uint32_t frozen;
+    uint32_t dir;
+    struct disk_thin_snapshot *snaps;
+    uint32_t nsnaps;
+    int readonly;
+    pthread_mutex_t lock;
+    pthread_rwlock_t snap_lock;
+    struct disk_thin_stats stats;
+};
+
+/**
+ * Returns 1 if the block holds only zeros.
+ */
+static int is_zero(const void *buf)
+{
+    const uint64_t *words = buf;
+
+    for (int i = 0; i < BLOCK_SIZE / 8; i++)
+    {
+        if (words[i] != 0)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Returns the image block holding a block, or 0 if it was never written.
+ */
+static uint32_t lookup(struct thin *t, uint64_t blocknum)
+{
+    uint32_t *table = __atomic_load_n(&t->l2[blocknum / DISK_THIN_L2_ENTRIES], __ATOMIC_ACQUIRE);
+
+    return table != NULL ? __atomic_load_n(&table[blocknum % DISK_THIN_L2_ENTRIES], __ATOMIC_RELAXED) : 0;
+}
+
+/**
+ * Makes sure the L2 table of a block exists and can be changed, appending a new one to the
+ * image if needed. A table a snapshot shares moves to the end of the image as it is, leaving
+ * the snapshot its old copy. Called with the tables locked.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int table_get(struct thin *t, uint64_t blocknum)
+{
+    uint32_t i = blocknum / DISK_THIN_L2_ENTRIES;
+
+    if (t->l2[i] != NULL && t->l1[i] >= t->frozen)
+    {
+        return 0;
+    }
+
+    uint32_t *table = t->l2[i];
+    if (table == NULL)
+    {
+        table = disk_alloc_blocks(1);
+        if (table == NULL)
+        {
+            printf("   ERROR: Could not allocate an L2 table.\n");
+            return -1;
+        }
+        memset(table, 0, BLOCK_SIZE);
+        t->stats.tables++;
+    }
+
+    // The table reaches the image on the next flush, before the L1 entry pointing at it.
+    t->l1[i] = t->next++;
+    t->header_dirty = 1;
+    __atomic_store_n(&t->l1_dirty[i / L1_PER_BLOCK], 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&t->l2_dirty[i], 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&t->l2[i], table, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * Moves the blocks of iov whose image blocks are in `where`, in runs of consecutive image
+ * blocks. Entries of 0 are skipped.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int move(struct vdisk *d, int write, const struct disk_iovec *iov, const uint32_t *where, int count)
+{
+    int i = 0;
+
+    while (i < count)
+    {
+        if (where[i] == 0)
+        {
+            i++;
+            continue;
+        }
+
+        int n = 1;
+        while (i + n < count && where[i + n] == where[i] + n)
+        {
+            n++;
+        }
+
+        uint64_t offset = (uint64_t)where[i] * BLOCK_SIZE;
+
+        if (disk_internal_extentv(d, write, offset, iov + i, n) != 0)
+        {
+            printf("   ERROR: Could not %s %d blocks.\n", write ? "write" : "read", n);
+            return -1;
+        }
+
+        if (d->model != NULL)
+        {
+            disk_model_charge_bytes(d, write, offset, (uint64_t)n * BLOCK_SIZE);
+        }
+
+        i += n;
+    }
+
+    return 0;
+}
+
+/**
+ * Writes up to CHUNK blocks. A block stored since the last snapshot is rewritten in place.
+ * Any other gets an image block appended in its order, unless it is zeros, which need none;
+ * its entry is set once it is stored.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int write_chunk(struct vdisk *d, const struct disk_iovec *iov, int count)
+{
+    struct thin *t = d->thin;
+    uint32_t old[CHUNK];
+    uint32_t where[CHUNK];
+    uint8_t remap[CHUNK]; // KEEP, STORE or DROP
+    int remapped = 0;
+
+    if (t->readonly)
+    {
+        printf("   ERROR: A snapshot cannot be written.\n");
+        return -1;
+    }
+
+    // No snapshot is taken until the blocks are stored and mapped.
+    pthread_rwlock_rdlock(&t->snap_lock);
+
+    for (int i = 0; i < count; i++)
+    {
+        old[i] = lookup(t, iov[i].blocknum);
+        where[i] = old[i];
+        remap[i] = 0;
+
+        if (old[i] == 0 || old[i] < t->frozen)
+        {
+            where[i] = 0;
+            remap[i] = !is_zero(iov[i].buf) ? STORE : old[i] != 0 ? DROP : KEEP;
+            remapped += remap[i] != KEEP;
+        }
+    }
+
+    if (remapped > 0)
+    {
+        // Append the tables first, so the new blocks follow one another.
+        pthread_mutex_lock(&t->lock);
+        for (int i = 0; i < count; i++)
+        {
+            if (remap[i] != KEEP && table_get(t, iov[i].blocknum) != 0)
+            {
+                pthread_mutex_unlock(&t->lock);
+                pthread_rwlock_unlock(&t->snap_lock);
+                return -1;
+            }
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if (remap[i] == STORE)
+            {
+                where[i] = t->next++;
+                *(old[i] == 0 ? &t->stats.allocated : &t->stats.copied) += 1;
+            }
+            else if (remap[i] == DROP)
+            {
+                t->stats.allocated--;
+            }
+        }
+        t->header_dirty = 1;
+        pthread_mutex_unlock(&t->lock);
+    }
+
+    int result = move(d, 1, iov, where, count);
+
+    for (int i = 0; result == 0 && i < count; i++)
+    {
+        if (remap[i] != KEEP)
+        {
+            uint32_t n = iov[i].blocknum / DISK_THIN_L2_ENTRIES;
+
+            __atomic_store_n(&t->l2[n][iov[i].blocknum % DISK_THIN_L2_ENTRIES], where[i], __ATOMIC_RELAXED);
+            __atomic_store_n(&t->l2_dirty[n], 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    pthread_rwlock_unlock(&t->snap_lock);
+    return result;
+}
+
+/**
+ * Reads up to CHUNK blocks. Blocks never written are zeroed without I/O.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int read_chunk(struct vdisk *d, const struct disk_iovec *iov, int count)
+{
+    struct thin *t = d->thin;
+    uint32_t where[CHUNK];
+    int zeros = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        where[i] = lookup(t, iov[i].blocknum);
+        if (where[i] == 0)
+        {
+            memset(iov[i].buf, 0, BLOCK_SIZE);
+            zeros++;
+        }
+    }
+
+    __atomic_add_fetch(&t->stats.zero_reads, zeros, __ATOMIC_RELAXED);
+    return zeros < count ? move(d, 0, iov, where, count) : 0;
+}
+
+/**
+ * Loads the L1 table at block `l1_at` of the image, and every L2 table it points at, in place
+ * of the tables of t. Every table and block must lie in the image.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int load_tables(struct vdisk *d, struct thin *t, uint32_t l1_at)
+{
+    if (t->l1_blocks > 0 && disk_internal_region(d, 0, l1_at, t->l1, t->l1_blocks) != 0)
+    {
+        return -1;
+    }
+
+    t->stats.tables = 0;
+    t->stats.allocated = 0;
+
+    for (uint32_t i = 0; i < t->l1_entries; i++)
+    {
+        if (t->l1[i] == 0)
+        {
+            disk_free_blocks(t->l2[i]);
+            t->l2[i] = NULL;
+            continue;
+        }
+
+        if (t->l1[i] <= t->l1_blocks || t->l1[i] >= t->next ||
+            (t->l2[i] == NULL && (t->l2[i] = disk_alloc_blocks(1)) == NULL) ||
+            disk_internal_region(d, 0, t->l1[i], t->l2[i], 1) != 0)
+        {
+            return -1;
+        }
+
+        t->stats.tables++;
+        for (int j = 0; j < DISK_THIN_L2_ENTRIES; j++)
+        {
+            if (t->l2[i][j] != 0 && (t->l2[i][j] <= t->l1_blocks || t->l2[i][j] >= t->next))
+            {
+                return -1;
+            }
+            t->stats.allocated += t->l2[i][j] != 0;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Writes the changed L2 tables, then the L1 blocks pointing at them, then the header sizing
+ * the image. Called with the tables locked.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int flush_tables(struct vdisk *d, struct thin *t)
+{
+    // Clear each flag first: an entry changed during the write sets it again.
+    for (uint32_t i = 0; i < t->l1_entries; i++)
+    {
+        if (__atomic_exchange_n(&t->l2_dirty[i], 0, __ATOMIC_ACQ_REL) != 0 &&
+            disk_internal_region(d, 1, t->l1[i], t->l2[i], 1) != 0)
+        {
+            __atomic_store_n(&t->l2_dirty[i], 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < t->l1_blocks; i++)
+    {
+        if (__atomic_exchange_n(&t->l1_dirty[i], 0, __ATOMIC_ACQ_REL) != 0 &&
+            disk_internal_region(d, 1, 1 + i, t->l1 + (size_t)i * L1_PER_BLOCK, 1) != 0)
+        {
+            __atomic_store_n(&t->l1_dirty[i], 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+    }
+
+    if (!t->header_dirty)
+    {
+        return 0;
+    }
+
+    struct thin_header *h = disk_alloc_blocks(1);
+    int result = -1;
+
+    if (h != NULL)
+    {
+        memset(h, 0, BLOCK_SIZE);
+        memcpy(h->magic, DISK_THIN_MAGIC, sizeof(h->magic));
+        h->version = DISK_THIN_VERSION;
+        h->block_size = BLOCK_SIZE;
+        h->nblocks = d->nblocks;
+        h->l1_blocks = t->l1_blocks;
+        h->next_block = t->next;
+        h->frozen = t->frozen;
+        h->snapshot_dir = t->dir;
+        h->snapshots = t->nsnaps;
+        result = disk_internal_region(d, 1, 0, h, 1);
+        disk_free_blocks(h);
+    }
+
+    t->header_dirty = result != 0;
+    return result;
+}
+
+void disk_thin_get_stats(struct disk_thin_stats *stats)
+{
+    vdisk_thin_get_stats(disk_default(), stats);
+}
+
+void vdisk_thin_get_stats(struct vdisk *d, struct disk_thin_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (d == NULL || d->thin == NULL)
+    {
+        return;
+    }
+
+    struct thin *t = d->thin;
+
+    pthread_mutex_lock(&t->lock);
+    stats->allocated = t->stats.allocated;
+    stats->tables = t->stats.tables;
+    stats->image_blocks = t->next;
+    stats->snapshots = t->nsnaps;
+    stats->copied = t->stats.copied;
+    pthread_mutex_unlock(&t->lock);
+    stats->zero_reads = __atomic_load_n(&t->stats.zero_reads, __ATOMIC_RELAXED);
+}
+
+/**
+ * Copies blocks first..first+count-1 from one disk to another, CHUNK at a time.
+ *
+ * @param buf Room for CHUNK blocks.
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int copy_blocks(struct vdisk *from, struct vdisk *to, uint64_t first, uint32_t count, uint8_t *buf)
+{
+    struct disk_iovec iov[CHUNK];
+
+    for (uint32_t done = 0; done < count; done += CHUNK)
+    {
+        int n = count - done < CHUNK ? count - done : CHUNK;
+
+        for (int i = 0; i < n; i++)
+        {
+            iov[i].blocknum = first + done + i;
+            iov[i].buf = buf + (size_t)i * BLOCK_SIZE;
+        }
+
+        if (vdisk_readv(from, iov, n) != n * BLOCK_SIZE || vdisk_writev(to, iov, n) != n * BLOCK_SIZE)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int disk_thin_import(char *flat, char *thin)
+{
+    struct vdisk *from = vdisk_open(flat, 0);
+    if (from == NULL)
+    {
+        printf("   ERROR: Could not open %s.\n", flat);
+        return -1;
+    }
+
+    struct vdisk *to = vdisk_init(thin, from->nblocks, DISK_THIN);
+    uint8_t *buf = disk_alloc_blocks(CHUNK);
+    int result = to != NULL && buf != NULL ? 0 : -1;
+
+    // Copy the extents that hold data, skipping the holes of a sparse image. A filesystem that
+    // cannot tell them apart has one extent over the whole image.
+    off_t end = (off_t)from->nblocks * BLOCK_SIZE;
+    off_t start = 0;
+
+    while (result == 0 && start < end)
+    {
+        off_t data = lseek(from->fd, start, SEEK_DATA);
+        if (data < 0)
+        {
+            data = errno == ENXIO ? end : start;
+        }
+        if (data >= end)
+        {
+            break;
+        }
+
+        off_t hole = lseek(from->fd, data, SEEK_HOLE);
+        if (hole < 0 || hole > end)
+        {
+            hole = end;
+        }
+
+        // Round out to whole blocks; blocks of zeros inside an extent are not stored anyway.
+        uint64_t first = data / BLOCK_SIZE;
+        uint64_t last = (hole + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        result = copy_blocks(from, to, first, last - first, buf);
+        start = (off_t)last * BLOCK_SIZE;
+    }
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not convert %s to %s.\n", flat, thin);
+    }
+
+    disk_free_blocks(buf);
+    if (to != NULL && vdisk_close(to, 0) != 0)
+    {
+        result = -1;
+    }
+    vdisk_close(from, 0);
+    return result;
+}
+
+int disk_thin_export(char *thin, char *flat)
+{
+    struct vdisk *from = vdisk_open(thin, DISK_THIN);
+    if (from == NULL)
+    {
+        printf("   ERROR: Could not open %s.\n", thin);
+        return -1;
+    }
+
+    struct vdisk *to = vdisk_init(flat, from->nblocks, 0);
+    uint8_t *buf = disk_alloc_blocks(CHUNK);
+    int result = to != NULL && buf != NULL ? 0 : -1;
+    struct thin *t = from->thin;
+
+    // Copy the runs of blocks that were written; the rest stay holes.
+    for (uint64_t b = 0; result == 0 && b < from->nblocks;)
+    {
+        if (t->l2[b / DISK_THIN_L2_ENTRIES] == NULL)
+        {
+            b = (b / DISK_THIN_L2_ENTRIES + 1) * DISK_THIN_L2_ENTRIES;
+            continue;
+        }
+
+        uint32_t n = 0;
+        while (b + n < from->nblocks && lookup(t, b + n) != 0)
+        {
+            n++;
+        }
+
+        result = copy_blocks(from, to, b, n, buf);
+        b += n + 1;
+    }
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not convert %s to %s.\n", thin, flat);
+    }
+
+    disk_free_blocks(buf);
+    if (to != NULL && vdisk_close(to, 0) != 0)
+    {
+        result = -1;
+    }
+    vdisk_close(from, 0);
+    return result;
+}
+
+/**
+ * Takes a snapshot: stores the tables as they are, then a copy of the L1 table pointing at
+ * them, and freezes everything stored so far. Called with the tables locked and no write in
+ * progress.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int take_snapshot(struct vdisk *d, struct thin *t, char *name)
+{
+    uint32_t n = t->nsnaps;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (strcmp(t->snaps[i].name, name) == 0)
+        {
+            printf("   ERROR: Snapshot %s already exists.\n", name);
+            return -1;
+        }
+    }
+
+    if (n == DISK_THIN_MAX_SNAPSHOTS)
+    {
+        printf("   ERROR: The image has %d snapshots already.\n", (int)DISK_THIN_MAX_SNAPSHOTS);
+        return -1;
+    }
+
+    if (flush_tables(d, t) != 0)
+    {
+        printf("   ERROR: Could not write the mapping tables.\n");
+        return -1;
+    }
+
+    // The copy goes to the end of the image, followed by the snapshot list the first time.
+    uint32_t l1_at = t->next;
+    uint32_t dir = t->dir != 0 ? t->dir : l1_at + t->l1_blocks;
+
+    if (t->l1_blocks > 0 && disk_internal_region(d, 1, l1_at, t->l1, t->l1_blocks) != 0)
+    {
+        printf("   ERROR: Could not write the snapshot.\n");
+        return -1;
+    }
+
+    memset(&t->snaps[n], 0, sizeof(t->snaps[n]));
+    strcpy(t->snaps[n].name, name);
+    t->snaps[n].time = time(NULL);
+    t->snaps[n].l1_block = l1_at;
+    t->snaps[n].blocks = t->stats.allocated;
+
+    if (disk_internal_region(d, 1, dir, t->snaps, 1) != 0)
+    {
+        memset(&t->snaps[n], 0, sizeof(t->snaps[n]));
+        printf("   ERROR: Could not write the snapshot list.\n");
+        return -1;
+    }
+
+    // From here on, nothing stored so far is written again.
+    t->next = l1_at + t->l1_blocks + (t->dir == 0);
+    t->dir = dir;
+    t->nsnaps = n + 1;
+    t->frozen = t->next;
+    t->header_dirty = 1;
+
+    if (flush_tables(d, t) != 0)
+    {
+        printf("   ERROR: Could not write the thin image header.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int disk_thin_snapshot(char *name)
+{
+    return vdisk_thin_snapshot(disk_default(), name);
+}
+
+int vdisk_thin_snapshot(struct vdisk *d, char *name)
+{
+    if (d == NULL || d->thin == NULL || d->thin->readonly)
+    {
+        printf("   ERROR: Disk is not a writable thin-provisioned image.\n");
+        return -1;
+    }
+
+    if (name == NULL || name[0] == '\0' || strlen(name) >= DISK_THIN_SNAPSHOT_NAME)
+    {
+        printf("   ERROR: Invalid snapshot name.\n");
+        return -1;
+    }
+
+    // Write out what the cache and the scheduler still hold, so the snapshot sees it.
+    if (vdisk_flush(d) != 0)
+    {
+        return -1;
+    }
+
+    struct thin *t = d->thin;
+
+    pthread_rwlock_wrlock(&t->snap_lock);
+    pthread_mutex_lock(&t->lock);
+    int result = take_snapshot(d, t, name);
+    pthread_mutex_unlock(&t->lock);
+    pthread_rwlock_unlock(&t->snap_lock);
+
+    return result;
+}
+
+int disk_thin_snapshot_list(struct disk_thin_snapshot *list, int max)
+{
+    return vdisk_thin_snapshot_list(disk_default(), list, max);
+}
+
+int vdisk_thin_snapshot_list(struct vdisk *d, struct disk_thin_snapshot *list, int max)
+{
+    if (d == NULL || d->thin == NULL)
+    {
+        printf("   ERROR: Disk is not thin-provisioned.\n");
+        return -1;
+    }
+
+    struct thin *t = d->thin;
+
+    pthread_mutex_lock(&t->lock);
+    int n = t->nsnaps;
+    for (int i = 0; i < n && i < max; i++)
+    {
+        list[i] = t->snaps[i];
+    }
+    pthread_mutex_unlock(&t->lock);
+
+    return n;
+}
+
+/**
+ * Opens a thin-provisioned image with the tables of one of its snapshots in place of its own.
+ *
+ * @return Returns the disk, or NULL on failure.
+ */
+static struct vdisk *open_snapshot(char *filename, char *name)
+{
+    struct vdisk *d = vdisk_open(filename, DISK_THIN);
+    if (d == NULL)
+    {
+        printf("   ERROR: Could not open %s.\n", filename);
+        return NULL;
+    }
+
+    struct thin *t = d->thin;
+    uint32_t i = 0;
+
+    while (i < t->nsnaps && strcmp(t->snaps[i].name, name) != 0)
+    {
+        i++;
+    }
+
+    if (i == t->nsnaps)
+    {
+        printf("   ERROR: %s has no snapshot %s.\n", filename, name);
+    }
+    else if (t->snaps[i].l1_block + t->l1_blocks > t->frozen || load_tables(d, t, t->snaps[i].l1_block) != 0)
+    {
+        printf("   ERROR: Could not read snapshot %s.\n", name);
+    }
+    else
+    {
+        return d;
+    }
+
+    // Nothing was marked changed, so nothing is written back.
+    vdisk_close(d, 0);
+    return NULL;
+}
+
+struct vdisk *vdisk_thin_snapshot_open(char *filename, char *name)
+{
+    struct vdisk *d = open_snapshot(filename, name);
+
+    if (d != NULL)
+    {
+        d->thin->readonly = 1;
+    }
+
+    return d;
+}
+
+int disk_thin_rollback(char *filename, char *name)
+{
+    struct vdisk *d = open_snapshot(filename, name);
+
+    if (d == NULL)
+    {
+        return -1;
+    }
+
+    // Make the tables of the snapshot the current ones. They stay frozen, so the snapshot
+    // keeps them.
+    struct thin *t = d->thin;
+    memset(t->l1_dirty, 1, t->l1_blocks);
+    t->header_dirty = 1;
+
+    return vdisk_close(d, 0);
+}
+
+/*------------------------------------------- HOOKS ---------------------------------------------*/
+
+/**
+ * Frees the tables of t.
+ */
+static void thin_free(struct thin *t)
+{
+    for (uint32_t i = 0; t->l2 != NULL && i < t->l1_entries; i++)
+    {
+        disk_free_blocks(t->l2[i]);
+    }
+
+    disk_free_blocks(t->l1);
+    disk_free_blocks(t->snaps);
+    free(t->l2);
+    free(t->l1_dirty);
+    free(t->l2_dirty);
+    free(t);
+}
+
+int disk_thin_attach(struct vdisk *d, int create)
+{
+    struct thin_header *h = disk_alloc_blocks(1);
+    struct thin *t = calloc(1, sizeof(struct thin));
+
+    if (h == NULL || t == NULL)
+    {
+        printf("   ERROR: Could not allocate the L1 table.\n");
+        disk_free_blocks(h);
+        free(t);
+        return -1;
+    }
+
+    if (create && d->nblocks > DISK_THIN_MAX_BLOCKS)
+    {
+        printf("   ERROR: A thin-provisioned image holds at most %u blocks.\n", DISK_THIN_MAX_BLOCKS);
+        disk_free_blocks(h);
+        free(t);
+        return -1;
+    }
+
+    // A new image gets a header; an existing one must have a header of this format.
+    uint32_t entries = (d->nblocks + DISK_THIN_L2_ENTRIES - 1) / DISK_THIN_L2_ENTRIES;
+    if (create)
+    {
+        memset(h, 0, BLOCK_SIZE);
+        memcpy(h->magic, DISK_THIN_MAGIC, sizeof(h->magic));
+        h->version = DISK_THIN_VERSION;
+        h->block_size = BLOCK_SIZE;
+        h->nblocks = d->nblocks;
+        h->l1_blocks = (entries + L1_PER_BLOCK - 1) / L1_PER_BLOCK;
+        h->next_block = 1 + h->l1_blocks;
+    }
+    else if (disk_internal_region(d, 0, 0, h, 1) != 0 || memcmp(h->magic, DISK_THIN_MAGIC, sizeof(h->magic)) != 0 ||
+             h->version != DISK_THIN_VERSION || h->block_size != BLOCK_SIZE ||
+             h->l1_blocks != ((h->nblocks + DISK_THIN_L2_ENTRIES - 1) / DISK_THIN_L2_ENTRIES + L1_PER_BLOCK - 1) / L1_PER_BLOCK ||
+             h->next_block < 1 + h->l1_blocks || h->frozen > h->next_block || h->snapshot_dir >= h->next_block ||
+             h->snapshots > (h->snapshot_dir != 0 ? DISK_THIN_MAX_SNAPSHOTS : 0))
+    {
+        printf("   ERROR: The disk is not a thin-provisioned image.\n");
+        disk_free_blocks(h);
+        free(t);
+        return -1;
+    }
+
+    t->l1_entries = (h->nblocks + DISK_THIN_L2_ENTRIES - 1) / DISK_THIN_L2_ENTRIES;
+    t->l1_blocks = h->l1_blocks;
+    t->next = h->next_block;
+    t->frozen = h->frozen;
+    t->dir = h->snapshot_dir;
+    t->nsnaps = h->snapshots;
+
+    // Block-aligned, so L1 blocks and the snapshot list go to the image straight from memory.
+    t->l1 = t->l1_blocks > 0 ? disk_alloc_blocks(t->l1_blocks) : NULL;
+    t->snaps = disk_alloc_blocks(1);
+    t->l2 = calloc(t->l1_entries + 1, sizeof(uint32_t *));
+    t->l1_dirty = calloc(t->l1_blocks + 1, 1);
+    t->l2_dirty = calloc(t->l1_entries + 1, 1);
+
+    if ((t->l1_blocks > 0 && t->l1 == NULL) || t->snaps == NULL || t->l2 == NULL || t->l1_dirty == NULL ||
+        t->l2_dirty == NULL)
+    {
+        printf("   ERROR: Could not allocate the L1 table.\n");
+        thin_free(t);
+        disk_free_blocks(h);
+        return -1;
+    }
+    memset(t->snaps, 0, BLOCK_SIZE);
+
+    // A new image is sized by its header and last L1 block; the L1 blocks between stay sparse.
+    // An existing one has its current tables loaded, and its snapshots listed.
+    int result;
+    if (create)
+    {
+        memset(t->l1, 0, (size_t)t->l1_blocks * BLOCK_SIZE);
+        result = disk_internal_region(d, 1, 0, h, 1);
+        if (result == 0 && t->l1_blocks > 0)
+        {
+            result = disk_internal_region(d, 1, t->l1_blocks, t->l1 + (size_t)(t->l1_blocks - 1) * L1_PER_BLOCK, 1);
+        }
+    }
+    else
+    {
+        result = load_tables(d, t, 1);
+        if (result == 0 && t->dir != 0)
+        {
+            result = disk_internal_region(d, 0, t->dir, t->snaps, 1);
+        }
+        for (uint32_t i = 0; i < t->nsnaps; i++)
+        {
+            t->snaps[i].name[DISK_THIN_SNAPSHOT_NAME - 1] = '\0';
+        }
+    }
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not %s the mapping tables.\n", create ? "write" : "read");
+        thin_free(t);
+        disk_free_blocks(h);
+        return -1;
+    }
+
+    // Let a snapshot waiting for the writes in progress go before the writes that follow.
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&t->snap_lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    pthread_mutex_init(&t->lock, NULL);
+
+    d->nblocks = h->nblocks;
+    d->thin = t;
+    disk_free_blocks(h);
+    return 0;
+}
+
+int disk_thin_flush(struct vdisk *d)
+{
+    struct thin *t = d->thin;
+
+    if (t == NULL)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&t->lock);
+    int result = flush_tables(d, t);
+    pthread_mutex_unlock(&t->lock);
+
+    if (result != 0)
+    {
+        printf("   ERROR: Could not write the mapping tables.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void disk_thin_detach(struct vdisk *d)
+{
+    struct thin *t = d->thin;
+
+    if (t != NULL)
+    {
+        d->thin = NULL;
+        pthread_mutex_destroy(&t->lock);
+        pthread_rwlock_destroy(&t->snap_lock);
+        thin_free(t);
+    }
+}
+
+int disk_thin_run(struct vdisk *d, int write, const struct disk_iovec *iov, int count)
+{
+    for (int done = 0; done < count; done += CHUNK)
+    {
+        int n = count - done < CHUNK ? count - done : CHUNK;
+
+        if ((write ? write_chunk(d, iov + done, n) : read_chunk(d, iov + done, n)) != 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file
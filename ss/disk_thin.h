@@ -0,0 +1,144 @@
+/**
+ * @file disk_thin.h
+ * @brief This header file contains the declarations of the thin-provisioned image format.
+ *
+ * A disk created with DISK_THIN stores only the blocks that were written, so its image grows
+ * with the data on it rather than with its size. The image starts with a header block and an
+ * L1 table of one entry per DISK_THIN_L2_ENTRIES blocks, each pointing at an L2 table, itself
+ * one block of entries pointing at where each block is stored. L2 tables and blocks are
+ * appended to the image as they are first needed, so a disk written in order keeps its blocks
+ * in order, and runs of them are moved with one preadv/pwritev.
+ *
+ * A block never written has no entry, and reads back as zeros without any I/O. Writing zeros
+ * to it leaves it so. The tables are kept in memory while the disk is open, and written back
+ * by disk_flush() and disk_close().
+ *
+ * A snapshot is a copy of the L1 table, taken in the time it takes to write the tables out.
+ * Everything stored before it is frozen from then on: a write to a frozen block goes to a new
+ * one at the end of the image, and so does the L2 table mapping it, while the snapshot keeps
+ * pointing at the old versions. A snapshot can be opened read-only while the disk is in use,
+ * or the disk rolled back to it. The space of old versions is not reclaimed; exporting and
+ * importing an image compacts it, without its snapshots.
+ *
+ * disk_thin_import() and disk_thin_export() convert images between this format and the flat one.
+ *
+ */
+
+#ifndef DISK_THIN_H
+#define DISK_THIN_H
+
+#include <stdint.h>
+
+#include "disk.h"
+
+#define DISK_THIN_MAGIC "RZTHIN01"
+#define DISK_THIN_VERSION 1
+#define DISK_THIN_MAX_BLOCKS UINT32_MAX // most blocks, as the tables hold 32-bit block numbers
+#define DISK_THIN_L2_ENTRIES (BLOCK_SIZE / 4) // blocks mapped by one L2 table
+#define DISK_THIN_SNAPSHOT_NAME 48            // longest snapshot name, with its terminating zero
+#define DISK_THIN_MAX_SNAPSHOTS (BLOCK_SIZE / sizeof(struct disk_thin_snapshot))
+
+/**
+ * @brief Counters kept by a thin-provisioned disk.
+ *
+ * @param allocated The blocks stored in the image.
+ * @param tables The L2 tables stored in the image.
+ * @param image_blocks The size of the image, in blocks.
+ * @param zero_reads The blocks read as zeros without I/O, since they were never written.
+ * @param snapshots The snapshots of the image.
+ * @param copied The blocks written to a new place since a snapshot kept their old version.
+ */
+struct disk_thin_stats
+{
+    uint64_t allocated;
+    uint64_t tables;
+    uint64_t image_blocks;
+    uint64_t zero_reads;
+    uint64_t snapshots;
+    uint64_t copied;
+};
+
+/**
+ * @brief One snapshot of a thin-provisioned image, as listed in the image.
+ *
+ * @param name Its name.
+ * @param time When it was taken, in seconds since the epoch.
+ * @param l1_block Where its copy of the L1 table starts in the image.
+ * @param blocks The blocks it holds data for.
+ */
+struct disk_thin_snapshot
+{
+    char name[DISK_THIN_SNAPSHOT_NAME];
+    int64_t time;
+    uint32_t l1_block;
+    uint32_t blocks;
+};
+
+/**
+ * @brief Copies the counters of the default disk into stats. They are all zero when it was not
+ * opened with DISK_THIN.
+ *
+ * @param stats Where to store the counters.
+ */
+void disk_thin_get_stats(struct disk_thin_stats *stats);
+
+/**
+ * @brief Takes a snapshot of the default disk, which must be opened with DISK_THIN. Blocks
+ * dirty in the cache or queued in the scheduler are written out first. Writes from other
+ * threads wait while the tables are written, and land after the snapshot.
+ *
+ * @param name A name no other snapshot of the image has, shorter than DISK_THIN_SNAPSHOT_NAME.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_thin_snapshot(char *name);
+
+/**
+ * @brief Copies the snapshots of the default disk into list, oldest first.
+ *
+ * @param max The room in list.
+ * @return int Returns the number of snapshots, which may be more than max, or -1 if the disk
+ * is not thin-provisioned.
+ */
+int disk_thin_snapshot_list(struct disk_thin_snapshot *list, int max);
+
+/**
+ * @brief Opens a snapshot of the thin-provisioned image `filename` as a disk of its own, which
+ * reads the blocks as they were when it was taken and fails every write. The image may be
+ * open and written at the same time, as long as its snapshot was flushed.
+ *
+ * @return struct vdisk* Returns the disk, to be closed with vdisk_close(), or NULL on failure.
+ */
+struct vdisk *vdisk_thin_snapshot_open(char *filename, char *name);
+
+/**
+ * @brief Rolls the thin-provisioned image `filename` back to a snapshot, dropping what was
+ * written since. The snapshot is kept. The image must not be open.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_thin_rollback(char *filename, char *name);
+
+/**
+ * @brief Converts the flat image `flat` into a new thin-provisioned image `thin` of the same
+ * size. Only the blocks that hold data are stored; holes of a sparse flat image are not read.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_thin_import(char *flat, char *thin);
+
+/**
+ * @brief Converts the thin-provisioned image `thin` into a new flat image `flat` of the same
+ * size. Blocks never written are left as holes of the sparse flat image.
+ *
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_thin_export(char *thin, char *flat);
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+void vdisk_thin_get_stats(struct vdisk *d, struct disk_thin_stats *stats);
+int vdisk_thin_snapshot(struct vdisk *d, char *name);
+int vdisk_thin_snapshot_list(struct vdisk *d, struct disk_thin_snapshot *list, int max);
+
+#endif
\ No newline at end of file
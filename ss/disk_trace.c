@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disk_trace.h"
+#include "disk_internal.h"
+
+#define TRACE_MAX_COUNT 65535 // most blocks in one record
+
+/**
+ * A running trace.
+ *
+ * @param file The trace file.
+ * @param flags The flags the trace was started with.
+ * @param start_ns The disk_stats_now() of when the trace started.
+ * @param failed 1 once a record could not be written.
+ */
+struct trace
+{
+    FILE *file;
+    int flags;
+    uint64_t start_ns;
+    int failed;
+};
+
+uint64_t disk_trace_hash(uint64_t hash, const void *block)
+{
+    const uint8_t *bytes = block;
+
+    for (int i = 0; i < BLOCK_SIZE; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+int disk_trace_start(const char *filename, int flags)
+{
+    return vdisk_trace_start(disk_default(), filename, flags);
+}
+
+int vdisk_trace_start(struct vdisk *d, const char *filename, int flags)
+{
+    if (d == NULL)
+    {
+        printf("   ERROR: Disk is not open.\n");
+        return -1;
+    }
+
+    struct trace *t = calloc(1, sizeof(struct trace));
+    if (t == NULL)
+    {
+        printf("   ERROR: Could not allocate trace.\n");
+        return -1;
+    }
+
+    t->file = fopen(filename, "wb");
+    if (t->file == NULL)
+    {
+        printf("   ERROR: Could not create trace file %s.\n", filename);
+        free(t);
+        return -1;
+    }
+
+    struct disk_trace_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DISK_TRACE_MAGIC, sizeof(header.magic));
+    header.version = DISK_TRACE_VERSION;
+    header.flags = flags;
+    header.block_size = BLOCK_SIZE;
+    header.nblocks = d->nblocks;
+
+    if (fwrite(&header, sizeof(header), 1, t->file) != 1)
+    {
+        printf("   ERROR: Could not write trace file %s.\n", filename);
+        fclose(t->file);
+        free(t);
+        return -1;
+    }
+
+    t->flags = flags;
+    t->start_ns = disk_stats_now();
+
+    // A trace already running is finished first, so its file is complete.
+    vdisk_trace_stop(d);
+
+    disk_internal_lock(d);
+    d->trace = t;
+    disk_internal_unlock(d);
+
+    return 0;
+}
+
+int disk_trace_stop()
+{
+    return vdisk_trace_stop(disk_default());
+}
+
+int vdisk_trace_stop(struct vdisk *d)
+{
+    if (d == NULL)
+    {
+        return 0;
+    }
+
+    disk_internal_lock(d);
+    struct trace *t = d->trace;
+    d->trace = NULL;
+    disk_internal_unlock(d);
+
+    if (t == NULL)
+    {
+        return 0;
+    }
+
+    int failed = t->failed;
+    if (fclose(t->file) != 0)
+    {
+        failed = 1;
+    }
+    free(t);
+
+    if (failed)
+    {
+        printf("   ERROR: Could not write the whole trace.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*------------------------------------------- HOOKS ---------------------------------------------*/
+
+void disk_trace_record(struct vdisk *d, int write, uint64_t start_ns, const struct disk_iovec *iov, int count, int async)
+{
+    disk_internal_lock(d);
+    struct trace *t = d->trace;
+
+    // Write one record per run of contiguous blocks.
+    for (int i = 0; t != NULL && i < count;)
+    {
+        struct disk_trace_record r;
+        memset(&r, 0, sizeof(r));
+        r.time_ns = start_ns > t->start_ns ? start_ns - t->start_ns : 0;
+        r.blocknum = iov[i].blocknum;
+        r.op = write ? DISK_TRACE_WRITE : DISK_TRACE_READ;
+        r.flags = (async ? DISK_TRACE_ASYNC : 0) | (i > 0 ? DISK_TRACE_VECTORED : 0);
+
+        uint64_t hash = DISK_TRACE_SEED;
+        do
+        {
+            if (t->flags & DISK_TRACE_HASH)
+            {
+                hash = disk_trace_hash(hash, iov[i].buf);
+            }
+            r.count++;
+            i++;
+        } while (i < count && r.count < TRACE_MAX_COUNT && iov[i].blocknum == r.blocknum + r.count);
+
+        r.hash = (t->flags & DISK_TRACE_HASH) ? hash : 0;
+
+        if (fwrite(&r, sizeof(r), 1, t->file) != 1)
+        {
+            t->failed = 1;
+        }
+    }
+
+    disk_internal_unlock(d);
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+/**
+ * @file disk_trace.h
+ * @brief This header file contains the declarations of the block I/O trace.
+ *
+ * While a trace is running, every request made to the disk is appended to a binary trace
+ * file: its time, whether it read or wrote, the blocks it covered and, optionally, a hash of
+ * the data moved. Requests are recorded as the file system makes them, before the cache, so a
+ * trace can be replayed against other cache and allocator designs with the replay tool. The
+ * reads the read-ahead makes ahead of the file system are asynchronous requests, and appear in
+ * the trace flagged DISK_TRACE_ASYNC.
+ *
+ * A trace file is a struct disk_trace_header followed by struct disk_trace_record entries, in
+ * the byte order of the machine that recorded it.
+ *
+ */
+
+#ifndef DISK_TRACE_H
+#define DISK_TRACE_H
+
+#include <stdint.h>
+
+#include "disk.h"
+
+#define DISK_TRACE_MAGIC "RZTRACE1" // first bytes of every trace file
+#define DISK_TRACE_VERSION 2 // version 1 had 32-bit block numbers; replay reads both
+
+/* Flags for disk_trace_start(). */
+#define DISK_TRACE_HASH (1 << 0) // hash the data of every request
+
+/* Operations of a record. */
+#define DISK_TRACE_READ 0
+#define DISK_TRACE_WRITE 1
+
+/* Flags of a record. */
+#define DISK_TRACE_ASYNC (1 << 0)    // made through disk_async_read/write/readv
+#define DISK_TRACE_VECTORED (1 << 1) // continues the disk_readv/disk_writev of the previous record
+
+#define DISK_TRACE_SEED 14695981039346656037ull // disk_trace_hash() of no data
+
+/**
+ * @brief The start of a trace file.
+ *
+ * @param magic DISK_TRACE_MAGIC, without the terminating zero.
+ * @param version DISK_TRACE_VERSION.
+ * @param flags The flags the trace was started with.
+ * @param block_size The block size of the disk.
+ * @param reserved 0.
+ * @param nblocks The number of blocks of the disk.
+ */
+struct disk_trace_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t block_size;
+    uint32_t reserved;
+    uint64_t nblocks;
+};
+
+/**
+ * @brief One run of contiguous blocks of a request. A disk_readv or disk_writev of scattered
+ * blocks takes one record per run, all but the first flagged DISK_TRACE_VECTORED.
+ *
+ * @param time_ns When the request was made, in nanoseconds since the trace started.
+ * @param hash The disk_trace_hash() of the data of the run (DISK_TRACE_HASH only), or 0.
+ * @param blocknum The first block of the run.
+ * @param count The number of blocks in the run.
+ * @param op DISK_TRACE_READ or DISK_TRACE_WRITE.
+ * @param flags DISK_TRACE_ASYNC and DISK_TRACE_VECTORED.
+ * @param reserved 0.
+ */
+struct disk_trace_record
+{
+    uint64_t time_ns;
+    uint64_t hash;
+    uint64_t blocknum;
+    uint16_t count;
+    uint8_t op;
+    uint8_t flags;
+    uint32_t reserved;
+};
+
+/**
+ * @brief Adds one block of data to a hash (64-bit FNV-1a). Start from DISK_TRACE_SEED and add
+ * the blocks of a run in order.
+ */
+uint64_t disk_trace_hash(uint64_t hash, const void *block);
+
+/**
+ * @brief Starts recording the requests made to the default disk, replacing any trace running.
+ *
+ * @param filename The trace file, which is created or truncated.
+ * @param flags 0, or DISK_TRACE_HASH.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int disk_trace_start(const char *filename, int flags);
+
+/**
+ * @brief Stops the trace and closes its file. Called by disk_close().
+ *
+ * @return int Returns 0 on success, -1 if the trace could not be written completely.
+ */
+int disk_trace_stop();
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above work on the default disk; these work on any disk (see struct vdisk). */
+int vdisk_trace_start(struct vdisk *d, const char *filename, int flags);
+int vdisk_trace_stop(struct vdisk *d);
+
+#endif
\ No newline at end of file
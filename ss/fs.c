@@ -1,78 +1,185 @@
-#include <math.h>
-#include <string.h>
-#include <stdlib.h>
-
-#include "fs.h"
-
-static int MOUNT_FLAG = 0;
-static union block SUPERBLOCK;
-static union block BLOCK_BITMAP;
-static union block INODE_BITMAP;
-
-int fs_format()
-{   
-    // TODO: Implement this function
-    return 0;
-}
-
-int fs_mount()
-{
-    //TODO: Implement this function
-    return 0;
-}
-
-void fs_unmount()
-{
-    if (MOUNT_FLAG == 0)
-    {
-        printf("\tError: Disk is not mounted.\n");
-        return;
-    }
-    // Set the mount flag to 0
-    MOUNT_FLAG = 0;
-}
-
-int fs_create(char *path, int is_directory)
-{
-    //TODO: Implement this function
-    return -1; // set the return value accordingly
-}
-
-int fs_remove(char *path)
-{
-    //TODO: Implement this function
-    return 0;
-}
-
-int fs_read(char *path, void *buf, size_t count, off_t offset)
-{
-    //TODO: Implement this function
-    return 0;
-}
-
-int fs_write(char *path, void *buf, size_t count, int append)
-{
-    //TODO: Implement this function
-    return 0;
-}
-
-int fs_list(char *path)
-{
-    //TODO: Implement this function
-    return 0;
-}
-
-void fs_stat()
-{
-    if (MOUNT_FLAG == 0)
-    {
-        printf("\tError: Disk is not mounted.\n");
-        return;
-    }
-
-    printf("Superblock:\n");
-    printf("    Blocks: %d\n", SUPERBLOCK.superblock.s_blocks_count);
-    printf("    Inodes: %d\n", SUPERBLOCK.superblock.s_inodes_count);
-    printf("    Inode Table Block Start: %d\n", SUPERBLOCK.superblock.s_inode_table_block_start);
-    printf("    Data Blocks Start: %d\n", SUPERBLOCK.superblock.s_data_blocks_start);
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "fs.h"
+#include "bitmap.h"
+#include "disk_dedup.h"
+
+/**
+ * The state of one file system. The bitmaps are opened on mount, and span as many blocks as
+ * the disk and the inode table need (see bitmap.h).
+ */
+struct vfs
+{
+    struct vdisk *disk;
+    int mount_flag;
+    union block superblock;
+    struct bitmap *block_bitmap;
+    struct bitmap *inode_bitmap;
+};
+
+static struct vfs DEFAULT_FS;
+
+/**
+ * Returns the context used by the fs_* functions, on whatever the default disk is now.
+ */
+static struct vfs *default_fs()
+{
+    DEFAULT_FS.disk = disk_default();
+    return &DEFAULT_FS;
+}
+
+struct vfs *vfs_init(struct vdisk *d)
+{
+    struct vfs *fs = calloc(1, sizeof(struct vfs));
+
+    if (fs == NULL)
+    {
+        printf("\tError: Could not allocate file system.\n");
+        return NULL;
+    }
+
+    fs->disk = d;
+    return fs;
+}
+
+void vfs_destroy(struct vfs *fs)
+{
+    if (fs == NULL)
+    {
+        return;
+    }
+
+    if (fs->mount_flag)
+    {
+        vfs_unmount(fs);
+    }
+    free(fs);
+}
+
+int fs_format()
+{
+    return vfs_format(default_fs());
+}
+
+int fs_mount()
+{
+    return vfs_mount(default_fs());
+}
+
+void fs_unmount()
+{
+    vfs_unmount(default_fs());
+}
+
+int fs_create(char *path, int is_directory)
+{
+    return vfs_create(default_fs(), path, is_directory);
+}
+
+int fs_remove(char *path)
+{
+    return vfs_remove(default_fs(), path);
+}
+
+int fs_read(char *path, void *buf, size_t count, off_t offset)
+{
+    return vfs_read(default_fs(), path, buf, count, offset);
+}
+
+int fs_write(char *path, void *buf, size_t count, int append)
+{
+    return vfs_write(default_fs(), path, buf, count, append);
+}
+
+int fs_list(char *path)
+{
+    return vfs_list(default_fs(), path);
+}
+
+void fs_stat()
+{
+    vfs_stat(default_fs());
+}
+
+int vfs_format(struct vfs *fs)
+{   
+    // TODO: Implement this function
+    return 0;
+}
+
+int vfs_mount(struct vfs *fs)
+{
+    //TODO: Implement this function
+    return 0;
+}
+
+void vfs_unmount(struct vfs *fs)
+{
+    if (fs->mount_flag == 0)
+    {
+        printf("\tError: Disk is not mounted.\n");
+        return;
+    }
+    bitmap_close(fs->block_bitmap);
+    bitmap_close(fs->inode_bitmap);
+    fs->block_bitmap = fs->inode_bitmap = NULL;
+
+    // Set the mount flag to 0
+    fs->mount_flag = 0;
+}
+
+int vfs_create(struct vfs *fs, char *path, int is_directory)
+{
+    //TODO: Implement this function
+    return -1; // set the return value accordingly
+}
+
+int vfs_remove(struct vfs *fs, char *path)
+{
+    //TODO: Implement this function
+    return 0;
+}
+
+int vfs_read(struct vfs *fs, char *path, void *buf, size_t count, off_t offset)
+{
+    //TODO: Implement this function
+    return 0;
+}
+
+int vfs_write(struct vfs *fs, char *path, void *buf, size_t count, int append)
+{
+    //TODO: Implement this function
+    return 0;
+}
+
+int vfs_list(struct vfs *fs, char *path)
+{
+    //TODO: Implement this function
+    return 0;
+}
+
+void vfs_stat(struct vfs *fs)
+{
+    if (fs->mount_flag == 0)
+    {
+        printf("\tError: Disk is not mounted.\n");
+        return;
+    }
+
+    printf("Superblock:\n");
+    printf("    Blocks: %d\n", fs->superblock.superblock.s_blocks_count);
+    printf("    Inodes: %d\n", fs->superblock.superblock.s_inodes_count);
+    printf("    Inode Table Block Start: %d\n", fs->superblock.superblock.s_inode_table_block_start);
+    printf("    Data Blocks Start: %d\n", fs->superblock.superblock.s_data_blocks_start);
+
+    // A deduplicated disk also tells how many blocks share each stored copy.
+    struct disk_dedup_stats dstats;
+    vdisk_dedup_get_stats(fs->disk, &dstats);
+    if (dstats.stored > 0)
+    {
+        printf("    Dedup Ratio: %.2f (%llu blocks in %llu)\n", (double)dstats.blocks / dstats.stored,
+               (unsigned long long)dstats.blocks, (unsigned long long)dstats.stored);
+    }
 }
\ No newline at end of file
@@ -1,218 +1,351 @@
-/**
- * @file fs.h
- * @brief This header file contains the structures and constants used in the file system.
- *
- * This header file contains the following structures:
- * - superblock: contains information about the file system.
- * - inode: contains information about a file or directory.
- * - directory_entry: contains information about a directory entry.
- * - directory_block: contains an array of directory entries.
- * - block: contains all possible types of blocks in the file system.
- *
- * This header file also defines the following constants:
- * - INODE_SIZE: size of an inode in bytes.
- * - INODES_PER_BLOCK: number of inodes that can fit in a block.
- * - INODE_DIRECT_POINTERS: number of direct pointers in an inode.
- * - INODE_INDIRECT_POINTERS_PER_BLOCK: number of indirect pointers that can fit in a block.
- * - DIRECTORY_ENTRY_SIZE: size of a directory entry in bytes.
- * - DIRECTORY_NAME_SIZE: maximum size of a directory name in bytes.
- * - DIRECTORY_ENTRIES_PER_BLOCK: number of directory entries that can fit in a block.
- *
- * This header file includes the following header files:
- * - stdint.h: defines integer types.
- * - disk.h: defines constants and functions related to the disk.
- */
-#ifndef FS_H
-#define FS_H
-
-#include <stdint.h>
-#include <sys/types.h>
-
-#include "disk.h"
-
-#define INODE_SIZE 64
-#define INODES_PER_BLOCK (BLOCK_SIZE / INODE_SIZE) 
-#define INODE_DIRECT_POINTERS 11
-#define INODE_INDIRECT_POINTERS_PER_BLOCK (BLOCK_SIZE / sizeof(uint32_t))
-
-#define DIRECTORY_ENTRY_SIZE 32
-#define DIRECTORY_NAME_SIZE 28
-#define DIRECTORY_ENTRIES_PER_BLOCK (BLOCK_SIZE / DIRECTORY_ENTRY_SIZE)
-#define DIRECTORY_DEPTH_LIMIT 10
-
-#define FLAGS_PER_BLOCK (BLOCK_SIZE / sizeof(uint32_t))
-
-/**
- * @brief The superblock structure contains information about the file system.
- *
- * @param s_blocks_count Total number of blocks in the file system.
- * @param s_inodes_count Total number of inodes in the file system.
- * @param s_inode_bitmap Block number of the inode bitmap.
- * @param s_block_bitmap Block number of the block bitmap.
- * @param s_inode_table_block_start Starting block number of the inode table.
- * @param s_data_blocks_start Starting block number of the data blocks.
- */
-struct superblock
-{
-    uint32_t s_blocks_count;
-    uint32_t s_inodes_count;
-    uint32_t s_block_bitmap;
-    uint32_t s_inode_bitmap;
-    uint32_t s_inode_table_block_start;
-    uint32_t s_data_blocks_start;
-};
-
-/**
- * @brief The inode structure contains information about a file or directory.
- *
- * @param i_is_directory Flag indicating whether the inode represents a directory.
- * @param i_size Size of the file or directory in bytes.
- * @param i_direct_pointers Array of direct pointers to data blocks.
- * @param i_single_indirect_pointer Pointer to a block containing indirect pointers to data blocks.
- */
-struct inode
-{
-    uint64_t i_size;
-    uint32_t i_is_directory;
-    uint32_t i_direct_pointers[INODE_DIRECT_POINTERS];
-    uint32_t i_single_indirect_pointer;
-};
-
-/**
- * @brief The directory_entry structure contains information about a directory entry.
- *
- * @param inode_number Inode number of the file or directory.
- * @param name Name of the file or directory.
- */
-struct directory_entry
-{
-    uint32_t inode_number;
-    char name[DIRECTORY_NAME_SIZE];
-};
-
-/**
- * @brief The directory_block structure contains an array of directory entries.
- *
- * @param entries Array of directory entries.
- */
-struct directory_block
-{
-    struct directory_entry entries[DIRECTORY_ENTRIES_PER_BLOCK];
-};
-
-/**
- * @brief The block union contains all possible types of blocks in the file system.
- *
- * @param superblock Superblock structure.
- * @param inodes Array of inodes.
- * @param bitmap Array of bitmap blocks.
- * @param directory_block Directory block structure.
- * @param data Array of data blocks.
- * @param pointers Array of indirect pointers.
- */
-union block
-{
-    struct superblock superblock;                         // Superblock
-    struct inode inodes[INODES_PER_BLOCK];                // Inode block
-    uint32_t bitmap[FLAGS_PER_BLOCK];                     // Bitmap block (inode or data)
-    struct directory_block directory_block;               // Directory block
-    uint8_t data[BLOCK_SIZE];                             // Data block
-    uint32_t pointers[INODE_INDIRECT_POINTERS_PER_BLOCK]; // Indirect pointer block
-};
-
-/*------------------------------------ FUNCTION DECLARATIONS ------------------------------------*/
-
-/**
- * @brief Formats the file system.
- *
- * @return 0 on success, -1 on failure.
- */
-int fs_format();
-
-/**
- * @brief Mounts the file system.
- *
- * @return 0 on success, -1 on failure.
- */
-int fs_mount();
-
-/**
- * @brief Unmounts the file system, if it is mounted.
- *
- */
-void fs_unmount();
-
-/**
- * @brief Create a file or directory at the specified absolute path.
- *
- * If intermediate directories leading to the path do not exist, create them. If the file or directory already exists, return an error.
- * The provided path must start with a slash (/) and be absolute.
- * Use a flag to specify whether the path represents a file or a directory.
- *
- * @param path The path of the file or directory to create.
- * @param is_directory Flag indicating whether the file or directory to create is a directory.
- * @return 0 on success, -1 on failure.
- */
-int fs_create(char *path, int is_directory);
-
-/**
- * @brief Remove the file or directory at the specified absolute path.
- *
- * If the path represents a directory, remove all files and directories inside it recursively (does NOT mean you are required to use recursion).
- * If the file or directory does not exist, return an error.
- * The provided path must start with a slash (/) and be absolute.
- *
- * @param path The path of the file or directory to remove.
- * @return 0 on success, -1 on failure.
- */
-int fs_remove(char *path);
-
-/**
- * @brief Reads data from a file at the specified path and stores it in the buffer pointed to by buf.
- * 
- * Think of edge cases such as reading from an offset other than 0, reading more bytes than the file contains, file not existing, etc.
- * 
- * @param path The path of the file to be read.
- * @param buf The buffer to store the read data.
- * @param count The number of bytes to be read.
- * @param offset The offset from the beginning of the file to start reading from.
- * 
- * @return On success, the number of bytes read is returned. On error, -1 is returned.
- */
-int fs_read(char *path, void *buf, size_t count, off_t offset);
-
-/**
- * @brief Writes data from the buffer pointed to by buf to a file at the specified path.
- * 
- * Create the file if it doesn't exist.
- * 
- * @param path The path of the file to be written to.
- * @param buf The buffer containing the data to be written.
- * @param count The number of bytes to be written.
- * @param append Flag indicating whether to append to the file.
- * 
- * @return On success, the number of bytes written is returned. On error, -1 is returned.
- */
-int fs_write(char *path, void *buf, size_t count, int append);
-
-/**
- * @brief Lists all files and directories in the directory at the specified path.
- * 
- * Format: <name> <size>
- * 
- * @param path The path of the directory to be listed.
- * 
- * @return 0 on success, -1 on failure.
- */
-int fs_list(char *path);
-
-/**
- * @brief Displays statistics about the file system.
- * Helper function to display state of the file system.
- * 
- */
-void fs_stat();
-
-
-
+/**
+ * @file fs.h
+ * @brief This header file contains the structures and constants used in the file system.
+ *
+ * This header file contains the following structures:
+ * - superblock: contains information about the file system.
+ * - inode: contains information about a file or directory.
+ * - superblock_v2, inode_v2: the same, with 64-bit block numbers, for disks of 2^32 blocks or more.
+ * - directory_entry: contains information about a directory entry.
+ * - directory_block: contains an array of directory entries.
+ * - block: contains all possible types of blocks in the file system.
+ *
+ * This header file also defines the following constants:
+ * - INODE_SIZE: size of an inode in bytes.
+ * - INODES_PER_BLOCK: number of inodes that can fit in a block.
+ * - INODE_DIRECT_POINTERS: number of direct pointers in an inode.
+ * - INODE_INDIRECT_POINTERS_PER_BLOCK: number of indirect pointers that can fit in a block.
+ * - DIRECTORY_ENTRY_SIZE: size of a directory entry in bytes.
+ * - DIRECTORY_NAME_SIZE: maximum size of a directory name in bytes.
+ * - DIRECTORY_ENTRIES_PER_BLOCK: number of directory entries that can fit in a block.
+ *
+ * This header file includes the following header files:
+ * - stdint.h: defines integer types.
+ * - disk.h: defines constants and functions related to the disk.
+ */
+#ifndef FS_H
+#define FS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "disk.h"
+
+// The geometry is fixed at compile time like BLOCK_SIZE; each can be overridden with
+// `make <NAME>=<value>`. fs_format records it in the superblock.
+#ifndef INODE_SIZE
+#define INODE_SIZE 64
+#endif
+#define INODES_PER_BLOCK (BLOCK_SIZE / INODE_SIZE) 
+#ifndef INODE_DIRECT_POINTERS
+#define INODE_DIRECT_POINTERS ((INODE_SIZE - 20) / 4) // as many as fill the inode, 11 in 64 bytes
+#endif
+#define INODE_INDIRECT_POINTERS_PER_BLOCK (BLOCK_SIZE / sizeof(uint32_t))
+
+#ifndef DIRECTORY_ENTRY_SIZE
+#define DIRECTORY_ENTRY_SIZE 32
+#endif
+#define DIRECTORY_NAME_SIZE (DIRECTORY_ENTRY_SIZE - 4)
+#define DIRECTORY_ENTRIES_PER_BLOCK (BLOCK_SIZE / DIRECTORY_ENTRY_SIZE)
+#define DIRECTORY_DEPTH_LIMIT 10
+
+#define FLAGS_PER_BLOCK (BLOCK_SIZE / sizeof(uint32_t))
+
+#if INODE_SIZE < 32 || INODE_SIZE > BLOCK_SIZE || (INODE_SIZE & (INODE_SIZE - 1)) != 0
+#error "INODE_SIZE must be a power of two from 32 to BLOCK_SIZE."
+#endif
+#if INODE_DIRECT_POINTERS < 1 || (16 + 4 * INODE_DIRECT_POINTERS + 7) / 8 * 8 != INODE_SIZE
+#error "INODE_DIRECT_POINTERS must fill an inode of INODE_SIZE bytes."
+#endif
+#if DIRECTORY_ENTRY_SIZE < 16 || DIRECTORY_ENTRY_SIZE > BLOCK_SIZE || (DIRECTORY_ENTRY_SIZE & (DIRECTORY_ENTRY_SIZE - 1)) != 0
+#error "DIRECTORY_ENTRY_SIZE must be a power of two from 16 to BLOCK_SIZE."
+#endif
+
+#define FS_VERSION_64 2 // s_version of a file system with 64-bit block numbers
+#define INODE_V2_SIZE 128
+#define INODES_V2_PER_BLOCK (BLOCK_SIZE / INODE_V2_SIZE)
+#define INODE_V2_DIRECT_POINTERS 13
+#define INODE_V2_INDIRECT_POINTERS_PER_BLOCK (BLOCK_SIZE / sizeof(uint64_t))
+
+/**
+ * @brief The superblock structure contains information about the file system.
+ *
+ * @param s_blocks_count Total number of blocks in the file system.
+ * @param s_inodes_count Total number of inodes in the file system.
+ * @param s_inode_bitmap Block number of the inode bitmap, the first of BITMAP_BLOCKS(s_inodes_count).
+ * @param s_block_bitmap Block number of the block bitmap, the first of BITMAP_BLOCKS(s_blocks_count).
+ * @param s_inode_table_block_start Starting block number of the inode table.
+ * @param s_data_blocks_start Starting block number of the data blocks.
+ * @param s_block_size ... s_directory_entry_size The geometry the file system was formatted with:
+ *        BLOCK_SIZE, INODE_SIZE, INODE_DIRECT_POINTERS and DIRECTORY_ENTRY_SIZE. All 0 in a file
+ *        system formatted before they were kept, which has the default geometry.
+ */
+struct superblock
+{
+    uint32_t s_blocks_count;
+    uint32_t s_inodes_count;
+    uint32_t s_block_bitmap;
+    uint32_t s_inode_bitmap;
+    uint32_t s_inode_table_block_start;
+    uint32_t s_data_blocks_start;
+    uint32_t s_block_size;
+    uint32_t s_inode_size;
+    uint32_t s_inode_direct_pointers;
+    uint32_t s_directory_entry_size;
+};
+
+/**
+ * @brief The inode structure contains information about a file or directory.
+ *
+ * @param i_is_directory Flag indicating whether the inode represents a directory.
+ * @param i_size Size of the file or directory in bytes.
+ * @param i_direct_pointers Array of direct pointers to data blocks.
+ * @param i_single_indirect_pointer Pointer to a block containing indirect pointers to data blocks.
+ */
+struct inode
+{
+    uint64_t i_size;
+    uint32_t i_is_directory;
+    uint32_t i_direct_pointers[INODE_DIRECT_POINTERS];
+    uint32_t i_single_indirect_pointer;
+};
+
+/**
+ * @brief The superblock of a version 2 file system, whose block numbers are 64-bit.
+ *
+ * The first word is where a version 1 superblock keeps its block count. It is 0, so a version 1
+ * reader sees a file system without blocks and refuses to mount it instead of misreading it.
+ *
+ * @param s_legacy_blocks_count Always 0.
+ * @param s_version FS_VERSION_64.
+ * @param s_blocks_count ... s_data_blocks_start As in the superblock, 64-bit.
+ * @param s_block_size ... s_directory_entry_size As in the superblock.
+ */
+struct superblock_v2
+{
+    uint32_t s_legacy_blocks_count;
+    uint32_t s_version;
+    uint64_t s_blocks_count;
+    uint64_t s_inodes_count;
+    uint64_t s_block_bitmap;
+    uint64_t s_inode_bitmap;
+    uint64_t s_inode_table_block_start;
+    uint64_t s_data_blocks_start;
+    uint32_t s_block_size;
+    uint32_t s_inode_size;
+    uint32_t s_inode_direct_pointers;
+    uint32_t s_directory_entry_size;
+};
+
+/**
+ * @brief The inode of a version 2 file system, INODE_V2_SIZE bytes with 64-bit block pointers.
+ *
+ * Its single indirect block holds INODE_V2_INDIRECT_POINTERS_PER_BLOCK 64-bit pointers.
+ *
+ * @param i_size Size of the file or directory in bytes.
+ * @param i_is_directory Flag indicating whether the inode represents a directory.
+ * @param i_reserved Always 0.
+ * @param i_direct_pointers Array of direct pointers to data blocks.
+ * @param i_single_indirect_pointer Pointer to a block containing indirect pointers to data blocks.
+ */
+struct inode_v2
+{
+    uint64_t i_size;
+    uint32_t i_is_directory;
+    uint32_t i_reserved;
+    uint64_t i_direct_pointers[INODE_V2_DIRECT_POINTERS];
+    uint64_t i_single_indirect_pointer;
+};
+
+/**
+ * @brief The directory_entry structure contains information about a directory entry.
+ *
+ * @param inode_number Inode number of the file or directory.
+ * @param name Name of the file or directory.
+ */
+struct directory_entry
+{
+    uint32_t inode_number;
+    char name[DIRECTORY_NAME_SIZE];
+};
+
+/**
+ * @brief The directory_block structure contains an array of directory entries.
+ *
+ * @param entries Array of directory entries.
+ */
+struct directory_block
+{
+    struct directory_entry entries[DIRECTORY_ENTRIES_PER_BLOCK];
+};
+
+/**
+ * @brief The block union contains all possible types of blocks in the file system.
+ *
+ * @param superblock Superblock structure.
+ * @param inodes Array of inodes.
+ * @param bitmap Array of bitmap blocks.
+ * @param directory_block Directory block structure.
+ * @param data Array of data blocks.
+ * @param pointers Array of indirect pointers.
+ */
+union block
+{
+    struct superblock superblock;                         // Superblock
+    struct inode inodes[INODES_PER_BLOCK];                // Inode block
+    uint32_t bitmap[FLAGS_PER_BLOCK];                     // Bitmap block (inode or data)
+    struct directory_block directory_block;               // Directory block
+    uint8_t data[BLOCK_SIZE];                             // Data block
+    uint32_t pointers[INODE_INDIRECT_POINTERS_PER_BLOCK]; // Indirect pointer block
+    struct superblock_v2 superblock_v2;                   // Superblock, version 2
+    struct inode_v2 inodes_v2[INODES_V2_PER_BLOCK];       // Inode block, version 2
+    uint64_t pointers_v2[INODE_V2_INDIRECT_POINTERS_PER_BLOCK]; // Indirect pointer block, version 2
+};
+
+/*------------------------------------ FUNCTION DECLARATIONS ------------------------------------*/
+
+/**
+ * @brief Formats the file system.
+ *
+ * A disk of UINT32_MAX blocks or fewer gets a version 1 file system (struct superblock and
+ * struct inode). A larger one gets version 2 (struct superblock_v2 and struct inode_v2), whose
+ * block numbers are 64-bit. Either records the geometry of the build in the superblock.
+ *
+ * The block bitmap starts at block 1 and takes BITMAP_BLOCKS(s_blocks_count) blocks; the inode
+ * bitmap follows it with BITMAP_BLOCKS(s_inodes_count), then the inode table. A disk of up to
+ * BITMAP_BITS_PER_BLOCK blocks has one block of each, at blocks 1 and 2. Both are written with
+ * bitmap_create() (see bitmap.h).
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int fs_format();
+
+/**
+ * @brief Mounts the file system.
+ *
+ * Either version is mounted: a superblock_v2 is told apart by s_legacy_blocks_count being 0 and
+ * s_version being FS_VERSION_64. A file system whose recorded geometry differs from the one this
+ * library was built with is refused. The bitmaps are opened with bitmap_open(), and data blocks
+ * and inodes are then allocated with bitmap_alloc() and freed with bitmap_clear().
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int fs_mount();
+
+/**
+ * @brief Unmounts the file system, if it is mounted.
+ *
+ */
+void fs_unmount();
+
+/**
+ * @brief Create a file or directory at the specified absolute path.
+ *
+ * If intermediate directories leading to the path do not exist, create them. If the file or directory already exists, return an error.
+ * The provided path must start with a slash (/) and be absolute.
+ * Use a flag to specify whether the path represents a file or a directory.
+ *
+ * @param path The path of the file or directory to create.
+ * @param is_directory Flag indicating whether the file or directory to create is a directory.
+ * @return 0 on success, -1 on failure.
+ */
+int fs_create(char *path, int is_directory);
+
+/**
+ * @brief Remove the file or directory at the specified absolute path.
+ *
+ * If the path represents a directory, remove all files and directories inside it recursively (does NOT mean you are required to use recursion).
+ * If the file or directory does not exist, return an error.
+ * The provided path must start with a slash (/) and be absolute.
+ * The data blocks freed are discarded with disk_discard(), one call per run of contiguous blocks,
+ * before they are cleared in the block bitmap: a flat image gives their space back to the host,
+ * and a deduplicated disk drops its references to their copies.
+ *
+ * @param path The path of the file or directory to remove.
+ * @return 0 on success, -1 on failure.
+ */
+int fs_remove(char *path);
+
+/**
+ * @brief Reads data from a file at the specified path and stores it in the buffer pointed to by buf.
+ * 
+ * Think of edge cases such as reading from an offset other than 0, reading more bytes than the file contains, file not existing, etc.
+ * 
+ * @param path The path of the file to be read.
+ * @param buf The buffer to store the read data.
+ * @param count The number of bytes to be read.
+ * @param offset The offset from the beginning of the file to start reading from.
+ * 
+ * @return On success, the number of bytes read is returned. On error, -1 is returned.
+ */
+int fs_read(char *path, void *buf, size_t count, off_t offset);
+
+/**
+ * @brief Writes data from the buffer pointed to by buf to a file at the specified path.
+ * 
+ * Create the file if it doesn't exist.
+ * 
+ * @param path The path of the file to be written to.
+ * @param buf The buffer containing the data to be written.
+ * @param count The number of bytes to be written.
+ * @param append Flag indicating whether to append to the file.
+ * 
+ * @return On success, the number of bytes written is returned. On error, -1 is returned.
+ */
+int fs_write(char *path, void *buf, size_t count, int append);
+
+/**
+ * @brief Lists all files and directories in the directory at the specified path.
+ * 
+ * Format: <name> <size>
+ * 
+ * @param path The path of the directory to be listed.
+ * 
+ * @return 0 on success, -1 on failure.
+ */
+int fs_list(char *path);
+
+/**
+ * @brief Displays statistics about the file system.
+ * Helper function to display state of the file system.
+ * 
+ */
+void fs_stat();
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/**
+ * @brief A file system context: the disk it lives on and its mounted state.
+ *
+ * The fs_* functions above work on one default context over the default disk (see disk.h).
+ * Each has a vfs_* counterpart taking a context as its first argument, so that a file system
+ * can be served from every open disk. Contexts on different disks may be used from different
+ * threads.
+ */
+struct vfs;
+
+/**
+ * @brief Creates an unmounted file system context on disk d.
+ *
+ * @return struct vfs* The context, or NULL on failure.
+ */
+struct vfs *vfs_init(struct vdisk *d);
+
+/**
+ * @brief Unmounts the context if it is mounted and frees it. The disk stays open.
+ */
+void vfs_destroy(struct vfs *fs);
+
+int vfs_format(struct vfs *fs);
+int vfs_mount(struct vfs *fs);
+void vfs_unmount(struct vfs *fs);
+int vfs_create(struct vfs *fs, char *path, int is_directory);
+int vfs_remove(struct vfs *fs, char *path);
+int vfs_read(struct vfs *fs, char *path, void *buf, size_t count, off_t offset);
+int vfs_write(struct vfs *fs, char *path, void *buf, size_t count, int append);
+int vfs_list(struct vfs *fs, char *path);
+void vfs_stat(struct vfs *fs);
+
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "disk.h"
+#include "disk_thin.h"
+
+int main(int argc, char *argv[])
+{
+    // Usage: ./imgconv thin|flat <from> <to>
+    if (argc != 4 || (strcmp(argv[1], "thin") != 0 && strcmp(argv[1], "flat") != 0))
+    {
+        printf("Usage: ./imgconv thin|flat <from> <to>\n");
+        printf("       thin  convert the flat image <from> to a new thin-provisioned image <to>\n");
+        printf("       flat  convert the thin-provisioned image <from> to a new flat image <to>\n");
+        return -1;
+    }
+
+    int to_thin = strcmp(argv[1], "thin") == 0;
+    int result = to_thin ? disk_thin_import(argv[2], argv[3]) : disk_thin_export(argv[2], argv[3]);
+
+    if (result != 0)
+    {
+        return -1;
+    }
+
+    printf("Converted %s to %s.\n", argv[2], argv[3]);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "readahead.h"
+#include "cache.h"
+#include "disk_internal.h"
+
+#define READAHEAD_STREAMS 64 // inodes tracked at once, by inode number modulo this
+
+/**
+ * Read-ahead state of one inode.
+ *
+ * @param inode_number The inode being tracked, or 0 if the slot is unused.
+ * @param next The file block a sequential reader will ask for next.
+ * @param window The number of blocks to keep prefetched ahead of the reader.
+ * @param end The first file block not prefetched yet.
+ */
+struct stream
+{
+    uint32_t inode_number;
+    uint64_t next;
+    uint32_t window;
+    uint64_t end;
+};
+
+/**
+ * The inode of a file being read, from a version 1 or a version 2 file system. Exactly one of
+ * the two is set; the helpers below read either with 64-bit block numbers.
+ */
+struct file
+{
+    const struct inode *v1;
+    const struct inode_v2 *v2;
+};
+
+/**
+ * A read-ahead engine bound to one disk.
+ */
+struct readahead
+{
+    struct vdisk *disk;
+    struct stream streams[READAHEAD_STREAMS];
+    uint32_t max_window;
+};
+
+static struct readahead *default_readahead = NULL; // engine used by the readahead_* functions
+
+int readahead_init(int window)
+{
+    readahead_close();
+    default_readahead = readahead_create(disk_default(), window);
+    return default_readahead != NULL ? 0 : -1;
+}
+
+void readahead_access(uint32_t inode_number, const struct inode *inode, uint32_t file_block)
+{
+    // The default disk may have been closed and reopened since the engine was started.
+    if (default_readahead != NULL && default_readahead->disk == disk_default())
+    {
+        readahead_note(default_readahead, inode_number, inode, file_block);
+    }
+}
+
+void readahead_access_v2(uint32_t inode_number, const struct inode_v2 *inode, uint64_t file_block)
+{
+    if (default_readahead != NULL && default_readahead->disk == disk_default())
+    {
+        readahead_note_v2(default_readahead, inode_number, inode, file_block);
+    }
+}
+
+void readahead_close()
+{
+    readahead_destroy(default_readahead);
+    default_readahead = NULL;
+}
+
+struct readahead *readahead_create(struct vdisk *d, int window)
+{
+    if (!vdisk_cache_enabled(d))
+    {
+        printf("   ERROR: Read-ahead needs the block cache.\n");
+        return NULL;
+    }
+
+    if (window < READAHEAD_MIN_WINDOW)
+    {
+        printf("   ERROR: Read-ahead window must be at least %d blocks.\n", READAHEAD_MIN_WINDOW);
+        return NULL;
+    }
+
+    if (vdisk_async_engine(d) == DISK_ASYNC_NONE && vdisk_async_init(d, window, 0) != 0)
+    {
+        return NULL;
+    }
+
+    struct readahead *ra = calloc(1, sizeof(struct readahead));
+    if (ra == NULL)
+    {
+        printf("   ERROR: Could not allocate read-ahead engine.\n");
+        return NULL;
+    }
+
+    ra->disk = d;
+    ra->max_window = window;
+    return ra;
+}
+
+/**
+ * Returns the number of blocks of the file, counting a partial last block.
+ */
+static uint64_t file_blocks(const struct file *f)
+{
+    uint64_t size = f->v2 != NULL ? f->v2->i_size : f->v1->i_size;
+    return (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+/**
+ * Returns the number of direct pointers of the file's inode.
+ */
+static uint64_t direct_pointers(const struct file *f)
+{
+    return f->v2 != NULL ? INODE_V2_DIRECT_POINTERS : INODE_DIRECT_POINTERS;
+}
+
+/**
+ * Returns the file's single indirect block, or 0 if it has none.
+ */
+static uint64_t indirect_pointer(const struct file *f)
+{
+    return f->v2 != NULL ? f->v2->i_single_indirect_pointer : f->v1->i_single_indirect_pointer;
+}
+
+/**
+ * Maps a file block to its disk block, or returns 0 if that is not possible without blocking.
+ * For blocks behind the indirect pointer, the indirect block is prefetched if it is not cached.
+ */
+static uint64_t map_block(struct vdisk *d, const struct file *f, uint64_t file_block)
+{
+    if (file_block < direct_pointers(f))
+    {
+        return f->v2 != NULL ? f->v2->i_direct_pointers[file_block] : f->v1->i_direct_pointers[file_block];
+    }
+
+    uint64_t indirect_block = indirect_pointer(f);
+    uint64_t per_block = f->v2 != NULL ? INODE_V2_INDIRECT_POINTERS_PER_BLOCK : INODE_INDIRECT_POINTERS_PER_BLOCK;
+
+    file_block -= direct_pointers(f);
+    if (file_block >= per_block || indirect_block == 0)
+    {
+        return 0;
+    }
+
+    // Only use the indirect block once it is in memory; until then, ask for it.
+    if (!cache_contains(d, indirect_block))
+    {
+        cache_prefetch(d, indirect_block, 1);
+        return 0;
+    }
+
+    union block indirect;
+    if (vdisk_read(d, indirect_block, indirect.data) != BLOCK_SIZE)
+    {
+        return 0;
+    }
+
+    return f->v2 != NULL ? indirect.pointers_v2[file_block] : indirect.pointers[file_block];
+}
+
+/**
+ * Body of readahead_note() and readahead_note_v2(), with the disk lock held.
+ */
+static void note(struct readahead *ra, uint32_t inode_number, const struct file *f, uint64_t file_block)
+{
+    struct vdisk *d = ra->disk;
+    struct stream *s = &ra->streams[inode_number % READAHEAD_STREAMS];
+
+    // A new inode, or a jump away from where the reader was going, starts over with a small window.
+    if (s->inode_number != inode_number || file_block != s->next)
+    {
+        s->inode_number = inode_number;
+        s->next = file_block + 1;
+        s->window = 0;
+        s->end = file_block + 1;
+        return;
+    }
+
+    // Sequential: grow the window.
+    s->next = file_block + 1;
+    if (s->window == 0)
+    {
+        s->window = READAHEAD_MIN_WINDOW;
+    }
+    else if (s->window < ra->max_window)
+    {
+        s->window = s->window * 2 < ra->max_window ? s->window * 2 : ra->max_window;
+    }
+
+    if (s->end < s->next)
+    {
+        s->end = s->next;
+    }
+
+    // Top the window up once the reader has used half of it, so prefetches go out in batches.
+    uint64_t target = s->next + s->window;
+    if (target > file_blocks(f))
+    {
+        target = file_blocks(f);
+    }
+
+    if (s->end >= target || s->end - s->next > s->window / 2)
+    {
+        return;
+    }
+
+    // Ask for the indirect block as soon as the window reaches it.
+    if (target > direct_pointers(f) && indirect_pointer(f) != 0)
+    {
+        cache_prefetch(d, indirect_pointer(f), 1);
+    }
+
+    // Prefetch the window, one request per run of physically contiguous blocks.
+    uint64_t run_start = 0;
+    uint32_t run_length = 0;
+
+    while (s->end < target)
+    {
+        uint64_t blocknum = map_block(d, f, s->end);
+
+        // Stop at a hole or at blocks that cannot be mapped yet; the next access tries again.
+        if (blocknum == 0)
+        {
+            break;
+        }
+
+        if (run_length > 0 && blocknum != run_start + run_length)
+        {
+            if (cache_prefetch(d, run_start, run_length) != 0)
+            {
+                run_length = 0;
+                break;
+            }
+            run_length = 0;
+        }
+
+        if (run_length == 0)
+        {
+            run_start = blocknum;
+        }
+        run_length++;
+        s->end++;
+    }
+
+    if (run_length > 0)
+    {
+        cache_prefetch(d, run_start, run_length);
+    }
+
+    // Start the reads now rather than when the queue fills up.
+    vdisk_async_submit(d);
+}
+
+void readahead_note(struct readahead *ra, uint32_t inode_number, const struct inode *inode, uint32_t file_block)
+{
+    if (ra == NULL)
+    {
+        return;
+    }
+
+    struct file f = {inode, NULL};
+
+    disk_internal_lock(ra->disk);
+    note(ra, inode_number, &f, file_block);
+    disk_internal_unlock(ra->disk);
+}
+
+void readahead_note_v2(struct readahead *ra, uint32_t inode_number, const struct inode_v2 *inode, uint64_t file_block)
+{
+    if (ra == NULL)
+    {
+        return;
+    }
+
+    struct file f = {NULL, inode};
+
+    disk_internal_lock(ra->disk);
+    note(ra, inode_number, &f, file_block);
+    disk_internal_unlock(ra->disk);
+}
+
+void readahead_destroy(struct readahead *ra)
+{
+    free(ra);
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+/**
+ * @file readahead.h
+ * @brief This header file contains the declarations of the sequential read-ahead engine.
+ *
+ * fs_read reports every data block it is about to read with readahead_access(), or with
+ * readahead_access_v2() on a version 2 file system (see fs.h). When an inode is being read
+ * sequentially, the engine prefetches the next blocks of the file into the block cache through
+ * the asynchronous engine, so that later disk_read calls are cache hits. The window starts
+ * small and doubles on every sequential access, up to the configured maximum. A random access
+ * resets it.
+ *
+ */
+
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <stdint.h>
+
+#include "fs.h"
+
+#define READAHEAD_MIN_WINDOW 4 // blocks prefetched after the first sequential access
+
+/**
+ * @brief Starts the read-ahead engine on the default disk.
+ *
+ * Needs the block cache (see cache.h). Starts the asynchronous engine if it is not running.
+ *
+ * @param max_window The most blocks to prefetch ahead of the reader.
+ * @return int Returns 0 on success, -1 on failure.
+ */
+int readahead_init(int max_window);
+
+/**
+ * @brief Reports that a data block of a file is about to be read.
+ *
+ * Blocks behind the single indirect pointer are mapped through the indirect block, which is
+ * prefetched itself as the reader approaches it.
+ *
+ * @param inode_number The inode number of the file.
+ * @param inode The inode of the file.
+ * @param file_block The index of the block within the file (offset / BLOCK_SIZE).
+ */
+void readahead_access(uint32_t inode_number, const struct inode *inode, uint32_t file_block);
+
+/**
+ * @brief Reports that a data block of a file on a version 2 file system is about to be read,
+ * like readahead_access(). Its pointers, and those of its indirect block, are 64-bit.
+ *
+ * @param inode_number The inode number of the file.
+ * @param inode The inode of the file.
+ * @param file_block The index of the block within the file (offset / BLOCK_SIZE).
+ */
+void readahead_access_v2(uint32_t inode_number, const struct inode_v2 *inode, uint64_t file_block);
+
+/**
+ * @brief Stops the read-ahead engine. Prefetches in flight still complete into the cache.
+ */
+void readahead_close();
+
+/*------------------------------------------- HANDLES -------------------------------------------*/
+
+/* The functions above drive one engine on the default disk; these drive any number of them. */
+struct readahead;
+
+/**
+ * @brief Creates a read-ahead engine on disk d, like readahead_init().
+ *
+ * @return struct readahead* The engine, or NULL on failure.
+ */
+struct readahead *readahead_create(struct vdisk *d, int max_window);
+
+/**
+ * @brief Reports a data block about to be read from disk d, like readahead_access().
+ */
+void readahead_note(struct readahead *ra, uint32_t inode_number, const struct inode *inode, uint32_t file_block);
+
+/**
+ * @brief Reports a data block about to be read from disk d, like readahead_access_v2().
+ */
+void readahead_note_v2(struct readahead *ra, uint32_t inode_number, const struct inode_v2 *inode, uint64_t file_block);
+
+/**
+ * @brief Stops and frees the engine. It must be destroyed before its disk is closed.
+ */
+void readahead_destroy(struct readahead *ra);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,417 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "disk.h"
+#include "cache.h"
+#include "disk_model.h"
+#include "disk_stats.h"
+#include "disk_trace.h"
+
+/**
+ * The header and records of a version 1 trace, whose block numbers are 32-bit.
+ */
+struct trace_header_v1
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t block_size;
+    uint32_t nblocks;
+};
+
+struct trace_record_v1
+{
+    uint64_t time_ns;
+    uint64_t hash;
+    uint32_t blocknum;
+    uint16_t count;
+    uint8_t op;
+    uint8_t flags;
+};
+
+/**
+ * A request being replayed: the records of one disk_readv/disk_writev, or a single record.
+ */
+struct request
+{
+    struct disk_trace_record *records;
+    int nrecords;
+    int records_cap;
+    struct disk_iovec *iov;
+    int nblocks;
+    int blocks_cap;
+    uint8_t *data;
+};
+
+/**
+ * Returns a monotonic timestamp in nanoseconds.
+ */
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Sleeps until `deadline` on the monotonic clock.
+ */
+static void sleep_until(uint64_t deadline)
+{
+    uint64_t now = now_ns();
+
+    if (deadline > now)
+    {
+        struct timespec ts = {(deadline - now) / 1000000000, (deadline - now) % 1000000000};
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        {
+        }
+    }
+}
+
+/**
+ * Appends a record to the request, growing its arrays as needed.
+ *
+ * @return Returns 0 on success, -1 on failure.
+ */
+static int add_record(struct request *req, const struct disk_trace_record *r)
+{
+    if (req->nrecords == req->records_cap)
+    {
+        int cap = req->records_cap > 0 ? req->records_cap * 2 : 16;
+        void *records = realloc(req->records, cap * sizeof(*req->records));
+        if (records == NULL)
+        {
+            return -1;
+        }
+        req->records = records;
+        req->records_cap = cap;
+    }
+
+    if (req->nblocks + r->count > req->blocks_cap)
+    {
+        int cap = req->blocks_cap > 0 ? req->blocks_cap : 64;
+        while (cap < req->nblocks + r->count)
+        {
+            cap *= 2;
+        }
+
+        void *iov = realloc(req->iov, cap * sizeof(*req->iov));
+        if (iov == NULL)
+        {
+            return -1;
+        }
+        req->iov = iov;
+
+        // Aligned, so O_DIRECT images need no extra copy. The blocks are filled after gathering.
+        uint8_t *data = disk_alloc_blocks(cap);
+        if (data == NULL)
+        {
+            return -1;
+        }
+
+        disk_free_blocks(req->data);
+        req->data = data;
+        req->blocks_cap = cap;
+    }
+
+    req->records[req->nrecords++] = *r;
+    req->nblocks += r->count;
+    return 0;
+}
+
+/**
+ * Reads the next record of a trace of the given version into `r`.
+ *
+ * @return Returns 1 if a record was read, 0 at the end of the trace.
+ */
+static int next_record(FILE *trace, uint32_t version, struct disk_trace_record *r)
+{
+    struct trace_record_v1 old;
+
+    if (version == DISK_TRACE_VERSION)
+    {
+        return fread(r, sizeof(*r), 1, trace) == 1;
+    }
+
+    if (fread(&old, sizeof(old), 1, trace) != 1)
+    {
+        return 0;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->time_ns = old.time_ns;
+    r->hash = old.hash;
+    r->blocknum = old.blocknum;
+    r->count = old.count;
+    r->op = old.op;
+    r->flags = old.flags;
+    return 1;
+}
+
+/**
+ * Reads the header of a trace of any version into `header`, leaving the file at the first record.
+ *
+ * @return Returns 0 on success, -1 if the file is not a trace of this disk format.
+ */
+static int read_header(FILE *trace, struct disk_trace_header *header)
+{
+    struct trace_header_v1 old;
+
+    if (fread(header, sizeof(*header), 1, trace) != 1 || memcmp(header->magic, DISK_TRACE_MAGIC, sizeof(header->magic)) != 0)
+    {
+        return -1;
+    }
+
+    // A version 1 header is shorter, so read it again from the start.
+    if (header->version == 1)
+    {
+        if (fseek(trace, 0, SEEK_SET) != 0 || fread(&old, sizeof(old), 1, trace) != 1)
+        {
+            return -1;
+        }
+        header->block_size = old.block_size;
+        header->nblocks = old.nblocks;
+    }
+
+    return (header->version == 1 || header->version == DISK_TRACE_VERSION) && header->block_size == BLOCK_SIZE ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    int timing = 0, verify = 0, cache_blocks = 0, model = 0, flags = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "tvdc:m:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            timing = 1;
+            break;
+        case 'v':
+            verify = 1;
+            break;
+        case 'd':
+            flags |= DISK_DIRECT;
+            break;
+        case 'c':
+            cache_blocks = atoi(optarg);
+            break;
+        case 'm':
+            model = strcmp(optarg, "hdd") == 0 ? DISK_MODEL_HDD : strcmp(optarg, "ssd") == 0 ? DISK_MODEL_SSD : -1;
+            break;
+        default:
+            model = -1;
+        }
+    }
+
+    // Usage: ./replay [-t] [-v] [-d] [-c <cache-blocks>] [-m hdd|ssd] <trace> <disk>
+    if (argc - optind != 2 || model < 0)
+    {
+        printf("Usage: ./replay [-t] [-v] [-d] [-c <cache-blocks>] [-m hdd|ssd] <trace> <disk>\n");
+        printf("       -t  keep the original timing instead of replaying at full speed\n");
+        printf("       -v  check the data read against the hashes in the trace\n");
+        printf("       -d  open the disk with DISK_DIRECT\n");
+        printf("       -c  put a block cache of that many blocks in front of the disk\n");
+        printf("       -m  attach a device model\n");
+        printf("       The disk is created with the size of the traced one if it does not exist.\n");
+        printf("       Writes store a pattern, since the trace does not keep their data.\n");
+        return -1;
+    }
+
+    char *trace_path = argv[optind];
+    char *disk_path = argv[optind + 1];
+
+    FILE *trace = fopen(trace_path, "rb");
+    if (trace == NULL)
+    {
+        printf("ERROR: Could not open trace %s.\n", trace_path);
+        return -1;
+    }
+
+    struct disk_trace_header header;
+    if (read_header(trace, &header) != 0)
+    {
+        printf("ERROR: %s is not a trace of this disk format.\n", trace_path);
+        fclose(trace);
+        return -1;
+    }
+
+    // Open the disk, or create one the size of the traced disk.
+    int opened = access(disk_path, F_OK) == 0 ? disk_open(disk_path, flags) : disk_init_flags(disk_path, header.nblocks, flags);
+    if (opened == -1)
+    {
+        printf("ERROR: Could not open disk.\n");
+        fclose(trace);
+        return -1;
+    }
+
+    if ((uint64_t)disk_size() < header.nblocks)
+    {
+        printf("ERROR: The disk has %lld blocks, the trace needs %llu.\n", (long long)disk_size(),
+               (unsigned long long)header.nblocks);
+        disk_close(0);
+        fclose(trace);
+        return -1;
+    }
+
+    struct disk_model params;
+    if ((cache_blocks > 0 && cache_init(cache_blocks) == -1) ||
+        (model > 0 && (disk_model_preset(model, &params) == -1 || disk_model_init(&params) == -1)))
+    {
+        disk_close(0);
+        fclose(trace);
+        return -1;
+    }
+
+    if (verify && !(header.flags & DISK_TRACE_HASH))
+    {
+        printf("WARNING: The trace has no hashes, nothing will be verified.\n");
+        verify = 0;
+    }
+
+    // Blocks written during the replay hold a pattern, so reads of them cannot be verified.
+    uint8_t *written = calloc((header.nblocks + 7) / 8, 1);
+    if (written == NULL)
+    {
+        printf("ERROR: Out of memory.\n");
+        disk_close(0);
+        fclose(trace);
+        return -1;
+    }
+
+    struct request req;
+    memset(&req, 0, sizeof(req));
+
+    struct disk_trace_record r;
+    int more = next_record(trace, header.version, &r);
+    long requests = 0, mismatches = 0, unverified = 0, read_blocks = 0, write_blocks = 0;
+    int result = 0;
+    uint64_t start = now_ns();
+
+    while (more && result == 0)
+    {
+        // Gather the record and the ones continuing its request.
+        req.nrecords = 0;
+        req.nblocks = 0;
+        do
+        {
+            if (r.blocknum + r.count > header.nblocks || r.count == 0 || add_record(&req, &r) != 0)
+            {
+                printf("ERROR: Bad record or out of memory at request %ld.\n", requests);
+                result = -1;
+                break;
+            }
+            more = next_record(trace, header.version, &r);
+        } while (more && (r.flags & DISK_TRACE_VECTORED));
+
+        if (result != 0)
+        {
+            break;
+        }
+
+        int write = req.records[0].op == DISK_TRACE_WRITE;
+        int n = 0;
+
+        for (int i = 0; i < req.nrecords; i++)
+        {
+            for (uint64_t b = 0; b < req.records[i].count; b++, n++)
+            {
+                uint64_t blocknum = req.records[i].blocknum + b;
+                req.iov[n].blocknum = blocknum;
+                req.iov[n].buf = req.data + (size_t)n * BLOCK_SIZE;
+
+                // Stamp each written block with its number and the request, so the data is deterministic.
+                if (write)
+                {
+                    uint64_t *words = req.iov[n].buf;
+                    for (int w = 0; w < BLOCK_SIZE / 8; w++)
+                    {
+                        words[w] = ((uint64_t)requests << 32) ^ blocknum ^ w;
+                    }
+                    written[blocknum / 8] |= 1 << (blocknum % 8);
+                }
+            }
+        }
+
+        if (timing)
+        {
+            sleep_until(start + req.records[0].time_ns);
+        }
+
+        int moved;
+        if (n == 1)
+        {
+            moved = write ? disk_write(req.iov[0].blocknum, req.iov[0].buf) : disk_read(req.iov[0].blocknum, req.iov[0].buf);
+        }
+        else
+        {
+            moved = write ? disk_writev(req.iov, n) : disk_readv(req.iov, n);
+        }
+
+        if (moved == -1)
+        {
+            printf("ERROR: Could not replay request %ld.\n", requests);
+            result = -1;
+            break;
+        }
+
+        // Compare the hash of each run read with the recorded one.
+        for (int i = 0, first = 0; verify && !write && i < req.nrecords; first += req.records[i].count, i++)
+        {
+            uint64_t hash = DISK_TRACE_SEED;
+            int clean = 1;
+
+            for (int b = 0; b < req.records[i].count; b++)
+            {
+                uint64_t blocknum = req.iov[first + b].blocknum;
+                clean &= !(written[blocknum / 8] & (1 << (blocknum % 8)));
+                hash = disk_trace_hash(hash, req.iov[first + b].buf);
+            }
+
+            if (!clean)
+            {
+                unverified++;
+            }
+            else if (hash != req.records[i].hash)
+            {
+                mismatches++;
+            }
+        }
+
+        *(write ? &write_blocks : &read_blocks) += n;
+        requests++;
+    }
+
+    double elapsed_ms = (now_ns() - start) / 1e6;
+
+    printf("Requests: %ld\n", requests);
+    printf("Blocks Read: %ld\n", read_blocks);
+    printf("Blocks Written: %ld\n", write_blocks);
+    printf("Elapsed (ms): %.3f\n", elapsed_ms);
+    if (verify)
+    {
+        printf("Mismatched Reads: %ld\n", mismatches);
+        printf("Unverified Reads: %ld\n", unverified);
+    }
+
+    free(written);
+    free(req.records);
+    free(req.iov);
+    disk_free_blocks(req.data);
+    fclose(trace);
+
+    if (disk_close(1) == -1)
+    {
+        printf("ERROR: Could not close disk.\n");
+        return -1;
+    }
+
+    return result != 0 ? -1 : mismatches > 0 ? 1 : 0;
+}
\ No newline at end of file
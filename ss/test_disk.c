@@ -0,0 +1,1096 @@
+#include "disk.h"
+#include "disk_raid.h"
+#include "disk_thin.h"
+#include "disk_sched.h"
+#include "cache.h"
+#include "readahead.h"
+#include "bitmap.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
+
+#define TEST_IMAGE "test/images/user/disk.img"
+#define TEST_HUGE_BLOCKS ((1ull << 32) + 1024)      // past 2^32 blocks
+#define TEST_HUGE_FALLBACK ((15ull << 40) / BLOCK_SIZE) // 15 TB, for hosts whose files stop at 16 TB
+#define TEST_HUGE_MEMBERS DISK_RAID_MAX_MEMBERS      // images a striped huge disk is spread over
+#define TEST_THIN_BLOCKS (2 * DISK_THIN_L2_ENTRIES) // blocks of the thin-provisioned disk, two L2 tables
+#define TEST_MIRROR_BLOCKS (4 * DISK_RAID_REGION + 100) // blocks of the mirrored disk, the last region partial
+#define TEST_WRITABLE 64 // blocks of the image still writable while writes are made to fail
+#define TEST_RUN 8                                  // blocks of the disk_writev run across a boundary
+#define TEST_RA_BLOCKS 48  // blocks of the file read ahead, past its direct pointers
+#define TEST_RA_WINDOW 16  // most blocks read ahead of it
+#define TEST_BITMAP_FIRST 5                               // first block of the test bitmap
+#define TEST_BITMAP_BITS (3 * BITMAP_BITS_PER_BLOCK + 77) // bits of it, over four blocks, the last partial
+
+/**
+ * Stamps a block with its number, so a block read from the wrong offset is caught.
+ */
+static void stamp_block(uint8_t *buf, uint64_t blocknum)
+{
+    uint64_t *words = (uint64_t *)buf;
+
+    for (int w = 0; w < BLOCK_SIZE / 8; w++)
+    {
+        words[w] = blocknum * 0x9e3779b97f4a7c15ull ^ w;
+    }
+}
+
+/**
+ * Returns the image of member i of a striped or mirrored test disk.
+ */
+static char *member_name(int i)
+{
+    static char names[DISK_RAID_MAX_MEMBERS + 1][64];
+
+    snprintf(names[i], sizeof(names[i]), "test/images/user/member%d.img", i);
+    return names[i];
+}
+
+/**
+ * Writes stamped blocks on each side of the 4 GB offset, of blocks 2^31 and 2^32 and of the end
+ * of the open disk of nblocks blocks, and a disk_writev run straddling the highest of those
+ * boundaries below the end. Then reopens the disk, from the image or from the `count` members
+ * given in reverse order, and reads every block back.
+ */
+static int check_boundaries(uint64_t nblocks, char **members, int count)
+{
+    uint64_t four_gb = (1ull << 32) / BLOCK_SIZE;
+    uint64_t fixed[] = {0, four_gb - 1, four_gb, (1ull << 31) - 1, 1ull << 31, (1ull << 32) - 1, 1ull << 32, nblocks - 1};
+    uint64_t blocks[sizeof(fixed) / sizeof(fixed[0])];
+    int nfixed = 0;
+    uint8_t *data = disk_alloc_blocks(TEST_RUN);
+    uint8_t expected[BLOCK_SIZE];
+    uint8_t block[BLOCK_SIZE];
+    struct disk_iovec iov[TEST_RUN];
+
+    if (data == NULL)
+    {
+        printf("\tERROR: Out of memory.\n");
+        return -1;
+    }
+
+    // Keep the boundaries inside the disk; the run straddles the last of them.
+    uint64_t run = 0;
+    for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++)
+    {
+        if (fixed[i] < nblocks)
+        {
+            blocks[nfixed++] = fixed[i];
+            if (fixed[i] >= TEST_RUN / 2 && fixed[i] + TEST_RUN / 2 <= nblocks && i + 1 < sizeof(fixed) / sizeof(fixed[0]))
+            {
+                run = fixed[i] - TEST_RUN / 2;
+            }
+        }
+    }
+
+    for (int i = 0; i < nfixed; i++)
+    {
+        stamp_block(block, blocks[i]);
+        if (disk_write(blocks[i], block) != BLOCK_SIZE)
+        {
+            printf("\tERROR: Could not write block %llu.\n", (unsigned long long)blocks[i]);
+            disk_free_blocks(data);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < TEST_RUN; i++)
+    {
+        iov[i].blocknum = run + i;
+        iov[i].buf = data + (size_t)i * BLOCK_SIZE;
+        stamp_block(iov[i].buf, iov[i].blocknum);
+    }
+    if (disk_writev(iov, TEST_RUN) != TEST_RUN * BLOCK_SIZE || disk_close(0) != 0)
+    {
+        printf("\tERROR: Could not write blocks %llu-%llu.\n", (unsigned long long)run, (unsigned long long)(run + TEST_RUN - 1));
+        disk_free_blocks(data);
+        return -1;
+    }
+
+    // A striped disk is reopened with its members in another order.
+    char *reversed[DISK_RAID_MAX_MEMBERS];
+    for (int i = 0; i < count; i++)
+    {
+        reversed[i] = members[count - 1 - i];
+    }
+
+    if ((count > 0 ? disk_open_raid(reversed, count, 0) : disk_open(TEST_IMAGE, 0)) != 0 || (uint64_t)disk_size() != nblocks)
+    {
+        printf("\tERROR: Could not reopen the %llu-block disk.\n", (unsigned long long)nblocks);
+        disk_free_blocks(data);
+        return -1;
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < nfixed; i++)
+    {
+        stamp_block(expected, blocks[i]);
+        if (disk_read(blocks[i], block) != BLOCK_SIZE || memcmp(block, expected, BLOCK_SIZE) != 0)
+        {
+            printf("\tERROR: Block %llu read back wrong.\n", (unsigned long long)blocks[i]);
+            mismatches++;
+        }
+    }
+
+    memset(data, 0, (size_t)TEST_RUN * BLOCK_SIZE);
+    disk_readv(iov, TEST_RUN);
+    for (int i = 0; i < TEST_RUN; i++)
+    {
+        stamp_block(expected, iov[i].blocknum);
+        if (memcmp(iov[i].buf, expected, BLOCK_SIZE) != 0)
+        {
+            printf("\tERROR: Block %llu of the run read back wrong.\n", (unsigned long long)iov[i].blocknum);
+            mismatches++;
+        }
+    }
+
+    disk_close(0);
+    disk_free_blocks(data);
+    return mismatches == 0 ? 0 : -1;
+}
+
+int huge_test()
+{
+    uint64_t nblocks = TEST_HUGE_BLOCKS;
+
+    // Some host filesystems cap a file below 2^32 blocks; the striped test below goes past it.
+    if (disk_init(TEST_IMAGE, nblocks) == -1)
+    {
+        nblocks = TEST_HUGE_FALLBACK;
+        printf("\tNOTE: The host cannot hold a %llu-block image; using %llu blocks.\n", (unsigned long long)TEST_HUGE_BLOCKS,
+               (unsigned long long)nblocks);
+        if (disk_init(TEST_IMAGE, nblocks) == -1)
+        {
+            printf("\tERROR: Could not initialize a %llu-block disk.\n", (unsigned long long)nblocks);
+            return -1;
+        }
+    }
+
+    int result = check_boundaries(nblocks, NULL, 0);
+
+    // Leave a small image behind rather than a huge one.
+    disk_init(TEST_IMAGE, 0);
+    disk_close(0);
+    return result;
+}
+
+int striped_huge_test()
+{
+    char *members[TEST_HUGE_MEMBERS];
+
+    for (int i = 0; i < TEST_HUGE_MEMBERS; i++)
+    {
+        members[i] = member_name(i);
+    }
+
+    if (disk_init_raid(members, TEST_HUGE_MEMBERS, TEST_HUGE_BLOCKS, 0, 0) == -1)
+    {
+        printf("\tERROR: Could not stripe a %llu-block disk across %d images.\n", (unsigned long long)TEST_HUGE_BLOCKS,
+               TEST_HUGE_MEMBERS);
+        return -1;
+    }
+
+    int result = check_boundaries(TEST_HUGE_BLOCKS, members, TEST_HUGE_MEMBERS);
+
+    for (int i = 0; i < TEST_HUGE_MEMBERS; i++)
+    {
+        unlink(members[i]);
+    }
+    return result;
+}
+
+int max_blocks_test()
+{
+    char *members[] = {member_name(0), member_name(1)};
+
+    // Creating a disk past DISK_MAX_BLOCKS, or of a negative size, is refused.
+    if (disk_init(TEST_IMAGE, DISK_MAX_BLOCKS + 1) != -1 || disk_init(TEST_IMAGE, -1) != -1 ||
+        disk_init_raid(members, 2, DISK_MAX_BLOCKS + 1, 0, 0) != -1 || disk_init_mirror(members, 2, DISK_MAX_BLOCKS + 1, 0) != -1)
+    {
+        printf("\tERROR: A disk of more than %llu blocks was created.\n", (unsigned long long)DISK_MAX_BLOCKS);
+        disk_close(0);
+        return -1;
+    }
+
+    // A flat image past DISK_MAX_BLOCKS is refused too, on hosts that can hold one at all.
+    int fd = open(TEST_IMAGE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int too_large = fd >= 0 && ftruncate(fd, (off_t)((DISK_MAX_BLOCKS + 1) * BLOCK_SIZE)) == 0;
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    if (too_large && disk_open(TEST_IMAGE, 0) != -1)
+    {
+        printf("\tERROR: An image of more than %llu blocks was opened.\n", (unsigned long long)DISK_MAX_BLOCKS);
+        disk_close(0);
+        return -1;
+    }
+    truncate(TEST_IMAGE, 0);
+
+    // So is a set whose header claims 2^52 blocks, for which the member size in bytes wraps
+    // around 64 bits. nblocks_hi is the last field of the header, at byte 68.
+    uint32_t nblocks_hi = 1u << 20;
+    if (disk_init_mirror(members, 2, 1024, 0) == -1 || disk_close(0) != 0)
+    {
+        printf("\tERROR: Could not initialize a mirrored disk.\n");
+        return -1;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        fd = open(members[i], O_RDWR);
+        if (fd < 0 || pwrite(fd, &nblocks_hi, sizeof(nblocks_hi), 68) != sizeof(nblocks_hi))
+        {
+            printf("\tERROR: Could not rewrite the header of %s.\n", members[i]);
+            return -1;
+        }
+        close(fd);
+    }
+
+    int result = 0;
+    if (disk_open_raid(members, 2, 0) != -1)
+    {
+        printf("\tERROR: A set of %llu blocks was opened.\n", (unsigned long long)disk_size());
+        disk_close(0);
+        result = -1;
+    }
+
+    unlink(members[0]);
+    unlink(members[1]);
+    return result;
+}
+
+/**
+ * What the callbacks of async_callback_test() saw.
+ */
+struct async_state
+{
+    uint8_t *extra;   // buffer of the read queued from the first callback
+    int seen[TEST_RUN]; // callbacks run for each block of the readv
+    int extra_seen;
+    int mismatches;
+};
+
+static void extra_done(uint64_t blocknum, void *buf, int result, void *arg)
+{
+    struct async_state *state = arg;
+    uint8_t expected[BLOCK_SIZE];
+
+    stamp_block(expected, blocknum);
+    state->mismatches += blocknum != 100 || result != BLOCK_SIZE || memcmp(buf, expected, BLOCK_SIZE) != 0;
+    state->extra_seen++;
+}
+
+static void run_done(uint64_t blocknum, void *buf, int result, void *arg)
+{
+    struct async_state *state = arg;
+    uint8_t expected[BLOCK_SIZE];
+
+    stamp_block(expected, blocknum);
+    state->mismatches += blocknum < 10 || blocknum >= 10 + TEST_RUN || result != BLOCK_SIZE || memcmp(buf, expected, BLOCK_SIZE) != 0;
+    if (blocknum >= 10 && blocknum < 10 + TEST_RUN)
+    {
+        state->seen[blocknum - 10]++;
+    }
+
+    // The queue is full, so this reuses the slot of the request being completed.
+    if (blocknum == 10 && disk_async_read(100, state->extra, extra_done, state) != 0)
+    {
+        state->mismatches++;
+    }
+}
+
+int async_callback_test()
+{
+    uint8_t *data = disk_alloc_blocks(TEST_RUN + 1);
+    int result = 0;
+
+    if (data == NULL || disk_init(TEST_IMAGE, 128) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        disk_free_blocks(data);
+        return -1;
+    }
+
+    for (uint64_t b = 10; b < 10 + TEST_RUN; b++)
+    {
+        stamp_block(data, b);
+        disk_write(b, data);
+    }
+    stamp_block(data, 100);
+    disk_write(100, data);
+
+    // A callback of a readv queues a new request while the queue is full, on either engine.
+    for (int flags = 0; flags <= DISK_ASYNC_THREADS; flags += DISK_ASYNC_THREADS)
+    {
+        struct async_state state;
+        struct disk_iovec iov[TEST_RUN];
+
+        memset(&state, 0, sizeof(state));
+        memset(data, 0, (size_t)(TEST_RUN + 1) * BLOCK_SIZE);
+        state.extra = data + (size_t)TEST_RUN * BLOCK_SIZE;
+        for (int i = 0; i < TEST_RUN; i++)
+        {
+            iov[i].blocknum = 10 + i;
+            iov[i].buf = data + (size_t)i * BLOCK_SIZE;
+        }
+
+        if (disk_async_init(1, flags) != 0 || disk_async_readv(iov, TEST_RUN, run_done, &state) != 0 || disk_async_wait(0) < 0)
+        {
+            printf("\tERROR: Could not read blocks asynchronously.\n");
+            result = -1;
+            break;
+        }
+        disk_async_close();
+
+        for (int i = 0; i < TEST_RUN; i++)
+        {
+            state.mismatches += state.seen[i] != 1;
+        }
+        if (state.mismatches > 0 || state.extra_seen != 1)
+        {
+            printf("\tERROR: %d callback(s) of the %s engine ran wrong or not at all.\n", state.mismatches + (state.extra_seen != 1),
+                   flags ? "thread-pool" : "default");
+            result = -1;
+        }
+    }
+
+    disk_close(0);
+    disk_free_blocks(data);
+    return result;
+}
+
+/**
+ * Returns the version of block b written by snapshot_test() before the snapshot (1), after it
+ * (2), or 0 if it was never written, as seen from the snapshot or from the disk.
+ */
+static int thin_version(uint64_t b, int snapshot)
+{
+    if (!snapshot && b % 2 == 0)
+    {
+        return 2;
+    }
+    return b % 3 == 0 ? 1 : 0;
+}
+
+/**
+ * Fills buf with version v of block b: zeros for 0, stamped blocks otherwise.
+ */
+static void thin_fill(uint8_t *buf, uint64_t b, int v)
+{
+    if (v == 0)
+    {
+        memset(buf, 0, BLOCK_SIZE);
+        return;
+    }
+    stamp_block(buf, b ^ (uint64_t)v << 40);
+}
+
+/**
+ * Reads every block of d and counts those that are not the version seen from the snapshot, or
+ * from the disk.
+ */
+static int thin_mismatches(struct vdisk *d, int snapshot)
+{
+    uint8_t block[BLOCK_SIZE], expected[BLOCK_SIZE];
+    int mismatches = 0;
+
+    for (uint64_t b = 0; b < TEST_THIN_BLOCKS; b++)
+    {
+        thin_fill(expected, b, thin_version(b, snapshot));
+        mismatches += vdisk_read(d, b, block) != BLOCK_SIZE || memcmp(block, expected, BLOCK_SIZE) != 0;
+    }
+    return mismatches;
+}
+
+int snapshot_test()
+{
+    char *thin = "test/images/user/thin.img";
+    char *copy = "test/images/user/thin_copy.img";
+    uint8_t block[BLOCK_SIZE];
+    struct disk_thin_snapshot list[2];
+
+    if (disk_init_flags(thin, TEST_THIN_BLOCKS, DISK_THIN) == -1)
+    {
+        printf("\tERROR: Could not initialize a thin-provisioned disk.\n");
+        return -1;
+    }
+
+    // Every third block before the snapshot, every second one after it, half of them over
+    // blocks the snapshot holds.
+    for (uint64_t b = 0; b < TEST_THIN_BLOCKS; b += 3)
+    {
+        thin_fill(block, b, 1);
+        disk_write(b, block);
+    }
+    if (disk_thin_snapshot("before") != 0 || disk_thin_snapshot_list(list, 2) != 1 || strcmp(list[0].name, "before") != 0)
+    {
+        printf("\tERROR: Could not take a snapshot.\n");
+        disk_close(0);
+        return -1;
+    }
+    for (uint64_t b = 0; b < TEST_THIN_BLOCKS; b += 2)
+    {
+        thin_fill(block, b, 2);
+        disk_write(b, block);
+    }
+    disk_flush();
+
+    // The snapshot still reads the old versions while the disk is open, and refuses writes.
+    struct vdisk *snap = vdisk_thin_snapshot_open(thin, "before");
+    if (snap == NULL)
+    {
+        printf("\tERROR: Could not open the snapshot.\n");
+        disk_close(0);
+        return -1;
+    }
+    int old = thin_mismatches(snap, 1);
+    int written = vdisk_write(snap, 1, block) != -1;
+    int live = thin_mismatches(disk_default(), 0);
+    vdisk_close(snap, 0);
+    disk_close(0);
+
+    if (old > 0 || written || live > 0)
+    {
+        printf("\tERROR: %d block(s) of the snapshot and %d of the disk read back wrong%s.\n", old, live,
+               written ? ", and the snapshot was written" : "");
+        return -1;
+    }
+
+    // Rolling back brings the old versions back, and keeps the snapshot.
+    if (disk_thin_rollback(thin, "before") != 0 || disk_open(thin, DISK_THIN) != 0)
+    {
+        printf("\tERROR: Could not roll back to the snapshot.\n");
+        return -1;
+    }
+    old = thin_mismatches(disk_default(), 1);
+    int snapshots = disk_thin_snapshot_list(list, 2);
+    disk_close(0);
+
+    if (old > 0 || snapshots != 1)
+    {
+        printf("\tERROR: %d block(s) read back wrong after the rollback, which left %d snapshot(s).\n", old, snapshots);
+        return -1;
+    }
+
+    // Exporting and importing the image keeps its blocks.
+    int result = 0;
+    if (disk_thin_export(thin, TEST_IMAGE) != 0 || disk_thin_import(TEST_IMAGE, copy) != 0 || disk_open(copy, DISK_THIN) != 0)
+    {
+        printf("\tERROR: Could not export and import the image.\n");
+        result = -1;
+    }
+    else if ((old = thin_mismatches(disk_default(), 1)) > 0)
+    {
+        printf("\tERROR: %d block(s) read back wrong after export and import.\n", old);
+        result = -1;
+    }
+
+    disk_close(0);
+    truncate(TEST_IMAGE, 0);
+    unlink(copy);
+    unlink(thin);
+    return result;
+}
+
+/**
+ * Writes version v of the blocks from first up to, not including, last of the mirrored disk,
+ * every step-th one, and records it in versions.
+ */
+static void mirror_write(uint8_t *versions, uint64_t first, uint64_t last, uint64_t step, int v)
+{
+    uint8_t block[BLOCK_SIZE];
+
+    for (uint64_t b = first; b < last; b += step)
+    {
+        thin_fill(block, b, v);
+        disk_write(b, block);
+        versions[b] = v;
+    }
+}
+
+/**
+ * Reads every block of the default disk and counts those that are not the version recorded.
+ */
+static int mirror_mismatches(const uint8_t *versions)
+{
+    uint8_t block[BLOCK_SIZE], expected[BLOCK_SIZE];
+    int mismatches = 0;
+
+    for (uint64_t b = 0; b < TEST_MIRROR_BLOCKS; b++)
+    {
+        thin_fill(expected, b, versions[b]);
+        mismatches += disk_read(b, block) != BLOCK_SIZE || memcmp(block, expected, BLOCK_SIZE) != 0;
+    }
+    return mismatches;
+}
+
+/**
+ * Drops member `failed` of the default mirrored disk, writes version v of some blocks, puts
+ * `filename` back in its place and then drops the other member, so every block must be read
+ * from what the resync copied. Puts the other member back last.
+ */
+static int mirror_resync(char **members, uint8_t *versions, int failed, char *filename, int v)
+{
+    int other = 1 - failed;
+
+    if (disk_raid_fail(failed) != 0)
+    {
+        printf("\tERROR: Could not drop member %d.\n", failed);
+        return -1;
+    }
+
+    // A run inside one region, a block at the start of another, and the partial last region.
+    mirror_write(versions, DISK_RAID_REGION + 10 * v, DISK_RAID_REGION + 10 * v + 50, 1, v);
+    mirror_write(versions, 3 * DISK_RAID_REGION, 3 * DISK_RAID_REGION + 1, 1, v);
+    mirror_write(versions, TEST_MIRROR_BLOCKS - 1, TEST_MIRROR_BLOCKS, 1, v);
+
+    if (disk_raid_replace(failed, filename) != 0 || disk_raid_fail(other) != 0)
+    {
+        printf("\tERROR: Could not resync member %d from %s.\n", failed, filename);
+        return -1;
+    }
+
+    int mismatches = mirror_mismatches(versions);
+    if (mismatches > 0)
+    {
+        printf("\tERROR: %d block(s) read back wrong from member %d alone.\n", mismatches, failed);
+        return -1;
+    }
+
+    if (disk_raid_replace(other, members[other]) != 0)
+    {
+        printf("\tERROR: Could not put member %d back.\n", other);
+        return -1;
+    }
+    members[failed] = filename;
+    return 0;
+}
+
+int mirror_test()
+{
+    char *members[] = {member_name(0), member_name(1)};
+    char *fresh = member_name(2);
+    uint8_t *versions = calloc(TEST_MIRROR_BLOCKS, 1);
+    struct disk_raid_stats stats;
+
+    if (versions == NULL || disk_init_mirror(members, 2, TEST_MIRROR_BLOCKS, 0) == -1)
+    {
+        printf("\tERROR: Could not initialize a mirrored disk.\n");
+        free(versions);
+        return -1;
+    }
+    mirror_write(versions, 0, TEST_MIRROR_BLOCKS, 5, 1);
+
+    // Member 1 comes back as the same file, then as a new one, which gets every region.
+    int result = mirror_resync(members, versions, 1, members[1], 2);
+    if (result == 0)
+    {
+        result = mirror_resync(members, versions, 1, fresh, 3);
+    }
+    disk_close(0);
+
+    // The set opens with its members in any order, and either member holds every block.
+    char *shuffled[] = {members[1], members[0]};
+    if (result == 0 && disk_open_raid(shuffled, 2, 0) != 0)
+    {
+        printf("\tERROR: Could not reopen the mirrored disk.\n");
+        result = -1;
+    }
+    else if (result == 0)
+    {
+        disk_raid_get_stats(&stats);
+        int mismatches = mirror_mismatches(versions);
+        if (stats.failed == 0 && disk_raid_fail(0) == 0)
+        {
+            mismatches += mirror_mismatches(versions);
+        }
+        else
+        {
+            printf("\tERROR: The reopened disk is missing a member.\n");
+            result = -1;
+        }
+        if (mismatches > 0)
+        {
+            printf("\tERROR: %d block(s) read back wrong after reopening.\n", mismatches);
+            result = -1;
+        }
+        disk_close(0);
+    }
+
+    unlink(member_name(0));
+    unlink(member_name(1));
+    unlink(fresh);
+    free(versions);
+    return result;
+}
+
+/**
+ * Makes writes to the image past its first TEST_WRITABLE blocks fail, as on a full device, or
+ * lets them through again.
+ */
+static void fail_writes(int fail)
+{
+    struct rlimit limit;
+
+    signal(SIGXFSZ, SIG_IGN);
+    getrlimit(RLIMIT_FSIZE, &limit);
+    limit.rlim_cur = fail ? (rlim_t)TEST_WRITABLE * BLOCK_SIZE : limit.rlim_max;
+    setrlimit(RLIMIT_FSIZE, &limit);
+}
+
+/**
+ * Returns 1 if block b of the test image holds version v (see thin_fill()), read straight from
+ * the file rather than through the disk.
+ */
+static int image_holds(uint64_t b, int v)
+{
+    uint8_t block[BLOCK_SIZE], expected[BLOCK_SIZE];
+    int fd = open(TEST_IMAGE, O_RDONLY);
+    int ok = fd >= 0 && pread(fd, block, BLOCK_SIZE, (off_t)(b * BLOCK_SIZE)) == BLOCK_SIZE;
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    thin_fill(expected, b, v);
+    return ok && memcmp(block, expected, BLOCK_SIZE) == 0;
+}
+
+/**
+ * Returns 1 if block b reads back through the disk as version v.
+ */
+static int disk_holds(uint64_t b, int v)
+{
+    uint8_t block[BLOCK_SIZE], expected[BLOCK_SIZE];
+
+    thin_fill(expected, b, v);
+    return disk_read(b, block) == BLOCK_SIZE && memcmp(block, expected, BLOCK_SIZE) == 0;
+}
+
+int sched_test()
+{
+    uint8_t block[BLOCK_SIZE];
+    struct disk_sched_stats stats;
+
+    if (disk_init(TEST_IMAGE, 2 * TEST_WRITABLE) == -1 || disk_sched_init(8, 0) == -1)
+    {
+        printf("\tERROR: Could not start the scheduler.\n");
+        disk_close(0);
+        return -1;
+    }
+
+    // A rewrite of a queued block replaces its data, and reads are answered from the queue.
+    for (uint64_t b = 10; b < 13; b++)
+    {
+        thin_fill(block, b, 1);
+        disk_write(b, block);
+    }
+    thin_fill(block, 11, 2);
+    disk_write(11, block);
+    disk_sched_get_stats(&stats);
+    if (stats.queued != 3 || stats.absorbed != 1 || !disk_holds(11, 2) || image_holds(11, 2))
+    {
+        printf("\tERROR: The queue did not merge or answer the writes.\n");
+        disk_close(0);
+        return -1;
+    }
+
+    // The three blocks go out as one run.
+    disk_sched_get_stats(&stats);
+    if (disk_flush() != 0 || !image_holds(10, 1) || !image_holds(11, 2) || !image_holds(12, 1))
+    {
+        printf("\tERROR: The queue was not written out.\n");
+        disk_close(0);
+        return -1;
+    }
+    uint64_t runs = stats.runs;
+    disk_sched_get_stats(&stats);
+    if (stats.runs != runs + 1 || stats.read_hits != 1)
+    {
+        printf("\tERROR: The queue went out in %llu runs.\n", (unsigned long long)(stats.runs - runs));
+        disk_close(0);
+        return -1;
+    }
+
+    // A dispatch that fails keeps the blocks queued, readable, and written by the next flush.
+    thin_fill(block, TEST_WRITABLE + 1, 1);
+    disk_write(TEST_WRITABLE + 1, block);
+    fail_writes(1);
+    int failed = disk_flush() != 0 && disk_flush() != 0;
+    int kept = disk_holds(TEST_WRITABLE + 1, 1);
+    fail_writes(0);
+    if (!failed || !kept || disk_flush() != 0 || !image_holds(TEST_WRITABLE + 1, 1))
+    {
+        printf("\tERROR: A failed dispatch %s.\n", !failed ? "was reported written" : "lost its blocks");
+        disk_close(0);
+        return -1;
+    }
+
+    // So does closing the disk with a queue that cannot be written.
+    disk_write(TEST_WRITABLE + 2, block);
+    fail_writes(1);
+    int closed = disk_close(0);
+    fail_writes(0);
+    if (closed != -1)
+    {
+        printf("\tERROR: The disk closed cleanly with its queue unwritten.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int cache_test()
+{
+    uint8_t block[BLOCK_SIZE];
+    struct cache_stats stats;
+
+    if (disk_init(TEST_IMAGE, 2 * TEST_WRITABLE) == -1 || cache_init(16) == -1)
+    {
+        printf("\tERROR: Could not enable the cache.\n");
+        disk_close(0);
+        return -1;
+    }
+
+    // A write stays in the cache until it is synced.
+    thin_fill(block, 5, 1);
+    disk_write(5, block);
+    if (!disk_holds(5, 1) || image_holds(5, 1) || cache_sync() != 0 || !image_holds(5, 1))
+    {
+        printf("\tERROR: The cache did not write the block back.\n");
+        disk_close(0);
+        return -1;
+    }
+    cache_get_stats(&stats);
+    if (stats.writebacks != 1)
+    {
+        printf("\tERROR: The cache counted %llu write-backs.\n", (unsigned long long)stats.writebacks);
+        disk_close(0);
+        return -1;
+    }
+
+    // A sync that fails keeps the block dirty, readable, and written by the next flush.
+    thin_fill(block, TEST_WRITABLE + 1, 1);
+    disk_write(TEST_WRITABLE + 1, block);
+    fail_writes(1);
+    int failed = cache_sync() != 0 && disk_flush() != 0;
+    int kept = disk_holds(TEST_WRITABLE + 1, 1);
+    fail_writes(0);
+    if (!failed || !kept || disk_flush() != 0 || !image_holds(TEST_WRITABLE + 1, 1))
+    {
+        printf("\tERROR: A failed write-back %s.\n", !failed ? "was reported written" : "lost its block");
+        disk_close(0);
+        return -1;
+    }
+
+    // Closing the disk with a block that cannot be written back is not clean.
+    disk_write(TEST_WRITABLE + 2, block);
+    fail_writes(1);
+    int closed = disk_close(0);
+    fail_writes(0);
+    if (closed != -1)
+    {
+        printf("\tERROR: The disk closed cleanly with a dirty block unwritten.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int readahead_test()
+{
+    char *members[TEST_HUGE_MEMBERS];
+    uint64_t base = (1ull << 32) + 8; // the file's first block, past 2^32
+    uint8_t block[BLOCK_SIZE], expected[BLOCK_SIZE];
+    union block indirect;
+    struct inode_v2 inode;
+    struct cache_stats stats;
+
+    for (int i = 0; i < TEST_HUGE_MEMBERS; i++)
+    {
+        members[i] = member_name(i);
+    }
+
+    if (disk_init_raid(members, TEST_HUGE_MEMBERS, TEST_HUGE_BLOCKS, 0, 0) == -1)
+    {
+        printf("\tERROR: Could not stripe a %llu-block disk across %d images.\n", (unsigned long long)TEST_HUGE_BLOCKS,
+               TEST_HUGE_MEMBERS);
+        return -1;
+    }
+
+    // A version 2 file of stamped blocks from `base` on, its indirect block just before them.
+    memset(&inode, 0, sizeof(inode));
+    memset(&indirect, 0, sizeof(indirect));
+    inode.i_size = (uint64_t)TEST_RA_BLOCKS * BLOCK_SIZE;
+    inode.i_single_indirect_pointer = base - 1;
+    for (uint64_t i = 0; i < TEST_RA_BLOCKS; i++)
+    {
+        if (i < INODE_V2_DIRECT_POINTERS)
+        {
+            inode.i_direct_pointers[i] = base + i;
+        }
+        else
+        {
+            indirect.pointers_v2[i - INODE_V2_DIRECT_POINTERS] = base + i;
+        }
+        stamp_block(block, base + i);
+        disk_write(base + i, block);
+    }
+    disk_write(base - 1, indirect.data);
+
+    if (cache_init(4 * TEST_RA_WINDOW) == -1 || readahead_init(TEST_RA_WINDOW) == -1)
+    {
+        printf("\tERROR: Could not start read-ahead.\n");
+        disk_close(0);
+        return -1;
+    }
+
+    // Read the file in order; once the window is open, the blocks are already in the cache.
+    int mismatches = 0;
+    for (uint64_t i = 0; i < TEST_RA_BLOCKS; i++)
+    {
+        readahead_access_v2(1, &inode, i);
+        stamp_block(expected, base + i);
+        if (disk_read(base + i, block) != BLOCK_SIZE || memcmp(block, expected, BLOCK_SIZE) != 0)
+        {
+            mismatches++;
+        }
+    }
+    cache_get_stats(&stats);
+    readahead_close();
+
+    int result = 0;
+    if (mismatches > 0)
+    {
+        printf("\tERROR: %d block(s) of the file read back wrong.\n", mismatches);
+        result = -1;
+    }
+    else if (stats.prefetches < TEST_RA_BLOCKS - READAHEAD_MIN_WINDOW || stats.misses > READAHEAD_MIN_WINDOW)
+    {
+        printf("\tERROR: Read-ahead prefetched %llu blocks, and %llu reads missed the cache.\n",
+               (unsigned long long)stats.prefetches, (unsigned long long)stats.misses);
+        result = -1;
+    }
+
+    disk_close(0);
+    for (int i = 0; i < TEST_HUGE_MEMBERS; i++)
+    {
+        unlink(members[i]);
+    }
+    return result;
+}
+
+/**
+ * Allocates a bit from goal and checks that it is `expected` and that `nfree` bits are left.
+ */
+static int check_alloc(struct bitmap *b, uint64_t goal, uint64_t expected, uint64_t nfree)
+{
+    uint64_t bit = 0;
+
+    if (bitmap_alloc(b, goal, &bit) != 0 || bit != expected || bitmap_free(b) != nfree)
+    {
+        printf("\tERROR: Allocating from bit %llu gave bit %llu with %llu free, not bit %llu with %llu.\n",
+               (unsigned long long)goal, (unsigned long long)bit, (unsigned long long)bitmap_free(b),
+               (unsigned long long)expected, (unsigned long long)nfree);
+        return -1;
+    }
+    return 0;
+}
+
+int bitmap_blocks_test()
+{
+    uint64_t nfree = TEST_BITMAP_BITS;
+    uint64_t bit = 0;
+
+    if (disk_init(TEST_IMAGE, TEST_BITMAP_FIRST + BITMAP_BLOCKS(TEST_BITMAP_BITS)) == -1)
+    {
+        printf("\tERROR: Could not initialize disk.\n");
+        return -1;
+    }
+
+    struct bitmap *b = bitmap_create(disk_default(), TEST_BITMAP_FIRST, TEST_BITMAP_BITS);
+    if (b == NULL || bitmap_free(b) != nfree)
+    {
+        printf("\tERROR: Could not create a bitmap of %llu bits.\n", (unsigned long long)TEST_BITMAP_BITS);
+        bitmap_close(b);
+        disk_close(0);
+        return -1;
+    }
+
+    // The last bit of the first bitmap block, then the first of the second as the search moves on.
+    int result = check_alloc(b, BITMAP_BITS_PER_BLOCK - 1, BITMAP_BITS_PER_BLOCK - 1, --nfree);
+    if (result == 0)
+    {
+        result = check_alloc(b, BITMAP_BITS_PER_BLOCK - 1, BITMAP_BITS_PER_BLOCK, --nfree);
+    }
+
+    // A full bitmap block is passed over for the next one with a clear bit.
+    for (uint64_t i = BITMAP_BITS_PER_BLOCK + 1; result == 0 && i < 2 * BITMAP_BITS_PER_BLOCK; i++)
+    {
+        result = bitmap_set(b, i);
+        nfree--;
+    }
+    if (result == 0)
+    {
+        result = check_alloc(b, BITMAP_BITS_PER_BLOCK + 5, 2 * BITMAP_BITS_PER_BLOCK, --nfree);
+    }
+
+    // From a set last bit the search wraps around to bit 0, ahead of the clear bits below it.
+    if (result == 0)
+    {
+        result = bitmap_set(b, TEST_BITMAP_BITS - 1);
+        nfree--;
+    }
+    if (result == 0)
+    {
+        result = check_alloc(b, TEST_BITMAP_BITS - 1, 0, --nfree);
+    }
+
+    // The free counts are rebuilt from the blocks on reopening.
+    bitmap_close(b);
+    b = result == 0 ? bitmap_open(disk_default(), TEST_BITMAP_FIRST, TEST_BITMAP_BITS) : NULL;
+    if (result == 0 && (b == NULL || bitmap_free(b) != nfree || bitmap_test(b, TEST_BITMAP_BITS - 1) != 1 ||
+                        bitmap_test(b, TEST_BITMAP_BITS - 2) != 0))
+    {
+        printf("\tERROR: The reopened bitmap differs, with %llu free bits rather than %llu.\n",
+               (unsigned long long)(b != NULL ? bitmap_free(b) : 0), (unsigned long long)nfree);
+        result = -1;
+    }
+
+    // Once every bit is set nothing is handed out, not even the padding past the last bit.
+    for (uint64_t i = 0; result == 0 && i < TEST_BITMAP_BITS; i++)
+    {
+        result = bitmap_set(b, i);
+    }
+    if (result == 0 && (bitmap_free(b) != 0 || bitmap_alloc(b, 0, &bit) != -1))
+    {
+        printf("\tERROR: A full bitmap handed out bit %llu.\n", (unsigned long long)bit);
+        result = -1;
+    }
+
+    // A bit cleared in the last block is found from the start.
+    if (result == 0 && bitmap_clear(b, 3 * BITMAP_BITS_PER_BLOCK + 3) == 0)
+    {
+        result = check_alloc(b, 0, 3 * BITMAP_BITS_PER_BLOCK + 3, 0);
+    }
+
+    bitmap_close(b);
+    disk_close(0);
+    return result;
+}
+
+int main()
+{
+    int total = 10;
+    int passed = 0;
+
+    printf("\tTesting the disk layer...\n");
+    if (huge_test() == -1)
+    {
+        printf("\t❌ Test Failed: Huge Image.\n");
+    }
+    else
+    {
+        printf("\t✅ Test Passed: Huge Image.\n");
+        passed += 1;
+    }
+
+    if (striped_huge_test() == -1)
+    {
+        printf("\t❌ Test Failed: Huge Striped Disk.\n");
+    }
+    else
+    {
+        printf("\t✅ Test Passed: Huge Striped Disk.\n");
+        passed += 1;
+    }
+
+    if (max_blocks_test() == -1)
+    {
+        printf("\t❌ Test Failed: Block Count Limit.\n");
+    }
+    else
+    {
+        printf("\t✅ Test Passed: Block Count Limit.\n");
+        passed += 1;
+    }
+
+    if (async_callback_test() == -1)
+    {
+        printf("\t❌ Test Failed: Requests Queued From Callbacks.\n");
+    }
+    else
+    {
+        printf("\t✅ Test Passed: Requests Queued From Callbacks.\n");
+        passed += 1;
+    }
+
+    if (snapshot_test() == -1)
+    {
+        printf("\t❌ Test Failed: Thin Snapshots.\n");
+    }
+    else
+    {
+        printf("\t✅ Test Passed: Thin Snapshots.\n");
+        passed += 1;
+    }
+
+    if (mirror_test() == -1)
+    {
+        printf("\t❌ Test Failed: Mirror Resync.\n");
+    }
+    else
+    {
+        printf("\t✅ Test Passed: Mirror Resync.\n");
+        passed += 1;
+    }
+
+    if (cache_test() == -1)
+    {
+        printf("\t❌ Test Failed: Write-Back Cache.\n");
+    }
+    else
+    {
+        printf("\t✅ Test Passed: Write-Back Cache.\n");
+        passed += 1;
+    }
+
+    if (sched_test() == -1)
+    {
+        printf("\t❌ Test Failed: Scheduler Queue.\n");
+    }
+    else
+    {
+        printf("\t✅ Test Passed: Scheduler Queue.\n");
+        passed += 1;
+    }
+
+    if (readahead_test() == -1)
+    {
+        printf("\t❌ Test Failed: Read-Ahead Past 2^32 Blocks.\n");
+    }
+    else
+    {
+        printf("\t✅ Test Passed: Read-Ahead Past 2^32 Blocks.\n");
+        passed += 1;
+    }
+
+    if (bitmap_blocks_test() == -1)
+    {
+        printf("\t❌ Test Failed: Multi-Block Bitmap.\n");
+    }
+    else
+    {
+        printf("\t✅ Test Passed: Multi-Block Bitmap.\n");
+        passed += 1;
+    }
+
+    printf("\t%d/%d Disk test(s) passed.\n", passed, total);
+
+    return passed == total ? 0 : 1;
+}
\ No newline at end of file